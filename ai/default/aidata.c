@@ -40,6 +40,7 @@
 #include "daicity.h"
 #include "daidiplomacy.h"
 #include "daieffects.h"
+#include "daimilitary.h"
 
 #include "aidata.h"
 
@@ -93,6 +94,7 @@ void dai_data_init(struct ai_type *ait, struct player *pplayer)
   ai->diplomacy.req_love_for_alliance = MAX_AI_LOVE / 4;
 
   ai->settler = NULL;
+  ai->threats = NULL;
 
   /* Initialise autosettler. */
   dai_auto_settler_init(ai);
@@ -112,6 +114,8 @@ void dai_data_close(struct ai_type *ait, struct player *pplayer)
   /* Free autosettler. */
   dai_auto_settler_free(ai);
 
+  dai_threat_map_free(ait, pplayer);
+
   if (ai->diplomacy.player_intel_slots != NULL) {
     players_iterate(aplayer) {
       /* destroy the ai diplomacy states of this player with others ... */
@@ -158,6 +162,9 @@ void dai_data_phase_begin(struct ai_type *ait, struct player *pplayer,
 
   ai->phase_initialized = TRUE;
 
+  /* Enemy units may have moved since the threat map was made. */
+  dai_threat_map_free(ait, pplayer);
+
   adv = adv_data_get(pplayer, &caller_closes);
 
   /* Store current number of known continents and oceans so we can compare
@@ -284,6 +291,8 @@ void dai_data_phase_finished(struct ai_type *ait, struct player *pplayer)
   free(ai->stats.ocean_workers);
   ai->stats.ocean_workers = NULL;
 
+  dai_threat_map_free(ait, pplayer);
+
   ai->phase_initialized = FALSE;
 }
 
@@ -451,9 +460,7 @@ void dai_adjust_policies(struct ai_type *ait, struct player *pplayer)
 
         pplayer->multipliers[pidx] = MAX(mp_val - ppol->step, ppol->start);
 
-        city_list_iterate(pplayer->cities, acity) {
-          auto_arrange_workers(acity);
-        } city_list_iterate_end;
+        auto_arrange_workers_for_player(pplayer);
 
         city_list_iterate(pplayer->cities, pcity) {
           new_value += dai_city_want(pplayer, pcity, adv, NULL);
@@ -474,9 +481,7 @@ void dai_adjust_policies(struct ai_type *ait, struct player *pplayer)
 
         pplayer->multipliers[pidx] = MIN(mp_val + ppol->step, ppol->stop);
 
-        city_list_iterate(pplayer->cities, acity) {
-          auto_arrange_workers(acity);
-        } city_list_iterate_end;
+        auto_arrange_workers_for_player(pplayer);
 
         city_list_iterate(pplayer->cities, pcity) {
           new_value += dai_city_want(pplayer, pcity, adv, NULL);
@@ -500,9 +505,7 @@ void dai_adjust_policies(struct ai_type *ait, struct player *pplayer)
   } multipliers_iterate_end;
 
   if (needs_back_rearrange) {
-    city_list_iterate(pplayer->cities, acity) {
-      auto_arrange_workers(acity);
-    } city_list_iterate_end;
+    auto_arrange_workers_for_player(pplayer);
   }
 }
 
@@ -535,9 +538,7 @@ void dai_gov_value(struct ai_type *ait, struct player *pplayer,
   /* Ideally we should change tax rates here, but since
    * this is a rather big CPU operation, we'd rather not. */
   check_player_max_rates(pplayer);
-  city_list_iterate(pplayer->cities, acity) {
-    auto_arrange_workers(acity);
-  } city_list_iterate_end;
+  auto_arrange_workers_for_player(pplayer);
   city_list_iterate(pplayer->cities, pcity) {
     bool capital;
 
@@ -101,6 +101,9 @@ struct ai_plr
   /* Cache map for AI settlers; defined in aisettler.c. */
   struct ai_settler *settler;
 
+  /* Enemy threats to our cities; defined in daimilitary.c. */
+  struct dai_threat_map *threats;
+
   /* The units of tech_want seem to be shields */
   adv_want tech_want[A_LAST+1];
 };
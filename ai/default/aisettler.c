@@ -28,10 +28,12 @@
 #include "city.h"
 #include "game.h"
 #include "government.h"
+#include "improvement.h"
 #include "map.h"
 #include "movement.h"
 #include "packets.h"
 #include "player.h"
+#include "research.h"
 
 /* common/aicore */
 #include "citymap.h"
@@ -126,6 +128,12 @@ struct tile_data_cache {
   int reserved; /* reservation for this tile; used by print_citymap() */
 
   int turn;     /* the turn the values were calculated */
+
+  /* The state of the tile when the values were calculated. The cached
+   * values are kept across turns until this changes. */
+  const struct terrain *terrain;
+  bv_extras extras;
+  const struct player *owner;
 };
 
 
@@ -144,6 +152,24 @@ static void tile_data_cache_destroy(struct tile_data_cache *ptdc);
 struct ai_settler {
   struct tile_data_cache_hash *tdc_hash;
 
+  /* The player state the cached tile values depend on. The cache is
+   * cleared when it changes, which is checked once per turn. */
+  struct {
+    int turn;
+    const struct government *gov;
+    int food_priority;
+    int shield_priority;
+    int science_priority;
+    genhash_val_t research;
+    genhash_val_t wonders;
+  } context;
+
+  /* The state of every tile when the context was last checked, see
+   * tdc_tile_state_val(). The cached values within city radius of a
+   * tile are dropped when it changes. */
+  genhash_val_t *tile_states;
+  int tile_states_size;
+
 #ifdef FREECIV_DEBUG
   struct {
     int hit;
@@ -188,6 +214,8 @@ static const struct tile_data_cache *tdc_plr_get(struct ai_type *ait,
                                                  int tindex);
 static void tdc_plr_set(struct ai_type *ait, struct player *plr, int tindex,
                         const struct tile_data_cache *tdcache);
+static void tdc_plr_check_context(struct player *plr,
+                                  struct ai_settler *settler);
 
 static struct cityresult *cityresult_new(struct tile *ptile);
 static void cityresult_destroy(struct cityresult *result);
@@ -346,7 +374,12 @@ static struct cityresult *cityresult_fill(struct ai_type *ait,
         if (!city_center && virtual_city) {
           /* real cities and any city center will give us spossibly
            * skewed results */
-          tdc_plr_set(ait, pplayer, tindex, tile_data_cache_copy(ptdc));
+          struct tile_data_cache *ptdc_save = tile_data_cache_copy(ptdc);
+
+          ptdc_save->terrain = tile_terrain(ptile);
+          ptdc_save->extras = *tile_extras(ptile);
+          ptdc_save->owner = tile_owner(ptile);
+          tdc_plr_set(ait, pplayer, tindex, ptdc_save);
         }
       } else {
         ptdc = tile_data_cache_copy(ptdc_hit);
@@ -483,6 +516,10 @@ struct tile_data_cache *
   ptdc_copy->reserved = ptdc->reserved;
   ptdc_copy->turn = ptdc->turn;
 
+  ptdc_copy->terrain = ptdc->terrain;
+  ptdc_copy->extras = ptdc->extras;
+  ptdc_copy->owner = ptdc->owner;
+
   return ptdc_copy;
 }
 
@@ -496,6 +533,147 @@ static void tile_data_cache_destroy(struct tile_data_cache *ptdc)
   }
 }
 
+/*************************************************************************//**
+  Return a value which changes when the wonders the player has, or the
+  great wonders of the world, change.
+*****************************************************************************/
+static genhash_val_t tdc_wonders_val(const struct player *plr)
+{
+  genhash_val_t val = 0;
+
+  improvement_iterate(pimprove) {
+    if (is_wonder(pimprove)) {
+      int idx = improvement_index(pimprove);
+
+      val = val * 31 + plr->wonders[idx];
+      if (is_great_wonder(pimprove)) {
+        val = val * 31 + game.info.great_wonder_owners[idx];
+      }
+    }
+  } improvement_iterate_end;
+
+  return val;
+}
+
+/*************************************************************************//**
+  Return a value which changes when the techs known by the player, or the
+  techs known anywhere in the world, change.
+*****************************************************************************/
+static genhash_val_t tdc_research_val(const struct player *plr)
+{
+  const struct research *presearch = research_get(plr);
+  genhash_val_t val = 0;
+
+  advance_index_iterate(A_FIRST, tech) {
+    val = val * 31 + research_invention_state(presearch, tech);
+    val = val * 31 + game.info.global_advances[tech];
+  } advance_index_iterate_end;
+
+  return val;
+}
+
+/*************************************************************************//**
+  Return a value which changes when the terrain, the extras or the owner
+  of the tile change.
+*****************************************************************************/
+static genhash_val_t tdc_tile_state_val(const struct tile *ptile)
+{
+  const struct terrain *pterrain = tile_terrain(ptile);
+  const struct player *owner = tile_owner(ptile);
+  const bv_extras *pextras = tile_extras(ptile);
+  genhash_val_t val;
+  size_t i;
+
+  val = (NULL != pterrain ? terrain_index(pterrain) + 1 : 0);
+  val = val * 31 + (NULL != owner ? player_index(owner) + 1 : 0);
+  for (i = 0; i < sizeof(pextras->vec); i++) {
+    val = val * 31 + pextras->vec[i];
+  }
+
+  return val;
+}
+
+/*************************************************************************//**
+  Drop the cached values within city radius of the tiles which changed
+  since the last check. A tile value also depends on the tiles around it,
+  for example through adjacent range requirements or the city center.
+*****************************************************************************/
+static void tdc_plr_check_tiles(struct ai_settler *settler)
+{
+  int radius_sq;
+
+  if (settler->tile_states_size != MAP_INDEX_SIZE) {
+    /* First check, or a new map. */
+    free(settler->tile_states);
+    settler->tile_states = fc_malloc(MAP_INDEX_SIZE
+                                     * sizeof(*settler->tile_states));
+    settler->tile_states_size = MAP_INDEX_SIZE;
+    whole_map_iterate(&(wld.map), ptile) {
+      settler->tile_states[tile_index(ptile)] = tdc_tile_state_val(ptile);
+    } whole_map_iterate_end;
+    tile_data_cache_hash_clear(settler->tdc_hash);
+    return;
+  }
+
+  radius_sq = rs_max_city_radius_sq();
+  whole_map_iterate(&(wld.map), ptile) {
+    int tindex = tile_index(ptile);
+    genhash_val_t state = tdc_tile_state_val(ptile);
+
+    if (settler->tile_states[tindex] != state) {
+      settler->tile_states[tindex] = state;
+      if (tile_data_cache_hash_size(settler->tdc_hash) > 0) {
+        circle_iterate(&(wld.map), ptile, radius_sq, atile) {
+          tile_data_cache_hash_remove(settler->tdc_hash, tile_index(atile));
+        } circle_iterate_end;
+      }
+    }
+  } whole_map_iterate_end;
+}
+
+/*************************************************************************//**
+  Once per turn, check whether the player state the cached tile values
+  depend on has changed, and clear the cache if so. The values depend on
+  the government the AI aims at, its priorities, and the effects active
+  for the player, which change with techs and wonders. Then drop the
+  values around the tiles which changed.
+*****************************************************************************/
+static void tdc_plr_check_context(struct player *plr,
+                                  struct ai_settler *settler)
+{
+  struct adv_data *adv;
+  genhash_val_t research;
+  genhash_val_t wonders;
+
+  if (settler->context.turn == game.info.turn) {
+    return;
+  }
+
+  adv = adv_data_get(plr, NULL);
+  research = tdc_research_val(plr);
+  wonders = tdc_wonders_val(plr);
+
+  if (settler->context.gov != adv->goal.govt.gov
+      || settler->context.food_priority != adv->food_priority
+      || settler->context.shield_priority != adv->shield_priority
+      || settler->context.science_priority != adv->science_priority
+      || settler->context.research != research
+      || settler->context.wonders != wonders) {
+    tile_data_cache_hash_clear(settler->tdc_hash);
+
+    settler->context.gov = adv->goal.govt.gov;
+    settler->context.food_priority = adv->food_priority;
+    settler->context.shield_priority = adv->shield_priority;
+    settler->context.science_priority = adv->science_priority;
+    settler->context.research = research;
+    settler->context.wonders = wonders;
+  }
+
+  tdc_plr_check_tiles(settler);
+
+  settler->context.turn = game.info.turn;
+}
+
 /*************************************************************************//**
   Return player's tile data cache
 *****************************************************************************/
@@ -510,7 +688,9 @@ static const struct tile_data_cache *tdc_plr_get(struct ai_type *ait,
   fc_assert_ret_val(ai->settler->tdc_hash != NULL, NULL);
 
   struct tile_data_cache *ptdc;
+  const struct tile *ptile;
 
+  tdc_plr_check_context(plr, ai->settler);
   tile_data_cache_hash_lookup(ai->settler->tdc_hash, tindex, &ptdc);
 
   if (!ptdc) {
@@ -518,7 +698,12 @@ static const struct tile_data_cache *tdc_plr_get(struct ai_type *ait,
     ai->settler->cache.miss++;
 #endif /* FREECIV_DEBUG */
     return NULL;
-  } else if (ptdc->turn != game.info.turn) {
+  }
+
+  ptile = index_to_tile(&(wld.map), tindex);
+  if (ptdc->terrain != tile_terrain(ptile)
+      || !BV_ARE_EQUAL(ptdc->extras, *tile_extras(ptile))
+      || ptdc->owner != tile_owner(ptile)) {
 #ifdef FREECIV_DEBUG
     ai->settler->cache.old++;
 #endif /* FREECIV_DEBUG */
@@ -997,6 +1182,7 @@ void dai_auto_settler_init(struct ai_plr *ai)
 
   ai->settler = fc_calloc(1, sizeof(*ai->settler));
   ai->settler->tdc_hash = tile_data_cache_hash_new();
+  ai->settler->context.turn = -1;
 
 #ifdef FREECIV_DEBUG
   ai->settler->cache.hit = 0;
@@ -1206,7 +1392,9 @@ void dai_auto_settler_reset(struct ai_type *ait, struct player *pplayer)
   ai->settler->cache.save = 0;
 #endif /* FREECIV_DEBUG */
 
-  tile_data_cache_hash_clear(ai->settler->tdc_hash);
+  /* The cached tile values are kept for the next turns; they are checked
+   * against the tile and the player state when read. */
+  tdc_plr_check_context(pplayer, ai->settler);
 
   if (caller_closes) {
     dai_data_phase_finished(ait, pplayer);
@@ -1224,6 +1412,7 @@ void dai_auto_settler_free(struct ai_plr *ai)
     if (ai->settler->tdc_hash) {
       tile_data_cache_hash_destroy(ai->settler->tdc_hash);
     }
+    free(ai->settler->tile_states);
     free(ai->settler);
   }
   ai->settler = NULL;
@@ -35,6 +35,7 @@
 
 /* common/aicore */
 #include "citymap.h"
+#include "pf_hierarchy.h"
 #include "pf_tools.h"
 
 /* server */
@@ -427,8 +428,13 @@ bool dai_unit_goto_constrained(struct ai_type *ait, struct unit *punit,
     return TRUE;
   }
 
-  pfm = pf_map_new(parameter);
-  path = pf_map_path(pfm, ptile);
+  if (game.server.pf_hierarchy) {
+    path = pf_hierarchy_path(parameter, ptile);
+  } else {
+    pfm = pf_map_new(parameter);
+    path = pf_map_path(pfm, ptile);
+    pf_map_destroy(pfm);
+  }
 
   if (path) {
     dai_log_path(punit, path, parameter);
@@ -439,7 +445,6 @@ bool dai_unit_goto_constrained(struct ai_type *ait, struct unit *punit,
   }
 
   pf_path_destroy(path);
-  pf_map_destroy(pfm);
 
   return alive;
 }
@@ -1115,9 +1120,7 @@ void dai_government_change(struct player *pplayer, struct government *gov)
 
   handle_player_change_government(pplayer, government_number(gov));
 
-  city_list_iterate(pplayer->cities, pcity) {
-    auto_arrange_workers(pcity); /* update cities */
-  } city_list_iterate_end;
+  auto_arrange_workers_for_player(pplayer); /* update cities */
 }
 
 /**********************************************************************//**
@@ -1502,6 +1502,9 @@ static adv_want base_want(struct ai_type *ait, struct player *pplayer,
     }
 
     pplayer->wonders[improvement_index(pimprove)] = wonder_city_id;
+    /* The wonder state is back to what the cached requirements saw
+     * before city_remove_improvement(). */
+    req_cache_invalidate();
   }
 
   return final_want;
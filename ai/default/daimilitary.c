@@ -18,7 +18,10 @@
 #include <string.h>
 
 /* utility */
+#include "bitvector.h"
+#include "fcthreadpool.h"
 #include "log.h"
+#include "mem.h"
 
 /* common */
 #include "combat.h"
@@ -26,6 +29,7 @@
 #include "government.h"
 #include "map.h"
 #include "movement.h"
+#include "requirements.h"
 #include "research.h"
 #include "specialist.h"
 #include "unitlist.h"
@@ -349,10 +353,541 @@ static int assess_defense_igwall(struct ai_type *ait, struct city *pcity)
   return assess_defense_backend(ait, pcity, TRUE);
 }
 
+/* The threat map tells how many turns the units of the other players
+ * need to reach the cities of an AI player. A path-finding map is built
+ * once for each unit position and type, and gives the turns to all the
+ * cities at once, instead of one reverse map per city and player. It
+ * gives the same turns as the reverse maps, where only the city looked
+ * up is an attack target: the unit goes through our other cities as it
+ * would there, and the attack of each city is evaluated from its
+ * adjacent tiles by dai_threat_get_MC(). It is kept until the end of the
+ * phase; a unit which moved meanwhile gets a new entry. */
+struct dai_threat_key {
+  const struct player *owner;
+  const struct tile *start_tile;
+  const struct unit_type *utype;
+  int move_rate;
+};
+
+struct dai_threat_reach {
+  int num_cities;
+  struct {
+    int tindex;
+    int turn;
+  } *cities;
+};
+
+static genhash_val_t dai_threat_key_val(const struct dai_threat_key *key);
+static bool dai_threat_key_comp(const struct dai_threat_key *key1,
+                                const struct dai_threat_key *key2);
+static void dai_threat_key_free(struct dai_threat_key *key);
+static void dai_threat_reach_free(struct dai_threat_reach *reach);
+
+#define SPECHASH_TAG dai_threat
+#define SPECHASH_IKEY_TYPE struct dai_threat_key *
+#define SPECHASH_IDATA_TYPE struct dai_threat_reach *
+#define SPECHASH_IKEY_VAL dai_threat_key_val
+#define SPECHASH_IKEY_COMP dai_threat_key_comp
+#define SPECHASH_IKEY_FREE dai_threat_key_free
+#define SPECHASH_IDATA_FREE dai_threat_reach_free
+#include "spechash.h"
+
+struct dai_threat_map {
+  int max_turns;
+  bool omniscient;
+  struct dbv targets;         /* Our city tiles when the map was made. */
+  int num_cities;
+  int *cities;                /* The index of these tiles. */
+  struct dai_threat_hash *hash;
+  struct pf_map *pfm;         /* Recycled between the entries. */
+  bool filled;                /* See dai_threat_map_fill(). */
+};
+
+/**********************************************************************//**
+  Hash function for the threat map keys.
+**************************************************************************/
+static genhash_val_t dai_threat_key_val(const struct dai_threat_key *key)
+{
+  return (tile_index(key->start_tile)
+          + (utype_index(key->utype) << 16)
+          + (player_index(key->owner) << 24)
+          + (key->move_rate << 8));
+}
+
+/**********************************************************************//**
+  Comparison function for the threat map keys.
+**************************************************************************/
+static bool dai_threat_key_comp(const struct dai_threat_key *key1,
+                                const struct dai_threat_key *key2)
+{
+  return (key1->start_tile == key2->start_tile
+          && key1->utype == key2->utype
+          && key1->owner == key2->owner
+          && key1->move_rate == key2->move_rate);
+}
+
+/**********************************************************************//**
+  Free a threat map key.
+**************************************************************************/
+static void dai_threat_key_free(struct dai_threat_key *key)
+{
+  free(key);
+}
+
+/**********************************************************************//**
+  Free a threat map entry.
+**************************************************************************/
+static void dai_threat_reach_free(struct dai_threat_reach *reach)
+{
+  free(reach->cities);
+  free(reach);
+}
+
+/* The state of the search of dai_threat_reach_fill(). */
+struct dai_threat_search {
+  const struct dai_threat_map *threats;
+  int (*get_MC) (const struct tile *from_tile,
+                 enum pf_move_scope src_move_scope,
+                 const struct tile *to_tile,
+                 enum pf_move_scope dst_move_scope,
+                 const struct pf_parameter *param);
+  int attack_cost;            /* The cost of the attack move. */
+  int cost;                   /* The cost of the tile being left. */
+  int *attack;                /* The best cost to attack each city, or -1.
+                               * Indexed like 'threats->cities'. */
+};
+
+/**********************************************************************//**
+  Return the index of the city tile in 'threats->cities'.
+**************************************************************************/
+static int dai_threat_city_index(const struct dai_threat_map *threats,
+                                 const struct tile *ptile)
+{
+  int tindex = tile_index(ptile);
+  int i;
+
+  for (i = 0; i < threats->num_cities; i++) {
+    if (threats->cities[i] == tindex) {
+      return i;
+    }
+  }
+
+  return -1;
+}
+
+/**********************************************************************//**
+  Like the reverse maps, consider our cities as attackable, also for
+  transports. But only the ones the unit cannot enter otherwise, so the
+  others don't stop the search: they are attacked in dai_threat_get_MC().
+  The unit may leave its start tile.
+**************************************************************************/
+static enum pf_action dai_threat_get_action(const struct tile *ptile,
+                                            enum known_type known,
+                                            const struct pf_parameter *param)
+{
+  const struct dai_threat_search *search = param->data;
+  bool can_disembark;
+
+  if (ptile == param->start_tile
+      || !dbv_isset(&search->threats->targets, tile_index(ptile))) {
+    return PF_ACTION_NONE;
+  }
+
+  return (PF_MS_NONE == param->get_move_scope(ptile, &can_disembark,
+                                              PF_MS_NONE, param)
+          ? PF_ACTION_ATTACK : PF_ACTION_NONE);
+}
+
+/**********************************************************************//**
+  Move cost callback of the threat searches. When the unit can move to one
+  of our cities, it could attack it as well, which costs it what it costs
+  in the reverse map of the city.
+**************************************************************************/
+static int dai_threat_get_MC(const struct tile *from_tile,
+                             enum pf_move_scope src_move_scope,
+                             const struct tile *to_tile,
+                             enum pf_move_scope dst_move_scope,
+                             const struct pf_parameter *param)
+{
+  const struct dai_threat_search *search = param->data;
+
+  if (dbv_isset(&search->threats->targets, tile_index(to_tile))) {
+    int i = dai_threat_city_index(search->threats, to_tile);
+    int moves_left = param->move_rate - search->cost % param->move_rate;
+    int cost = search->cost + MIN(search->attack_cost, moves_left);
+
+    if (search->attack[i] == -1 || cost < search->attack[i]) {
+      search->attack[i] = cost;
+    }
+  }
+
+  return search->get_MC(from_tile, src_move_scope, to_tile, dst_move_scope,
+                        param);
+}
+
+/**********************************************************************//**
+  Free the threat map of the player, if any.
+**************************************************************************/
+void dai_threat_map_free(struct ai_type *ait, struct player *pplayer)
+{
+  struct ai_plr *ai = def_ai_player_data(pplayer, ait);
+  struct dai_threat_map *threats = ai->threats;
+
+  if (threats == NULL) {
+    return;
+  }
+
+  dai_threat_hash_destroy(threats->hash);
+  dbv_free(&threats->targets);
+  free(threats->cities);
+  if (threats->pfm != NULL) {
+    pf_map_destroy(threats->pfm);
+  }
+  free(threats);
+  ai->threats = NULL;
+}
+
+/**********************************************************************//**
+  Return the threat map of the city owner, making a new one if the
+  current one cannot be used for this city.
+**************************************************************************/
+static struct dai_threat_map *dai_threat_map_get(struct ai_type *ait,
+                                                 const struct city *pcity,
+                                                 int max_turns,
+                                                 bool omniscient)
+{
+  struct player *pplayer = city_owner(pcity);
+  struct ai_plr *ai = def_ai_player_data(pplayer, ait);
+  struct dai_threat_map *threats = ai->threats;
+
+  if (threats != NULL
+      && (threats->max_turns != max_turns
+          || threats->omniscient != omniscient
+          || !dbv_isset(&threats->targets, tile_index(city_tile(pcity))))) {
+    /* E.g. a new city. */
+    dai_threat_map_free(ait, pplayer);
+    threats = NULL;
+  }
+
+  if (threats == NULL) {
+    threats = fc_calloc(1, sizeof(*threats));
+    threats->max_turns = max_turns;
+    threats->omniscient = omniscient;
+    dbv_init(&threats->targets, MAP_INDEX_SIZE);
+    threats->cities = fc_malloc(MAX(1, city_list_size(pplayer->cities))
+                                * sizeof(*threats->cities));
+    city_list_iterate(pplayer->cities, acity) {
+      int tindex = tile_index(city_tile(acity));
+
+      dbv_set(&threats->targets, tindex);
+      threats->cities[threats->num_cities++] = tindex;
+    } city_list_iterate_end;
+    threats->hash = dai_threat_hash_new();
+    ai->threats = threats;
+  }
+
+  return threats;
+}
+
+/**********************************************************************//**
+  Add the turns the unit needs to reach our city to the entry.
+**************************************************************************/
+static void dai_threat_reach_add(struct dai_threat_reach *reach, int *size,
+                                 int tindex, int turn)
+{
+  if (reach->num_cities == *size) {
+    *size = MAX(4, 2 * *size);
+    reach->cities = fc_realloc(reach->cities,
+                               *size * sizeof(*reach->cities));
+  }
+  reach->cities[reach->num_cities].tindex = tindex;
+  reach->cities[reach->num_cities].turn = turn;
+  reach->num_cities++;
+}
+
+/**********************************************************************//**
+  Fill the turns the unit of the key needs to reach our cities, using and
+  recycling the path-finding map '*ppfm'. Only the cities reached within
+  the turn limit are listed.
+**************************************************************************/
+static void dai_threat_reach_fill(struct dai_threat_map *threats,
+                                  const struct dai_threat_key *key,
+                                  struct pf_map **ppfm,
+                                  struct dai_threat_reach *reach)
+{
+  struct pf_parameter parameter;
+  struct dai_threat_search search;
+  struct pf_position pos;
+  int *turns;
+  int max_cost, size = 0, i;
+
+  /* Same parameter as the reverse maps. */
+  pft_fill_reverse_parameter(&parameter, NULL);
+  search.threats = threats;
+  search.get_MC = parameter.get_MC;
+  search.attack_cost = (utype_has_flag(key->utype, UTYF_ONEATTACK)
+                        || utype_can_do_action(key->utype,
+                                               ACTION_SUICIDE_ATTACK)
+                        ? key->move_rate : SINGLE_MOVE);
+  search.cost = 0;
+  search.attack = fc_malloc(MAX(1, threats->num_cities)
+                            * sizeof(*search.attack));
+  turns = fc_malloc(MAX(1, threats->num_cities) * sizeof(*turns));
+  for (i = 0; i < threats->num_cities; i++) {
+    search.attack[i] = -1;
+    turns[i] = -1;
+  }
+  parameter.get_MC = dai_threat_get_MC;
+  parameter.get_action = dai_threat_get_action;
+  parameter.data = &search;
+  parameter.owner = key->owner;
+  parameter.omniscience = threats->omniscient;
+  parameter.start_tile = (struct tile *) key->start_tile;
+  parameter.move_rate = key->move_rate;
+  parameter.moves_left_initially = key->move_rate;
+  parameter.utype = key->utype;
+
+  *ppfm = pf_map_renew(*ppfm, &parameter);
+  if (*ppfm == NULL) {
+    *ppfm = pf_map_new(&parameter);
+  }
+
+  max_cost = key->move_rate * (threats->max_turns + 1);
+  pf_map_tiles_iterate(*ppfm, ptile, TRUE) {
+    /* The moves from this tile are evaluated at the next iteration. */
+    search.cost = pf_map_iter_move_cost(*ppfm);
+    if (search.cost >= max_cost) {
+      break;
+    }
+    if (dbv_isset(&threats->targets, tile_index(ptile))) {
+      pf_map_iter_position(*ppfm, &pos);
+      turns[dai_threat_city_index(threats, ptile)] = pos.turn;
+    }
+  } pf_map_tiles_iterate_end;
+
+  /* The cities the unit could move to are attacked from the adjacent
+   * tiles. The others, e.g. unknown to the unit owner or only attackable,
+   * were reached by the search itself. */
+  for (i = 0; i < threats->num_cities; i++) {
+    if (search.attack[i] != -1) {
+      if (search.attack[i] < max_cost) {
+        dai_threat_reach_add(reach, &size, threats->cities[i],
+                             search.attack[i] / key->move_rate);
+      }
+    } else if (turns[i] != -1) {
+      dai_threat_reach_add(reach, &size, threats->cities[i], turns[i]);
+    }
+  }
+
+  free(search.attack);
+  free(turns);
+}
+
+/**********************************************************************//**
+  Fill the key of the threat map entry of the unit.
+**************************************************************************/
+static void dai_threat_key_fill(struct dai_threat_key *key,
+                                const struct unit *punit)
+{
+  key->owner = unit_owner(punit);
+  key->start_tile = unit_tile(punit);
+  key->utype = unit_type_get(punit);
+  key->move_rate = unit_move_rate(punit);
+}
+
+/**********************************************************************//**
+  Return the turns the unit needs to reach our cities, computing them if
+  needed.
+**************************************************************************/
+static const struct dai_threat_reach *
+dai_threat_reach_get(struct dai_threat_map *threats,
+                     const struct unit *punit)
+{
+  struct dai_threat_key key, *pkey;
+  struct dai_threat_reach *reach;
+
+  dai_threat_key_fill(&key, punit);
+  if (dai_threat_hash_lookup(threats->hash, &key, &reach)) {
+    return reach;
+  }
+
+  reach = fc_calloc(1, sizeof(*reach));
+  dai_threat_reach_fill(threats, &key, &threats->pfm, reach);
+
+  pkey = fc_malloc(sizeof(*pkey));
+  *pkey = key;
+  dai_threat_hash_insert(threats->hash, pkey, reach);
+
+  return reach;
+}
+
+/* A part of the entries added by dai_threat_map_fill(). */
+struct dai_threat_task {
+  struct dai_threat_map *threats;
+  int first, last;
+  const struct dai_threat_key **keys;
+  struct dai_threat_reach **reaches;
+};
+
+/**********************************************************************//**
+  Fill a part of the new threat map entries. Run in the thread pool.
+**************************************************************************/
+static void dai_threat_task_run(int index, void *data)
+{
+  struct dai_threat_task *task = (struct dai_threat_task *) data + index;
+  struct pf_map *pfm = NULL;
+  int i;
+
+  for (i = task->first; i < task->last; i++) {
+    dai_threat_reach_fill(task->threats, task->keys[i], &pfm,
+                          task->reaches[i]);
+  }
+  if (pfm != NULL) {
+    pf_map_destroy(pfm);
+  }
+}
+
+/**********************************************************************//**
+  Fill a new threat map with the units the first assess_danger() call
+  using it is about to look up, the searches running in srv_threadpool().
+  Nothing changes the game during that call, so this gives the same
+  entries as computing them one by one there.
+**************************************************************************/
+static void dai_threat_map_fill(struct ai_type *ait,
+                                struct dai_threat_map *threats,
+                                struct player *pplayer,
+                                const struct tile *ptile)
+{
+  struct fc_threadpool *pool = srv_threadpool();
+  struct dai_threat_task *tasks;
+  const struct dai_threat_key **keys = NULL;
+  struct dai_threat_reach **reaches = NULL;
+  int num = 0, size = 0, ntasks, i;
+
+  threats->filled = TRUE;
+
+  /* The same units as assess_danger(). */
+  players_iterate(aplayer) {
+    if (!adv_is_player_dangerous(pplayer, aplayer)) {
+      continue;
+    }
+
+    unit_list_iterate(aplayer->units, punit) {
+      const struct unit_type *utype = unit_type_get(punit);
+      struct unit_type_ai *utai = utype_ai_data(utype, ait);
+      const struct unit *lookup[2];
+      int nlookup = 0, j;
+
+#ifdef FREECIV_WEB
+      int unit_distance = real_map_distance(ptile, unit_tile(punit));
+
+      if (unit_distance > ASSESS_DANGER_MAX_DISTANCE
+          || (has_handicap(pplayer, H_ASSESS_DANGER_LIMITED)
+              && unit_distance > AI_HANDICAP_DISTANCE_LIMIT)) {
+        continue;
+      }
+#endif /* FREECIV_WEB */
+
+      if (!utai->carries_occupiers && !utype_acts_hostile(utype)) {
+        continue;
+      }
+
+      lookup[nlookup++] = punit;
+      if (unit_transported(punit)) {
+        const struct unit *ferry = unit_transport_get(punit);
+
+        if (ferry != NULL) {
+          lookup[nlookup++] = ferry;
+        }
+      }
+
+      for (j = 0; j < nlookup; j++) {
+        struct dai_threat_key key, *pkey;
+        struct dai_threat_reach *reach;
+
+        dai_threat_key_fill(&key, lookup[j]);
+        if (dai_threat_hash_lookup(threats->hash, &key, &reach)) {
+          continue;
+        }
+
+        /* Inserted empty, filled by the tasks. */
+        pkey = fc_malloc(sizeof(*pkey));
+        *pkey = key;
+        reach = fc_calloc(1, sizeof(*reach));
+        dai_threat_hash_insert(threats->hash, pkey, reach);
+
+        if (num == size) {
+          size = MAX(64, 2 * size);
+          keys = fc_realloc(keys, size * sizeof(*keys));
+          reaches = fc_realloc(reaches, size * sizeof(*reaches));
+        }
+        keys[num] = pkey;
+        reaches[num] = reach;
+        num++;
+      }
+    } unit_list_iterate_end;
+  } players_iterate_end;
+
+  if (num == 0) {
+    return;
+  }
+
+  ntasks = MIN(num, fc_threadpool_size(pool));
+  tasks = fc_calloc(ntasks, sizeof(*tasks));
+  for (i = 0; i < ntasks; i++) {
+    tasks[i].threats = threats;
+    tasks[i].first = num * i / ntasks;
+    tasks[i].last = num * (i + 1) / ntasks;
+    tasks[i].keys = keys;
+    tasks[i].reaches = reaches;
+  }
+
+  /* Nothing changes the game while the tasks run. */
+  req_cache_set_readonly(TRUE);
+  fc_threadpool_run(pool, ntasks, dai_threat_task_run, tasks);
+  req_cache_set_readonly(FALSE);
+
+  free(tasks);
+  free(keys);
+  free(reaches);
+}
+
+/**********************************************************************//**
+  Return whether the unit can reach the city within the turn limit, and
+  fill the position where it gets. Uses the threat map if there is one,
+  or else the reverse map for the city.
+**************************************************************************/
+static bool assess_danger_position(const struct city *pcity,
+                                   struct dai_threat_map *threats,
+                                   struct pf_reverse_map *pcity_map,
+                                   const struct unit *punit,
+                                   struct pf_position *pos)
+{
+  if (threats != NULL) {
+    const struct dai_threat_reach *reach
+      = dai_threat_reach_get(threats, punit);
+    int tindex = tile_index(city_tile(pcity));
+    int i;
+
+    for (i = 0; i < reach->num_cities; i++) {
+      if (reach->cities[i].tindex == tindex) {
+        pos->tile = city_tile(pcity);
+        pos->turn = reach->cities[i].turn;
+        return TRUE;
+      }
+    }
+
+    return FALSE;
+  }
+
+  return pf_reverse_map_unit_position(pcity_map, punit, pos);
+}
+
 /**********************************************************************//**
   How dangerous and far a unit is for a city?
 **************************************************************************/
 static unsigned int assess_danger_unit(const struct city *pcity,
+                                       struct dai_threat_map *threats,
                                        struct pf_reverse_map *pcity_map,
                                        const struct unit *punit,
                                        int *move_time)
@@ -372,7 +907,7 @@ static unsigned int assess_danger_unit(const struct city *pcity,
                   / punittype->paratroopers_range);
   }
 
-  if (pf_reverse_map_unit_position(pcity_map, punit, &pos)
+  if (assess_danger_position(pcity, threats, pcity_map, punit, &pos)
       && (PF_IMPOSSIBLE_MC == *move_time
           || *move_time > pos.turn)) {
     *move_time = pos.turn;
@@ -380,7 +915,7 @@ static unsigned int assess_danger_unit(const struct city *pcity,
 
   if (unit_transported(punit)
       && (ferry = unit_transport_get(punit))
-      && pf_reverse_map_unit_position(pcity_map, ferry, &pos)) {
+      && assess_danger_position(pcity, threats, pcity_map, ferry, &pos)) {
     if ((PF_IMPOSSIBLE_MC == *move_time
          || *move_time > pos.turn)) {
       *move_time = pos.turn;
@@ -407,6 +942,21 @@ static unsigned int assess_danger_unit(const struct city *pcity,
   return danger * 100 / MAX(mod, 1);
 }
 
+/**********************************************************************//**
+  How many turns ahead assess_danger() looks for the enemy units.
+**************************************************************************/
+static int assess_danger_turns(const struct player *pplayer)
+{
+  if (player_is_cpuhog(pplayer)) {
+    return 6;
+  }
+#ifdef FREECIV_WEB
+  return has_handicap(pplayer, H_ASSESS_DANGER_LIMITED) ? 2 : 3;
+#else
+  return 3;
+#endif
+}
+
 /**********************************************************************//**
   Call assess_danger() for all cities owned by pplayer.
 
@@ -495,6 +1045,7 @@ static unsigned int assess_danger(struct ai_type *ait, struct city *pcity,
   bool defender_type_handled[U_LAST];
   int assess_turns;
   bool omnimap;
+  struct dai_threat_map *threats = NULL;
 
   TIMING_LOG(AIT_DANGER, TIMER_START);
 
@@ -543,20 +1094,22 @@ static unsigned int assess_danger(struct ai_type *ait, struct city *pcity,
     }
   } unit_list_iterate_end;
 
-  if (player_is_cpuhog(pplayer)) {
-    assess_turns = 6;
-  } else {
-    assess_turns = 3;
-#ifdef FREECIV_WEB
-    assess_turns = has_handicap(pplayer, H_ASSESS_DANGER_LIMITED) ? 2 : 3;
-#endif
-  }
-
+  assess_turns = assess_danger_turns(pplayer);
   omnimap = !has_handicap(pplayer, H_MAP);
 
+  if (ul_cb == NULL && dmap == &(wld.map)) {
+    /* Share the path-finding with our other cities. Not done for the
+     * unit lists and maps of the threaded AIs, which run their own
+     * copies of the game. */
+    threats = dai_threat_map_get(ait, pcity, assess_turns, omnimap);
+    if (!threats->filled) {
+      dai_threat_map_fill(ait, threats, pplayer, ptile);
+    }
+  }
+
   /* Check. */
   players_iterate(aplayer) {
-    struct pf_reverse_map *pcity_map;
+    struct pf_reverse_map *pcity_map = NULL;
     struct unit_list *units;
 
     if (!adv_is_player_dangerous(pplayer, aplayer)) {
@@ -565,8 +1118,10 @@ static unsigned int assess_danger(struct ai_type *ait, struct city *pcity,
     /* Note that we still consider the units of players we are not (yet)
      * at war with. */
 
-    pcity_map = pf_reverse_map_new_for_city(pcity, aplayer, assess_turns,
-                                            omnimap, dmap);
+    if (threats == NULL) {
+      pcity_map = pf_reverse_map_new_for_city(pcity, aplayer, assess_turns,
+                                              omnimap, dmap);
+    }
 
     if (ul_cb != NULL) {
       units = ul_cb(aplayer);
@@ -596,7 +1151,7 @@ static unsigned int assess_danger(struct ai_type *ait, struct city *pcity,
         continue;
       }
 
-      vulnerability = assess_danger_unit(pcity, pcity_map,
+      vulnerability = assess_danger_unit(pcity, threats, pcity_map,
                                          punit, &move_time);
 
       if (PF_IMPOSSIBLE_MC == move_time) {
@@ -649,8 +1204,9 @@ static unsigned int assess_danger(struct ai_type *ait, struct city *pcity,
       total_danger += vulnerability;
     } unit_list_iterate_end;
 
-    pf_reverse_map_destroy(pcity_map);
-
+    if (pcity_map != NULL) {
+      pf_reverse_map_destroy(pcity_map);
+    }
   } players_iterate_end;
 
   if (total_danger) {
@@ -936,7 +1492,7 @@ static void process_attacker_want(struct ai_type *ait,
   /* The enemy city.  acity == NULL means stray enemy unit */
   struct city *acity = tile_city(ptile);
   struct pf_parameter parameter;
-  struct pf_map *pfm;
+  struct pf_map *pfm = NULL;
   struct pf_position pos;
   const struct unit_type *orig_utype = best_choice->value.utype;
   int victim_count = 1;
@@ -1011,7 +1567,7 @@ static void process_attacker_want(struct ai_type *ait,
       pft_fill_utype_parameter(&parameter, punittype, city_tile(pcity),
                                pplayer);
       parameter.omniscience = !has_handicap(pplayer, H_MAP);
-      pfm = pf_map_new(&parameter);
+      pfm = pf_map_renew(pfm, &parameter);
 
       /* Set the move_time appropriatelly. */
       move_time = -1;
@@ -1042,11 +1598,9 @@ static void process_attacker_want(struct ai_type *ait,
         if (pf_map_position(pfm, ptile, &pos)) {
           move_time = pos.turn;
         } else {
-          pf_map_destroy(pfm);
           continue;
         }
       }
-      pf_map_destroy(pfm);
 
       /* Estimate strength of the enemy. */
 
@@ -1167,6 +1721,10 @@ static void process_attacker_want(struct ai_type *ait,
       }
     }
   } simple_ai_unit_type_iterate_end;
+
+  if (NULL != pfm) {
+    pf_map_destroy(pfm);
+  }
 }
 
 /**********************************************************************//**
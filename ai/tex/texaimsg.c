@@ -17,6 +17,7 @@
 
 /* ai/tex */
 #include "texaiplayer.h"
+#include "texaiworld.h"
 
 #include "texaimsg.h"
 
@@ -28,9 +29,9 @@ void texai_send_msg(enum texaimsgtype type, struct player *pplayer,
 {
   struct texai_msg *msg;
 
-  if (!texai_thread_running()) {
-    /* No player thread to send messages to */
-    return;
+  if (type != TEXAI_MSG_WORLD && texai_thread_running()) {
+    /* Let the thread see the world as it is now. */
+    texai_world_publish();
   }
 
   msg = fc_malloc(sizeof(*msg));
@@ -39,9 +40,35 @@ void texai_send_msg(enum texaimsgtype type, struct player *pplayer,
   msg->plr = pplayer;
   msg->data = data;
 
+  if (!texai_thread_running()) {
+    /* No player thread to send messages to */
+    texai_msg_destroy(msg);
+    return;
+  }
+
   texai_msg_to_thr(msg);
 }
 
+/**********************************************************************//**
+  Free the message and its payload, whether it was handled or not.
+**************************************************************************/
+void texai_msg_destroy(struct texai_msg *msg)
+{
+  switch (msg->type) {
+  case TEXAI_MSG_WORLD:
+    texai_world_msg_free(msg->data);
+    break;
+  case TEXAI_MSG_FIRST_ACTIVITIES:
+  case TEXAI_MSG_PHASE_FINISHED:
+  case TEXAI_MSG_THR_EXIT:
+  case TEXAI_MSG_MAP_ALLOC:
+  case TEXAI_MSG_MAP_FREE:
+    break;
+  }
+
+  free(msg);
+}
+
 /**********************************************************************//**
   Construct and send request from player thread.
 **************************************************************************/
@@ -20,26 +20,12 @@
 #define SPECENUM_VALUE1NAME "FirstActivities"
 #define SPECENUM_VALUE2 TEXAI_MSG_PHASE_FINISHED
 #define SPECENUM_VALUE2NAME "PhaseFinished"
-#define SPECENUM_VALUE3 TEXAI_MSG_TILE_INFO
-#define SPECENUM_VALUE3NAME "TileInfo"
+#define SPECENUM_VALUE3 TEXAI_MSG_WORLD
+#define SPECENUM_VALUE3NAME "World"
 #define SPECENUM_VALUE4 TEXAI_MSG_MAP_ALLOC
 #define SPECENUM_VALUE4NAME "MapAlloc"
 #define SPECENUM_VALUE5 TEXAI_MSG_MAP_FREE
 #define SPECENUM_VALUE5NAME "MapFree"
-#define SPECENUM_VALUE6 TEXAI_MSG_CITY_CREATED
-#define SPECENUM_VALUE6NAME "CityCreated"
-#define SPECENUM_VALUE7 TEXAI_MSG_CITY_CHANGED
-#define SPECENUM_VALUE7NAME "CityChanged"
-#define SPECENUM_VALUE8 TEXAI_MSG_CITY_DESTROYED
-#define SPECENUM_VALUE8NAME "CityDestroyed"
-#define SPECENUM_VALUE9 TEXAI_MSG_UNIT_CREATED
-#define SPECENUM_VALUE9NAME "UnitCreated"
-#define SPECENUM_VALUE10 TEXAI_MSG_UNIT_CHANGED
-#define SPECENUM_VALUE10NAME "UnitChanged"
-#define SPECENUM_VALUE11 TEXAI_MSG_UNIT_DESTROYED
-#define SPECENUM_VALUE11NAME "UnitDestroyed"
-#define SPECENUM_VALUE12 TEXAI_MSG_UNIT_MOVED
-#define SPECENUM_VALUE12NAME "UnitMoved"
 #include "specenum_gen.h"
 
 #define SPECENUM_NAME texaireqtype
@@ -75,6 +61,7 @@ struct texai_req
 
 void texai_send_msg(enum texaimsgtype type, struct player *pplayer,
                     void *data);
+void texai_msg_destroy(struct texai_msg *msg);
 void texai_send_req(enum texaireqtype type, struct player *pplayer,
                     void *data);
 
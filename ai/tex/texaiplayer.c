@@ -220,25 +220,8 @@ static enum texai_abort_msg_class texai_check_messages(struct ai_type *ait)
       texai_send_req(TEXAI_REQ_TURN_DONE, msg->plr, NULL);
 
       break;
-    case TEXAI_MSG_TILE_INFO:
-      texai_tile_info_recv(msg->data);
-      break;
-    case TEXAI_MSG_UNIT_MOVED:
-      texai_unit_moved_recv(msg->data);
-      break;
-    case TEXAI_MSG_UNIT_CREATED:
-    case TEXAI_MSG_UNIT_CHANGED:
-      texai_unit_info_recv(msg->data, msg->type);
-      break;
-    case TEXAI_MSG_UNIT_DESTROYED:
-      texai_unit_destruction_recv(msg->data);
-      break;
-    case TEXAI_MSG_CITY_CREATED:
-    case TEXAI_MSG_CITY_CHANGED:
-      texai_city_info_recv(msg->data, msg->type);
-      break;
-    case TEXAI_MSG_CITY_DESTROYED:
-      texai_city_destruction_recv(msg->data);
+    case TEXAI_MSG_WORLD:
+      texai_world_recv(msg->data);
       break;
     case TEXAI_MSG_PHASE_FINISHED:
       new_abort = TEXAI_ABORT_PHASE_END;
@@ -262,7 +245,7 @@ static enum texai_abort_msg_class texai_check_messages(struct ai_type *ait)
       ret_abort = new_abort;
     }
 
-    FC_FREE(msg);
+    texai_msg_destroy(msg);
 
     texaimsg_list_allocate_mutex(exthrai.msgs_to.msglist);
   }
@@ -352,8 +335,16 @@ void texai_control_lost(struct ai_type *ait, struct player *pplayer)
 
     fc_thread_cond_destroy(&exthrai.msgs_to.thr_cond);
     fc_destroy_mutex(&exthrai.msgs_to.mutex);
+    /* The thread may have exited before handling all the messages. */
+    while (texaimsg_list_size(exthrai.msgs_to.msglist) > 0) {
+      struct texai_msg *msg = texaimsg_list_get(exthrai.msgs_to.msglist, 0);
+
+      texaimsg_list_remove(exthrai.msgs_to.msglist, msg);
+      texai_msg_destroy(msg);
+    }
     texaimsg_list_destroy(exthrai.msgs_to.msglist);
     texaireq_list_destroy(exthrai.reqs_from.reqlist);
+    texai_world_pending_free();
   }
 }
 
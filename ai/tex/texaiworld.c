@@ -15,6 +15,11 @@
 #include <fc_config.h>
 #endif
 
+/* utility */
+#include "bitvector.h"
+#include "log.h"
+#include "mem.h"
+
 /* common */
 #include "idex.h"
 #include "map.h"
@@ -30,37 +35,63 @@
 
 static struct world texai_world;
 
-struct texai_tile_info_msg
+struct texai_tile_info
 {
   int index;
   struct terrain *terrain;
   bv_extras extras;
 };
 
-struct texai_city_info_msg
-{
-  int id;
-  int owner;
-  int tindex;
-};
-
-struct texai_id_msg
+enum texai_change
 {
-  int id;
+  TEXAI_CHANGE_CREATED,
+  TEXAI_CHANGE_CHANGED,
+  TEXAI_CHANGE_DESTROYED
 };
 
-struct texai_unit_info_msg
+/* The state of a city or a unit to publish, only the latest one. */
+struct texai_obj_info
 {
   int id;
+  enum texai_change change;
   int owner;
   int tindex;
   int type;
 };
 
-struct texai_unit_move_msg
+#define SPECLIST_TAG texai_obj
+#define SPECLIST_TYPE struct texai_obj_info
+#include "speclist.h"
+
+#define texai_obj_list_iterate(objlist, pobj) \
+  TYPED_LIST_ITERATE(struct texai_obj_info, objlist, pobj)
+#define texai_obj_list_iterate_end LIST_ITERATE_END
+
+#define SPECHASH_TAG texai_obj
+#define SPECHASH_INT_KEY_TYPE
+#define SPECHASH_IDATA_TYPE struct texai_obj_info *
+#include "spechash.h"
+
+/* Changes of the main world not yet published to the thread. Only used
+ * by the main thread. Every tile, city or unit appears once, however
+ * often it changed. */
+static struct {
+  unsigned int version;
+  struct dbv tiles;
+  struct texai_obj_list *cities;
+  struct texai_obj_hash *cities_by_id;
+  struct texai_obj_list *units;
+  struct texai_obj_hash *units_by_id;
+} texai_pending;
+
+/* All the changes since the previous one, sent as a single message. */
+struct texai_world_msg
 {
-  int id;
-  int tindex;
+  unsigned int version;
+  int num_tiles;
+  struct texai_tile_info *tiles;
+  struct texai_obj_list *cities;
+  struct texai_obj_list *units;
 };
 
 /**********************************************************************//**
@@ -105,53 +136,164 @@ void texai_map_close(void)
 }
 
 /**********************************************************************//**
-  Tile info updated on main map. Send update to tex map.
+  Free an object change.
 **************************************************************************/
-void texai_tile_info(struct tile *ptile)
+static void texai_obj_info_free(struct texai_obj_info *info)
 {
-  if (texai_thread_running()) {
-    struct texai_tile_info_msg *info = fc_malloc(sizeof(struct texai_tile_info_msg));
+  free(info);
+}
+
+/**********************************************************************//**
+  Make sure the pending changes can be recorded.
+**************************************************************************/
+static void texai_pending_init(void)
+{
+  if (texai_pending.cities == NULL) {
+    texai_pending.cities = texai_obj_list_new_full(texai_obj_info_free);
+    texai_pending.cities_by_id = texai_obj_hash_new();
+    texai_pending.units = texai_obj_list_new_full(texai_obj_info_free);
+    texai_pending.units_by_id = texai_obj_hash_new();
+  }
+}
 
-    info->index = tile_index(ptile);
-    info->terrain = ptile->terrain;
-    info->extras = ptile->extras;
+/**********************************************************************//**
+  Forget the pending changes, when there is no thread to publish them to.
+**************************************************************************/
+void texai_world_pending_free(void)
+{
+  dbv_free(&texai_pending.tiles);
+
+  if (texai_pending.cities != NULL) {
+    texai_obj_hash_destroy(texai_pending.cities_by_id);
+    texai_obj_list_destroy(texai_pending.cities);
+    texai_obj_hash_destroy(texai_pending.units_by_id);
+    texai_obj_list_destroy(texai_pending.units);
+    texai_pending.cities = NULL;
+    texai_pending.cities_by_id = NULL;
+    texai_pending.units = NULL;
+    texai_pending.units_by_id = NULL;
+  }
+}
 
-    texai_send_msg(TEXAI_MSG_TILE_INFO, NULL, info);
+/**********************************************************************//**
+  Record the change of a city or a unit, merging it with the change
+  already pending for it, if any.
+**************************************************************************/
+static void texai_obj_record(struct texai_obj_list *plist,
+                             struct texai_obj_hash *phash, int id,
+                             enum texai_change change, int owner,
+                             int tindex, int type)
+{
+  struct texai_obj_info *info;
+
+  if (!texai_obj_hash_lookup(phash, id, &info)) {
+    info = fc_malloc(sizeof(*info));
+    info->id = id;
+    info->change = change;
+    texai_obj_list_append(plist, info);
+    texai_obj_hash_insert(phash, id, info);
+  } else if (change == TEXAI_CHANGE_DESTROYED) {
+    if (info->change == TEXAI_CHANGE_CREATED) {
+      /* The thread never heard of it. */
+      texai_obj_hash_remove(phash, id);
+      texai_obj_list_remove(plist, info);
+      texai_obj_info_free(info);
+      return;
+    }
+    info->change = TEXAI_CHANGE_DESTROYED;
+  } else if (info->change == TEXAI_CHANGE_DESTROYED) {
+    info->change = TEXAI_CHANGE_CHANGED;
   }
+
+  info->owner = owner;
+  info->tindex = tindex;
+  info->type = type;
 }
 
 /**********************************************************************//**
-  Receive tile update to the thread.
+  Send all the changes recorded since the previous call to the thread, as
+  a new version of its world. Called before any other message, so the
+  thread always sees the world as it was when the message was sent.
 **************************************************************************/
-void texai_tile_info_recv(void *data)
+void texai_world_publish(void)
 {
-  struct texai_tile_info_msg *info = (struct texai_tile_info_msg *)data;
+  struct texai_world_msg *msg;
+  int num_tiles, i = 0;
 
-  if (texai_world.map.tiles != NULL) {
-    struct tile *ptile;
+  if (!texai_thread_running()) {
+    return;
+  }
 
-    ptile = index_to_tile(&(texai_world.map), info->index);
-    ptile->terrain = info->terrain;
-    ptile->extras = info->extras;
+  if (texai_pending.tiles.vec != NULL && wld.map.tiles == NULL) {
+    /* The main map is already gone, so are its changes. */
+    dbv_free(&texai_pending.tiles);
   }
 
-  free(info);
+  num_tiles = (texai_pending.tiles.vec != NULL
+               ? dbv_count(&texai_pending.tiles) : 0);
+  if (num_tiles == 0
+      && (texai_pending.cities == NULL
+          || (texai_obj_list_size(texai_pending.cities) == 0
+              && texai_obj_list_size(texai_pending.units) == 0))) {
+    return;
+  }
+
+  msg = fc_calloc(1, sizeof(*msg));
+  msg->version = ++texai_pending.version;
+
+  msg->num_tiles = num_tiles;
+  if (num_tiles > 0) {
+    msg->tiles = fc_malloc(msg->num_tiles * sizeof(*msg->tiles));
+    dbv_set_bits_iterate(&texai_pending.tiles, tindex) {
+      struct tile *ptile = index_to_tile(&(wld.map), tindex);
+
+      msg->tiles[i].index = tindex;
+      msg->tiles[i].terrain = ptile->terrain;
+      msg->tiles[i].extras = ptile->extras;
+      i++;
+    } dbv_set_bits_iterate_end;
+    dbv_clr_all(&texai_pending.tiles);
+  }
+
+  /* The lists go to the thread as they are, start new ones. */
+  if (texai_pending.cities != NULL) {
+    msg->cities = texai_pending.cities;
+    msg->units = texai_pending.units;
+    texai_obj_hash_destroy(texai_pending.cities_by_id);
+    texai_obj_hash_destroy(texai_pending.units_by_id);
+    texai_pending.cities = NULL;
+    texai_pending.units = NULL;
+    texai_pending.cities_by_id = NULL;
+    texai_pending.units_by_id = NULL;
+  }
+
+  texai_send_msg(TEXAI_MSG_WORLD, NULL, msg);
 }
 
 /**********************************************************************//**
-  Send city information to the thread.
+  Tile info updated on main map. Record it for the tex map.
 **************************************************************************/
-static void texai_city_update(struct city *pcity, enum texaimsgtype msgtype)
+void texai_tile_info(struct tile *ptile)
 {
   if (texai_thread_running()) {
-    struct texai_city_info_msg *info
-      = fc_malloc(sizeof(struct texai_city_info_msg));
-
-    info->id = pcity->id;
-    info->owner = player_number(city_owner(pcity));
-    info->tindex = tile_index(city_tile(pcity));
+    if (dbv_bits(&texai_pending.tiles) != MAP_INDEX_SIZE) {
+      dbv_free(&texai_pending.tiles);
+      dbv_init(&texai_pending.tiles, MAP_INDEX_SIZE);
+    }
+    dbv_set(&texai_pending.tiles, tile_index(ptile));
+  }
+}
 
-    texai_send_msg(msgtype, NULL, info);
+/**********************************************************************//**
+  Record city information for the thread.
+**************************************************************************/
+static void texai_city_update(struct city *pcity, enum texai_change change)
+{
+  if (texai_thread_running()) {
+    texai_pending_init();
+    texai_obj_record(texai_pending.cities, texai_pending.cities_by_id,
+                     pcity->id, change, player_number(city_owner(pcity)),
+                     tile_index(city_tile(pcity)), 0);
   }
 }
 
@@ -160,7 +302,7 @@ static void texai_city_update(struct city *pcity, enum texaimsgtype msgtype)
 **************************************************************************/
 void texai_city_created(struct city *pcity)
 {
-  texai_city_update(pcity, TEXAI_MSG_CITY_CREATED);
+  texai_city_update(pcity, TEXAI_CHANGE_CREATED);
 }
 
 /**********************************************************************//**
@@ -168,37 +310,15 @@ void texai_city_created(struct city *pcity)
 **************************************************************************/
 void texai_city_changed(struct city *pcity)
 {
-  texai_city_update(pcity, TEXAI_MSG_CITY_CHANGED);
+  texai_city_update(pcity, TEXAI_CHANGE_CHANGED);
 }
 
 /**********************************************************************//**
-  Receive city update to the thread.
+  City has been removed from the main map.
 **************************************************************************/
-void texai_city_info_recv(void *data, enum texaimsgtype msgtype)
+void texai_city_destroyed(struct city *pcity)
 {
-  struct texai_city_info_msg *info = (struct texai_city_info_msg *)data;
-  struct city *pcity;
-  struct player *pplayer = player_by_number(info->owner);
-
-  if (msgtype == TEXAI_MSG_CITY_CREATED) {
-    struct tile *ptile = index_to_tile(&(texai_world.map), info->tindex);
-
-    pcity = create_city_virtual(pplayer, ptile, "");
-    adv_city_alloc(pcity);
-    pcity->id = info->id;
-
-    idex_register_city(&texai_world, pcity);
-    tile_set_worked(ptile, pcity);
-  } else {
-    pcity = idex_lookup_city(&texai_world, info->id);
-
-    if (pcity != NULL) {
-      pcity->owner = pplayer;
-    } else {
-      log_error("Tex: requested change on city id %d that's not known.",
-                info->id);
-    }
-  }
+  texai_city_update(pcity, TEXAI_CHANGE_DESTROYED);
 }
 
 /**********************************************************************//**
@@ -208,138 +328,121 @@ struct city *texai_map_city(int city_id)
 {
   return idex_lookup_city(&texai_world, city_id);
 }
-  
+
 /**********************************************************************//**
-  City has been removed from the main map.
+  Record unit information for the thread.
 **************************************************************************/
-void texai_city_destroyed(struct city *pcity)
+static void texai_unit_update(struct unit *punit, enum texai_change change)
 {
   if (texai_thread_running()) {
-    struct texai_id_msg *info = fc_malloc(sizeof(struct texai_id_msg));
-
-    info->id = pcity->id;
-
-    texai_send_msg(TEXAI_MSG_CITY_DESTROYED, NULL, info);
+    texai_pending_init();
+    texai_obj_record(texai_pending.units, texai_pending.units_by_id,
+                     punit->id, change, player_number(unit_owner(punit)),
+                     tile_index(unit_tile(punit)),
+                     utype_number(unit_type_get(punit)));
   }
 }
 
 /**********************************************************************//**
-  Receive city destruction to the thread.
+  New unit has been added to the main map.
 **************************************************************************/
-void texai_city_destruction_recv(void *data)
+void texai_unit_created(struct unit *punit)
 {
-  struct texai_id_msg *info = (struct texai_id_msg *)data;
-  struct city *pcity = idex_lookup_city(&texai_world, info->id);
-
-  if (pcity != NULL) {
-    adv_city_free(pcity);
-    tile_set_worked(city_tile(pcity), NULL);
-    idex_unregister_city(&texai_world, pcity);
-    destroy_city_virtual(pcity);
-  } else {
-    log_error("Tex: requested removal of city id %d that's not known.",
-              info->id);
-  }
+  texai_unit_update(punit, TEXAI_CHANGE_CREATED);
 }
 
 /**********************************************************************//**
-  Send unit information to the thread.
+  Unit (potentially) changed in main map.
 **************************************************************************/
-static void texai_unit_update(struct unit *punit, enum texaimsgtype msgtype)
+void texai_unit_changed(struct unit *punit)
 {
-  if (texai_thread_running()) {
-    struct texai_unit_info_msg *info
-      = fc_malloc(sizeof(struct texai_unit_info_msg));
-
-    info->id = punit->id;
-    info->owner = player_number(unit_owner(punit));
-    info->tindex = tile_index(unit_tile(punit));
-    info->type = utype_number(unit_type_get(punit));
-
-    texai_send_msg(msgtype, NULL, info);
-  }
+  texai_unit_update(punit, TEXAI_CHANGE_CHANGED);
 }
 
 /**********************************************************************//**
-  New unit has been added to the main map.
+  Unit has been removed from the main map.
 **************************************************************************/
-void texai_unit_created(struct unit *punit)
+void texai_unit_destroyed(struct unit *punit)
 {
-  texai_unit_update(punit, TEXAI_MSG_UNIT_CREATED);
+  texai_unit_update(punit, TEXAI_CHANGE_DESTROYED);
 }
 
 /**********************************************************************//**
-  Unit (potentially) changed in main map.
+  Unit has moved in the main map.
 **************************************************************************/
-void texai_unit_changed(struct unit *punit)
+void texai_unit_move_seen(struct unit *punit)
 {
-  texai_unit_update(punit, TEXAI_MSG_UNIT_CHANGED);
+  texai_unit_update(punit, TEXAI_CHANGE_CHANGED);
 }
 
 /**********************************************************************//**
-  Receive unit update to the thread.
+  Apply a city change in the thread.
 **************************************************************************/
-void texai_unit_info_recv(void *data, enum texaimsgtype msgtype)
+static void texai_city_apply(const struct texai_obj_info *info)
 {
-  struct texai_unit_info_msg *info = (struct texai_unit_info_msg *)data;
-  struct unit *punit;
+  struct city *pcity;
   struct player *pplayer = player_by_number(info->owner);
-  struct unit_type *type = utype_by_number(info->type);
-  struct tile *ptile = index_to_tile(&(texai_world.map), info->tindex);
 
-  if (msgtype == TEXAI_MSG_UNIT_CREATED) {
-    struct texai_plr *plr_data = player_ai_data(pplayer, texai_get_self());
+  if (info->change == TEXAI_CHANGE_CREATED) {
+    struct tile *ptile = index_to_tile(&(texai_world.map), info->tindex);
 
-    punit = unit_virtual_create(pplayer, NULL, type, 0);
-    punit->id = info->id;
+    pcity = create_city_virtual(pplayer, ptile, "");
+    adv_city_alloc(pcity);
+    pcity->id = info->id;
 
-    idex_register_unit(&texai_world, punit);
-    unit_list_prepend(ptile->units, punit);
-    unit_list_prepend(plr_data->units, punit);
-  } else if (msgtype == TEXAI_MSG_UNIT_MOVED) {
-    struct tile *old_tile;
+    idex_register_city(&texai_world, pcity);
+    tile_set_worked(ptile, pcity);
+    return;
+  }
 
-    punit = idex_lookup_unit(&texai_world, info->id);
+  pcity = idex_lookup_city(&texai_world, info->id);
+  if (pcity == NULL) {
+    log_error("Tex: requested change on city id %d that's not known.",
+              info->id);
+    return;
+  }
 
-    old_tile = punit->tile;
-    if (old_tile != ptile) {
-      unit_list_remove(old_tile->units, punit);
-      unit_list_prepend(ptile->units, punit);
-    }
+  if (info->change == TEXAI_CHANGE_DESTROYED) {
+    adv_city_free(pcity);
+    tile_set_worked(city_tile(pcity), NULL);
+    idex_unregister_city(&texai_world, pcity);
+    destroy_city_virtual(pcity);
   } else {
-    fc_assert(msgtype == TEXAI_MSG_UNIT_CHANGED);
-
-    punit = idex_lookup_unit(&texai_world, info->id);
-
-    punit->utype = type;
+    pcity->owner = pplayer;
   }
-
-  unit_tile_set(punit, ptile);
 }
 
 /**********************************************************************//**
-  Unit has been removed from the main map.
+  Apply a unit change in the thread.
 **************************************************************************/
-void texai_unit_destroyed(struct unit *punit)
+static void texai_unit_apply(const struct texai_obj_info *info)
 {
-  if (texai_thread_running()) {
-    struct texai_id_msg *info = fc_malloc(sizeof(struct texai_id_msg));
+  struct unit *punit;
+  struct player *pplayer = player_by_number(info->owner);
+  struct tile *ptile = index_to_tile(&(texai_world.map), info->tindex);
 
-    info->id = punit->id;
+  if (info->change == TEXAI_CHANGE_CREATED) {
+    struct texai_plr *plr_data = player_ai_data(pplayer, texai_get_self());
+
+    punit = unit_virtual_create(pplayer, NULL,
+                                utype_by_number(info->type), 0);
+    punit->id = info->id;
 
-    texai_send_msg(TEXAI_MSG_UNIT_DESTROYED, NULL, info);
+    idex_register_unit(&texai_world, punit);
+    unit_list_prepend(ptile->units, punit);
+    unit_list_prepend(plr_data->units, punit);
+    unit_tile_set(punit, ptile);
+    return;
   }
-}
 
-/**********************************************************************//**
-  Receive unit destruction to the thread.
-**************************************************************************/
-void texai_unit_destruction_recv(void *data)
-{
-  struct texai_id_msg *info = (struct texai_id_msg *)data;
-  struct unit *punit = idex_lookup_unit(&texai_world, info->id);
+  punit = idex_lookup_unit(&texai_world, info->id);
+  if (punit == NULL) {
+    log_error("Tex: requested change on unit id %d that's not known.",
+              info->id);
+    return;
+  }
 
-  if (punit != NULL) {
+  if (info->change == TEXAI_CHANGE_DESTROYED) {
     struct texai_plr *plr_data = player_ai_data(punit->owner,
                                                 texai_get_self());
 
@@ -348,42 +451,57 @@ void texai_unit_destruction_recv(void *data)
     idex_unregister_unit(&texai_world, punit);
     unit_virtual_destroy(punit);
   } else {
-    log_error("Tex: requested removal of unit id %d that's not known.",
-              info->id);
+    if (punit->tile != ptile) {
+      unit_list_remove(punit->tile->units, punit);
+      unit_list_prepend(ptile->units, punit);
+    }
+    punit->utype = utype_by_number(info->type);
+    unit_tile_set(punit, ptile);
   }
 }
 
 /**********************************************************************//**
-  Unit has moved in the main map.
+  Receive a new version of the world to the thread.
 **************************************************************************/
-void texai_unit_move_seen(struct unit *punit)
+void texai_world_recv(void *data)
 {
-  if (texai_thread_running()) {
-    struct texai_unit_move_msg *info = fc_malloc(sizeof(struct texai_unit_move_msg));
+  struct texai_world_msg *msg = (struct texai_world_msg *)data;
+  int i;
 
-    info->id = punit->id;
-    info->tindex = tile_index(unit_tile(punit));
+  if (texai_world.map.tiles != NULL) {
+    for (i = 0; i < msg->num_tiles; i++) {
+      struct tile *ptile = index_to_tile(&(texai_world.map),
+                                         msg->tiles[i].index);
 
-    texai_send_msg(TEXAI_MSG_UNIT_MOVED, NULL, info);
+      ptile->terrain = msg->tiles[i].terrain;
+      ptile->extras = msg->tiles[i].extras;
+    }
   }
+
+  if (msg->cities != NULL) {
+    texai_obj_list_iterate(msg->cities, info) {
+      texai_city_apply(info);
+    } texai_obj_list_iterate_end;
+    texai_obj_list_iterate(msg->units, info) {
+      texai_unit_apply(info);
+    } texai_obj_list_iterate_end;
+  }
+
+  log_debug("Tex world version %u, %d tiles changed.",
+            msg->version, msg->num_tiles);
 }
 
 /**********************************************************************//**
-  Receive unit move to the thread.
+  Free a world message, whether it was received or not.
 **************************************************************************/
-void texai_unit_moved_recv(void *data)
+void texai_world_msg_free(void *data)
 {
-  struct texai_unit_move_msg *info = (struct texai_unit_move_msg *)data;
-  struct unit *punit = idex_lookup_unit(&texai_world, info->id);
-  struct tile *ptile = index_to_tile(&(texai_world.map), info->tindex);
+  struct texai_world_msg *msg = (struct texai_world_msg *)data;
 
-  if (punit != NULL) {
-    unit_list_remove(punit->tile->units, punit);
-    unit_list_prepend(ptile->units, punit);
-
-    unit_tile_set(punit, ptile);
-  } else {
-    log_error("Tex: requested moving of unit id %d that's not known.",
-              info->id);
+  if (msg->cities != NULL) {
+    texai_obj_list_destroy(msg->cities);
+    texai_obj_list_destroy(msg->units);
   }
+  free(msg->tiles);
+  free(msg);
 }
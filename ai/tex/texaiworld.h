@@ -22,22 +22,21 @@ void texai_map_init(void);
 void texai_map_close(void);
 struct civ_map *texai_map_get(void);
 
+void texai_world_publish(void);
+void texai_world_recv(void *data);
+void texai_world_msg_free(void *data);
+void texai_world_pending_free(void);
+
 void texai_tile_info(struct tile *ptile);
-void texai_tile_info_recv(void *data);
 
 void texai_city_created(struct city *pcity);
 void texai_city_changed(struct city *pcity);
-void texai_city_info_recv(void *data, enum texaimsgtype msgtype);
 void texai_city_destroyed(struct city *pcity);
-void texai_city_destruction_recv(void *data);
 struct city *texai_map_city(int city_id);
 
 void texai_unit_created(struct unit *punit);
 void texai_unit_changed(struct unit *punit);
-void texai_unit_info_recv(void *data, enum texaimsgtype msgtype);
 void texai_unit_destroyed(struct unit *punit);
-void texai_unit_destruction_recv(void *data);
 void texai_unit_move_seen(struct unit *punit);
-void texai_unit_moved_recv(void *data);
 
 #endif /* FC__TEXAIWORLD_H */
@@ -26,6 +26,7 @@
 #include "map.h"
 #include "movement.h"
 #include "packets.h"
+#include "pf_hierarchy.h"
 #include "pf_tools.h"
 #include "road.h"
 #include "unit.h"
@@ -1539,9 +1540,13 @@ bool send_goto_tile(struct unit *punit, struct tile *ptile)
   struct pf_path *path;
 
   goto_fill_parameter_base(&parameter, punit);
-  pfm = pf_map_new(&parameter);
-  path = pf_map_path(pfm, ptile);
-  pf_map_destroy(pfm);
+  if (gui_options.goto_hierarchical) {
+    path = pf_hierarchy_path(&parameter, ptile);
+  } else {
+    pfm = pf_map_new(&parameter);
+    path = pf_map_path(pfm, ptile);
+    pf_map_destroy(pfm);
+  }
 
   if (path) {
     send_goto_path(punit, path, NULL);
@@ -1580,9 +1585,13 @@ bool send_rally_tile(struct city *pcity, struct tile *ptile)
 
   /* Use the unit to find a path to the destination tile. */
   goto_fill_parameter_base(&parameter, punit);
-  pfm = pf_map_new(&parameter);
-  path = pf_map_path(pfm, ptile);
-  pf_map_destroy(pfm);
+  if (gui_options.goto_hierarchical) {
+    path = pf_hierarchy_path(&parameter, ptile);
+  } else {
+    pfm = pf_map_new(&parameter);
+    path = pf_map_path(pfm, ptile);
+    pf_map_destroy(pfm);
+  }
 
   if (path) {
     /* Send orders to server. */
@@ -117,6 +117,7 @@ struct client_options gui_options = {
   .auto_center_each_turn = TRUE,
   .wakeup_focus = TRUE,
   .goto_into_unknown = TRUE,
+  .goto_hierarchical = FALSE,
   .center_when_popup_city = TRUE,
   .show_previous_turn_messages = TRUE,
   .concise_city_production = FALSE,
@@ -2199,6 +2200,13 @@ static struct client_option client_options[] = {
                      "moving into unknown tiles.  If not, then goto routes "
                      "will detour around or be blocked by unknown tiles."),
                   COC_INTERFACE, GUI_STUB, TRUE, NULL),
+  GEN_BOOL_OPTION(goto_hierarchical, N_("Faster long distance goto"),
+                  N_("Setting this option makes the game look for long "
+                     "distance goto routes through a graph of map sectors "
+                     "first, then search the path only in the sectors on "
+                     "the way. This is faster on big maps, but the paths "
+                     "may be slightly longer."),
+                  COC_INTERFACE, GUI_STUB, FALSE, NULL),
   GEN_BOOL_OPTION(center_when_popup_city, N_("Center map when popup city"),
                   N_("Setting this option makes the mapview center on a "
                      "city when its city dialog is popped up."),
@@ -136,6 +136,7 @@ struct client_options
   bool auto_center_each_turn;
   bool wakeup_focus;
   bool goto_into_unknown;
+  bool goto_hierarchical;
   bool center_when_popup_city;
   bool show_previous_turn_messages;
   bool concise_city_production;
@@ -32,6 +32,7 @@
 #include "actions.h"
 #include "capstr.h"
 #include "citizens.h"
+#include "effects.h"
 #include "events.h"
 #include "extras.h"
 #include "game.h"
@@ -2103,6 +2104,8 @@ void handle_game_info(const struct packet_game_info *pinfo)
   }
 
   game.info = *pinfo;
+  /* The global advances and the great wonders may have changed. */
+  req_cache_invalidate();
 
   /* check the values! */
 #define VALIDATE(_count, _maximum, _string)                                 \
@@ -2364,6 +2367,7 @@ void handle_player_info(const struct packet_player_info *pinfo)
   for (i = 0; i < B_LAST; i++) {
     pplayer->wonders[i] = pinfo->wonders[i];
   }
+  req_cache_invalidate();
 
   /* Set AI.control. */
   if (is_ai(pplayer) != BV_ISSET(pinfo->flags, PLRF_AI)) {
@@ -3325,6 +3329,9 @@ void handle_rulesets_ready(void)
   /* Setup improvement feature caches */
   improvement_feature_cache_init();
 
+  /* Index the received effects */
+  ruleset_cache_index_build();
+
   /* Setup road integrators caches */
   road_integrators_cache_init();
 
@@ -209,21 +209,13 @@ bool achievement_check(struct achievement *ach, struct player *pplayer)
       max_unknown = (total * (100 - ach->value)) / 100;
       required = total - max_unknown;
 
-      whole_map_iterate(&(wld.map), ptile) {
-        bool this_is_known = FALSE;
-
-        if (is_server()) {
-          if (dbv_isset(&pplayer->tile_known, tile_index(ptile))) {
-            this_is_known = TRUE;
-          }
-        } else {
-          /* Client */
-          if (ptile->terrain != T_UNKNOWN) {
-            this_is_known = TRUE;
-          }
-        }
+      if (is_server()) {
+        return pplayer->server.known_tiles >= required;
+      }
 
-        if (this_is_known) {
+      /* Client */
+      whole_map_iterate(&(wld.map), ptile) {
+        if (ptile->terrain != T_UNKNOWN) {
           known++;
           if (known >= required) {
             return TRUE;
@@ -292,33 +284,25 @@ bool achievement_check(struct achievement *ach, struct player *pplayer)
     return get_literacy(pplayer) >= ach->value;
   case ACHIEVEMENT_LAND_AHOY:
     {
-      bool *seen = fc_calloc(wld.map.num_continents, sizeof(bool));
+      bool *seen;
       int count = 0;
 
-      whole_map_iterate(&(wld.map), ptile) {
-        bool this_is_known = FALSE;
-
-        if (is_server()) {
-          if (dbv_isset(&pplayer->tile_known, tile_index(ptile))) {
-            this_is_known = TRUE;
-          }
-        } else {
-          /* Client */
-          if (ptile->terrain != T_UNKNOWN) {
-            this_is_known = TRUE;
-          }
-        }
+      if (is_server()) {
+        /* FIXME: This makes the assumption that fogged tiles belonged
+         *        to their current continent when they were last seen. */
+        return player_known_continents(pplayer) >= ach->value;
+      }
 
-        if (this_is_known) {
-          /* FIXME: This makes the assumption that fogged tiles belonged
-           *        to their current continent when they were last seen. */
-          if (ptile->continent > 0 && !seen[ptile->continent - 1]) {
-            if (++count >= ach->value) {
-              free(seen);
-              return TRUE;
-            }
-            seen[ptile->continent - 1] = TRUE;
+      /* Client */
+      seen = fc_calloc(wld.map.num_continents, sizeof(bool));
+      whole_map_iterate(&(wld.map), ptile) {
+        if (ptile->terrain != T_UNKNOWN
+            && ptile->continent > 0 && !seen[ptile->continent - 1]) {
+          if (++count >= ach->value) {
+            free(seen);
+            return TRUE;
           }
+          seen[ptile->continent - 1] = TRUE;
         }
       } whole_map_iterate_end;
 
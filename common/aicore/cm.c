@@ -230,10 +230,43 @@ struct cm_state {
   bool *workers_map; /* placement of the workers within the city map */
 };
 
+/*
+ * Per city cache, kept between the queries.
+ *
+ * Building the lattice is a large part of a query, and between two
+ * queries the city tiles seldom change. The signature holds everything
+ * the lattice is computed from (city radius, production of every tile and
+ * specialist). When it changes, only the tile types of the tiles whose
+ * production changed are updated. The cached lattice is not cleaned for
+ * the city size, and is never modified by a query: every query works on
+ * its own copy.
+ *
+ * The last solution found is also kept. It is the first incumbent of the
+ * next search, so that the branch and bound can prune with it from the
+ * start.
+ */
+struct cm_cache {
+  int *signature;
+  int signature_size;
+  struct tile_type_vector lattice; /* lattice_index is the position */
+
+  /* last solution found, valid if solution_workers != NULL */
+  int solution_radius_sq;
+  citizens solution_size;
+  bool *solution_workers;
+  citizens solution_specialists[SP_MAX];
+};
+
+/* Marks a tile or specialist which is not part of the lattice in the
+ * signature. */
+#define CM_NOT_IN_LATTICE (-FC_INFINITY)
+
 
 /* return #fields + specialist types */
 static int num_types(const struct cm_state *state);
 
+static void tile_type_vector_free_all(struct tile_type_vector *vec);
+
 
 /* debugging functions */
 #ifdef CM_DEBUG
@@ -315,7 +348,16 @@ void cm_init_citymap(void)
 ****************************************************************************/
 void cm_clear_cache(struct city *pcity)
 {
-  /* The B&B algorithm doesn't have city caches so there's nothing to do. */
+  struct cm_cache *cache = pcity->cm_cache;
+
+  if (cache == NULL) {
+    return;
+  }
+
+  tile_type_vector_free_all(&cache->lattice);
+  free(cache->signature);
+  free(cache->solution_workers);
+  FC_FREE(pcity->cm_cache);
 }
 
 /************************************************************************//**
@@ -879,43 +921,72 @@ static int compare_tile_type_by_fitness(const void *va, const void *vb)
   return compare_tile_type_by_lattice_order(*a, *b);
 }
 
-static Output_type_id compare_key;
-static double compare_key_trade_bonus;
+/* A tile type with its production of the stat the lattice is sorted by.
+ * The value is stored with the type rather than in a global, so that
+ * several cities can be solved at once in different threads. */
+struct cm_stat_key {
+  double value;
+  struct cm_tile_type *type;
+};
 
 /************************************************************************//**
-  Compare by the production of type compare_key.
+  Compare by the production of the stat the keys were computed for.
   If a produces more food than b, then a cannot be a child of b, so
   this respects the partial order -- unless a and b produce equal food.
   In that case, use compare_tile_type_by_lattice_order.
 ****************************************************************************/
 static int compare_tile_type_by_stat(const void *va, const void *vb)
 {
-  struct cm_tile_type * const *a = va;
-  struct cm_tile_type * const *b = vb;
+  const struct cm_stat_key *a = va;
+  const struct cm_stat_key *b = vb;
 
-  if (*a == *b) {
+  if (a->type == b->type) {
     return 0;
   }
 
-  /* consider the influence of trade on science, luxury, gold
-     for compute_max_stats_heuristics, which uses these sorted arrays,
-     it is essential, that the sorting is correct, else promising 
-     branches get pruned */
-  double valuea = (*a)->production[compare_key] + 
-                    compare_key_trade_bonus * (*a)->production[O_TRADE];
-  double valueb = (*b)->production[compare_key] +
-                    compare_key_trade_bonus * (*b)->production[O_TRADE];
-
   /* most production of what we care about goes first */
   /* double compare is ok, both values are calculated in the same way
-     and should only be considered equal, if equal in compare_key 
+     and should only be considered equal, if equal in the stat
      and O_TRADE */
-  if (valuea != valueb) {
+  if (a->value != b->value) {
     /* b-a so we sort big numbers first */
-    return valueb - valuea;
+    return b->value - a->value;
   }
 
-  return compare_tile_type_by_lattice_order(*a, *b);
+  return compare_tile_type_by_lattice_order(a->type, b->type);
+}
+
+/************************************************************************//**
+  Sort the lattice by the production of 'stat'. 'trade_bonus' is the
+  effect of 1 trade production on this stat.
+****************************************************************************/
+static void sort_lattice_by_stat(struct tile_type_vector *lattice,
+                                 Output_type_id stat, double trade_bonus)
+{
+  struct cm_stat_key *keys;
+  int i;
+
+  if (lattice->size == 0) {
+    return;
+  }
+
+  /* consider the influence of trade on science, luxury, gold
+     for compute_max_stats_heuristics, which uses these sorted arrays,
+     it is essential, that the sorting is correct, else promising 
+     branches get pruned */
+  keys = fc_malloc(lattice->size * sizeof(*keys));
+  for (i = 0; i < lattice->size; i++) {
+    keys[i].type = lattice->p[i];
+    keys[i].value = lattice->p[i]->production[stat]
+                    + trade_bonus * lattice->p[i]->production[O_TRADE];
+  }
+
+  qsort(keys, lattice->size, sizeof(*keys), compare_tile_type_by_stat);
+
+  for (i = 0; i < lattice->size; i++) {
+    lattice->p[i] = keys[i].type;
+  }
+  free(keys);
 }
 
 /****************************************************************************
@@ -923,18 +994,48 @@ static int compare_tile_type_by_stat(const void *va, const void *vb)
 ****************************************************************************/
 
 /************************************************************************//**
-  Compute the production of tile [x,y] and stuff it into the tile type.
-  Doesn't touch the other fields.
+  Compute the signature of the lattice of the city: its radius, then
+  O_LAST values for each index of the city map and for each
+  specialist. Tiles and specialists which can't be used get
+  CM_NOT_IN_LATTICE. Returns a newly allocated array.
+
+  The production of the tiles is read from the tile cache of the city, so
+  the city must have been refreshed.
 ****************************************************************************/
-static void compute_tile_production(const struct city *pcity,
-                                    const struct tile *ptile,
-                                    struct cm_tile_type *out)
+static int *compute_lattice_signature(const struct city *pcity, int *size)
 {
-  bool is_celebrating = base_city_celebrating(pcity);
+  int radius_sq = city_map_radius_sq_get(pcity);
+  int ntiles = city_map_tiles(radius_sq);
+  int *signature, *spec_signature;
+  int i;
 
-  output_type_iterate(o) {
-    out->production[o] = city_tile_output(pcity, ptile, is_celebrating, o);
-  } output_type_iterate_end;
+  *size = 1 + (ntiles + specialist_count()) * O_LAST;
+  signature = fc_malloc(*size * sizeof(*signature));
+  signature[0] = radius_sq;
+  for (i = 1; i < *size; i++) {
+    signature[i] = CM_NOT_IN_LATTICE;
+  }
+
+  city_tile_iterate_index(radius_sq, city_tile(pcity), ptile, ctindex) {
+    if (!is_free_worked(pcity, ptile) && city_can_work_tile(pcity, ptile)) {
+      output_type_iterate(o) {
+        signature[1 + ctindex * O_LAST + o]
+          = city_tile_cache_get_output(pcity, ctindex, o);
+      } output_type_iterate_end;
+    }
+  } city_tile_iterate_index_end;
+
+  spec_signature = signature + 1 + ntiles * O_LAST;
+  specialist_type_iterate(sp) {
+    if (city_can_use_specialist(pcity, sp)) {
+      output_type_iterate(output) {
+        spec_signature[sp * O_LAST + output]
+          = get_specialist_output(pcity, sp, output);
+      } output_type_iterate_end;
+    }
+  } specialist_type_iterate_end;
+
+  return signature;
 }
 
 /************************************************************************//**
@@ -975,14 +1076,106 @@ static void tile_type_lattice_add(struct tile_type_vector *lattice,
     tile_type_vector_append(lattice, type);
   }
 
-  /* Finally, add the tile to the tile type. */
+  /* Finally, add the tile to the tile type. The tiles are kept in city
+   * map index order, whatever the order they are added in. */
   if (!type->is_specialist) {
     struct cm_tile tile;
+    int j;
 
     tile.type = type;
     tile.index = tindex;
 
     tile_vector_append(&type->tiles, tile);
+    for (j = type->tiles.size - 1;
+         j > 0 && type->tiles.p[j - 1].index > tindex; j--) {
+      type->tiles.p[j] = type->tiles.p[j - 1];
+    }
+    type->tiles.p[j] = tile;
+  }
+}
+
+/************************************************************************//**
+  Remove all the links between the type and the other types of the
+  lattice. The type itself stays in the lattice vector.
+****************************************************************************/
+static void tile_type_lattice_unlink(struct cm_tile_type *ptype)
+{
+  int i;
+
+  tile_type_vector_iterate(&ptype->better_types, better) {
+    for (i = 0; i < better->worse_types.size; i++) {
+      if (better->worse_types.p[i] == ptype) {
+        tile_type_vector_remove(&better->worse_types, i);
+        break;
+      }
+    }
+  } tile_type_vector_iterate_end;
+  tile_type_vector_iterate(&ptype->worse_types, worse) {
+    for (i = 0; i < worse->better_types.size; i++) {
+      if (worse->better_types.p[i] == ptype) {
+        tile_type_vector_remove(&worse->better_types, i);
+        break;
+      }
+    }
+  } tile_type_vector_iterate_end;
+  ptype->better_types.size = 0;
+  ptype->worse_types.size = 0;
+}
+
+/************************************************************************//**
+  Remove the tile of city map index 'tindex' from the tile type it belongs
+  to. The type is left in the lattice, even if it has no tile anymore.
+****************************************************************************/
+static void tile_type_lattice_remove_tile(struct tile_type_vector *lattice,
+                                          int tindex)
+{
+  tile_type_vector_iterate(lattice, ptype) {
+    int j;
+
+    if (ptype->is_specialist) {
+      continue;
+    }
+    for (j = 0; j < ptype->tiles.size; j++) {
+      if (ptype->tiles.p[j].index == tindex) {
+        tile_vector_remove(&ptype->tiles, j);
+        return;
+      }
+    }
+  } tile_type_vector_iterate_end;
+
+  fc_assert_msg(FALSE, "City map index %d not in the lattice.", tindex);
+}
+
+/************************************************************************//**
+  Copy the lattice 'from' into the empty vector 'to'. The types are copied
+  too, with their tiles and links. The lattice_index of the types of
+  'from' must be their position.
+****************************************************************************/
+static void tile_type_lattice_copy(struct tile_type_vector *to,
+                                   const struct tile_type_vector *from)
+{
+  int i, j;
+
+  tile_type_vector_reserve(to, from->size);
+  for (i = 0; i < from->size; i++) {
+    struct cm_tile_type *ptype = tile_type_dup(from->p[i]);
+
+    tile_vector_copy(&ptype->tiles, &from->p[i]->tiles);
+    for (j = 0; j < ptype->tiles.size; j++) {
+      ptype->tiles.p[j].type = ptype;
+    }
+    to->p[i] = ptype;
+  }
+
+  for (i = 0; i < from->size; i++) {
+    tile_type_vector_iterate(&from->p[i]->better_types, better) {
+      tile_type_vector_append(&to->p[i]->better_types,
+                              to->p[better->lattice_index]);
+    } tile_type_vector_iterate_end;
+    tile_type_vector_iterate(&from->p[i]->worse_types, worse) {
+      tile_type_vector_append(&to->p[i]->worse_types,
+                              to->p[worse->lattice_index]);
+    } tile_type_vector_iterate_end;
   }
 }
 
@@ -995,7 +1188,7 @@ static void tile_type_lattice_add(struct tile_type_vector *lattice,
   tile_type for each specialist type.
 ****************************************************************************/
 static void init_specialist_lattice_nodes(struct tile_type_vector *lattice,
-                                          const struct city *pcity)
+                                          const int *spec_signature)
 {
   struct cm_tile_type type;
 
@@ -1005,11 +1198,11 @@ static void init_specialist_lattice_nodes(struct tile_type_vector *lattice,
   /* for each specialist type, create a tile_type that has as production
    * the bonus for the specialist (if the city is allowed to use it) */
   specialist_type_iterate(i) {
-    if (city_can_use_specialist(pcity, i)) {
+    const int *production = spec_signature + i * O_LAST;
+
+    if (production[0] != CM_NOT_IN_LATTICE) {
       type.spec = i;
-      output_type_iterate(output) {
-        type.production[output] = get_specialist_output(pcity, i, output);
-      } output_type_iterate_end;
+      memcpy(type.production, production, sizeof(type.production));
 
       tile_type_lattice_add(lattice, &type, 0);
     }
@@ -1198,36 +1391,33 @@ static void sort_lattice_by_fitness(const struct cm_state *state,
 }
 
 /************************************************************************//**
-  Create the lattice.
+  Create the lattice from the productions of the lattice signature. The
+  lattice is not cleaned for the city size, see clean_lattice().
 ****************************************************************************/
-static void init_tile_lattice(struct city *pcity,
-                              struct tile_type_vector *lattice)
+static void init_tile_lattice(struct tile_type_vector *lattice,
+                              const int *signature)
 {
   struct cm_tile_type type;
-  struct tile *pcenter = city_tile(pcity);
+  int ntiles = city_map_tiles(signature[0]);
+  int ctindex;
 
   /* add all the fields into the lattice */
   tile_type_init(&type); /* init just once */
 
-  city_tile_iterate_index(city_map_radius_sq_get(pcity), pcenter, ptile,
-                          ctindex) {
-    if (is_free_worked(pcity, ptile)) {
-      continue;
-    } else if (city_can_work_tile(pcity, ptile)) {
-      compute_tile_production(pcity, ptile, &type); /* clobbers type */
+  for (ctindex = 0; ctindex < ntiles; ctindex++) {
+    const int *production = signature + 1 + ctindex * O_LAST;
+
+    if (production[0] != CM_NOT_IN_LATTICE) {
+      memcpy(type.production, production, sizeof(type.production));
       tile_type_lattice_add(lattice, &type, ctindex); /* copy type if needed */
     }
-  } city_tile_iterate_index_end;
+  }
 
   /* Add all the specialists into the lattice.  */
-  init_specialist_lattice_nodes(lattice, pcity);
+  init_specialist_lattice_nodes(lattice, signature + 1 + ntiles * O_LAST);
 
-  /* Set the lattice_depth fields, and clean up unreachable nodes. */
+  /* Set the lattice_depth fields. */
   top_sort_lattice(lattice);
-  clean_lattice(lattice, pcity);
-
-  /* All done now. */
-  print_lattice(LOG_LATTICE, lattice);
 }
 
 
@@ -1816,6 +2006,107 @@ static bool bb_next(struct cm_state *state, bool negative_ok)
   return FALSE;
 }
 
+/************************************************************************//**
+  Update the cached lattice from the signature 'old' to the signature
+  'signature' of the same size and radius. Only the tiles and specialists
+  whose production changed are moved to other tile types. The result is
+  the lattice init_tile_lattice() would build, up to the order of the
+  types and of their links.
+****************************************************************************/
+static void cm_cache_lattice_update(struct tile_type_vector *lattice,
+                                    const int *old, const int *signature)
+{
+  struct cm_tile_type type;
+  int ntiles = city_map_tiles(signature[0]);
+  size_t spec_size = specialist_count() * O_LAST * sizeof(*signature);
+  const int *old_spec = old + 1 + ntiles * O_LAST;
+  const int *spec_signature = signature + 1 + ntiles * O_LAST;
+  bool specialists_changed = (0 != memcmp(old_spec, spec_signature,
+                                          spec_size));
+  int ctindex, i, j;
+
+  /* Move the changed tiles. Types left without tiles are removed below. */
+  tile_type_init(&type);
+  for (ctindex = 0; ctindex < ntiles; ctindex++) {
+    const int *old_production = old + 1 + ctindex * O_LAST;
+    const int *production = signature + 1 + ctindex * O_LAST;
+
+    if (0 == memcmp(old_production, production,
+                    O_LAST * sizeof(*production))) {
+      continue;
+    }
+    if (old_production[0] != CM_NOT_IN_LATTICE) {
+      tile_type_lattice_remove_tile(lattice, ctindex);
+    }
+    if (production[0] != CM_NOT_IN_LATTICE) {
+      memcpy(type.production, production, sizeof(type.production));
+      tile_type_lattice_add(lattice, &type, ctindex);
+    }
+  }
+
+  /* Remove the empty tile types, and the specialists if any changed. */
+  for (i = 0, j = 0; i < lattice->size; i++) {
+    struct cm_tile_type *ptype = lattice->p[i];
+
+    if (ptype->is_specialist ? specialists_changed
+                             : 0 == ptype->tiles.size) {
+      tile_type_lattice_unlink(ptype);
+      tile_type_destroy(ptype);
+      free(ptype);
+    } else {
+      ptype->lattice_index = j;
+      lattice->p[j++] = ptype;
+    }
+  }
+  lattice->size = j;
+
+  if (specialists_changed) {
+    init_specialist_lattice_nodes(lattice, spec_signature);
+  }
+
+  /* The number of tiles of the types changed, so all the depths may have
+   * changed. */
+  top_sort_lattice(lattice);
+}
+
+/************************************************************************//**
+  Make sure the lattice in the cache of the city matches the city. It is
+  built the first time and when the city radius changes, and updated when
+  the lattice signature changes.
+****************************************************************************/
+static void cm_cache_update_lattice(struct city *pcity)
+{
+  struct cm_cache *cache = pcity->cm_cache;
+  int size;
+  int *signature = compute_lattice_signature(pcity, &size);
+
+  if (cache == NULL) {
+    cache = fc_calloc(1, sizeof(*cache));
+    tile_type_vector_init(&cache->lattice);
+    pcity->cm_cache = cache;
+  } else if (cache->signature_size == size
+             && 0 == memcmp(cache->signature, signature,
+                            size * sizeof(*signature))) {
+    /* Nothing has changed, the lattice can be reused. */
+    free(signature);
+    return;
+  }
+
+  if (cache->signature != NULL
+      && cache->signature_size == size
+      && cache->signature[0] == signature[0]) {
+    cm_cache_lattice_update(&cache->lattice, cache->signature, signature);
+  } else {
+    tile_type_vector_free_all(&cache->lattice);
+    tile_type_vector_init(&cache->lattice);
+    init_tile_lattice(&cache->lattice, signature);
+  }
+
+  free(cache->signature);
+  cache->signature = signature;
+  cache->signature_size = size;
+}
+
 /************************************************************************//**
   Initialize the state for the branch-and-bound algorithm.
 ****************************************************************************/
@@ -1826,6 +2117,7 @@ static struct cm_state *cm_state_init(struct city *pcity, bool negative_ok)
   int numtypes;
   struct cm_state *state = fc_malloc(sizeof(*state));
   int rates[3];
+  double trade_bonus;
 
   log_base(LOG_CM_STATE, "creating cm_state for %s (size %d)",
            city_name_get(pcity), city_size_get(pcity));
@@ -1833,9 +2125,13 @@ static struct cm_state *cm_state_init(struct city *pcity, bool negative_ok)
   /* copy the arguments */
   state->pcity = pcity;
 
-  /* create the lattice */
+  /* create the lattice from the one of the cache, and clean it up for
+   * the city size */
+  cm_cache_update_lattice(pcity);
   tile_type_vector_init(&state->lattice);
-  init_tile_lattice(pcity, &state->lattice);
+  tile_type_lattice_copy(&state->lattice, &pcity->cm_cache->lattice);
+  clean_lattice(&state->lattice, pcity);
+  print_lattice(LOG_LATTICE, &state->lattice);
   numtypes = tile_type_vector_size(&state->lattice);
 
   get_tax_rates(pplayer, rates);
@@ -1844,25 +2140,23 @@ static struct cm_state *cm_state_init(struct city *pcity, bool negative_ok)
   output_type_iterate(stat_index) {
     tile_type_vector_init(&state->lattice_by_prod[stat_index]);
     tile_type_vector_copy(&state->lattice_by_prod[stat_index], &state->lattice);
-    compare_key = stat_index;
     /* calculate effect of 1 trade production on interesting production */
     switch (stat_index) {
       case O_SCIENCE:
-        compare_key_trade_bonus = rates[SCIENCE] * pcity->bonus[O_TRADE] / 100.0;
+        trade_bonus = rates[SCIENCE] * pcity->bonus[O_TRADE] / 100.0;
         break;
       case O_LUXURY:
-        compare_key_trade_bonus = rates[LUXURY] * pcity->bonus[O_TRADE] / 100.0;
+        trade_bonus = rates[LUXURY] * pcity->bonus[O_TRADE] / 100.0;
         break;
       case O_GOLD:
-        compare_key_trade_bonus = rates[TAX] * pcity->bonus[O_TRADE] / 100.0;
+        trade_bonus = rates[TAX] * pcity->bonus[O_TRADE] / 100.0;
         break;
       default:
-        compare_key_trade_bonus = 0.0;
+        trade_bonus = 0.0;
         break;
     }
-    qsort(state->lattice_by_prod[stat_index].p, state->lattice_by_prod[stat_index].size,
-          sizeof(*state->lattice_by_prod[stat_index].p),
-          compare_tile_type_by_stat);
+    sort_lattice_by_stat(&state->lattice_by_prod[stat_index], stat_index,
+                         trade_bonus);
   } output_type_iterate_end;
 
   state->min_luxury = - FC_INFINITY;
@@ -2003,6 +2297,107 @@ static void cm_state_free(struct cm_state *state)
   FC_FREE(state);
 }
 
+/************************************************************************//**
+  Make the last solution found for the city the best solution, if it can
+  still be made with the current lattice and is better. Done before the
+  search, the branch and bound then only explores the branches which may
+  beat it.
+****************************************************************************/
+static void use_cached_solution(struct cm_state *state, bool negative_ok)
+{
+  struct city *pcity = state->pcity;
+  const struct cm_cache *cache = pcity->cm_cache;
+  int ntiles = city_map_tiles_from_city(pcity);
+  const struct cm_tile_type *types_by_tile[MAX_CITY_TILES];
+  int types_by_spec[SP_MAX];
+  struct partial_solution soln;
+  struct cm_fitness value;
+  int i, nworkers = 0;
+
+  if (cache->solution_workers == NULL
+      || cache->solution_radius_sq != city_map_radius_sq_get(pcity)
+      || cache->solution_size != city_size_get(pcity)) {
+    return;
+  }
+
+  memset(types_by_tile, 0, ntiles * sizeof(*types_by_tile));
+  for (i = 0; i < SP_MAX; i++) {
+    types_by_spec[i] = -1;
+  }
+  tile_type_vector_iterate(&state->lattice, ptype) {
+    if (ptype->is_specialist) {
+      types_by_spec[ptype->spec] = ptype->lattice_index;
+    } else {
+      int j;
+
+      for (j = 0; j < ptype->tiles.size; j++) {
+        types_by_tile[ptype->tiles.p[j].index] = ptype;
+      }
+    }
+  } tile_type_vector_iterate_end;
+
+  /* Check that every worker of the solution still has a place. */
+  for (i = 0; i < ntiles; i++) {
+    if (cache->solution_workers[i] && !is_free_worked_index(i)) {
+      if (types_by_tile[i] == NULL) {
+        return;
+      }
+      nworkers++;
+    }
+  }
+  specialist_type_iterate(sp) {
+    if (cache->solution_specialists[sp] > 0) {
+      if (types_by_spec[sp] < 0) {
+        return;
+      }
+      nworkers += cache->solution_specialists[sp];
+    }
+  } specialist_type_iterate_end;
+  if (nworkers != city_size_get(pcity)) {
+    return;
+  }
+
+  init_partial_solution(&soln, num_types(state), city_size_get(pcity),
+                        negative_ok);
+  for (i = 0; i < ntiles; i++) {
+    if (cache->solution_workers[i] && !is_free_worked_index(i)) {
+      add_worker(&soln, types_by_tile[i]->lattice_index, state);
+    }
+  }
+  specialist_type_iterate(sp) {
+    add_workers(&soln, types_by_spec[sp], cache->solution_specialists[sp],
+                state);
+  } specialist_type_iterate_end;
+
+  value = evaluate_solution(state, &soln);
+  if (fitness_better(value, state->best_value)) {
+    copy_partial_solution(&state->best, &soln, state);
+    state->best_value = value;
+  }
+  destroy_partial_solution(&soln);
+}
+
+/************************************************************************//**
+  Remember the solution applied to the city for the next query. Must be
+  called while the solution is still applied, before the city is restored.
+****************************************************************************/
+static void cache_solution(struct cm_state *state)
+{
+  struct city *pcity = state->pcity;
+  struct cm_cache *cache = pcity->cm_cache;
+  int ntiles = city_map_tiles_from_city(pcity);
+
+  cache->solution_workers = fc_realloc(cache->solution_workers,
+                                       ntiles
+                                       * sizeof(*cache->solution_workers));
+  memcpy(cache->solution_workers, state->workers_map,
+         ntiles * sizeof(*cache->solution_workers));
+  memcpy(cache->solution_specialists, pcity->specialists,
+         sizeof(cache->solution_specialists));
+  cache->solution_radius_sq = city_map_radius_sq_get(pcity);
+  cache->solution_size = city_size_get(pcity);
+}
+
 /************************************************************************//**
   Run B&B until we find the best solution.
 ****************************************************************************/
@@ -2031,6 +2426,9 @@ static void cm_find_best_solution(struct cm_state *state,
 
   result->aborted = FALSE;
 
+  /* start from the last solution of the city */
+  use_cached_solution(state, negative_ok);
+
   /* search until we find a feasible solution */
   while (!bb_next(state, negative_ok)) {
     /* Limit the number of loops. */
@@ -2046,6 +2444,9 @@ static void cm_find_best_solution(struct cm_state *state,
 
   /* convert to the caller's format */
   convert_solution_to_result(state, &state->best, result);
+  if (result->found_a_valid) {
+    cache_solution(state);
+  }
 
   memcpy(state->pcity, &backup, sizeof(backup));
 
@@ -2060,13 +2461,16 @@ void cm_query_result(struct city *pcity,
                      const struct cm_parameter *param,
                      struct cm_result *result, bool negative_ok)
 {
-  struct cm_state *state = cm_state_init(pcity, negative_ok);
+  struct cm_state *state;
 
   /* Refresh the city.  Otherwise the CM can give wrong results or just be
    * slower than necessary.  Note that cities are often passed in in an
-   * unrefreshed state (which should probably be fixed). */
+   * unrefreshed state (which should probably be fixed). This also fills
+   * the tile cache the lattice is built from. */
   city_refresh_from_main_map(pcity, NULL);
 
+  state = cm_state_init(pcity, negative_ok);
+
   cm_find_best_solution(state, param, result, negative_ok);
   cm_state_free(state);
 }
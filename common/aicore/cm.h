@@ -78,8 +78,10 @@ void cm_query_result(struct city *pcity,
                      struct cm_result *result, bool negative_ok);
 
 /*
- * Call this function if the city has changed. To be safe call it
- * everytime before you call cm_query_result().
+ * The CM keeps the tile lattice and the last solution of each city, to
+ * reuse them in the next query. The cache checks by itself whether the
+ * city tiles have changed, so calling this is never needed for
+ * correctness. It frees the cache of the city.
  */
 void cm_clear_cache(struct city *pcity);
 
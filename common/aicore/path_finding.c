@@ -17,6 +17,7 @@
 
 /* utility */
 #include "bitvector.h"
+#include "fcthread.h"
 #include "log.h"
 #include "mem.h"
 #include "support.h"
@@ -46,14 +47,15 @@
 
 /* ======================== Internal structures ========================== */
 
-#ifdef PF_DEBUG
-/* The mode we use the pf_map. Used for cast converion checks. */
+/* The mode we use the pf_map. Used for cast converion checks and to
+ * recycle the maps. */
 enum pf_mode {
-  PF_NORMAL = 1,        /* Usual goto */
+  PF_NORMAL = 0,        /* Usual goto */
   PF_DANGER,            /* Goto with dangerous positions */
-  PF_FUEL               /* Goto for fueled units */
+  PF_FUEL,              /* Goto for fueled units */
+  PF_SHARED,            /* View of a shared map */
+  PF_MODE_COUNT
 };
-#endif /* PF_DEBUG */
 
 enum pf_node_status {
   NS_UNINIT = 0,        /* memory is calloced, hence zero means
@@ -75,13 +77,18 @@ enum pf_zoc_type {
 };
 
 /* Abstract base class for pf_normal_map, pf_danger_map, and pf_fuel_map. */
+struct pf_map_record;
+
 struct pf_map {
-#ifdef PF_DEBUG
   enum pf_mode mode;    /* The mode of the map, for conversion checking. */
-#endif /* PF_DEBUG */
+  int lattice_size;     /* The number of nodes of the lattice. */
+  struct pf_map_record *record; /* The order of the iteration, only kept
+                                 * for shared maps. */
 
   /* "Virtual" function table. */
   void (*destroy) (struct pf_map *pfm); /* Destructor. */
+  bool (*reset) (struct pf_map *pfm,    /* Restart with new parameters. */
+                 const struct pf_parameter *parameter);
   int (*get_move_cost) (struct pf_map *pfm, struct tile *ptile);
   struct pf_path * (*get_path) (struct pf_map *pfm, struct tile *ptile);
   bool (*get_position) (struct pf_map *pfm, struct tile *ptile,
@@ -220,6 +227,7 @@ struct pf_normal_node {
   unsigned behavior : 2;        /* 'enum tile_behavior' really. */
   unsigned zoc_number : 2;      /* 'enum pf_zoc_type' really. */
   unsigned short extra_tile;    /* EC */
+  unsigned short generation;    /* The search which set this node. */
 };
 
 /* Derived structure of struct pf_map. */
@@ -230,6 +238,10 @@ struct pf_normal_map {
                                * processed yet (NS_NEW), sorted by their
                                * total_CC. */
   struct pf_normal_node *lattice; /* Lattice of nodes. */
+  unsigned short generation; /* The current search, see
+                              * pf_normal_map_node(). */
+  const bool *allowed_tiles; /* If set, the search is restricted to these
+                              * tiles, see pf_map_new_restricted(). */
 };
 
 /* Up-cast macro. */
@@ -249,6 +261,24 @@ pf_normal_map_check(struct pf_map *pfm, const char *file,
 #define PF_NORMAL_MAP(pfm) ((struct pf_normal_map *) (pfm))
 #endif /* PF_DEBUG */
 
+/************************************************************************//**
+  Returns the node at 'tindex'. Maps are recycled by increasing their
+  generation instead of clearing the whole lattice, so a node left by a
+  previous search is cleared when it is accessed for the first time.
+****************************************************************************/
+static inline struct pf_normal_node *
+pf_normal_map_node(const struct pf_normal_map *pfnm, int tindex)
+{
+  struct pf_normal_node *node = pfnm->lattice + tindex;
+
+  if (node->generation != pfnm->generation) {
+    memset(node, 0, sizeof(*node));
+    node->generation = pfnm->generation;
+  }
+
+  return node;
+}
+
 /* ================  Specific pf_normal_* mode functions ================= */
 
 /************************************************************************//**
@@ -272,6 +302,14 @@ static inline bool pf_normal_node_init(struct pf_normal_map *pfnm,
 
   node->status = NS_INIT;
 
+  /* Tiles outside of the allowed area are just ignored. */
+  if (NULL != pfnm->allowed_tiles
+      && !pfnm->allowed_tiles[tile_index(ptile)]
+      && params->start_tile != ptile) {
+    node->behavior = TB_IGNORE;
+    return FALSE;
+  }
+
   /* Establish the "known" status of node. */
   if (params->omniscience) {
     node_known_type = TILE_KNOWN_SEEN;
@@ -401,7 +439,7 @@ static void pf_normal_map_fill_position(const struct pf_normal_map *pfnm,
                                         struct pf_position *pos)
 {
   int tindex = tile_index(ptile);
-  struct pf_normal_node *node = pfnm->lattice + tindex;
+  struct pf_normal_node *node = pf_normal_map_node(pfnm, tindex);
   const struct pf_parameter *params = pf_map_parameter(PF_MAP(pfnm));
 
 #ifdef PF_DEBUG
@@ -436,7 +474,7 @@ static struct pf_path *
 pf_normal_map_construct_path(const struct pf_normal_map *pfnm,
                              struct tile *dest_tile)
 {
-  struct pf_normal_node *node = pfnm->lattice + tile_index(dest_tile);
+  struct pf_normal_node *node = pf_normal_map_node(pfnm, tile_index(dest_tile));
   const struct pf_parameter *params = pf_map_parameter(PF_MAP(pfnm));
   enum direction8 dir_next = direction8_invalid();
   struct pf_path *path;
@@ -461,7 +499,7 @@ pf_normal_map_construct_path(const struct pf_normal_map *pfnm,
     }
 
     ptile = mapstep(params->map, ptile, DIR_REVERSE(node->dir_to_here));
-    node = pfnm->lattice + tile_index(ptile);
+    node = pf_normal_map_node(pfnm, tile_index(ptile));
   }
 
   /* 2: Allocate the memory */
@@ -470,7 +508,7 @@ pf_normal_map_construct_path(const struct pf_normal_map *pfnm,
 
   /* 3: Backtrack again and fill the positions this time */
   ptile = dest_tile;
-  node = pfnm->lattice + tile_index(ptile);
+  node = pf_normal_map_node(pfnm, tile_index(ptile));
 
   for (; i >= 0; i--) {
     pf_normal_map_fill_position(pfnm, ptile, &path->positions[i]);
@@ -482,7 +520,7 @@ pf_normal_map_construct_path(const struct pf_normal_map *pfnm,
     if (i > 0) {
       /* Step further back, if we haven't finished yet */
       ptile = mapstep(params->map, ptile, DIR_REVERSE(dir_next));
-      node = pfnm->lattice + tile_index(ptile);
+      node = pf_normal_map_node(pfnm, tile_index(ptile));
     }
   }
 
@@ -521,7 +559,7 @@ static bool pf_jumbo_map_iterate(struct pf_map *pfm)
   struct pf_normal_map *pfnm = PF_NORMAL_MAP(pfm);
   struct tile *tile = pfm->tile;
   int tindex = tile_index(tile);
-  struct pf_normal_node *node = pfnm->lattice + tindex;
+  struct pf_normal_node *node = pf_normal_map_node(pfnm, tindex);
   const struct pf_parameter *params = pf_map_parameter(pfm);
 
   /* Processing Stage */
@@ -534,7 +572,7 @@ static bool pf_jumbo_map_iterate(struct pf_map *pfm)
     /* Calculate the cost of every adjacent position and set them in the
      * priority queue for next call to pf_jumbo_map_iterate(). */
     int tindex1 = tile_index(tile1);
-    struct pf_normal_node *node1 = pfnm->lattice + tindex1;
+    struct pf_normal_node *node1 = pf_normal_map_node(pfnm, tindex1);
     int priority, cost1, extra_cost1;
 
     /* As for the previous position, 'tile1', 'node1' and 'tindex1' are
@@ -582,12 +620,12 @@ static bool pf_jumbo_map_iterate(struct pf_map *pfm)
   }
 
 #ifdef PF_DEBUG
-  fc_assert(NS_NEW == pfnm->lattice[tindex].status);
+  fc_assert(NS_NEW == pf_normal_map_node(pfnm, tindex)->status);
 #endif
 
   /* Change the pf_map iterator. Node status step B. to C. */
   pfm->tile = index_to_tile(params->map, tindex);
-  pfnm->lattice[tindex].status = NS_PROCESSED;
+  pf_normal_map_node(pfnm, tindex)->status = NS_PROCESSED;
 
   return TRUE;
 }
@@ -613,7 +651,7 @@ static bool pf_normal_map_iterate(struct pf_map *pfm)
   struct pf_normal_map *pfnm = PF_NORMAL_MAP(pfm);
   struct tile *tile = pfm->tile;
   int tindex = tile_index(tile);
-  struct pf_normal_node *node = pfnm->lattice + tindex;
+  struct pf_normal_node *node = pf_normal_map_node(pfnm, tindex);
   const struct pf_parameter *params = pf_map_parameter(pfm);
   int cost_of_path;
   enum pf_move_scope scope = node->move_scope;
@@ -632,7 +670,7 @@ static bool pf_normal_map_iterate(struct pf_map *pfm)
       /* Calculate the cost of every adjacent position and set them in the
        * priority queue for next call to pf_normal_map_iterate(). */
       int tindex1 = tile_index(tile1);
-      struct pf_normal_node *node1 = pfnm->lattice + tindex1;
+      struct pf_normal_node *node1 = pf_normal_map_node(pfnm, tindex1);
       int cost;
       int extra = 0;
 
@@ -735,12 +773,12 @@ static bool pf_normal_map_iterate(struct pf_map *pfm)
   }
 
 #ifdef PF_DEBUG
-  fc_assert(NS_NEW == pfnm->lattice[tindex].status);
+  fc_assert(NS_NEW == pf_normal_map_node(pfnm, tindex)->status);
 #endif
 
   /* Change the pf_map iterator. Node status step C. to D. */
   pfm->tile = index_to_tile(params->map, tindex);
-  pfnm->lattice[tindex].status = NS_PROCESSED;
+  pf_normal_map_node(pfnm, tindex)->status = NS_PROCESSED;
 
   return TRUE;
 }
@@ -752,7 +790,7 @@ static inline bool pf_normal_map_iterate_until(struct pf_normal_map *pfnm,
                                                struct tile *ptile)
 {
   struct pf_map *pfm = PF_MAP(pfnm);
-  struct pf_normal_node *node = pfnm->lattice + tile_index(ptile);
+  struct pf_normal_node *node = pf_normal_map_node(pfnm, tile_index(ptile));
 
   if (NULL == pf_map_parameter(pfm)->get_costs) {
     /* Start position is handled in every function calling this function. */
@@ -791,7 +829,7 @@ static int pf_normal_map_move_cost(struct pf_map *pfm, struct tile *ptile)
   if (ptile == pfm->params.start_tile) {
     return 0;
   } else if (pf_normal_map_iterate_until(pfnm, ptile)) {
-    return (pfnm->lattice[tile_index(ptile)].cost
+    return (pf_normal_map_node(pfnm, tile_index(ptile))->cost
             - pf_move_rate(pf_map_parameter(pfm))
             + pf_moves_left_initially(pf_map_parameter(pfm)));
   } else {
@@ -838,6 +876,9 @@ static bool pf_normal_map_position(struct pf_map *pfm, struct tile *ptile,
   }
 }
 
+static bool pf_normal_map_reset(struct pf_map *pfm,
+                                const struct pf_parameter *parameter);
+
 /************************************************************************//**
   'pf_normal_map' destructor.
 ****************************************************************************/
@@ -851,40 +892,31 @@ static void pf_normal_map_destroy(struct pf_map *pfm)
 }
 
 /************************************************************************//**
-  'pf_normal_map' constructor.
+  Initialize the 'pf_normal_map' for a new search: copy the parameters and
+  set the starting node. The lattice and the queue must be empty.
 ****************************************************************************/
-static struct pf_map *pf_normal_map_new(const struct pf_parameter *parameter)
+static bool pf_normal_map_start(struct pf_normal_map *pfnm,
+                                const struct pf_parameter *parameter)
 {
-  struct pf_normal_map *pfnm;
-  struct pf_map *base_map;
-  struct pf_parameter *params;
+  struct pf_map *base_map = &pfnm->base_map;
+  struct pf_parameter *params = &base_map->params;
   struct pf_normal_node *node;
 
-  pfnm = fc_malloc(sizeof(*pfnm));
-  base_map = &pfnm->base_map;
-  params = &base_map->params;
-#ifdef PF_DEBUG
-  /* Set the mode, used for cast check. */
-  base_map->mode = PF_NORMAL;
-#endif /* PF_DEBUG */
-
-  /* Allocate the map. */
-  pfnm->lattice = fc_calloc(MAP_INDEX_SIZE, sizeof(struct pf_normal_node));
-  pfnm->queue = map_index_pq_new(INITIAL_QUEUE_SIZE);
-
   if (NULL == parameter->get_costs) {
     /* 'get_MC' callback must be set. */
-    fc_assert_ret_val(NULL != parameter->get_MC, NULL);
+    fc_assert_ret_val(NULL != parameter->get_MC, FALSE);
 
     /* 'get_move_scope' callback must be set. */
-    fc_assert_ret_val(parameter->get_move_scope != NULL, NULL);
+    fc_assert_ret_val(parameter->get_move_scope != NULL, FALSE);
   }
 
   /* Copy parameters. */
   *params = *parameter;
+  pfnm->allowed_tiles = NULL;
 
   /* Initialize virtual function table. */
   base_map->destroy = pf_normal_map_destroy;
+  base_map->reset = pf_normal_map_reset;
   base_map->get_move_cost = pf_normal_map_move_cost;
   base_map->get_path = pf_normal_map_path;
   base_map->get_position = pf_normal_map_position;
@@ -895,7 +927,7 @@ static struct pf_map *pf_normal_map_new(const struct pf_parameter *parameter)
   }
 
   /* Initialise starting node. */
-  node = pfnm->lattice + tile_index(params->start_tile);
+  node = pf_normal_map_node(pfnm, tile_index(params->start_tile));
   if (NULL == params->get_costs) {
     if (!pf_normal_node_init(pfnm, node, params->start_tile, PF_MS_NONE)) {
       /* Always fails. */
@@ -930,7 +962,56 @@ static struct pf_map *pf_normal_map_new(const struct pf_parameter *parameter)
   node->dir_to_here = direction8_invalid();
   node->status = NS_PROCESSED;
 
-  return PF_MAP(pfnm);
+  return TRUE;
+}
+
+/************************************************************************//**
+  Restart the 'pf_normal_map' with new parameters. The nodes of the
+  previous search are not cleared here, but when they are accessed again,
+  see pf_normal_map_node().
+****************************************************************************/
+static bool pf_normal_map_reset(struct pf_map *pfm,
+                                const struct pf_parameter *parameter)
+{
+  struct pf_normal_map *pfnm = PF_NORMAL_MAP(pfm);
+
+  if (0 == ++pfnm->generation) {
+    /* Wrapped, older nodes could be considered as valid. */
+    memset(pfnm->lattice, 0,
+           pfm->lattice_size * sizeof(struct pf_normal_node));
+  }
+  map_index_pq_destroy(pfnm->queue);
+  pfnm->queue = map_index_pq_new(INITIAL_QUEUE_SIZE);
+
+  return pf_normal_map_start(pfnm, parameter);
+}
+
+/************************************************************************//**
+  'pf_normal_map' constructor.
+****************************************************************************/
+static struct pf_map *pf_normal_map_new(const struct pf_parameter *parameter)
+{
+  struct pf_normal_map *pfnm;
+  struct pf_map *base_map;
+
+  pfnm = fc_malloc(sizeof(*pfnm));
+  base_map = &pfnm->base_map;
+  /* Set the mode, used for cast check and recycling. */
+  base_map->mode = PF_NORMAL;
+
+  /* Allocate the map. */
+  base_map->lattice_size = MAP_INDEX_SIZE;
+  base_map->record = NULL;
+  pfnm->lattice = fc_calloc(MAP_INDEX_SIZE, sizeof(struct pf_normal_node));
+  pfnm->generation = 0;
+  pfnm->queue = map_index_pq_new(INITIAL_QUEUE_SIZE);
+
+  if (!pf_normal_map_start(pfnm, parameter)) {
+    pf_normal_map_destroy(base_map);
+    return NULL;
+  }
+
+  return base_map;
 }
 
 
@@ -961,6 +1042,7 @@ struct pf_danger_node {
   bool is_dangerous : 1;        /* Whether we cannot end the turn there. */
   bool waited : 1;              /* TRUE if waited to get there. */
   unsigned short extra_tile;    /* EC */
+  unsigned short generation;    /* The search which set this node. */
 
   /* Segment leading across the danger area back to the nearest safe node:
    * need to remeber costs and stuff. */
@@ -980,6 +1062,8 @@ struct pf_danger_map {
                                  * sorted by their total_CC. */
   struct map_index_pq *danger_queue; /* Dangerous positions. */
   struct pf_danger_node *lattice; /* Lattice of nodes. */
+  unsigned short generation;    /* The current search, see
+                                 * pf_danger_map_node(). */
 };
 
 /* Up-cast macro. */
@@ -999,6 +1083,26 @@ pf_danger_map_check(struct pf_map *pfm, const char *file,
 #define PF_DANGER_MAP(pfm) ((struct pf_danger_map *) (pfm))
 #endif /* PF_DEBUG */
 
+/************************************************************************//**
+  Returns the node at 'tindex', clearing it if it was set by a previous
+  search. See pf_normal_map_node().
+****************************************************************************/
+static inline struct pf_danger_node *
+pf_danger_map_node(const struct pf_danger_map *pfdm, int tindex)
+{
+  struct pf_danger_node *node = pfdm->lattice + tindex;
+
+  if (node->generation != pfdm->generation) {
+    if (NULL != node->danger_segment) {
+      free(node->danger_segment);
+    }
+    memset(node, 0, sizeof(*node));
+    node->generation = pfdm->generation;
+  }
+
+  return node;
+}
+
 /* ===============  Specific pf_danger_* mode functions ================== */
 
 /************************************************************************//**
@@ -1160,7 +1264,7 @@ static void pf_danger_map_fill_position(const struct pf_danger_map *pfdm,
                                         struct pf_position *pos)
 {
   int tindex = tile_index(ptile);
-  struct pf_danger_node *node = pfdm->lattice + tindex;
+  struct pf_danger_node *node = pf_danger_map_node(pfdm, tindex);
   const struct pf_parameter *params = pf_map_parameter(PF_MAP(pfdm));
 
 #ifdef PF_DEBUG
@@ -1218,7 +1322,7 @@ pf_danger_map_construct_path(const struct pf_danger_map *pfdm,
   enum direction8 dir_next = direction8_invalid();
   struct pf_danger_pos *danger_seg = NULL;
   bool waited = FALSE;
-  struct pf_danger_node *node = pfdm->lattice + tile_index(ptile);
+  struct pf_danger_node *node = pf_danger_map_node(pfdm, tile_index(ptile));
   int length = 1;
   struct tile *iter_tile = ptile;
   const struct pf_parameter *params = pf_map_parameter(PF_MAP(pfdm));
@@ -1255,7 +1359,7 @@ pf_danger_map_construct_path(const struct pf_danger_map *pfdm,
 
     /* Step backward. */
     iter_tile = mapstep(params->map, iter_tile, DIR_REVERSE(dir_next));
-    node = pfdm->lattice + tile_index(iter_tile);
+    node = pf_danger_map_node(pfdm, tile_index(iter_tile));
   }
 
   /* Allocate memory for path. */
@@ -1264,7 +1368,7 @@ pf_danger_map_construct_path(const struct pf_danger_map *pfdm,
 
   /* Reset variables for main iteration. */
   iter_tile = ptile;
-  node = pfdm->lattice + tile_index(ptile);
+  node = pf_danger_map_node(pfdm, tile_index(ptile));
   danger_seg = NULL;
   waited = FALSE;
 
@@ -1346,7 +1450,7 @@ pf_danger_map_construct_path(const struct pf_danger_map *pfdm,
 
     /* 5: Step further back. */
     iter_tile = mapstep(params->map, iter_tile, DIR_REVERSE(dir_next));
-    node = pfdm->lattice + tile_index(iter_tile);
+    node = pf_danger_map_node(pfdm, tile_index(iter_tile));
   }
 
   fc_assert_msg(FALSE, "Cannot get to the starting point!");
@@ -1375,7 +1479,7 @@ static void pf_danger_map_create_segment(struct pf_danger_map *pfdm,
                                          struct pf_danger_node *node1)
 {
   struct tile *ptile = PF_MAP(pfdm)->tile;
-  struct pf_danger_node *node = pfdm->lattice + tile_index(ptile);
+  struct pf_danger_node *node = pf_danger_map_node(pfdm, tile_index(ptile));
   struct pf_danger_pos *pos;
   int length = 0, i;
   const struct pf_parameter *params = pf_map_parameter(PF_MAP(pfdm));
@@ -1390,7 +1494,7 @@ static void pf_danger_map_create_segment(struct pf_danger_map *pfdm,
   while (node->is_dangerous && direction8_is_valid(node->dir_to_here)) {
     length++;
     ptile = mapstep(params->map, ptile, DIR_REVERSE(node->dir_to_here));
-    node = pfdm->lattice + tile_index(ptile);
+    node = pf_danger_map_node(pfdm, tile_index(ptile));
   }
 
   /* Allocate memory for segment */
@@ -1398,7 +1502,7 @@ static void pf_danger_map_create_segment(struct pf_danger_map *pfdm,
 
   /* Reset tile and node pointers for main iteration */
   ptile = PF_MAP(pfdm)->tile;
-  node = pfdm->lattice + tile_index(ptile);
+  node = pf_danger_map_node(pfdm, tile_index(ptile));
 
   /* Now fill the positions */
   for (i = 0, pos = node1->danger_segment; i < length; i++, pos++) {
@@ -1413,7 +1517,7 @@ static void pf_danger_map_create_segment(struct pf_danger_map *pfdm,
 
     /* Step further down the tree */
     ptile = mapstep(params->map, ptile, DIR_REVERSE(node->dir_to_here));
-    node = pfdm->lattice + tile_index(ptile);
+    node = pf_danger_map_node(pfdm, tile_index(ptile));
   }
 
 #ifdef PF_DEBUG
@@ -1487,7 +1591,7 @@ static bool pf_danger_map_iterate(struct pf_map *pfm)
   const struct pf_parameter *const params = pf_map_parameter(pfm);
   struct tile *tile = pfm->tile;
   int tindex = tile_index(tile);
-  struct pf_danger_node *node = pfdm->lattice + tindex;
+  struct pf_danger_node *node = pf_danger_map_node(pfdm, tindex);
   enum pf_move_scope scope = node->move_scope;
 
   /* The previous position is defined by 'tile' (tile pointer), 'node'
@@ -1528,7 +1632,7 @@ static bool pf_danger_map_iterate(struct pf_map *pfm)
         /* Calculate the cost of every adjacent position and set them in
          * the priority queues for next call to pf_danger_map_iterate(). */
         int tindex1 = tile_index(tile1);
-        struct pf_danger_node *node1 = pfdm->lattice + tindex1;
+        struct pf_danger_node *node1 = pf_danger_map_node(pfdm, tindex1);
         int cost;
         int extra = 0;
 
@@ -1698,7 +1802,7 @@ static bool pf_danger_map_iterate(struct pf_map *pfm)
       /* Change the pf_map iterator and reset data. */
       tile = index_to_tile(params->map, tindex);
       pfm->tile = tile;
-      node = pfdm->lattice + tindex;
+      node = pf_danger_map_node(pfdm, tindex);
     } else {
       /* No dangerous nodes to process, go for a safe one. */
       if (!map_index_pq_remove(pfdm->queue, &tindex)) {
@@ -1707,13 +1811,13 @@ static bool pf_danger_map_iterate(struct pf_map *pfm)
       }
 
 #ifdef PF_DEBUG
-      fc_assert(NS_PROCESSED != pfdm->lattice[tindex].status);
+      fc_assert(NS_PROCESSED != pf_danger_map_node(pfdm, tindex)->status);
 #endif
 
       /* Change the pf_map iterator and reset data. */
       tile = index_to_tile(params->map, tindex);
       pfm->tile = tile;
-      node = pfdm->lattice + tindex;
+      node = pf_danger_map_node(pfdm, tindex);
       if (NS_WAITING != node->status) {
         /* Node status step C. and D. */
 #ifdef PF_DEBUG
@@ -1750,7 +1854,7 @@ static inline bool pf_danger_map_iterate_until(struct pf_danger_map *pfdm,
                                                struct tile *ptile)
 {
   struct pf_map *pfm = PF_MAP(pfdm);
-  struct pf_danger_node *node = pfdm->lattice + tile_index(ptile);
+  struct pf_danger_node *node = pf_danger_map_node(pfdm, tile_index(ptile));
 
   /* Start position is handled in every function calling this function. */
 
@@ -1789,7 +1893,7 @@ static int pf_danger_map_move_cost(struct pf_map *pfm, struct tile *ptile)
   if (ptile == pfm->params.start_tile) {
     return 0;
   } else if (pf_danger_map_iterate_until(pfdm, ptile)) {
-    return (pfdm->lattice[tile_index(ptile)].cost
+    return (pf_danger_map_node(pfdm, tile_index(ptile))->cost
             - pf_move_rate(pf_map_parameter(pfm))
             + pf_moves_left_initially(pf_map_parameter(pfm)));
   } else {
@@ -1836,6 +1940,9 @@ static bool pf_danger_map_position(struct pf_map *pfm, struct tile *ptile,
   }
 }
 
+static bool pf_danger_map_reset(struct pf_map *pfm,
+                                const struct pf_parameter *parameter);
+
 /************************************************************************//**
   'pf_danger_map' destructor.
 ****************************************************************************/
@@ -1846,7 +1953,7 @@ static void pf_danger_map_destroy(struct pf_map *pfm)
   int i;
 
   /* Need to clean up the dangling danger segments. */
-  for (i = 0, node = pfdm->lattice; i < MAP_INDEX_SIZE; i++, node++) {
+  for (i = 0, node = pfdm->lattice; i < pfm->lattice_size; i++, node++) {
     if (node->danger_segment) {
       free(node->danger_segment);
     }
@@ -1858,49 +1965,38 @@ static void pf_danger_map_destroy(struct pf_map *pfm)
 }
 
 /************************************************************************//**
-  'pf_danger_map' constructor.
+  Initialize the 'pf_danger_map' for a new search: copy the parameters and
+  set the starting node. The lattice and the queues must be empty.
 ****************************************************************************/
-static struct pf_map *pf_danger_map_new(const struct pf_parameter *parameter)
+static bool pf_danger_map_start(struct pf_danger_map *pfdm,
+                                const struct pf_parameter *parameter)
 {
-  struct pf_danger_map *pfdm;
-  struct pf_map *base_map;
-  struct pf_parameter *params;
+  struct pf_map *base_map = &pfdm->base_map;
+  struct pf_parameter *params = &base_map->params;
   struct pf_danger_node *node;
 
-  pfdm = fc_malloc(sizeof(*pfdm));
-  base_map = &pfdm->base_map;
-  params = &base_map->params;
-#ifdef PF_DEBUG
-  /* Set the mode, used for cast check. */
-  base_map->mode = PF_DANGER;
-#endif /* PF_DEBUG */
-
-  /* Allocate the map. */
-  pfdm->lattice = fc_calloc(MAP_INDEX_SIZE, sizeof(struct pf_danger_node));
-  pfdm->queue = map_index_pq_new(INITIAL_QUEUE_SIZE);
-  pfdm->danger_queue = map_index_pq_new(INITIAL_QUEUE_SIZE);
-
   /* 'get_MC' callback must be set. */
-  fc_assert_ret_val(parameter->get_MC != NULL, NULL);
+  fc_assert_ret_val(parameter->get_MC != NULL, FALSE);
 
   /* 'is_pos_dangerous' callback must be set. */
-  fc_assert_ret_val(parameter->is_pos_dangerous != NULL, NULL);
+  fc_assert_ret_val(parameter->is_pos_dangerous != NULL, FALSE);
 
   /* 'get_move_scope' callback must be set. */
-  fc_assert_ret_val(parameter->get_move_scope != NULL, NULL);
+  fc_assert_ret_val(parameter->get_move_scope != NULL, FALSE);
 
   /* Copy parameters */
   *params = *parameter;
 
   /* Initialize virtual function table. */
   base_map->destroy = pf_danger_map_destroy;
+  base_map->reset = pf_danger_map_reset;
   base_map->get_move_cost = pf_danger_map_move_cost;
   base_map->get_path = pf_danger_map_path;
   base_map->get_position = pf_danger_map_position;
   base_map->iterate = pf_danger_map_iterate;
 
   /* Initialise starting node. */
-  node = pfdm->lattice + tile_index(params->start_tile);
+  node = pf_danger_map_node(pfdm, tile_index(params->start_tile));
   if (!pf_danger_node_init(pfdm, node, params->start_tile, PF_MS_NONE)) {
     /* Always fails. */
     fc_assert(TRUE == pf_danger_node_init(pfdm, node, params->start_tile,
@@ -1923,7 +2019,64 @@ static struct pf_map *pf_danger_map_new(const struct pf_parameter *parameter)
   node->dir_to_here = direction8_invalid();
   node->status = (node->is_dangerous ? NS_NEW : NS_PROCESSED);
 
-  return PF_MAP(pfdm);
+  return TRUE;
+}
+
+/************************************************************************//**
+  Restart the 'pf_danger_map' with new parameters. The nodes of the
+  previous search are cleared when they are accessed again, see
+  pf_danger_map_node().
+****************************************************************************/
+static bool pf_danger_map_reset(struct pf_map *pfm,
+                                const struct pf_parameter *parameter)
+{
+  struct pf_danger_map *pfdm = PF_DANGER_MAP(pfm);
+
+  if (0 == ++pfdm->generation) {
+    /* Wrapped, older nodes could be considered as valid. */
+    struct pf_danger_node *node;
+    int i;
+
+    for (i = 0, node = pfdm->lattice; i < pfm->lattice_size; i++, node++) {
+      node->generation = 1;
+      (void) pf_danger_map_node(pfdm, i);
+    }
+  }
+  map_index_pq_destroy(pfdm->queue);
+  pfdm->queue = map_index_pq_new(INITIAL_QUEUE_SIZE);
+  map_index_pq_destroy(pfdm->danger_queue);
+  pfdm->danger_queue = map_index_pq_new(INITIAL_QUEUE_SIZE);
+
+  return pf_danger_map_start(pfdm, parameter);
+}
+
+/************************************************************************//**
+  'pf_danger_map' constructor.
+****************************************************************************/
+static struct pf_map *pf_danger_map_new(const struct pf_parameter *parameter)
+{
+  struct pf_danger_map *pfdm;
+  struct pf_map *base_map;
+
+  pfdm = fc_malloc(sizeof(*pfdm));
+  base_map = &pfdm->base_map;
+  /* Set the mode, used for cast check and recycling. */
+  base_map->mode = PF_DANGER;
+
+  /* Allocate the map. */
+  base_map->lattice_size = MAP_INDEX_SIZE;
+  base_map->record = NULL;
+  pfdm->lattice = fc_calloc(MAP_INDEX_SIZE, sizeof(struct pf_danger_node));
+  pfdm->generation = 0;
+  pfdm->queue = map_index_pq_new(INITIAL_QUEUE_SIZE);
+  pfdm->danger_queue = map_index_pq_new(INITIAL_QUEUE_SIZE);
+
+  if (!pf_danger_map_start(pfdm, parameter)) {
+    pf_danger_map_destroy(base_map);
+    return NULL;
+  }
+
+  return base_map;
 }
 
 
@@ -1964,6 +2117,7 @@ struct pf_fuel_node {
                                  * constant move costs! */
   unsigned short extra_tile;    /* EC */
   unsigned short cost_to_here[DIR8_MAGIC_MAX]; /* Step cost[dir to here] */
+  unsigned short generation;    /* The search which set this node. */
 
   /* Segment leading across the danger area back to the nearest safe node:
    * need to remember costs and stuff. */
@@ -1994,6 +2148,8 @@ struct pf_fuel_map {
   struct map_index_pq *waited_queue; /* Queue of nodes to reach farer
                                       * positions after having refueled. */
   struct pf_fuel_node *lattice; /* Lattice of nodes */
+  unsigned short generation;    /* The current search, see
+                                 * pf_fuel_map_node(). */
 };
 
 /* Up-cast macro. */
@@ -2013,6 +2169,27 @@ pf_fuel_map_check(struct pf_map *pfm, const char *file,
 #define PF_FUEL_MAP(pfm) ((struct pf_fuel_map *) (pfm))
 #endif /* PF_DEBUG */
 
+static inline void pf_fuel_pos_unref(struct pf_fuel_pos *pos);
+
+/************************************************************************//**
+  Returns the node at 'tindex', clearing it if it was set by a previous
+  search. See pf_normal_map_node().
+****************************************************************************/
+static inline struct pf_fuel_node *
+pf_fuel_map_node(const struct pf_fuel_map *pffm, int tindex)
+{
+  struct pf_fuel_node *node = pffm->lattice + tindex;
+
+  if (node->generation != pffm->generation) {
+    pf_fuel_pos_unref(node->pos);
+    pf_fuel_pos_unref(node->segment);
+    memset(node, 0, sizeof(*node));
+    node->generation = pffm->generation;
+  }
+
+  return node;
+}
+
 /* =================  Specific pf_fuel_* mode functions ================== */
 
 /************************************************************************//**
@@ -2324,7 +2501,7 @@ static void pf_fuel_map_fill_position(const struct pf_fuel_map *pffm,
                                       struct pf_position *pos)
 {
   int tindex = tile_index(ptile);
-  struct pf_fuel_node *node = pffm->lattice + tindex;
+  struct pf_fuel_node *node = pf_fuel_map_node(pffm, tindex);
   struct pf_fuel_pos *head = node->segment;
   const struct pf_parameter *params = pf_map_parameter(PF_MAP(pffm));
 
@@ -2366,7 +2543,7 @@ pf_fuel_map_construct_path(const struct pf_fuel_map *pffm,
 {
   struct pf_path *path = fc_malloc(sizeof(*path));
   enum direction8 dir_next = direction8_invalid();
-  struct pf_fuel_node *node = pffm->lattice + tile_index(ptile);
+  struct pf_fuel_node *node = pf_fuel_map_node(pffm, tile_index(ptile));
   struct pf_fuel_pos *segment = node->segment;
   int length = 1;
   struct tile *iter_tile = ptile;
@@ -2399,7 +2576,7 @@ pf_fuel_map_construct_path(const struct pf_fuel_map *pffm,
     /* Step backward. */
     iter_tile = mapstep(params->map, iter_tile,
                         DIR_REVERSE(segment->dir_to_here));
-    node = pffm->lattice + tile_index(iter_tile);
+    node = pf_fuel_map_node(pffm, tile_index(iter_tile));
     segment = segment->prev;
 #ifdef PF_DEBUG
     fc_assert(NULL != segment);
@@ -2416,7 +2593,7 @@ pf_fuel_map_construct_path(const struct pf_fuel_map *pffm,
 
   /* Reset variables for main iteration. */
   iter_tile = ptile;
-  node = pffm->lattice + tile_index(ptile);
+  node = pf_fuel_map_node(pffm, tile_index(ptile));
   segment = node->segment;
 
   for (i = length - 1; i >= 0; i--) {
@@ -2469,7 +2646,7 @@ pf_fuel_map_construct_path(const struct pf_fuel_map *pffm,
 
     /* 5: Step further back. */
     iter_tile = mapstep(params->map, iter_tile, DIR_REVERSE(dir_next));
-    node = pffm->lattice + tile_index(iter_tile);
+    node = pf_fuel_map_node(pffm, tile_index(iter_tile));
     segment = segment->prev;
 #ifdef PF_DEBUG
     fc_assert(NULL != segment);
@@ -2511,7 +2688,7 @@ static inline void pf_fuel_map_create_segment(struct pf_fuel_map *pffm,
   do {
     next = pos;
     ptile = mapstep(params->map, ptile, DIR_REVERSE(node->dir_to_here));
-    node = pffm->lattice + tile_index(ptile);
+    node = pf_fuel_map_node(pffm, tile_index(ptile));
     pos = node->pos;
     if (NULL != pos) {
       if (pos->cost == node->cost
@@ -2621,7 +2798,7 @@ static bool pf_fuel_map_iterate(struct pf_map *pfm)
   const struct pf_parameter *const params = pf_map_parameter(pfm);
   struct tile *tile = pfm->tile;
   int tindex = tile_index(tile);
-  struct pf_fuel_node *node = pffm->lattice + tindex;
+  struct pf_fuel_node *node = pf_fuel_map_node(pffm, tindex);
   enum pf_move_scope scope = node->move_scope;
   int priority, waited_priority;
   bool waited = FALSE;
@@ -2667,7 +2844,7 @@ static bool pf_fuel_map_iterate(struct pf_map *pfm)
         /* Calculate the cost of every adjacent position and set them in
          * the priority queues for next call to pf_fuel_map_iterate(). */
         int tindex1 = tile_index(tile1);
-        struct pf_fuel_node *node1 = pffm->lattice + tindex1;
+        struct pf_fuel_node *node1 = pf_fuel_map_node(pffm, tindex1);
         int cost, extra = 0;
         int moves_left;
         int cost_of_path, old_cost_of_path;
@@ -2904,7 +3081,7 @@ static bool pf_fuel_map_iterate(struct pf_map *pfm)
       /* Change the pf_map iterator and reset data. */
       tile = index_to_tile(params->map, tindex);
       pfm->tile = tile;
-      node = pffm->lattice + tindex;
+      node = pf_fuel_map_node(pffm, tindex);
       waited = TRUE;
 #ifdef PF_DEBUG
       fc_assert(0 < node->moves_left_req);
@@ -2922,7 +3099,7 @@ static bool pf_fuel_map_iterate(struct pf_map *pfm)
       /* Change the pf_map iterator and reset data. */
       tile = index_to_tile(params->map, tindex);
       pfm->tile = tile;
-      node = pffm->lattice + tindex;
+      node = pf_fuel_map_node(pffm, tindex);
 
 #ifdef PF_DEBUG
       fc_assert(NS_PROCESSED != node->status);
@@ -2966,7 +3143,7 @@ static inline bool pf_fuel_map_iterate_until(struct pf_fuel_map *pffm,
                                              struct tile *ptile)
 {
   struct pf_map *pfm = PF_MAP(pffm);
-  struct pf_fuel_node *node = pffm->lattice + tile_index(ptile);
+  struct pf_fuel_node *node = pf_fuel_map_node(pffm, tile_index(ptile));
 
   /* Start position is handled in every function calling this function. */
 
@@ -3004,7 +3181,7 @@ static int pf_fuel_map_move_cost(struct pf_map *pfm, struct tile *ptile)
   if (ptile == pfm->params.start_tile) {
     return 0;
   } else if (pf_fuel_map_iterate_until(pffm, ptile)) {
-    const struct pf_fuel_node *node = pffm->lattice + tile_index(ptile);
+    const struct pf_fuel_node *node = pf_fuel_map_node(pffm, tile_index(ptile));
 
     return (node->segment->cost
             - pf_move_rate(pf_map_parameter(pfm))
@@ -3053,6 +3230,9 @@ static bool pf_fuel_map_position(struct pf_map *pfm, struct tile *ptile,
   }
 }
 
+static bool pf_fuel_map_reset(struct pf_map *pfm,
+                              const struct pf_parameter *parameter);
+
 /************************************************************************//**
   'pf_fuel_map' destructor.
 ****************************************************************************/
@@ -3063,7 +3243,7 @@ static void pf_fuel_map_destroy(struct pf_map *pfm)
   int i;
 
   /* Need to clean up the dangling fuel segments. */
-  for (i = 0, node = pffm->lattice; i < MAP_INDEX_SIZE; i++, node++) {
+  for (i = 0, node = pffm->lattice; i < pfm->lattice_size; i++, node++) {
     pf_fuel_pos_unref(node->pos);
     pf_fuel_pos_unref(node->segment);
   }
@@ -3074,49 +3254,38 @@ static void pf_fuel_map_destroy(struct pf_map *pfm)
 }
 
 /************************************************************************//**
-  'pf_fuel_map' constructor.
+  Initialize the 'pf_fuel_map' for a new search: copy the parameters and
+  set the starting node. The lattice and the queues must be empty.
 ****************************************************************************/
-static struct pf_map *pf_fuel_map_new(const struct pf_parameter *parameter)
+static bool pf_fuel_map_start(struct pf_fuel_map *pffm,
+                              const struct pf_parameter *parameter)
 {
-  struct pf_fuel_map *pffm;
-  struct pf_map *base_map;
-  struct pf_parameter *params;
+  struct pf_map *base_map = &pffm->base_map;
+  struct pf_parameter *params = &base_map->params;
   struct pf_fuel_node *node;
 
-  pffm = fc_malloc(sizeof(*pffm));
-  base_map = &pffm->base_map;
-  params = &base_map->params;
-#ifdef PF_DEBUG
-  /* Set the mode, used for cast check. */
-  base_map->mode = PF_FUEL;
-#endif /* PF_DEBUG */
-
-  /* Allocate the map. */
-  pffm->lattice = fc_calloc(MAP_INDEX_SIZE, sizeof(struct pf_fuel_node));
-  pffm->queue = map_index_pq_new(INITIAL_QUEUE_SIZE);
-  pffm->waited_queue = map_index_pq_new(INITIAL_QUEUE_SIZE);
-
   /* 'get_MC' callback must be set. */
-  fc_assert_ret_val(parameter->get_MC != NULL, NULL);
+  fc_assert_ret_val(parameter->get_MC != NULL, FALSE);
 
   /* 'get_moves_left_req' callback must be set. */
-  fc_assert_ret_val(parameter->get_moves_left_req != NULL, NULL);
+  fc_assert_ret_val(parameter->get_moves_left_req != NULL, FALSE);
 
   /* 'get_move_scope' callback must be set. */
-  fc_assert_ret_val(parameter->get_move_scope != NULL, NULL);
+  fc_assert_ret_val(parameter->get_move_scope != NULL, FALSE);
 
   /* Copy parameters. */
   *params = *parameter;
 
   /* Initialize virtual function table. */
   base_map->destroy = pf_fuel_map_destroy;
+  base_map->reset = pf_fuel_map_reset;
   base_map->get_move_cost = pf_fuel_map_move_cost;
   base_map->get_path = pf_fuel_map_path;
   base_map->get_position = pf_fuel_map_position;
   base_map->iterate = pf_fuel_map_iterate;
 
   /* Initialise starting node. */
-  node = pffm->lattice + tile_index(params->start_tile);
+  node = pf_fuel_map_node(pffm, tile_index(params->start_tile));
   if (!pf_fuel_node_init(pffm, node, params->start_tile, PF_MS_NONE)) {
     /* Always fails. */
     fc_assert(TRUE == pf_fuel_node_init(pffm, node, params->start_tile,
@@ -3140,18 +3309,519 @@ static struct pf_map *pf_fuel_map_new(const struct pf_parameter *parameter)
   node->dir_to_here = direction8_invalid();
   node->status = NS_PROCESSED;
 
-  return PF_MAP(pffm);
+  return TRUE;
+}
+
+/************************************************************************//**
+  Restart the 'pf_fuel_map' with new parameters. The nodes of the
+  previous search are cleared when they are accessed again, see
+  pf_fuel_map_node().
+****************************************************************************/
+static bool pf_fuel_map_reset(struct pf_map *pfm,
+                              const struct pf_parameter *parameter)
+{
+  struct pf_fuel_map *pffm = PF_FUEL_MAP(pfm);
+
+  if (0 == ++pffm->generation) {
+    /* Wrapped, older nodes could be considered as valid. */
+    struct pf_fuel_node *node;
+    int i;
+
+    for (i = 0, node = pffm->lattice; i < pfm->lattice_size; i++, node++) {
+      node->generation = 1;
+      (void) pf_fuel_map_node(pffm, i);
+    }
+  }
+  map_index_pq_destroy(pffm->queue);
+  pffm->queue = map_index_pq_new(INITIAL_QUEUE_SIZE);
+  map_index_pq_destroy(pffm->waited_queue);
+  pffm->waited_queue = map_index_pq_new(INITIAL_QUEUE_SIZE);
+
+  return pf_fuel_map_start(pffm, parameter);
+}
+
+/************************************************************************//**
+  'pf_fuel_map' constructor.
+****************************************************************************/
+static struct pf_map *pf_fuel_map_new(const struct pf_parameter *parameter)
+{
+  struct pf_fuel_map *pffm;
+  struct pf_map *base_map;
+
+  pffm = fc_malloc(sizeof(*pffm));
+  base_map = &pffm->base_map;
+  /* Set the mode, used for cast check and recycling. */
+  base_map->mode = PF_FUEL;
+
+  /* Allocate the map. */
+  base_map->lattice_size = MAP_INDEX_SIZE;
+  base_map->record = NULL;
+  pffm->lattice = fc_calloc(MAP_INDEX_SIZE, sizeof(struct pf_fuel_node));
+  pffm->generation = 0;
+  pffm->queue = map_index_pq_new(INITIAL_QUEUE_SIZE);
+  pffm->waited_queue = map_index_pq_new(INITIAL_QUEUE_SIZE);
+
+  if (!pf_fuel_map_start(pffm, parameter)) {
+    pf_fuel_map_destroy(base_map);
+    return NULL;
+  }
+
+  return base_map;
 }
 
 
 
+/* ================ Specific pf_shared_* mode structures ================= */
+
+/* Shared maps are used for identical searches, e.g. for the units of a
+ * stack, or for the unit types a city could build. The first caller does
+ * the search, next ones only read the results. Every caller gets its own
+ * view of the shared map, which keeps its own iteration position, so
+ * iterating it gives the same results as iterating a new map.
+ *
+ * A search reads the state of the tiles it iterates, of their adjacent
+ * tiles it reaches, and of the tiles adjacent to those for the zones of
+ * control. So a change at a tile only matters to the shared maps which
+ * iterated, or were asked about, a tile within PF_SHARED_RANGE of it;
+ * they are forgotten by pf_map_shared_clear_tile(). The other ones stay
+ * valid: what they already found does not depend on the tile, and the
+ * rest of their search will see its new state, as a new search would.
+ * Everything is forgotten by pf_map_shared_clear(), e.g. when the
+ * diplomatic states change. */
+
+/* The order in which the tiles were iterated by a shared map. */
+struct pf_map_record {
+  int count;            /* The number of iterated tiles. */
+  int *order;           /* The index of the iterated tiles. */
+  int *position;        /* Index in 'order' of each tile. Valid only if
+                         * 'order' points back to the tile. */
+  struct dbv probed;    /* The tiles asked for directly, which the search
+                         * may have read before iterating them. */
+};
+
+/* A map in the shared map cache. */
+struct pf_shared_entry {
+  struct pf_parameter parameter; /* The key. */
+  struct pf_map *map;   /* The real map, with its record. */
+  int ref_count;        /* Views plus one while in the cache. */
+};
+
+/* Derived structure of struct pf_map. */
+struct pf_shared_map {
+  struct pf_map base_map;       /* Base structure, must be the first! */
+
+  struct pf_shared_entry *entry; /* The shared search. */
+  int cursor;                   /* Index in the record of the iterated
+                                 * tile. */
+};
+
+/* Up-cast macro. */
+#ifdef PF_DEBUG
+static inline struct pf_shared_map *
+pf_shared_map_check(struct pf_map *pfm, const char *file,
+                    const char *function, int line)
+{
+  fc_assert_full(file, function, line,
+                 NULL != pfm && PF_SHARED == pfm->mode,
+                 return NULL, "Wrong pf_map to pf_shared_map conversion.");
+  return (struct pf_shared_map *) pfm;
+}
+#define PF_SHARED_MAP(pfm) \
+  pf_shared_map_check(pfm, __FILE__, __FUNCTION__, __FC_LINE__)
+#else
+#define PF_SHARED_MAP(pfm) ((struct pf_shared_map *) (pfm))
+#endif /* PF_DEBUG */
+
+static genhash_val_t pf_shared_hash_val(const struct pf_parameter *param);
+static bool pf_shared_hash_cmp(const struct pf_parameter *param1,
+                               const struct pf_parameter *param2);
+
+#define SPECHASH_TAG pf_shared
+#define SPECHASH_IKEY_TYPE struct pf_parameter *
+#define SPECHASH_IDATA_TYPE struct pf_shared_entry *
+#define SPECHASH_IKEY_VAL pf_shared_hash_val
+#define SPECHASH_IKEY_COMP pf_shared_hash_cmp
+#include "spechash.h"
+#define pf_shared_hash_data_iterate(phash, data)                            \
+  TYPED_HASH_DATA_ITERATE(struct pf_shared_entry *, phash, data)
+#define pf_shared_hash_data_iterate_end HASH_DATA_ITERATE_END
+
+/* The maximal number of shared maps, as every one holds a whole lattice. */
+#define PF_SHARED_CACHE_SIZE 16
+
+/* The distance from which the state of a tile is read by a search, see
+ * above. */
+#define PF_SHARED_RANGE 2
+
+static struct pf_shared_hash *pf_shared_cache = NULL;
+
+/* How well the shared maps are reused, see pf_map_shared_log_stats(). */
+static struct {
+  int searches;         /* pf_map_new_shared() calls doing a search. */
+  int hits;             /* pf_map_new_shared() calls sharing one. */
+  int clears;           /* pf_map_shared_clear() calls forgetting maps. */
+  int forgotten;        /* Maps forgotten by pf_map_shared_clear_tile(). */
+} pf_shared_stats;
+
+/* ================ Specific pf_shared_* mode functions ================== */
+
+/************************************************************************//**
+  Hash function for the shared map cache.
+****************************************************************************/
+static genhash_val_t pf_shared_hash_val(const struct pf_parameter *param)
+{
+  return (tile_index(param->start_tile)
+          + (utype_index(param->utype) << 16)
+          + (NULL != param->owner ? player_index(param->owner) << 24 : 0)
+          + param->moves_left_initially);
+}
+
+/************************************************************************//**
+  Comparison function for the shared map cache. All the parameters must be
+  the same, as the callbacks may use any of them.
+****************************************************************************/
+static bool pf_shared_hash_cmp(const struct pf_parameter *param1,
+                               const struct pf_parameter *param2)
+{
+  return (param1->start_tile == param2->start_tile
+          && param1->utype == param2->utype
+          && param1->owner == param2->owner
+          && param1->moves_left_initially == param2->moves_left_initially
+          && param1->fuel_left_initially == param2->fuel_left_initially
+          && param1->transported_by_initially
+             == param2->transported_by_initially
+          && param1->cargo_depth == param2->cargo_depth
+          && BV_ARE_EQUAL(param1->cargo_types, param2->cargo_types)
+          && param1->move_rate == param2->move_rate
+          && param1->fuel == param2->fuel
+          && param1->omniscience == param2->omniscience
+          && param1->map == param2->map
+          && param1->get_MC == param2->get_MC
+          && param1->get_move_scope == param2->get_move_scope
+          && param1->ignore_none_scopes == param2->ignore_none_scopes
+          && param1->get_TB == param2->get_TB
+          && param1->get_EC == param2->get_EC
+          && param1->get_action == param2->get_action
+          && param1->actions == param2->actions
+          && param1->is_action_possible == param2->is_action_possible
+          && param1->get_zoc == param2->get_zoc
+          && param1->is_pos_dangerous == param2->is_pos_dangerous
+          && param1->get_moves_left_req == param2->get_moves_left_req
+          && param1->get_costs == param2->get_costs
+          && param1->data == param2->data);
+}
+
+/************************************************************************//**
+  Start to record the iteration of the map.
+****************************************************************************/
+static void pf_map_record_new(struct pf_map *pfm)
+{
+  struct pf_map_record *record = fc_malloc(sizeof(*record));
+
+  record->order = fc_malloc(pfm->lattice_size * sizeof(*record->order));
+  record->position = fc_calloc(pfm->lattice_size,
+                               sizeof(*record->position));
+  record->order[0] = tile_index(pfm->tile);
+  record->position[record->order[0]] = 0;
+  record->count = 1;
+  dbv_init(&record->probed, pfm->lattice_size);
+  pfm->record = record;
+}
+
+/************************************************************************//**
+  Stop to record the iteration of the map.
+****************************************************************************/
+static void pf_map_record_destroy(struct pf_map *pfm)
+{
+  free(pfm->record->order);
+  free(pfm->record->position);
+  dbv_free(&pfm->record->probed);
+  free(pfm->record);
+  pfm->record = NULL;
+}
+
+/************************************************************************//**
+  Returns the index in the record of the tile, or -1 if the tile was not
+  iterated yet.
+****************************************************************************/
+static inline int pf_map_record_position(const struct pf_map_record *record,
+                                         int tindex)
+{
+  int pos = record->position[tindex];
+
+  return (pos < record->count && record->order[pos] == tindex ? pos : -1);
+}
+
+/************************************************************************//**
+  Add the current tile of the map to its record.
+****************************************************************************/
+static inline void pf_map_record_add(struct pf_map *pfm)
+{
+  struct pf_map_record *record = pfm->record;
+  int tindex = tile_index(pfm->tile);
+
+  if (-1 == pf_map_record_position(record, tindex)) {
+    record->position[tindex] = record->count;
+    record->order[record->count++] = tindex;
+  }
+}
+
+/************************************************************************//**
+  Release a reference to a shared search.
+****************************************************************************/
+static void pf_shared_entry_unref(struct pf_shared_entry *entry)
+{
+  if (0 == --entry->ref_count) {
+    pf_map_record_destroy(entry->map);
+    pf_map_destroy(entry->map);
+    free(entry);
+  }
+}
+
+/************************************************************************//**
+  After a query for 'ptile', the iteration of a normal map would resume
+  from it, if it was not yet reached. Do the same for the view.
+****************************************************************************/
+static void pf_shared_map_seek(struct pf_shared_map *pfsm,
+                               const struct tile *ptile)
+{
+  const struct pf_map_record *record = pfsm->entry->map->record;
+  int pos = pf_map_record_position(record, tile_index(ptile));
+
+  if (pos > pfsm->cursor) {
+    pfsm->cursor = pos;
+    pfsm->base_map.tile = index_to_tile(pfsm->base_map.params.map,
+                                        record->order[pos]);
+  }
+}
+
+/************************************************************************//**
+  Return the move cost at ptile, using the shared map.
+****************************************************************************/
+static int pf_shared_map_move_cost(struct pf_map *pfm, struct tile *ptile)
+{
+  struct pf_shared_map *pfsm = PF_SHARED_MAP(pfm);
+  int cost;
+
+  dbv_set(&pfsm->entry->map->record->probed, tile_index(ptile));
+  cost = pf_map_move_cost(pfsm->entry->map, ptile);
+
+  pf_shared_map_seek(pfsm, ptile);
+
+  return cost;
+}
+
+/************************************************************************//**
+  Return the path to ptile, using the shared map.
+****************************************************************************/
+static struct pf_path *pf_shared_map_path(struct pf_map *pfm,
+                                          struct tile *ptile)
+{
+  struct pf_shared_map *pfsm = PF_SHARED_MAP(pfm);
+  struct pf_path *path;
+
+  dbv_set(&pfsm->entry->map->record->probed, tile_index(ptile));
+  path = pf_map_path(pfsm->entry->map, ptile);
+
+  pf_shared_map_seek(pfsm, ptile);
+
+  return path;
+}
+
+/************************************************************************//**
+  Get info about the position at ptile, using the shared map.
+****************************************************************************/
+static bool pf_shared_map_position(struct pf_map *pfm, struct tile *ptile,
+                                   struct pf_position *pos)
+{
+  struct pf_shared_map *pfsm = PF_SHARED_MAP(pfm);
+  bool reached;
+
+  dbv_set(&pfsm->entry->map->record->probed, tile_index(ptile));
+  reached = pf_map_position(pfsm->entry->map, ptile, pos);
+
+  pf_shared_map_seek(pfsm, ptile);
+
+  return reached;
+}
+
+/************************************************************************//**
+  Move the view to the next tile. The shared map is only iterated when the
+  view reaches the last recorded tile.
+****************************************************************************/
+static bool pf_shared_map_iterate(struct pf_map *pfm)
+{
+  struct pf_shared_map *pfsm = PF_SHARED_MAP(pfm);
+  struct pf_map *shared = pfsm->entry->map;
+  const struct pf_map_record *record = shared->record;
+
+  while (pfsm->cursor + 1 >= record->count) {
+    if (!pf_map_iterate(shared)) {
+      pfsm->cursor = record->count;
+      return FALSE;
+    }
+  }
+
+  pfsm->cursor++;
+  pfm->tile = index_to_tile(pfm->params.map, record->order[pfsm->cursor]);
+
+  return TRUE;
+}
+
+/************************************************************************//**
+  'pf_shared_map' destructor.
+****************************************************************************/
+static void pf_shared_map_destroy(struct pf_map *pfm)
+{
+  struct pf_shared_map *pfsm = PF_SHARED_MAP(pfm);
+
+  pf_shared_entry_unref(pfsm->entry);
+  free(pfsm);
+}
+
+/************************************************************************//**
+  'pf_shared_map' constructor.
+****************************************************************************/
+static struct pf_map *pf_shared_map_new(struct pf_shared_entry *entry)
+{
+  struct pf_shared_map *pfsm = fc_malloc(sizeof(*pfsm));
+  struct pf_map *base_map = &pfsm->base_map;
+
+  base_map->mode = PF_SHARED;
+  base_map->lattice_size = 0;
+  base_map->record = NULL;
+  base_map->params = entry->parameter;
+
+  /* Initialize virtual function table. */
+  base_map->destroy = pf_shared_map_destroy;
+  base_map->reset = NULL;
+  base_map->get_move_cost = pf_shared_map_move_cost;
+  base_map->get_path = pf_shared_map_path;
+  base_map->get_position = pf_shared_map_position;
+  base_map->iterate = pf_shared_map_iterate;
+
+  /* Initialise the iterator. */
+  base_map->tile = entry->parameter.start_tile;
+  pfsm->cursor = 0;
+
+  pfsm->entry = entry;
+  entry->ref_count++;
+
+  return base_map;
+}
+
+
+/* ============================ pf_map pool ============================= */
+
+/* Destroyed maps are kept here to be reused by the next pf_map_new() call
+ * for the same mode, avoiding to allocate and to clear a whole lattice for
+ * every search. */
+#define PF_MAP_POOL_SIZE 4
+
+static struct {
+  bool initialized;
+  fc_mutex mutex;
+  int count[PF_MODE_COUNT];
+  struct pf_map *maps[PF_MODE_COUNT][PF_MAP_POOL_SIZE];
+} pf_map_pool;
+
+/************************************************************************//**
+  Initialize the pf_map pool. Until this is called, maps are not recycled.
+****************************************************************************/
+void pf_map_pool_init(void)
+{
+  if (!pf_map_pool.initialized) {
+    fc_init_mutex(&pf_map_pool.mutex);
+    memset(pf_map_pool.count, 0, sizeof(pf_map_pool.count));
+    pf_map_pool.initialized = TRUE;
+  }
+}
+
+/************************************************************************//**
+  Destroy all the maps kept in the pool and the pool itself, and forget
+  the shared maps.
+****************************************************************************/
+void pf_map_pool_free(void)
+{
+  enum pf_mode mode;
+
+  if (NULL != pf_shared_cache) {
+    pf_map_shared_clear();
+    pf_shared_hash_destroy(pf_shared_cache);
+    pf_shared_cache = NULL;
+  }
+
+  if (!pf_map_pool.initialized) {
+    return;
+  }
+
+  for (mode = 0; mode < PF_MODE_COUNT; mode++) {
+    while (0 < pf_map_pool.count[mode]) {
+      struct pf_map *pfm =
+          pf_map_pool.maps[mode][--pf_map_pool.count[mode]];
+
+      pfm->destroy(pfm);
+    }
+  }
+  fc_destroy_mutex(&pf_map_pool.mutex);
+  pf_map_pool.initialized = FALSE;
+}
+
+/************************************************************************//**
+  Take a map of the given mode from the pool. Returns NULL if there are
+  none. The maps allocated for an other map size are destroyed.
+****************************************************************************/
+static struct pf_map *pf_map_pool_pop(enum pf_mode mode)
+{
+  struct pf_map *pfm = NULL;
+
+  if (!pf_map_pool.initialized) {
+    return NULL;
+  }
+
+  fc_allocate_mutex(&pf_map_pool.mutex);
+  while (NULL == pfm && 0 < pf_map_pool.count[mode]) {
+    pfm = pf_map_pool.maps[mode][--pf_map_pool.count[mode]];
+    if (pfm->lattice_size != MAP_INDEX_SIZE) {
+      pfm->destroy(pfm);
+      pfm = NULL;
+    }
+  }
+  fc_release_mutex(&pf_map_pool.mutex);
+
+  return pfm;
+}
+
+/************************************************************************//**
+  Give a map back to the pool. Returns FALSE if the pool is full, then the
+  map must be destroyed by the caller.
+****************************************************************************/
+static bool pf_map_pool_push(struct pf_map *pfm)
+{
+  bool pushed = FALSE;
+
+  if (!pf_map_pool.initialized || PF_SHARED == pfm->mode
+      || pfm->lattice_size != MAP_INDEX_SIZE) {
+    return FALSE;
+  }
+
+  fc_allocate_mutex(&pf_map_pool.mutex);
+  if (PF_MAP_POOL_SIZE > pf_map_pool.count[pfm->mode]) {
+    pf_map_pool.maps[pfm->mode][pf_map_pool.count[pfm->mode]++] = pfm;
+    pushed = TRUE;
+  }
+  fc_release_mutex(&pf_map_pool.mutex);
+
+  return pushed;
+}
+
+
 /* ====================== pf_map public functions ======================= */
 
 /************************************************************************//**
-  Factory function to create a new map according to the parameter.
-  Does not do any iterations.
+  Returns the mode of the map matching the parameter.
 ****************************************************************************/
-struct pf_map *pf_map_new(const struct pf_parameter *parameter)
+static enum pf_mode pf_parameter_mode(const struct pf_parameter *parameter)
 {
   if (parameter->is_pos_dangerous) {
     if (parameter->get_moves_left_req) {
@@ -3161,26 +3831,254 @@ struct pf_map *pf_map_new(const struct pf_parameter *parameter)
     if (parameter->get_costs) {
       log_error("jumbo callbacks for danger maps are not yet implemented.");
     }
-    return pf_danger_map_new(parameter);
+    return PF_DANGER;
   } else if (parameter->get_moves_left_req) {
     if (parameter->get_costs) {
       log_error("jumbo callbacks for fuel maps are not yet implemented.");
     }
+    return PF_FUEL;
+  }
+
+  return PF_NORMAL;
+}
+
+/************************************************************************//**
+  Create a new map of the given mode, or reuse one from the pool.
+****************************************************************************/
+static struct pf_map *pf_map_new_mode(enum pf_mode mode,
+                                      const struct pf_parameter *parameter)
+{
+  struct pf_map *pfm = pf_map_pool_pop(mode);
+
+  if (NULL != pfm) {
+    if (!pfm->reset(pfm, parameter)) {
+      pfm->destroy(pfm);
+      return NULL;
+    }
+    return pfm;
+  }
+
+  switch (mode) {
+  case PF_DANGER:
+    return pf_danger_map_new(parameter);
+  case PF_FUEL:
     return pf_fuel_map_new(parameter);
+  case PF_NORMAL:
+  case PF_SHARED:
+  case PF_MODE_COUNT:
+    break;
   }
 
   return pf_normal_map_new(parameter);
 }
 
 /************************************************************************//**
-  After usage the map must be destroyed.
+  Factory function to create a new map according to the parameter.
+  Does not do any iterations. A map released by pf_map_destroy() is reused
+  when possible.
+****************************************************************************/
+struct pf_map *pf_map_new(const struct pf_parameter *parameter)
+{
+  return pf_map_new_mode(pf_parameter_mode(parameter), parameter);
+}
+
+/************************************************************************//**
+  Restart the map 'pfm' with a new parameter, e.g. for an other start tile
+  or an other unit, without clearing its lattice. If 'pfm' is NULL, or
+  cannot be used for this parameter, a new map is returned instead.
+  Usage: pfm = pf_map_renew(pfm, &parameter);
+****************************************************************************/
+struct pf_map *pf_map_renew(struct pf_map *pfm,
+                            const struct pf_parameter *parameter)
+{
+  if (NULL == pfm) {
+    return pf_map_new(parameter);
+  }
+
+  if (pfm->mode != pf_parameter_mode(parameter)
+      || pfm->lattice_size != MAP_INDEX_SIZE) {
+    /* Also for shared maps, which cannot be restarted. */
+    pf_map_destroy(pfm);
+    return pf_map_new(parameter);
+  }
+
+  if (!pfm->reset(pfm, parameter)) {
+    pfm->destroy(pfm);
+    return NULL;
+  }
+
+  return pfm;
+}
+
+/************************************************************************//**
+  After usage the map must be destroyed. It may be kept in a pool to be
+  reused by a next pf_map_new() call.
 ****************************************************************************/
 void pf_map_destroy(struct pf_map *pfm)
 {
 #ifdef PF_DEBUG
   fc_assert_ret(NULL != pfm);
 #endif
-  pfm->destroy(pfm);
+  if (!pf_map_pool_push(pfm)) {
+    pfm->destroy(pfm);
+  }
+}
+
+/************************************************************************//**
+  Like pf_map_new(), but the search doesn't go through the tiles which are
+  not set in 'allowed_tiles' (indexed by tile index), except the start
+  tile. The array must stay valid while the map is used. This is only
+  possible with normal maps, i.e. without danger, fuel or jumbo callbacks.
+  Returns NULL for other parameters.
+****************************************************************************/
+struct pf_map *pf_map_new_restricted(const struct pf_parameter *parameter,
+                                     const bool *allowed_tiles)
+{
+  struct pf_map *pfm;
+
+  if (PF_NORMAL != pf_parameter_mode(parameter)
+      || NULL != parameter->get_costs) {
+    return NULL;
+  }
+
+  pfm = pf_map_new_mode(PF_NORMAL, parameter);
+  if (NULL != pfm) {
+    PF_NORMAL_MAP(pfm)->allowed_tiles = allowed_tiles;
+  }
+
+  return pfm;
+}
+
+/************************************************************************//**
+  Like pf_map_new(), but the search is shared with the other callers using
+  the same parameter, until it is forgotten by pf_map_shared_clear() or
+  pf_map_shared_clear_tile(). The returned map must be destroyed with
+  pf_map_destroy() too. Don't use a parameter whose 'data' is not constant
+  while the map is shared.
+****************************************************************************/
+struct pf_map *pf_map_new_shared(const struct pf_parameter *parameter)
+{
+  struct pf_shared_entry *entry;
+
+  if (NULL == pf_shared_cache) {
+    pf_shared_cache = pf_shared_hash_new();
+  }
+
+  if (!pf_shared_hash_lookup(pf_shared_cache, parameter, &entry)) {
+    struct pf_map *pfm = pf_map_new(parameter);
+
+    if (NULL == pfm) {
+      return NULL;
+    }
+
+    if (PF_SHARED_CACHE_SIZE <= pf_shared_hash_size(pf_shared_cache)) {
+      pf_map_shared_clear();
+    }
+
+    entry = fc_malloc(sizeof(*entry));
+    entry->parameter = *parameter;
+    entry->map = pfm;
+    entry->ref_count = 1;
+    pf_map_record_new(pfm);
+    pf_shared_hash_insert(pf_shared_cache, &entry->parameter, entry);
+    pf_shared_stats.searches++;
+  } else {
+    pf_shared_stats.hits++;
+  }
+
+  return pf_shared_map_new(entry);
+}
+
+/************************************************************************//**
+  Forget all the shared maps. The maps already given by
+  pf_map_new_shared() are still valid, but new calls will do new searches.
+****************************************************************************/
+void pf_map_shared_clear(void)
+{
+  if (NULL == pf_shared_cache || 0 == pf_shared_hash_size(pf_shared_cache)) {
+    return;
+  }
+
+  pf_shared_hash_data_iterate(pf_shared_cache, entry) {
+    pf_shared_entry_unref(entry);
+  } pf_shared_hash_data_iterate_end;
+  pf_shared_hash_clear(pf_shared_cache);
+  pf_shared_stats.clears++;
+}
+
+/************************************************************************//**
+  Returns whether the search of the shared map may have read the state of
+  'ptile', that is whether it iterated or was asked for a tile within
+  PF_SHARED_RANGE.
+****************************************************************************/
+static bool pf_shared_entry_reads_tile(const struct pf_shared_entry *entry,
+                                       const struct tile *ptile)
+{
+  const struct pf_map_record *record = entry->map->record;
+
+  square_iterate(entry->parameter.map, ptile, PF_SHARED_RANGE, piter) {
+    int tindex = tile_index(piter);
+
+    if (-1 != pf_map_record_position(record, tindex)
+        || dbv_isset(&record->probed, tindex)) {
+      return TRUE;
+    }
+  } square_iterate_end;
+
+  return FALSE;
+}
+
+/************************************************************************//**
+  Forget the shared maps which may depend on the state of 'ptile': its
+  terrain, extras, owner, city or units. If 'pplayer' is not NULL, only
+  the vision of this player changed at the tile, so only its searches
+  which are not omniscient are concerned. The maps already given by
+  pf_map_new_shared() are still valid.
+****************************************************************************/
+void pf_map_shared_clear_tile(const struct tile *ptile,
+                              const struct player *pplayer)
+{
+  struct pf_shared_entry *forget[PF_SHARED_CACHE_SIZE];
+  int count = 0, i;
+
+  if (NULL == pf_shared_cache || 0 == pf_shared_hash_size(pf_shared_cache)) {
+    return;
+  }
+
+  pf_shared_hash_data_iterate(pf_shared_cache, entry) {
+    if (NULL != pplayer
+        && (entry->parameter.owner != pplayer
+            || entry->parameter.omniscience)) {
+      continue;
+    }
+    if (pf_shared_entry_reads_tile(entry, ptile)) {
+      forget[count++] = entry;
+    }
+  } pf_shared_hash_data_iterate_end;
+
+  for (i = 0; i < count; i++) {
+    pf_shared_hash_remove(pf_shared_cache, &forget[i]->parameter);
+    pf_shared_entry_unref(forget[i]);
+  }
+  pf_shared_stats.forgotten += count;
+}
+
+/************************************************************************//**
+  Log how many pf_map_new_shared() calls found a shared search since the
+  last call, and reset the counts.
+****************************************************************************/
+void pf_map_shared_log_stats(void)
+{
+  int total = pf_shared_stats.searches + pf_shared_stats.hits;
+
+  if (0 < total) {
+    log_verbose("Shared path-finding: %d of %d searches shared (%d%%), "
+                "%d maps forgotten for tile changes, %d clears.",
+                pf_shared_stats.hits, total,
+                100 * pf_shared_stats.hits / total,
+                pf_shared_stats.forgotten, pf_shared_stats.clears);
+  }
+  memset(&pf_shared_stats, 0, sizeof(pf_shared_stats));
 }
 
 /************************************************************************//**
@@ -3273,6 +4171,10 @@ bool pf_map_iterate(struct pf_map *pfm)
     return FALSE;
   }
 
+  if (NULL != pfm->record) {
+    pf_map_record_add(pfm);
+  }
+
   return TRUE;
 }
 
@@ -3714,7 +4616,7 @@ pf_reverse_map_pos(struct pf_reverse_map *pfrm,
   struct pf_map *pfm;
   struct pf_parameter *copy;
   struct tile *target_tile;
-  const struct pf_normal_node *lattice;
+  struct pf_normal_map *pfnm;
   int max_cost;
 
   /* Check if we already processed something similar. */
@@ -3723,18 +4625,19 @@ pf_reverse_map_pos(struct pf_reverse_map *pfrm,
   }
 
   /* We didn't. Build map and iterate. */
-  pfm = pf_normal_map_new(param);
-  lattice = PF_NORMAL_MAP(pfm)->lattice;
+  pfm = pf_map_new_mode(PF_NORMAL, param);
+  pfnm = PF_NORMAL_MAP(pfm);
   target_tile = pfrm->target_tile;
   if (pfrm->max_turns >= 0) {
     max_cost = param->move_rate * (pfrm->max_turns + 1);
     do {
-      if (lattice[tile_index(pfm->tile)].cost >= max_cost) {
+      if (pf_normal_map_node(pfnm, tile_index(pfm->tile))->cost
+          >= max_cost) {
         break;
       } else if (pfm->tile == target_tile) {
         /* Found our position. Insert in hash, destroy map, and return. */
         pos = fc_malloc(sizeof(*pos));
-        pf_normal_map_fill_position(PF_NORMAL_MAP(pfm), target_tile, pos);
+        pf_normal_map_fill_position(pfnm, target_tile, pos);
         copy = fc_malloc(sizeof(*copy));
         *copy = *param;
         pf_pos_hash_insert(pfrm->hash, copy, pos);
@@ -3748,7 +4651,7 @@ pf_reverse_map_pos(struct pf_reverse_map *pfrm,
       if (pfm->tile == target_tile) {
         /* Found our position. Insert in hash, destroy map, and return. */
         pos = fc_malloc(sizeof(*pos));
-        pf_normal_map_fill_position(PF_NORMAL_MAP(pfm), target_tile, pos);
+        pf_normal_map_fill_position(pfnm, target_tile, pos);
         copy = fc_malloc(sizeof(*copy));
         *copy = *param;
         pf_pos_hash_insert(pfrm->hash, copy, pos);
@@ -194,6 +194,23 @@ extern "C" {
  *
  * You may call pf_map_path() multiple times with the same pfm.
  *
+ * To search again from an other start tile, or for an other unit, the
+ * map can be restarted instead of being destroyed and created again:
+ *
+ *    pfm = pf_map_renew(pfm, &parameter);
+ *
+ * Destroyed maps are kept in a pool to be reused by the next pf_map_new()
+ * call, so the whole lattice doesn't need to be allocated and cleared for
+ * every search.
+ *
+ * When many callers do the same search, e.g. for all the units of a stack,
+ * pf_map_new_shared() can be used instead of pf_map_new(). The search is
+ * then done once. pf_map_shared_clear_tile() must be called when a tile
+ * changes for the path-finding (terrain, extras, owner, city, units, or
+ * vision of a player), and pf_map_shared_clear() when the diplomatic
+ * states change. Only the parameters whose callbacks read the evaluated
+ * tile and the adjacent tiles, like the ones of pf_tools.h, can be used.
+ *
  * B) the caller doesn't know the map position of the goal yet (but knows
  * what he is looking for, e.g. a port) and wants to iterate over
  * all paths in order of increasing costs (total_CC):
@@ -475,6 +492,26 @@ struct pf_reverse_map;
 struct pf_map *pf_map_new(const struct pf_parameter *parameter)
                fc__warn_unused_result;
 void pf_map_destroy(struct pf_map *pfm);
+struct pf_map *pf_map_renew(struct pf_map *pfm,
+                            const struct pf_parameter *parameter)
+               fc__warn_unused_result;
+
+/* Maps recycling, see pf_map_new() and pf_map_destroy(). */
+void pf_map_pool_init(void);
+void pf_map_pool_free(void);
+
+/* Searches restricted to some tiles, see also pf_hierarchy.h. */
+struct pf_map *pf_map_new_restricted(const struct pf_parameter *parameter,
+                                     const bool *allowed_tiles)
+               fc__warn_unused_result;
+
+/* Maps shared by identical searches. */
+struct pf_map *pf_map_new_shared(const struct pf_parameter *parameter)
+               fc__warn_unused_result;
+void pf_map_shared_clear(void);
+void pf_map_shared_clear_tile(const struct tile *ptile,
+                              const struct player *pplayer);
+void pf_map_shared_log_stats(void);
 
 /* Method A) functions. */
 int pf_map_move_cost(struct pf_map *pfm, struct tile *ptile);
@@ -0,0 +1,427 @@
+/***********************************************************************
+ Freeciv - Copyright (C) 2003 - The Freeciv Project
+   This program is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation; either version 2, or (at your option)
+   any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+***********************************************************************/
+
+#ifdef HAVE_CONFIG_H
+#include <fc_config.h>
+#endif
+
+#include <string.h>
+
+/* utility */
+#include "fcthread.h"
+#include "log.h"
+#include "mem.h"
+#include "support.h"
+
+/* common */
+#include "game.h"
+#include "map.h"
+#include "movement.h"
+#include "unittype.h"
+
+/* common/aicore */
+#include "path_finding.h"
+
+#include "pf_hierarchy.h"
+
+/* The size of the sectors, in native coordinates. */
+#define PF_SECTOR_SIZE 16
+
+/* The number of tiles of the map. */
+#define PF_LATTICE_SIZE(nmap) ((nmap)->xsize * (nmap)->ysize)
+
+/* A node of the sector graph: the part of a continent or an ocean which
+ * is in a sector. */
+struct pf_sector_node {
+  int sector;                   /* Index of the sector. */
+  Continent_id continent;       /* Continent or ocean number. */
+  int num_links;                /* The number of linked nodes. */
+  int links_size;               /* The allocated size of 'links'. */
+  int *links;                   /* The nodes we can move to. */
+};
+
+/* The sector graph of a unit class. */
+struct pf_sector_graph {
+  const struct civ_map *map;    /* The map it was built for. */
+  int lattice_size;             /* The size of this map. */
+  int turn;                     /* The turn it was built. */
+  int sectors_x, sectors_y;     /* The number of sectors. */
+  int *tile_node;               /* The node of every tile, or -1 if the
+                                 * tile is not native. */
+  int num_nodes;
+  struct pf_sector_node *nodes;
+};
+
+/* The sector graphs are shared by all the searches. The mutex protects
+ * them while they are (re)built and while a route is looked for, as the
+ * searches may run in several threads. */
+static struct {
+  bool initialized;
+  fc_mutex mutex;
+  struct pf_sector_graph *graphs[UCL_LAST];
+} pf_hierarchy;
+
+/************************************************************************//**
+  Add a link from the node 'from' to the node 'to', if not already done.
+****************************************************************************/
+static void pf_sector_node_link(struct pf_sector_node *from, int to)
+{
+  int i;
+
+  for (i = 0; i < from->num_links; i++) {
+    if (from->links[i] == to) {
+      return;
+    }
+  }
+
+  if (from->num_links == from->links_size) {
+    from->links_size = MAX(4, 2 * from->links_size);
+    from->links = fc_realloc(from->links,
+                             from->links_size * sizeof(*from->links));
+  }
+  from->links[from->num_links++] = to;
+}
+
+/************************************************************************//**
+  Free a sector graph.
+****************************************************************************/
+static void pf_sector_graph_destroy(struct pf_sector_graph *graph)
+{
+  int i;
+
+  for (i = 0; i < graph->num_nodes; i++) {
+    free(graph->nodes[i].links);
+  }
+  free(graph->nodes);
+  free(graph->tile_node);
+  free(graph);
+}
+
+/************************************************************************//**
+  Build the sector graph of the unit class, for the current map.
+****************************************************************************/
+static struct pf_sector_graph *
+pf_sector_graph_new(const struct civ_map *nmap,
+                    const struct unit_class *pclass)
+{
+  struct pf_sector_graph *graph = fc_malloc(sizeof(*graph));
+  int nodes_size = 0;
+  int sx, sy, nat_x, nat_y;
+
+  graph->map = nmap;
+  graph->lattice_size = PF_LATTICE_SIZE(nmap);
+  graph->turn = game.info.turn;
+  graph->sectors_x = (nmap->xsize + PF_SECTOR_SIZE - 1) / PF_SECTOR_SIZE;
+  graph->sectors_y = (nmap->ysize + PF_SECTOR_SIZE - 1) / PF_SECTOR_SIZE;
+  graph->tile_node = fc_malloc(graph->lattice_size
+                              * sizeof(*graph->tile_node));
+  graph->num_nodes = 0;
+  graph->nodes = NULL;
+
+  /* Make the nodes, sector by sector, so the nodes of a sector follow each
+   * other. */
+  for (sy = 0; sy < graph->sectors_y; sy++) {
+    for (sx = 0; sx < graph->sectors_x; sx++) {
+      int sector = sy * graph->sectors_x + sx;
+      int first_node = graph->num_nodes;
+
+      for (nat_y = sy * PF_SECTOR_SIZE;
+           nat_y < MIN((sy + 1) * PF_SECTOR_SIZE, nmap->ysize); nat_y++) {
+        for (nat_x = sx * PF_SECTOR_SIZE;
+             nat_x < MIN((sx + 1) * PF_SECTOR_SIZE, nmap->xsize);
+             nat_x++) {
+          struct tile *ptile = native_pos_to_tile(nmap, nat_x, nat_y);
+          Continent_id continent;
+          int node;
+
+          if (!is_native_tile_to_class(pclass, ptile)) {
+            graph->tile_node[tile_index(ptile)] = -1;
+            continue;
+          }
+
+          continent = tile_continent(ptile);
+          for (node = first_node; node < graph->num_nodes; node++) {
+            if (graph->nodes[node].continent == continent) {
+              break;
+            }
+          }
+
+          if (node == graph->num_nodes) {
+            if (graph->num_nodes == nodes_size) {
+              nodes_size = MAX(64, 2 * nodes_size);
+              graph->nodes = fc_realloc(graph->nodes,
+                                        nodes_size * sizeof(*graph->nodes));
+            }
+            graph->nodes[node].sector = sector;
+            graph->nodes[node].continent = continent;
+            graph->nodes[node].num_links = 0;
+            graph->nodes[node].links_size = 0;
+            graph->nodes[node].links = NULL;
+            graph->num_nodes++;
+          }
+          graph->tile_node[tile_index(ptile)] = node;
+        }
+      }
+    }
+  }
+
+  /* Link the nodes. */
+  whole_map_iterate(nmap, ptile) {
+    int node = graph->tile_node[tile_index(ptile)];
+
+    if (-1 == node) {
+      continue;
+    }
+
+    adjc_iterate(nmap, ptile, adjc_tile) {
+      int adjc_node = graph->tile_node[tile_index(adjc_tile)];
+
+      if (-1 != adjc_node && node != adjc_node) {
+        pf_sector_node_link(graph->nodes + node, adjc_node);
+      }
+    } adjc_iterate_end;
+  } whole_map_iterate_end;
+
+  log_debug("Sector graph for %s: %d nodes.",
+            uclass_rule_name(pclass), graph->num_nodes);
+
+  return graph;
+}
+
+/************************************************************************//**
+  Returns the sector graph of the unit class, (re)building it if needed.
+  Must be called with the mutex held.
+****************************************************************************/
+static const struct pf_sector_graph *
+pf_sector_graph_get(const struct civ_map *nmap,
+                    const struct unit_class *pclass)
+{
+  struct pf_sector_graph **pgraph = pf_hierarchy.graphs
+                                    + uclass_index(pclass);
+
+  if (NULL != *pgraph
+      && ((*pgraph)->map != nmap
+          || (*pgraph)->lattice_size != PF_LATTICE_SIZE(nmap)
+          || (*pgraph)->turn != game.info.turn)) {
+    /* Another map, or terrains may have changed. */
+    pf_sector_graph_destroy(*pgraph);
+    *pgraph = NULL;
+  }
+
+  if (NULL == *pgraph) {
+    *pgraph = pf_sector_graph_new(nmap, pclass);
+  }
+
+  return *pgraph;
+}
+
+/************************************************************************//**
+  Returns the node of the tile. For a tile which is not native, e.g. when
+  the unit is transported or attacks, returns the node of an adjacent
+  tile. Returns -1 if there are none.
+****************************************************************************/
+static int pf_sector_graph_tile_node(const struct pf_sector_graph *graph,
+                                     const struct tile *ptile)
+{
+  int node = graph->tile_node[tile_index(ptile)];
+
+  if (-1 == node) {
+    adjc_iterate(graph->map, ptile, adjc_tile) {
+      node = graph->tile_node[tile_index(adjc_tile)];
+      if (-1 != node) {
+        break;
+      }
+    } adjc_iterate_end;
+  }
+
+  return node;
+}
+
+/************************************************************************//**
+  Look for a route between the nodes in the sector graph. If found, mark
+  the tiles of the sectors of the route and of their neighbours in
+  'allowed_tiles' (one per tile of the map) and returns TRUE.
+****************************************************************************/
+static bool pf_sector_graph_route(const struct pf_sector_graph *graph,
+                                  int start_node, int dest_node,
+                                  bool *allowed_tiles)
+{
+  int *prev = fc_malloc(graph->num_nodes * sizeof(*prev));
+  int *queue = fc_malloc(graph->num_nodes * sizeof(*queue));
+  bool *allowed_sectors;
+  int queue_start = 0, queue_end = 0;
+  int node, i, sx, sy, nat_x, nat_y;
+
+  /* Breadth-first search: the sectors have all the same size. */
+  for (i = 0; i < graph->num_nodes; i++) {
+    prev[i] = -2;
+  }
+  prev[start_node] = -1;
+  queue[queue_end++] = start_node;
+  while (queue_start < queue_end && -2 == prev[dest_node]) {
+    const struct pf_sector_node *pnode = graph->nodes + queue[queue_start++];
+
+    for (i = 0; i < pnode->num_links; i++) {
+      if (-2 == prev[pnode->links[i]]) {
+        prev[pnode->links[i]] = pnode - graph->nodes;
+        queue[queue_end++] = pnode->links[i];
+      }
+    }
+  }
+  free(queue);
+
+  if (-2 == prev[dest_node]) {
+    free(prev);
+    return FALSE;
+  }
+
+  /* Mark the sectors on the route and their neighbours. */
+  allowed_sectors = fc_calloc(graph->sectors_x * graph->sectors_y,
+                              sizeof(*allowed_sectors));
+  for (node = dest_node; -1 != node; node = prev[node]) {
+    int x, y;
+
+    sx = graph->nodes[node].sector % graph->sectors_x;
+    sy = graph->nodes[node].sector / graph->sectors_x;
+    for (y = MAX(0, sy - 1); y <= MIN(graph->sectors_y - 1, sy + 1); y++) {
+      for (x = MAX(0, sx - 1); x <= MIN(graph->sectors_x - 1, sx + 1);
+           x++) {
+        allowed_sectors[y * graph->sectors_x + x] = TRUE;
+      }
+    }
+  }
+  free(prev);
+
+  /* Mark their tiles. */
+  memset(allowed_tiles, 0, graph->lattice_size * sizeof(*allowed_tiles));
+  for (sy = 0; sy < graph->sectors_y; sy++) {
+    for (sx = 0; sx < graph->sectors_x; sx++) {
+      if (!allowed_sectors[sy * graph->sectors_x + sx]) {
+        continue;
+      }
+      for (nat_y = sy * PF_SECTOR_SIZE;
+           nat_y < MIN((sy + 1) * PF_SECTOR_SIZE, graph->map->ysize);
+           nat_y++) {
+        for (nat_x = sx * PF_SECTOR_SIZE;
+             nat_x < MIN((sx + 1) * PF_SECTOR_SIZE, graph->map->xsize);
+             nat_x++) {
+          struct tile *ptile = native_pos_to_tile(graph->map, nat_x, nat_y);
+
+          allowed_tiles[tile_index(ptile)] = TRUE;
+        }
+      }
+    }
+  }
+  free(allowed_sectors);
+
+  return TRUE;
+}
+
+/************************************************************************//**
+  Returns whether the hierarchical search can be used for this query.
+****************************************************************************/
+static bool pf_hierarchy_usable(const struct pf_parameter *parameter,
+                                const struct tile *ptile)
+{
+  return (NULL != parameter->utype
+          && NULL == parameter->is_pos_dangerous
+          && NULL == parameter->get_moves_left_req
+          && NULL == parameter->get_costs
+          /* On server side, the sector graph knows the whole map. */
+          && (parameter->omniscience || !is_server())
+          /* Short queries are cheap enough. */
+          && real_map_distance(parameter->start_tile, ptile)
+             >= 2 * PF_SECTOR_SIZE
+          && pf_hierarchy.initialized);
+}
+
+/************************************************************************//**
+  Returns the path to 'ptile', first looking for a route in the sector
+  graph, then for the real path in the sectors of this route. Falls back
+  to a full search when needed. See pf_hierarchy.h.
+****************************************************************************/
+struct pf_path *pf_hierarchy_path(const struct pf_parameter *parameter,
+                                  struct tile *ptile)
+{
+  struct pf_map *pfm;
+  struct pf_path *path = NULL;
+
+  if (pf_hierarchy_usable(parameter, ptile)) {
+    const struct pf_sector_graph *graph;
+    bool *allowed_tiles = fc_malloc(PF_LATTICE_SIZE(parameter->map)
+                                    * sizeof(*allowed_tiles));
+    int start_node, dest_node;
+    bool found;
+
+    fc_allocate_mutex(&pf_hierarchy.mutex);
+    graph = pf_sector_graph_get(parameter->map,
+                                utype_class(parameter->utype));
+    start_node = pf_sector_graph_tile_node(graph, parameter->start_tile);
+    dest_node = pf_sector_graph_tile_node(graph, ptile);
+    found = (-1 != start_node && -1 != dest_node
+             && pf_sector_graph_route(graph, start_node, dest_node,
+                                      allowed_tiles));
+    fc_release_mutex(&pf_hierarchy.mutex);
+
+    if (found) {
+      pfm = pf_map_new_restricted(parameter, allowed_tiles);
+      if (NULL != pfm) {
+        path = pf_map_path(pfm, ptile);
+        pf_map_destroy(pfm);
+      }
+    }
+    free(allowed_tiles);
+  }
+
+  if (NULL == path) {
+    pfm = pf_map_new(parameter);
+    path = pf_map_path(pfm, ptile);
+    pf_map_destroy(pfm);
+  }
+
+  return path;
+}
+
+/************************************************************************//**
+  Initialize the sector graph cache. Until this is called, full searches
+  are done.
+****************************************************************************/
+void pf_hierarchy_init(void)
+{
+  if (!pf_hierarchy.initialized) {
+    fc_init_mutex(&pf_hierarchy.mutex);
+    memset(pf_hierarchy.graphs, 0, sizeof(pf_hierarchy.graphs));
+    pf_hierarchy.initialized = TRUE;
+  }
+}
+
+/************************************************************************//**
+  Free all the sector graphs and the cache itself.
+****************************************************************************/
+void pf_hierarchy_free(void)
+{
+  size_t i;
+
+  if (!pf_hierarchy.initialized) {
+    return;
+  }
+
+  for (i = 0; i < ARRAY_SIZE(pf_hierarchy.graphs); i++) {
+    if (NULL != pf_hierarchy.graphs[i]) {
+      pf_sector_graph_destroy(pf_hierarchy.graphs[i]);
+      pf_hierarchy.graphs[i] = NULL;
+    }
+  }
+  fc_destroy_mutex(&pf_hierarchy.mutex);
+  pf_hierarchy.initialized = FALSE;
+}
@@ -0,0 +1,56 @@
+/***********************************************************************
+ Freeciv - Copyright (C) 2003 - The Freeciv Project
+   This program is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation; either version 2, or (at your option)
+   any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+***********************************************************************/
+#ifndef FC__PF_HIERARCHY_H
+#define FC__PF_HIERARCHY_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif /* __cplusplus */
+
+/* common/aicore */
+#include "path_finding.h"
+
+/* ========================== Hierarchical goto ========================== */
+
+/*
+ * For long distance queries on big maps, a full path-finding search
+ * expands a lot of nodes which are not on the way to the destination.
+ * This layer first looks for a route in a small graph of map sectors,
+ * then searches the real path with the usual pf_map, restricted to the
+ * sectors of this route and their neighbours.
+ *
+ * The sector graph is built for every unit class. Its nodes are the
+ * parts of continents or oceans lying in a sector, and two nodes are
+ * linked when a unit of the class can move between them, considering
+ * only the native terrains. It is rebuilt every turn.
+ *
+ * The sector graph is only used to restrict the search area. The path
+ * is always computed with the given pf_parameter, so it respects all its
+ * callbacks. It may not be the best one though, as a better path could
+ * leave the sectors of the route. If no path is found this way, or if the
+ * parameter cannot be handled (danger, fuel or jumbo callbacks), a full
+ * search is done.
+ */
+
+struct pf_path *pf_hierarchy_path(const struct pf_parameter *parameter,
+                                  struct tile *ptile)
+                fc__warn_unused_result;
+
+void pf_hierarchy_init(void);
+void pf_hierarchy_free(void);
+
+#ifdef __cplusplus
+}
+#endif /* __cplusplus */
+
+#endif /* FC__PF_HIERARCHY_H */
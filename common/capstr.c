@@ -90,7 +90,21 @@ void init_our_capability(void)
 
   s = getenv("FREECIV_CAPS");
   if (!s) {
-    s = NETWORK_CAPSTRING;
+    /* The compression codecs we can decode, see packets.c. */
+    fc_snprintf(our_capability_internal, sizeof(our_capability_internal),
+                "%s compress_codec%s%s", NETWORK_CAPSTRING,
+#ifdef FREECIV_HAVE_LIBZSTD
+                " compress_zstd",
+#else
+                "",
+#endif
+#ifdef FREECIV_HAVE_LIBLZ4
+                " compress_lz4"
+#else
+                ""
+#endif
+                );
+    return;
   }
   sz_strlcpy(our_capability_internal, s);
 }
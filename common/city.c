@@ -71,9 +71,6 @@ struct tile_cache {
 };
 
 static inline void city_tile_cache_update(struct city *pcity);
-static inline int city_tile_cache_get_output(const struct city *pcity,
-                                             int city_tile_index,
-                                             enum output_type_id o);
 
 struct citystyle *city_styles = NULL;
 
@@ -518,8 +515,7 @@ static void citylog_map_radius_sq(enum log_level level)
 void generate_city_map_indices(void)
 {
   int i, dx, dy, city_x, city_y, dist, city_count_tiles = 0;
-  struct iter_index city_map_index_tmp[CITY_MAP_MAX_SIZE
-                                       * CITY_MAP_MAX_SIZE];
+  struct iter_index city_map_index_tmp[MAX_CITY_TILES];
 
   /* initialise map information for each city radii */
   for (i = 0; i <= CITY_MAP_MAX_RADIUS_SQ; i++) {
@@ -2306,11 +2302,11 @@ static inline void city_tile_cache_update(struct city *pcity)
 
 /**********************************************************************//**
   This function returns the output of 'o' for the city tile 'city_tile_index'
-  of 'pcity'.
+  of 'pcity', as of its last full refresh.
 **************************************************************************/
-static inline int city_tile_cache_get_output(const struct city *pcity,
-                                             int city_tile_index,
-                                             enum output_type_id o)
+int city_tile_cache_get_output(const struct city *pcity,
+                               int city_tile_index,
+                               enum output_type_id o)
 {
   fc_assert_ret_val(pcity->tile_cache_radius_sq
                     == city_map_radius_sq_get(pcity), 0);
@@ -3363,6 +3359,7 @@ void destroy_city_virtual(struct city *pcity)
   if (pcity->cm_parameter) {
     free(pcity->cm_parameter);
   }
+  cm_clear_cache(pcity);
 
   if (!is_server()) {
     unit_list_destroy(pcity->client.info_units_supported);
@@ -82,6 +82,9 @@ enum production_class_type {
 /* Maximum diameter of the workable city area. */
 #define CITY_MAP_MAX_SIZE (CITY_MAP_MAX_RADIUS * 2 + 1)
 
+/* Maximum number of tiles of the workable city area. */
+#define MAX_CITY_TILES (CITY_MAP_MAX_SIZE * CITY_MAP_MAX_SIZE)
+
 #define INCITE_IMPOSSIBLE_COST (1000 * 1000 * 1000)
 
 /*
@@ -294,6 +297,7 @@ struct tile_cache; /* defined and only used within city.c */
 
 struct adv_city; /* defined in ./server/advisors/infracache.h */
 
+struct cm_cache; /* defined in ./common/aicore/cm.c */
 struct cm_parameter; /* defined in ./common/aicore/cm.h */
 
 struct city {
@@ -395,6 +399,7 @@ struct city {
   } rally_point;
 
   struct cm_parameter *cm_parameter;
+  struct cm_cache *cm_cache; /* lattice and last solution of the CM */
 
   union {
     struct {
@@ -653,6 +658,9 @@ int city_tile_output(const struct city *pcity, const struct tile *ptile,
 		     bool is_celebrating, Output_type_id otype);
 int city_tile_output_now(const struct city *pcity, const struct tile *ptile,
 			 Output_type_id otype);
+int city_tile_cache_get_output(const struct city *pcity,
+                               int city_tile_index,
+                               enum output_type_id o);
 
 bool base_city_can_work_tile(const struct player *restriction,
                              const struct city *pcity,
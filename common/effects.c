@@ -34,7 +34,9 @@
 #include "map.h"
 #include "packets.h"
 #include "player.h"
+#include "specialist.h"
 #include "tech.h"
+#include "unittype.h"
 
 #include "effects.h"
 
@@ -119,7 +121,71 @@ static struct {
     /* ...advances... */
     struct effect_list *advances[A_LAST];
   } reqs;
-} ruleset_cache;
+
+  /* Index of the effects of each type, see ruleset_cache_index_build(). */
+  struct effect_index *index[EFT_COUNT];
+  bool indexed;
+  bool use_index;
+} ruleset_cache = { .use_index = TRUE };
+
+/**************************************************************************
+  Effect index. get_target_bonus_effects() used to evaluate all the
+  requirements of every effect of the queried type. Most effects however
+  are restricted to a single building, unit type, government... and can
+  only be active for targets matching it.
+
+  So the effects of every type are partitioned according to their most
+  selective requirement. Such a requirement is necessarily fulfilled by
+  an active effect, and its source can be read directly from the target
+  (the government of the target player, the target building, the
+  buildings of the target city...). The query only evaluates the effects
+  found in the partitions matching the target, plus the ones without any
+  indexable requirement.
+
+  The index is built once the ruleset is fully loaded. When an effect is
+  added or modified later, the index is dropped and the queries scan the
+  whole effect lists again until it is rebuilt.
+**************************************************************************/
+enum effect_index_kind {
+  /* Most selective first. */
+  EIK_BUILDING_LOCAL,   /* The target building. */
+  EIK_UTYPE,            /* The target unit type. */
+  EIK_SPECIALIST,       /* The target specialist. */
+  EIK_BUILDING_CITY,    /* A building of the target city. */
+  EIK_GOVERNMENT,       /* The government of the target player. */
+  EIK_OTYPE,            /* The target output type. */
+  EIK_COUNT             /* No indexable requirement. */
+};
+
+/* Positions of some effects in the list of their type, increasing. */
+struct effect_bucket {
+  int count;
+  int *pos;
+};
+
+struct effect_partition {
+  struct effect_bucket *buckets;        /* Indexed by the source number. */
+  int nkeys;                            /* Number of non-empty buckets... */
+  int *keys;                            /* ...and their source numbers. */
+};
+
+struct effect_index {
+  int count;
+  struct effect **effects;              /* Same order as get_effects(). */
+  struct effect_bucket generic;         /* Effects without any key. */
+  struct effect_partition *parts[EIK_COUNT];
+};
+
+static const int effect_index_domain[EIK_COUNT] = {
+  [EIK_BUILDING_LOCAL] = B_LAST,
+  [EIK_UTYPE] = U_LAST,
+  [EIK_SPECIALIST] = SP_MAX,
+  [EIK_BUILDING_CITY] = B_LAST,
+  [EIK_GOVERNMENT] = G_LAST,
+  [EIK_OTYPE] = O_LAST
+};
+
+static void ruleset_cache_index_free(void);
 
 
 /**********************************************************************//**
@@ -184,6 +250,7 @@ struct effect *effect_new(enum effect_type type, int value,
   /* Now add the effect to the ruleset cache. */
   effect_list_append(ruleset_cache.tracker, peffect);
   effect_list_append(get_effects(type), peffect);
+  ruleset_cache.indexed = FALSE;
 
   return peffect;
 }
@@ -211,6 +278,7 @@ void effect_req_append(struct effect *peffect, struct requirement req)
   struct effect_list *eff_list = get_req_source_effects(&req.source);
 
   requirement_vector_append(&peffect->reqs, req);
+  ruleset_cache.indexed = FALSE;
 
   if (eff_list) {
     effect_list_append(eff_list, peffect);
@@ -298,9 +366,200 @@ void ruleset_cache_free(void)
     }
   }
 
+  ruleset_cache_index_free();
+
   initialized = FALSE;
 }
 
+/**********************************************************************//**
+  Return the kind of the most selective requirement of the effect which
+  can be used to index it, and put the number of its source in 'key'.
+  Returns EIK_COUNT if the effect has no such requirement.
+**************************************************************************/
+static enum effect_index_kind effect_index_key(const struct effect *peffect,
+                                               int *key)
+{
+  enum effect_index_kind best = EIK_COUNT;
+
+  requirement_vector_iterate(&peffect->reqs, preq) {
+    enum effect_index_kind kind = EIK_COUNT;
+    int value = 0;
+
+    if (!preq->present) {
+      continue;
+    }
+
+    switch (preq->source.kind) {
+    case VUT_IMPROVEMENT:
+      if (preq->survives) {
+        break;
+      }
+      if (preq->range == REQ_RANGE_LOCAL) {
+        kind = EIK_BUILDING_LOCAL;
+      } else if (preq->range == REQ_RANGE_CITY) {
+        kind = EIK_BUILDING_CITY;
+      }
+      value = improvement_index(preq->source.value.building);
+      break;
+    case VUT_UTYPE:
+      if (preq->range == REQ_RANGE_LOCAL) {
+        kind = EIK_UTYPE;
+        value = utype_index(preq->source.value.utype);
+      }
+      break;
+    case VUT_SPECIALIST:
+      kind = EIK_SPECIALIST;
+      value = specialist_index(preq->source.value.specialist);
+      break;
+    case VUT_GOVERNMENT:
+      kind = EIK_GOVERNMENT;
+      value = government_index(preq->source.value.govern);
+      break;
+    case VUT_OTYPE:
+      kind = EIK_OTYPE;
+      value = preq->source.value.outputtype;
+      break;
+    default:
+      break;
+    }
+
+    if (kind < best) {
+      best = kind;
+      *key = value;
+    }
+  } requirement_vector_iterate_end;
+
+  return best;
+}
+
+/**********************************************************************//**
+  Build the effect index of the ruleset cache. This must be called once
+  all the effects of the ruleset have been loaded or received.
+**************************************************************************/
+void ruleset_cache_index_build(void)
+{
+  int type;
+
+  ruleset_cache_index_free();
+
+  for (type = 0; type < EFT_COUNT; type++) {
+    struct effect_list *plist = ruleset_cache.effects[type];
+    struct effect_index *pindex;
+    enum effect_index_kind *kinds;
+    int *keys;
+    int i;
+
+    if (plist == NULL || effect_list_size(plist) == 0) {
+      continue;
+    }
+
+    pindex = fc_calloc(1, sizeof(*pindex));
+    pindex->count = effect_list_size(plist);
+    pindex->effects = fc_malloc(pindex->count * sizeof(*pindex->effects));
+    kinds = fc_malloc(pindex->count * sizeof(*kinds));
+    keys = fc_malloc(pindex->count * sizeof(*keys));
+
+    /* Find the key of every effect, and count the bucket sizes. */
+    i = 0;
+    effect_list_iterate(plist, peffect) {
+      struct effect_bucket *pbucket;
+
+      pindex->effects[i] = peffect;
+      kinds[i] = effect_index_key(peffect, &keys[i]);
+      if (kinds[i] == EIK_COUNT) {
+        pbucket = &pindex->generic;
+      } else {
+        struct effect_partition *ppart = pindex->parts[kinds[i]];
+
+        fc_assert(keys[i] >= 0 && keys[i] < effect_index_domain[kinds[i]]);
+        if (ppart == NULL) {
+          ppart = fc_calloc(1, sizeof(*ppart));
+          ppart->buckets = fc_calloc(effect_index_domain[kinds[i]],
+                                     sizeof(*ppart->buckets));
+          ppart->keys = fc_malloc(effect_index_domain[kinds[i]]
+                                  * sizeof(*ppart->keys));
+          pindex->parts[kinds[i]] = ppart;
+        }
+        pbucket = &ppart->buckets[keys[i]];
+        if (pbucket->count == 0) {
+          ppart->keys[ppart->nkeys++] = keys[i];
+        }
+      }
+      pbucket->count++;
+      i++;
+    } effect_list_iterate_end;
+
+    /* Fill the buckets. */
+    for (i = 0; i < pindex->count; i++) {
+      struct effect_bucket *pbucket = (kinds[i] == EIK_COUNT
+                                       ? &pindex->generic
+                                       : &pindex->parts[kinds[i]]
+                                             ->buckets[keys[i]]);
+
+      if (pbucket->pos == NULL) {
+        pbucket->pos = fc_malloc(pbucket->count * sizeof(*pbucket->pos));
+        pbucket->count = 0;
+      }
+      pbucket->pos[pbucket->count++] = i;
+    }
+
+    free(kinds);
+    free(keys);
+    ruleset_cache.index[type] = pindex;
+  }
+
+  ruleset_cache.indexed = TRUE;
+}
+
+/**********************************************************************//**
+  Free the effect index of the ruleset cache.
+**************************************************************************/
+static void ruleset_cache_index_free(void)
+{
+  int type, kind, i;
+
+  for (type = 0; type < EFT_COUNT; type++) {
+    struct effect_index *pindex = ruleset_cache.index[type];
+
+    if (pindex == NULL) {
+      continue;
+    }
+
+    for (kind = 0; kind < EIK_COUNT; kind++) {
+      struct effect_partition *ppart = pindex->parts[kind];
+
+      if (ppart != NULL) {
+        for (i = 0; i < ppart->nkeys; i++) {
+          free(ppart->buckets[ppart->keys[i]].pos);
+        }
+        free(ppart->buckets);
+        free(ppart->keys);
+        free(ppart);
+      }
+    }
+    free(pindex->generic.pos);
+    free(pindex->effects);
+    free(pindex);
+    ruleset_cache.index[type] = NULL;
+  }
+
+  ruleset_cache.indexed = FALSE;
+}
+
+/**********************************************************************//**
+  Set whether the effect index is used by the queries when it is built.
+  Returns the previous setting. Only meant for comparison with a full
+  scan of the effects.
+**************************************************************************/
+bool ruleset_cache_index_use(bool use)
+{
+  bool old = ruleset_cache.use_index;
+
+  ruleset_cache.use_index = use;
+
+  return old;
+}
+
 /**********************************************************************//**
   Get the maximum effect value in this ruleset for the universal
   (that is, the sum of all positive effects clauses that apply specifically
@@ -589,6 +848,28 @@ bool is_building_replaced(const struct city *pcity,
   return TRUE;
 }
 
+/**********************************************************************//**
+  Returns the value that an active effect adds to the bonus of the target
+  player.
+**************************************************************************/
+static int effect_active_value(const struct effect *peffect,
+                               const struct player *target_player)
+{
+  /* This code will add value of effect. If there's multiplier for
+   * effect and target_player aren't null, then value is multiplied
+   * by player's multiplier factor. */
+  if (peffect->multiplier) {
+    if (target_player) {
+      return (peffect->value
+              * player_multiplier_effect_value(target_player,
+                                               peffect->multiplier)) / 100;
+    }
+    return 0;
+  }
+
+  return peffect->value;
+}
+
 /**********************************************************************//**
   Returns the effect bonus of a given type for any target.
 
@@ -614,34 +895,118 @@ int get_target_bonus_effects(struct effect_list *plist,
                              const struct action *target_action,
                              enum effect_type effect_type)
 {
+  const struct effect_index *pindex;
+  const struct effect_partition *ppart;
+  const struct effect_bucket *selected[EIK_COUNT + B_LAST];
+  const struct unit_type *putype;
+  int cursor[EIK_COUNT + B_LAST];
+  int nselected = 0;
   int bonus = 0;
+  int i, j;
+
+  if (!ruleset_cache.indexed || !ruleset_cache.use_index) {
+    /* Loop over all effects of this type. */
+    effect_list_iterate(get_effects(effect_type), peffect) {
+      /* For each effect, see if it is active. */
+      if (are_reqs_active(target_player, other_player, target_city,
+                          target_building, target_tile,
+                          target_unit, target_unittype,
+                          target_output, target_specialist, target_action,
+                          &peffect->reqs, RPT_CERTAIN)) {
+        bonus += effect_active_value(peffect, target_player);
 
-  /* Loop over all effects of this type. */
-  effect_list_iterate(get_effects(effect_type), peffect) {
-    /* For each effect, see if it is active. */
-    if (are_reqs_active(target_player, other_player, target_city,
-                        target_building, target_tile,
-                        target_unit, target_unittype,
-                        target_output, target_specialist, target_action,
-                        &peffect->reqs, RPT_CERTAIN)) {
-      /* This code will add value of effect. If there's multiplier for 
-       * effect and target_player aren't null, then value is multiplied
-       * by player's multiplier factor. */
-      if (peffect->multiplier) {
-        if (target_player) {
-          bonus += (peffect->value
-            * player_multiplier_effect_value(target_player,
-                                             peffect->multiplier)) / 100;
+        if (plist) {
+          effect_list_append(plist, peffect);
         }
-      } else {
-        bonus += peffect->value;
       }
+    } effect_list_iterate_end;
+
+    return bonus;
+  }
 
-      if (plist) {
-        effect_list_append(plist, peffect);
+  pindex = ruleset_cache.index[effect_type];
+  if (pindex == NULL) {
+    return 0;
+  }
+
+  /* Select the buckets of the effects which may be active. */
+#define SELECT_BUCKET(_kind, _key)                                          \
+  if ((ppart = pindex->parts[_kind]) != NULL                                \
+      && ppart->buckets[_key].count > 0) {                                  \
+    selected[nselected++] = &ppart->buckets[_key];                          \
+  }
+
+  if (pindex->generic.count > 0) {
+    selected[nselected++] = &pindex->generic;
+  }
+  if (target_building != NULL) {
+    SELECT_BUCKET(EIK_BUILDING_LOCAL, improvement_index(target_building));
+  }
+  putype = (target_unittype == NULL && target_unit != NULL
+            ? unit_type_get(target_unit) : target_unittype);
+  if (putype != NULL) {
+    SELECT_BUCKET(EIK_UTYPE, utype_index(putype));
+  }
+  if (target_specialist != NULL) {
+    SELECT_BUCKET(EIK_SPECIALIST, specialist_index(target_specialist));
+  }
+  if (target_city != NULL
+      && (ppart = pindex->parts[EIK_BUILDING_CITY]) != NULL) {
+    for (i = 0; i < ppart->nkeys; i++) {
+      if (city_has_building(target_city,
+                            improvement_by_number(ppart->keys[i]))) {
+        selected[nselected++] = &ppart->buckets[ppart->keys[i]];
       }
     }
-  } effect_list_iterate_end;
+  }
+  if (target_player != NULL && target_player->government != NULL) {
+    SELECT_BUCKET(EIK_GOVERNMENT,
+                  government_index(target_player->government));
+  }
+  if (target_output != NULL) {
+    SELECT_BUCKET(EIK_OTYPE, target_output->index);
+  }
+#undef SELECT_BUCKET
+
+  /* When the active effects are requested, the buckets are merged so that
+   * they are listed in the same order as in the effect list. */
+  memset(cursor, 0, nselected * sizeof(*cursor));
+  for (;;) {
+    const struct effect *peffect;
+    int best = -1;
+
+    for (i = 0; i < nselected; i++) {
+      if (cursor[i] < selected[i]->count
+          && (best == -1 || (plist != NULL
+                             && selected[i]->pos[cursor[i]]
+                                < selected[best]->pos[cursor[best]]))) {
+        best = i;
+      }
+    }
+    if (best == -1) {
+      break;
+    }
+
+    /* Consume the remaining effects of the bucket at once when their
+     * order does not matter. */
+    for (j = cursor[best]; j < (plist != NULL ? cursor[best] + 1
+                                              : selected[best]->count); j++) {
+      peffect = pindex->effects[selected[best]->pos[j]];
+
+      if (are_reqs_active(target_player, other_player, target_city,
+                          target_building, target_tile,
+                          target_unit, target_unittype,
+                          target_output, target_specialist, target_action,
+                          &peffect->reqs, RPT_CERTAIN)) {
+        bonus += effect_active_value(peffect, target_player);
+
+        if (plist) {
+          effect_list_append(plist, (struct effect *) peffect);
+        }
+      }
+    }
+    cursor[best] = j;
+  }
 
   return bonus;
 }
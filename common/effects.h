@@ -359,6 +359,8 @@ struct packet_ruleset_effect;
 
 void ruleset_cache_init(void);
 void ruleset_cache_free(void);
+void ruleset_cache_index_build(void);
+bool ruleset_cache_index_use(bool use);
 void recv_ruleset_effect(const struct packet_ruleset_effect *packet);
 void send_ruleset_cache(struct conn_list *dest);
 
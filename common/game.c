@@ -25,6 +25,8 @@
 
 /* aicore */
 #include "cm.h"
+#include "path_finding.h"
+#include "pf_hierarchy.h"
 
 /* common */
 #include "ai.h"
@@ -396,6 +398,7 @@ static void game_defaults(bool keep_ruleset_value)
     game.server.netwait           = GAME_DEFAULT_NETWAIT;
     game.server.occupychance      = GAME_DEFAULT_OCCUPYCHANCE;
     game.server.onsetbarbarian    = GAME_DEFAULT_ONSETBARBARIAN;
+    game.server.pf_hierarchy      = GAME_DEFAULT_PF_HIERARCHY;
     game.server.additional_phase_seconds = 0;
     game.server.phase_mode_stored = GAME_DEFAULT_PHASE_MODE;
     game.server.pingtime          = GAME_DEFAULT_PINGTIME;
@@ -403,6 +406,7 @@ static void game_defaults(bool keep_ruleset_value)
     game.server.razechance        = GAME_DEFAULT_RAZECHANCE;
     game.server.revealmap         = GAME_DEFAULT_REVEALMAP;
     game.server.revolution_length = GAME_DEFAULT_REVOLUTION_LENGTH;
+    game.server.threads           = GAME_DEFAULT_THREADS;
     if (!keep_ruleset_value) {
       sz_strlcpy(game.server.rulesetdir, GAME_DEFAULT_RULESETDIR);
     }
@@ -453,6 +457,8 @@ void game_init(bool keep_ruleset_value)
   game_ruleset_init();
   idex_init(&wld);
   cm_init();
+  pf_map_pool_init();
+  pf_hierarchy_init();
   researches_init();
   universal_found_functions_init();
 }
@@ -484,6 +490,8 @@ void game_free(void)
   game_ruleset_free();
   researches_free();
   cm_free();
+  pf_hierarchy_free();
+  pf_map_pool_free();
 }
 
 /**********************************************************************//**
@@ -595,6 +603,7 @@ void game_ruleset_free(void)
   extra_flags_free();
   user_terrain_flags_free();
   ruleset_cache_free();
+  req_cache_free();
   nation_sets_groups_free();
   multipliers_free();
   clause_infos_free();
@@ -693,6 +702,7 @@ void initialize_globals(void)
       } city_built_iterate_end;
     } city_list_iterate_end;
   } players_iterate_end;
+  req_cache_invalidate();
 }
 
 /**********************************************************************//**
@@ -167,6 +167,7 @@ struct civ_game {
       int num_phases;
       int occupychance;
       int onsetbarbarian;
+      bool pf_hierarchy;
       int pingtime;
       int pingtimeout;
       int ransom_gold;
@@ -174,6 +175,7 @@ struct civ_game {
       unsigned revealmap;
       int revolution_length;
       int spaceship_travel_time;
+      int threads;
       bool threaded_save;
       int save_compress_level;
       enum fz_method save_compress_type;
@@ -558,6 +560,12 @@ extern struct world wld;
 
 #define GAME_DEFAULT_AUTO_AI_TOGGLE  FALSE
 
+#define GAME_DEFAULT_PF_HIERARCHY    FALSE
+
+#define GAME_DEFAULT_THREADS         1
+#define GAME_MIN_THREADS             1
+#define GAME_MAX_THREADS             64
+
 #define GAME_DEFAULT_TIMEOUT         0
 #define GAME_DEFAULT_FIRST_TIMEOUT   -1
 #define GAME_DEFAULT_TIMEOUTINT      0
@@ -848,6 +848,12 @@ class Variant:
             self.delta=0
             self.no_packet=1
 
+        # The encoding of a packet can be shared by all the connections
+        # using this variant, unless it depends on what was sent before.
+        self.want_fanout=not self.no_packet and not (self.delta and
+            len(list(filter(lambda x:x.diff and x.is_array==1,
+                            self.other_fields)))>0)
+
         if len(self.fields)>5 or self.name.split("_")[1]=="ruleset":
             self.handle_via_packet=1
 
@@ -980,6 +986,30 @@ static char *stats_%(name)s_names[] = {%(names)s};
             extro="}\n"
             return intro+body+extro
 
+    # Returns a code fragment which is the implementation of the
+    # fanout_equal function: whether two packets are encoded the same way.
+    # Used to share an encoding in a fan-out.
+    def get_fanout_equal(self):
+        if not self.want_fanout: return ""
+        body=""
+        for field in self.fields:
+            body=body+field.get_cmp()+'''
+  if (differ) {
+    return FALSE;
+  }
+'''
+        intro='''static bool fanout_equal_%(name)s(const void *vpacket1,
+                                   const void *vpacket2)
+{
+  const struct %(packet_name)s *old =
+    (const struct %(packet_name)s *) vpacket1;
+  const struct %(packet_name)s *real_packet =
+    (const struct %(packet_name)s *) vpacket2;
+  bool differ;
+
+'''%self.__dict__
+        return intro+body+"\n  return TRUE;\n}\n\n"
+
     # Returns a code fragment which is the implementation of the send
     # function. This is one of the two real functions. So it is rather
     # complex to create.
@@ -1045,8 +1075,10 @@ static char *stats_%(name)s_names[] = {%(names)s};
                 delta_header=""
                 body="#if 1 /* To match endif */"
             body=body+"\n"
+            body=body+self.get_fanout_start("NULL", "0")
             for field in self.fields:
                 body=body+field.get_put(0)+"\n"
+            body=body+self.get_fanout_end("NULL", "0")
             body=body+"\n#endif\n"
         else:
             body=""
@@ -1081,6 +1113,25 @@ static char *stats_%(name)s_names[] = {%(names)s};
 
     # '''
 
+    # Helpers for get_send(): reuse the encoding of an identical packet
+    # sent to another connection of the same fan-out, or record it.
+    def get_fanout_start(self,fields,fields_size):
+        if not self.want_fanout: return ""
+        return '''
+  if (!packet_fanout_lookup(pc, SEND_PACKET_RAW_OUT, %(type)s, %(no)d,
+                            real_packet, sizeof(*real_packet),
+                            fanout_equal_%(name)s, %%s, %%s)) {
+'''%self.__dict__%(fields,fields_size)
+
+    def get_fanout_end(self,fields,fields_size):
+        if not self.want_fanout: return ""
+        return '''
+  packet_fanout_store(pc, SEND_PACKET_RAW_OUT, %(type)s, %(no)d,
+                      real_packet, sizeof(*real_packet),
+                      %%s, %%s);
+  }
+'''%self.__dict__%(fields,fields_size)
+
     # Helper for get_send()
     def get_delta_send_body(self):
         intro='''
@@ -1119,6 +1170,7 @@ static char *stats_%(name)s_names[] = {%(names)s};
   }
 '''%self.get_dict(vars())
 
+        body=body+self.get_fanout_start("&fields", "sizeof(fields)")
         body=body+'''
 #ifdef FREECIV_JSON_CONNECTION
   field_addr.name = "fields";
@@ -1133,6 +1185,7 @@ static char *stats_%(name)s_names[] = {%(names)s};
         for i in range(len(self.other_fields)):
             field=self.other_fields[i]
             body=body+field.get_put_wrapper(self,i,1)
+        body=body+self.get_fanout_end("&fields", "sizeof(fields)")
         body=body+'''
   *old = *real_packet;
 '''
@@ -1502,6 +1555,7 @@ class Packet:
                 result=result+v.get_bitvector()
                 result=result+"#endif /* FREECIV_DELTA_PROTOCOL */\n\n"
             result=result+v.get_receive()
+            result=result+v.get_fanout_equal()
             result=result+v.get_send()
         return result
 
@@ -1511,9 +1565,12 @@ class Packet:
         if not self.want_lsend: return ""
         return '''%(lsend_prototype)s
 {
+  bool fanout = packet_fanout_begin(dest);
+
   conn_list_iterate(dest, pconn) {
     send_%(name)s(pconn%(extra_send_args2)s);
   } conn_list_iterate_end;
+  packet_fanout_end(fanout);
 }
 
 '''%self.__dict__
@@ -122,6 +122,19 @@ void improvement_feature_cache_init(void)
       }
     } action_enablers_iterate_end;
 
+    /* The requirement cache needs to know whether the obsolescence
+     * of the building depends on the target city. */
+    pimprove->player_obsolescence = TRUE;
+    requirement_vector_iterate(&pimprove->obsolete_by, preq) {
+      if (!((preq->source.kind == VUT_ADVANCE
+             || preq->source.kind == VUT_TECHFLAG)
+            && (preq->range == REQ_RANGE_PLAYER
+                || (preq->range == REQ_RANGE_WORLD && preq->survives)))) {
+        pimprove->player_obsolescence = FALSE;
+        break;
+      }
+    } requirement_vector_iterate_end;
+
   } improvement_iterate_end;
 }
 
@@ -754,6 +767,7 @@ void wonder_built(const struct city *pcity, const struct impr_type *pimprove)
 
   pplayer = city_owner(pcity);
   pplayer->wonders[windex] = pcity->id;
+  req_cache_invalidate();
 
   if (is_great_wonder(pimprove)) {
     game.info.great_wonder_owners[windex] = player_number(pplayer);
@@ -776,6 +790,7 @@ void wonder_destroyed(const struct city *pcity,
   pplayer = city_owner(pcity);
   fc_assert_ret(pplayer->wonders[windex] == pcity->id);
   pplayer->wonders[windex] = WONDER_LOST;
+  req_cache_invalidate();
 
   if (is_great_wonder(pimprove)) {
     fc_assert_ret(game.info.great_wonder_owners[windex]
@@ -87,6 +87,7 @@ struct impr_type {
   bool allows_extras;
   bool prevents_disaster;
   bool protects_vs_actions;
+  bool player_obsolescence; /* Obsolescence only depends on player techs */
   
 };
 
@@ -98,26 +98,81 @@ void connection_close(struct connection *pconn, const char *reason)
 }
 
 /**********************************************************************//**
-  Make sure that there is at least extra_space bytes free space in buffer,
-  allocating more memory if needed.
+  Make sure that there is at least extra_space bytes free space after the
+  data in buffer, moving the data to the front or allocating more memory
+  if needed.
 **************************************************************************/
 static bool buffer_ensure_free_extra_space(struct socket_packet_buffer *buf,
                                            int extra_space)
 {
+  int head = buf->data - buf->base;
+
   /* room for more? */
-  if (buf->nsize - buf->ndata < extra_space) {
-    buf->nsize = buf->ndata + extra_space;
+  if (buf->nsize - head - buf->ndata >= extra_space) {
+    return TRUE;
+  }
 
-    /* added this check so we don't gobble up too much mem */
-    if (buf->nsize > MAX_LEN_BUFFER) {
-      return FALSE;
-    }
-    buf->data = (unsigned char *) fc_realloc(buf->data, buf->nsize);
+  /* added this check so we don't gobble up too much mem */
+  if (buf->ndata + extra_space > MAX_LEN_BUFFER) {
+    return FALSE;
+  }
+
+  if (0 < head) {
+    memmove(buf->base, buf->data, buf->ndata);
+    buf->data = buf->base;
+  }
+
+  /* Keep at least half of the buffer free, so that the data is moved
+   * only once every many packets. */
+  if (buf->nsize - buf->ndata < MAX(extra_space, buf->nsize / 2)
+      && buf->nsize < MAX_LEN_BUFFER) {
+    buf->nsize = MIN(MAX(buf->nsize * 2, buf->ndata + extra_space),
+                     MAX_LEN_BUFFER);
+    buf->base = (unsigned char *) fc_realloc(buf->base, buf->nsize);
+    buf->data = buf->base;
   }
 
   return TRUE;
 }
 
+/**********************************************************************//**
+  Remove len bytes from the front of the buffer.
+**************************************************************************/
+void socket_packet_buffer_consume(struct socket_packet_buffer *buf, int len)
+{
+  fc_assert_ret(0 <= len && len <= buf->ndata);
+
+  buf->ndata -= len;
+  if (0 == buf->ndata) {
+    buf->data = buf->base;
+  } else {
+    buf->data += len;
+  }
+}
+
+/**********************************************************************//**
+  Put len bytes of data in front of the data of the buffer.
+**************************************************************************/
+void socket_packet_buffer_prepend(struct socket_packet_buffer *buf,
+                                  const void *data, int len)
+{
+  int head = buf->data - buf->base;
+
+  if (head < len) {
+    if (buf->nsize < buf->ndata + len) {
+      buf->nsize = buf->ndata + len;
+      buf->base = (unsigned char *) fc_realloc(buf->base, buf->nsize);
+      buf->data = buf->base + head;
+    }
+    memmove(buf->base + len, buf->data, buf->ndata);
+    buf->data = buf->base + len;
+  }
+
+  buf->data -= len;
+  buf->ndata += len;
+  memcpy(buf->data, data, len);
+}
+
 /**********************************************************************//**
   Read data from socket, and check if a packet is ready.
   Returns:
@@ -128,16 +183,17 @@ static bool buffer_ensure_free_extra_space(struct socket_packet_buffer *buf,
 **************************************************************************/
 int read_socket_data(int sock, struct socket_packet_buffer *buffer)
 {
-  int didget;
+  int didget, space;
 
   if (!buffer_ensure_free_extra_space(buffer, MAX_LEN_PACKET)) {
     log_error("can't grow buffer");
     return -1;
   }
 
-  log_debug("try reading %d bytes", buffer->nsize - buffer->ndata);
+  space = buffer->nsize - (buffer->data - buffer->base) - buffer->ndata;
+  log_debug("try reading %d bytes", space);
   didget = fc_readsocket(sock, (char *) (buffer->data + buffer->ndata),
-                         buffer->nsize - buffer->ndata);
+                         space);
 
   if (didget > 0) {
     buffer->ndata += didget;
@@ -214,8 +270,7 @@ static int write_socket_data(struct connection *pc,
   }
 
   if (start > 0) {
-    buf->ndata -= start;
-    memmove(buf->data, buf->data+start, buf->ndata);
+    socket_packet_buffer_consume(buf, start);
     pc->last_write = timer_renew(pc->last_write, TIMER_USER, TIMER_ACTIVE);
     timer_start(pc->last_write);
   }
@@ -443,7 +498,8 @@ struct socket_packet_buffer *new_socket_packet_buffer(void)
   buf->ndata = 0;
   buf->do_buffer_sends = 0;
   buf->nsize = 10*MAX_LEN_PACKET;
-  buf->data = (unsigned char *)fc_malloc(buf->nsize);
+  buf->base = (unsigned char *)fc_malloc(buf->nsize);
+  buf->data = buf->base;
 
   return buf;
 }
@@ -454,8 +510,8 @@ struct socket_packet_buffer *new_socket_packet_buffer(void)
 static void free_socket_packet_buffer(struct socket_packet_buffer *buf)
 {
   if (buf) {
-    if (buf->data) {
-      free(buf->data);
+    if (buf->base) {
+      free(buf->base);
     }
     free(buf);
   }
@@ -609,6 +665,7 @@ void connection_common_init(struct connection *pconn)
   pconn->buffer = new_socket_packet_buffer();
   pconn->send_buffer = new_socket_packet_buffer();
   pconn->statistics.bytes_send = 0;
+  pconn->packet_record = NULL;
 #ifdef FREECIV_JSON_CONNECTION
   pconn->json_mode = TRUE;
 #endif /* FREECIV_JSON_CONNECTION */
@@ -117,12 +117,18 @@ struct connection;
 /***********************************************************
   This is a buffer where the data is first collected,
   whenever it arrives to the client/server.
+
+  The data starts at 'data', somewhere in the 'nsize' bytes
+  allocated at 'base'. Consuming data from the front only moves
+  'data' forward; the data is moved back to 'base' when the end
+  of the allocation is reached.
 ***********************************************************/
 struct socket_packet_buffer {
   int ndata;
   int do_buffer_sends;
   int nsize;
   unsigned char *data;
+  unsigned char *base;
 };
 
 struct packet_header {
@@ -267,6 +273,10 @@ struct connection {
     const struct packet_handlers *handlers;
   } phs;
 
+  /* When not NULL, the data of the packets sent are also appended there,
+   * see conn_send_packet_stream(). */
+  struct byte_vector *packet_record;
+
 #ifdef USE_COMPRESSION
   struct {
     int frozen_level;
@@ -301,6 +311,9 @@ struct connection *conn_by_user_prefix(const char *user_name,
 struct connection *conn_by_number(int id);
 
 struct socket_packet_buffer *new_socket_packet_buffer(void);
+void socket_packet_buffer_consume(struct socket_packet_buffer *buf, int len);
+void socket_packet_buffer_prepend(struct socket_packet_buffer *buf,
+                                  const void *data, int len);
 void connection_common_init(struct connection *pconn);
 void connection_common_close(struct connection *pconn);
 void conn_set_capability(struct connection *pconn, const char *capability);
@@ -38,6 +38,7 @@
 #include "support.h"
 
 /* commmon */
+#include "capstr.h"
 #include "dataio.h"
 #include "game.h"
 #include "events.h"
@@ -47,6 +48,38 @@
 
 #ifdef USE_COMPRESSION
 #include <zlib.h>
+#ifdef FREECIV_HAVE_LIBZSTD
+#include <zstd.h>
+#endif
+#ifdef FREECIV_HAVE_LIBLZ4
+#include <lz4.h>
+#endif
+
+/*
+ * Codecs for the compressed packets. When both ends have the
+ * "compress_codec" capability, the compressed data starts with the codec
+ * (uint8) and the uncompressed size (uint32). Otherwise it is zlib data.
+ */
+enum packet_codec {
+  PACKET_CODEC_ZLIB,
+  PACKET_CODEC_ZSTD,
+  PACKET_CODEC_LZ4,
+  PACKET_CODEC_COUNT
+};
+
+#define CODEC_HEADER_SIZE       5
+
+/* Name, as used by FREECIV_COMPRESSION_CODEC, and capability of the
+ * receiving end needed to use it. */
+static const struct {
+  const char *name;
+  const char *capability;
+} packet_codecs[PACKET_CODEC_COUNT] = {
+  { "zlib", "compress_codec" },
+  { "zstd", "compress_zstd" },
+  { "lz4", "compress_lz4" }
+};
+
 /*
  * Value for the 16bit size to indicate a jumbo packet
  */
@@ -62,6 +95,11 @@
  */
 #define JUMBO_BORDER 		(64*1024-COMPRESSION_BORDER-1)
 
+/* Keep this a decent amount less than MAX_LEN_BUFFER to avoid the
+ * (remote) possibility of trying to dump MAX_LEN_BUFFER to the
+ * network in one go */
+#define MAX_LEN_COMPRESS_QUEUE (MAX_LEN_BUFFER/2)
+
 #define log_compress    log_debug
 #define log_compress2   log_debug
 
@@ -85,10 +123,36 @@ extern const char *const packet_functional_capability;
 
 static struct packet_handler_hash *packet_handlers = NULL;
 
+/* Encoded packets shared by the connections of a fan-out, see
+ * packet_fanout_begin(). A packet body only depends on the packet, the
+ * variant and the fields sent, so it is reused when they are the same.
+ * The packets are compared field by field, as the padding and the string
+ * tails of the packet structures are not initialized. */
+#define PACKET_FANOUT_SLOTS 4
+
+struct packet_fanout_slot {
+  bool valid;
+  enum packet_type type;
+  int variant;
+  size_t packet_size;
+  size_t fields_size;
+  unsigned char *key;        /* packet then fields */
+  size_t key_alloc;
+  unsigned char *body;       /* encoding, without the header */
+  size_t body_size;
+  size_t body_alloc;
+};
+
+static struct {
+  int depth;
+  int next;                  /* slot to replace */
+  struct packet_fanout_slot slots[PACKET_FANOUT_SLOTS];
+} fanout;
+
 #ifdef USE_COMPRESSION
 static int stat_size_alone = 0;
-static int stat_size_uncompressed = 0;
-static int stat_size_compressed = 0;
+static int stat_size_uncompressed[PACKET_CODEC_COUNT];
+static int stat_size_compressed[PACKET_CODEC_COUNT];
 static int stat_size_no_compression = 0;
 
 /**********************************************************************//**
@@ -110,72 +174,276 @@ static inline int get_compression_level(void)
 }
 
 /**********************************************************************//**
-  Send all waiting data. Return TRUE on success.
+  Returns the codec wanted for sending, from FREECIV_COMPRESSION_CODEC.
+  Initilialize it if needed.
 **************************************************************************/
-static bool conn_compression_flush(struct connection *pconn)
+static inline enum packet_codec get_compression_codec(void)
+{
+  static int codec = -1;        /* Magic not initialized, see below. */
+
+  if (-1 == codec) {
+    const char *s = getenv("FREECIV_COMPRESSION_CODEC");
+
+    codec = PACKET_CODEC_ZLIB;
+    if (NULL != s) {
+      int i;
+
+      for (i = 0; i < PACKET_CODEC_COUNT; i++) {
+        if (0 == fc_strcasecmp(s, packet_codecs[i].name)
+            && has_capability(packet_codecs[i].capability,
+                              our_capability)) {
+          codec = i;
+          break;
+        }
+      }
+      if (i == PACKET_CODEC_COUNT) {
+        log_error("Compression codec \"%s\" is not supported, using %s.",
+                  s, packet_codecs[PACKET_CODEC_ZLIB].name);
+      }
+    }
+  }
+
+  return codec;
+}
+
+/**********************************************************************//**
+  Returns whether the compressed data exchanged with the connection
+  starts with the codec header.
+**************************************************************************/
+static bool conn_has_codec_header(const struct connection *pconn)
+{
+  const char *cap = packet_codecs[PACKET_CODEC_ZLIB].capability;
+
+  return (has_capability(cap, pconn->capability)
+          && has_capability(cap, our_capability));
+}
+
+/**********************************************************************//**
+  Returns the maximum compressed size of 'size' bytes.
+**************************************************************************/
+static size_t packet_codec_bound(enum packet_codec codec, size_t size)
+{
+  switch (codec) {
+  case PACKET_CODEC_ZLIB:
+    return compressBound(size);
+  case PACKET_CODEC_ZSTD:
+#ifdef FREECIV_HAVE_LIBZSTD
+    return ZSTD_compressBound(size);
+#endif
+    break;
+  case PACKET_CODEC_LZ4:
+#ifdef FREECIV_HAVE_LIBLZ4
+    return LZ4_compressBound(size);
+#endif
+    break;
+  case PACKET_CODEC_COUNT:
+    break;
+  }
+
+  fc_assert_msg(FALSE, "Codec %d not supported.", codec);
+  return 0;
+}
+
+/**********************************************************************//**
+  Compress 'src' into 'dst', whose size is 'dst_size'. Returns the
+  compressed size, or 0 on failure.
+**************************************************************************/
+static size_t packet_codec_compress(enum packet_codec codec, int level,
+                                    void *dst, size_t dst_size,
+                                    const void *src, size_t src_size)
+{
+  switch (codec) {
+  case PACKET_CODEC_ZLIB:
+    {
+      uLongf size = dst_size;
+
+      if (Z_OK == compress2(dst, &size, src, src_size, level)) {
+        return size;
+      }
+    }
+    break;
+  case PACKET_CODEC_ZSTD:
+#ifdef FREECIV_HAVE_LIBZSTD
+    {
+      /* Level 0 is the zstd default. */
+      size_t size = ZSTD_compress(dst, dst_size, src, src_size,
+                                  MAX(level, 0));
+
+      if (!ZSTD_isError(size)) {
+        return size;
+      }
+    }
+#endif /* FREECIV_HAVE_LIBZSTD */
+    break;
+  case PACKET_CODEC_LZ4:
+#ifdef FREECIV_HAVE_LIBLZ4
+    {
+      /* The fast mode: the level is not used. */
+      int size = LZ4_compress_default(src, dst, src_size, dst_size);
+
+      if (size > 0) {
+        return size;
+      }
+    }
+#endif /* FREECIV_HAVE_LIBLZ4 */
+    break;
+  case PACKET_CODEC_COUNT:
+    break;
+  }
+
+  return 0;
+}
+
+/**********************************************************************//**
+  Decompress 'src' into 'dst', which must be filled exactly. Returns TRUE
+  on success.
+**************************************************************************/
+static bool packet_codec_decompress(enum packet_codec codec,
+                                    void *dst, size_t dst_size,
+                                    const void *src, size_t src_size)
+{
+  switch (codec) {
+  case PACKET_CODEC_ZLIB:
+    {
+      uLongf size = dst_size;
+
+      return (Z_OK == uncompress(dst, &size, src, src_size)
+              && size == dst_size);
+    }
+  case PACKET_CODEC_ZSTD:
+#ifdef FREECIV_HAVE_LIBZSTD
+    return ZSTD_decompress(dst, dst_size, src, src_size) == dst_size;
+#endif
+    break;
+  case PACKET_CODEC_LZ4:
+#ifdef FREECIV_HAVE_LIBLZ4
+    return (LZ4_decompress_safe(src, dst, src_size, dst_size)
+            == (int) dst_size);
+#endif
+    break;
+  case PACKET_CODEC_COUNT:
+    break;
+  }
+
+  return FALSE;
+}
+
+/**********************************************************************//**
+  Returns the codec to use for the data sent to the connection.
+**************************************************************************/
+static enum packet_codec conn_compression_codec(const struct connection *pconn)
+{
+  enum packet_codec codec = get_compression_codec();
+
+  if (conn_has_codec_header(pconn)
+      && has_capability(packet_codecs[codec].capability,
+                        pconn->capability)) {
+    return codec;
+  }
+
+  return PACKET_CODEC_ZLIB;
+}
+
+/**********************************************************************//**
+  Append to 'out' what is sent to the connection for the 'size' bytes of
+  packets in 'data': one compressed packet, or the data themselves when
+  compressing them would not pay.
+**************************************************************************/
+static void conn_compress_data(const struct connection *pconn,
+                               const unsigned char *data, size_t size,
+                               struct byte_vector *out)
 {
   int compression_level = get_compression_level();
-  uLongf compressed_size = 12 + 1.001 * pconn->compression.queue.size;
-  int error;
-  Bytef compressed[compressed_size];
+  enum packet_codec codec = conn_compression_codec(pconn);
+  int codec_header_size = (conn_has_codec_header(pconn)
+                           ? CODEC_HEADER_SIZE : 0);
+  size_t bound = packet_codec_bound(codec, size);
+  size_t old_size = byte_vector_size(out);
+  unsigned char *compressed;
+  size_t compressed_size;
   bool jumbo;
   unsigned long compressed_packet_len;
+  struct raw_data_out dout;
+
+  /* Room for the biggest header and the compressed data. */
+  byte_vector_reserve(out, old_size + 6 + codec_header_size + bound);
+  compressed = out->p + old_size + 6;
 
-  error = compress2(compressed, &compressed_size,
-                    pconn->compression.queue.p,
-                    pconn->compression.queue.size,
-                    compression_level);
-  fc_assert_ret_val(error == Z_OK, FALSE);
+  compressed_size = packet_codec_compress(codec, compression_level,
+                                          compressed + codec_header_size,
+                                          bound, data, size);
+  fc_assert_action(0 < compressed_size, compressed_size = size);
 
   /* Compression signalling currently assumes a 2-byte packet length; if that
    * changes, the protocol should probably be changed */
-  fc_assert_ret_val(data_type_size(pconn->packet_header.length) == 2, FALSE);
+  fc_assert(data_type_size(pconn->packet_header.length) == 2);
+
+  if (0 < codec_header_size) {
+    dio_output_init(&dout, compressed, codec_header_size);
+    dio_put_uint8_raw(&dout, codec);
+    dio_put_uint32_raw(&dout, size);
+    compressed_size += codec_header_size;
+  }
 
   /* Include normal length field in decision */
   jumbo = (compressed_size+2 >= JUMBO_BORDER);
 
   compressed_packet_len = compressed_size + (jumbo ? 6 : 2);
-  if (compressed_packet_len < pconn->compression.queue.size) {
-    struct raw_data_out dout;
+  if (compressed_packet_len < size) {
+    int header_size = (jumbo ? 6 : 2);
 
-    log_compress("COMPRESS: compressed %lu bytes to %ld (level %d)",
-                 (unsigned long) pconn->compression.queue.size,
-                 compressed_size, compression_level);
-    stat_size_uncompressed += pconn->compression.queue.size;
-    stat_size_compressed += compressed_size;
+    log_compress("COMPRESS: compressed %lu bytes to %lu (%s level %d)",
+                 (unsigned long) size, (unsigned long) compressed_size,
+                 packet_codecs[codec].name, compression_level);
+    stat_size_uncompressed[codec] += size;
+    stat_size_compressed[codec] += compressed_size;
 
+    /* Put the header right before the compressed data. */
+    dio_output_init(&dout, compressed - header_size, header_size);
     if (!jumbo) {
-      unsigned char header[2];
       FC_STATIC_ASSERT(COMPRESSION_BORDER > MAX_LEN_PACKET,
                        uncompressed_compressed_packet_len_overlap);
 
-      log_compress("COMPRESS: sending %ld as normal", compressed_size);
-
-      dio_output_init(&dout, header, sizeof(header));
+      log_compress("COMPRESS: sending %lu as normal",
+                   (unsigned long) compressed_size);
       dio_put_uint16_raw(&dout, 2 + compressed_size + COMPRESSION_BORDER);
-      connection_send_data(pconn, header, sizeof(header));
-      connection_send_data(pconn, compressed, compressed_size);
     } else {
-      unsigned char header[6];
       FC_STATIC_ASSERT(JUMBO_SIZE >= JUMBO_BORDER+COMPRESSION_BORDER,
                        compressed_normal_jumbo_packet_len_overlap);
 
-      log_compress("COMPRESS: sending %ld as jumbo", compressed_size);
-      dio_output_init(&dout, header, sizeof(header));
+      log_compress("COMPRESS: sending %lu as jumbo",
+                   (unsigned long) compressed_size);
       dio_put_uint16_raw(&dout, JUMBO_SIZE);
       dio_put_uint32_raw(&dout, 6 + compressed_size);
-      connection_send_data(pconn, header, sizeof(header));
-      connection_send_data(pconn, compressed, compressed_size);
     }
+    if (6 > header_size) {
+      memmove(out->p + old_size, compressed - header_size,
+              header_size + compressed_size);
+    }
+    byte_vector_reserve(out, old_size + header_size + compressed_size);
   } else {
-    log_compress("COMPRESS: would enlarge %lu bytes to %ld; "
+    log_compress("COMPRESS: would enlarge %lu bytes to %lu; "
                  "sending uncompressed",
-                 (unsigned long) pconn->compression.queue.size,
-                 compressed_packet_len);
-    connection_send_data(pconn, pconn->compression.queue.p,
-                         pconn->compression.queue.size);
-    stat_size_no_compression += pconn->compression.queue.size;
+                 (unsigned long) size, compressed_packet_len);
+    byte_vector_reserve(out, old_size + size);
+    memcpy(out->p + old_size, data, size);
+    stat_size_no_compression += size;
   }
+}
+
+/**********************************************************************//**
+  Send all waiting data. Return TRUE on success.
+**************************************************************************/
+static bool conn_compression_flush(struct connection *pconn)
+{
+  struct byte_vector out;
+
+  byte_vector_init(&out);
+  conn_compress_data(pconn, pconn->compression.queue.p,
+                     byte_vector_size(&pconn->compression.queue), &out);
+  connection_send_data(pconn, out.p, byte_vector_size(&out));
+  byte_vector_free(&out);
+
   return pconn->used;
 }
 #endif /* USE_COMPRESSION */
@@ -200,6 +468,59 @@ bool conn_compression_thaw(struct connection *pconn)
   return pconn->used;
 }
 
+/**********************************************************************//**
+  Send to the connection the packets recorded in 'packets' (see
+  connection.packet_record) with as few writes as possible. 'frames'
+  caches the form they are sent in: it is filled by the first call and
+  can then be reused for all connections with the same capabilities.
+  Returns TRUE on success.
+**************************************************************************/
+bool conn_send_packet_stream(struct connection *pconn,
+                             const struct byte_vector *packets,
+                             struct byte_vector *frames)
+{
+  const struct byte_vector *stream = packets;
+  size_t sent;
+
+#ifdef USE_COMPRESSION
+  if (0 == byte_vector_size(frames) && 0 < byte_vector_size(packets)) {
+    size_t start = 0, end = 0;
+
+    /* Compress the packets by runs that fit in the compression queue,
+     * as send_packet_data() would have. */
+    while (end < packets->size) {
+      size_t next = end + ((packets->p[end] << 8) | packets->p[end + 1]);
+
+      fc_assert_ret_val(next > end && next <= packets->size, FALSE);
+      if (next - start > MAX_LEN_COMPRESS_QUEUE) {
+        conn_compress_data(pconn, packets->p + start, end - start, frames);
+        start = end;
+      }
+      end = next;
+    }
+    conn_compress_data(pconn, packets->p + start, end - start, frames);
+  }
+  stream = frames;
+
+  /* Keep the order with what is already waiting for compression. */
+  if (0 < byte_vector_size(&pconn->compression.queue)) {
+    if (!conn_compression_flush(pconn)) {
+      return FALSE;
+    }
+    byte_vector_reserve(&pconn->compression.queue, 0);
+  }
+#endif /* USE_COMPRESSION */
+
+  for (sent = 0; sent < stream->size; sent += MAX_LEN_COMPRESS_QUEUE) {
+    if (!connection_send_data(pconn, stream->p + sent,
+                              MIN(stream->size - sent,
+                                  MAX_LEN_COMPRESS_QUEUE))) {
+      return FALSE;
+    }
+  }
+
+  return pconn->used;
+}
 
 /**********************************************************************//**
   It returns the request id of the outgoing packet (or 0 if is_server()).
@@ -226,6 +547,13 @@ int send_packet_data(struct connection *pc, unsigned char *data, int len,
     pc->outgoing_packet_notify(pc, packet_type, len, result);
   }
 
+  if (NULL != pc->packet_record) {
+    size_t old_size = byte_vector_size(pc->packet_record);
+
+    byte_vector_reserve(pc->packet_record, old_size + len);
+    memcpy(pc->packet_record->p + old_size, data, len);
+  }
+
 #ifdef USE_COMPRESSION
   if (TRUE) {
     int size = len;
@@ -233,10 +561,6 @@ int send_packet_data(struct connection *pc, unsigned char *data, int len,
     if (conn_compression_frozen(pc)) {
       size_t old_size;
 
-      /* Keep this a decent amount less than MAX_LEN_BUFFER to avoid the
-       * (remote) possibility of trying to dump MAX_LEN_BUFFER to the
-       * network in one go */
-#define MAX_LEN_COMPRESS_QUEUE (MAX_LEN_BUFFER/2)
       FC_STATIC_ASSERT(MAX_LEN_COMPRESS_QUEUE < MAX_LEN_BUFFER,
                        compress_queue_maxlen_too_big);
 
@@ -266,10 +590,16 @@ int send_packet_data(struct connection *pc, unsigned char *data, int len,
       connection_send_data(pc, data, len);
     }
 
-    log_compress2("COMPRESS: STATS: alone=%d compression-expand=%d "
-                  "compression (before/after) = %d/%d",
-                  stat_size_alone, stat_size_no_compression,
-                  stat_size_uncompressed, stat_size_compressed);
+    log_compress2("COMPRESS: STATS: alone=%d compression-expand=%d",
+                  stat_size_alone, stat_size_no_compression);
+    log_compress2("COMPRESS: STATS: zlib/zstd/lz4 (before/after) = "
+                  "%d/%d %d/%d %d/%d",
+                  stat_size_uncompressed[PACKET_CODEC_ZLIB],
+                  stat_size_compressed[PACKET_CODEC_ZLIB],
+                  stat_size_uncompressed[PACKET_CODEC_ZSTD],
+                  stat_size_compressed[PACKET_CODEC_ZSTD],
+                  stat_size_uncompressed[PACKET_CODEC_LZ4],
+                  stat_size_compressed[PACKET_CODEC_LZ4]);
   }
 #else  /* USE_COMPRESSION */
   connection_send_data(pc, data, len);
@@ -360,6 +690,157 @@ int send_packet_data(struct connection *pc, unsigned char *data, int len,
   return result;
 }
 
+/**********************************************************************//**
+  Start sending the same packets to the connections of 'dest'. Until the
+  matching packet_fanout_end(), packets which encode the same way for
+  several connections are only encoded once. Calls can be nested.
+  Returns whether a fan-out was started, to pass to packet_fanout_end().
+**************************************************************************/
+bool packet_fanout_begin(const struct conn_list *dest)
+{
+  if (conn_list_size(dest) < 2) {
+    /* Nothing to share. */
+    return FALSE;
+  }
+
+  fanout.depth++;
+
+  return TRUE;
+}
+
+/**********************************************************************//**
+  End a fan-out started with packet_fanout_begin().
+**************************************************************************/
+void packet_fanout_end(bool started)
+{
+  int i;
+
+  if (!started) {
+    return;
+  }
+
+  fc_assert_ret(fanout.depth > 0);
+
+  if (--fanout.depth == 0) {
+    for (i = 0; i < PACKET_FANOUT_SLOTS; i++) {
+      fanout.slots[i].valid = FALSE;
+    }
+  }
+}
+
+/**********************************************************************//**
+  Return the slot holding the encoding of this packet, or NULL.
+**************************************************************************/
+static struct packet_fanout_slot *
+packet_fanout_find(enum packet_type type, int variant,
+                   const void *packet, size_t packet_size,
+                   packet_equal_fn_t equal,
+                   const void *fields, size_t fields_size)
+{
+  int i;
+
+  for (i = 0; i < PACKET_FANOUT_SLOTS; i++) {
+    struct packet_fanout_slot *slot = fanout.slots + i;
+
+    if (slot->valid && slot->type == type && slot->variant == variant
+        && slot->packet_size == packet_size
+        && slot->fields_size == fields_size
+        && equal(slot->key, packet)
+        && (0 == fields_size
+            || 0 == memcmp(slot->key + packet_size, fields, fields_size))) {
+      return slot;
+    }
+  }
+
+  return NULL;
+}
+
+/**********************************************************************//**
+  If this packet was already encoded during the current fan-out, append
+  its body to 'dout' and return TRUE. Otherwise the caller encodes it and
+  calls packet_fanout_store().
+**************************************************************************/
+bool packet_fanout_lookup(struct connection *pc, struct raw_data_out *dout,
+                          enum packet_type type, int variant,
+                          const void *packet, size_t packet_size,
+                          packet_equal_fn_t equal,
+                          const void *fields, size_t fields_size)
+{
+  struct packet_fanout_slot *slot;
+
+  if (0 == fanout.depth) {
+    return FALSE;
+  }
+#ifdef FREECIV_JSON_CONNECTION
+  if (pc->json_mode) {
+    return FALSE;
+  }
+#endif /* FREECIV_JSON_CONNECTION */
+
+  slot = packet_fanout_find(type, variant, packet, packet_size, equal,
+                            fields, fields_size);
+  if (NULL == slot) {
+    return FALSE;
+  }
+
+  dio_put_memory_raw(dout, slot->body, slot->body_size);
+
+  return TRUE;
+}
+
+/**********************************************************************//**
+  Remember the body of the packet just encoded in 'dout', so other
+  connections of the current fan-out can reuse it.
+**************************************************************************/
+void packet_fanout_store(struct connection *pc, struct raw_data_out *dout,
+                         enum packet_type type, int variant,
+                         const void *packet, size_t packet_size,
+                         const void *fields, size_t fields_size)
+{
+  struct packet_fanout_slot *slot;
+  size_t header_size, used;
+
+  if (0 == fanout.depth || dout->too_short) {
+    return;
+  }
+#ifdef FREECIV_JSON_CONNECTION
+  if (pc->json_mode) {
+    return;
+  }
+#endif /* FREECIV_JSON_CONNECTION */
+
+  header_size = data_type_size(pc->packet_header.length)
+                + data_type_size(pc->packet_header.type);
+  used = dio_output_used(dout);
+  fc_assert_ret(used >= header_size);
+
+  slot = fanout.slots + fanout.next;
+  fanout.next = (fanout.next + 1) % PACKET_FANOUT_SLOTS;
+
+  if (slot->key_alloc < packet_size + fields_size) {
+    slot->key_alloc = packet_size + fields_size;
+    slot->key = fc_realloc(slot->key, slot->key_alloc);
+  }
+  memcpy(slot->key, packet, packet_size);
+  if (0 < fields_size) {
+    memcpy(slot->key + packet_size, fields, fields_size);
+  }
+
+  slot->body_size = used - header_size;
+  if (slot->body_alloc < slot->body_size) {
+    slot->body_alloc = slot->body_size;
+    slot->body = fc_realloc(slot->body, slot->body_alloc);
+  }
+  memcpy(slot->body, (unsigned char *) dout->dest + header_size,
+         slot->body_size);
+
+  slot->type = type;
+  slot->variant = variant;
+  slot->packet_size = packet_size;
+  slot->fields_size = fields_size;
+  slot->valid = TRUE;
+}
+
 /**********************************************************************//**
   Read and return a packet from the connection 'pc'. The type of the
   packet is written in 'ptype'. On error, the connection is closed and
@@ -436,62 +917,82 @@ void *get_packet_from_connection_raw(struct connection *pc,
 
   if (compressed_packet) {
     uLong compressed_size = whole_packet_len - header_size;
-    int decompress_factor = 80;
-    unsigned long int decompressed_size = decompress_factor * compressed_size;
-    int error = Z_DATA_ERROR;
+    unsigned long int decompressed_size;
     struct socket_packet_buffer *buffer = pc->buffer;
-    void *decompressed = fc_malloc(decompressed_size);
-
-    do {
-      error =
-        uncompress(decompressed, &decompressed_size,
-                   ADD_TO_POINTER(buffer->data, header_size),
-                   compressed_size);
-
-      if (error == Z_DATA_ERROR) {
-        decompress_factor += 50;
-        decompressed_size = decompress_factor * compressed_size;
-        decompressed = fc_realloc(decompressed, decompressed_size);
+    void *decompressed;
+
+    if (conn_has_codec_header(pc)) {
+      struct data_in codec_din;
+      int codec, size;
+
+      dio_input_init(&codec_din, ADD_TO_POINTER(buffer->data, header_size),
+                     compressed_size);
+      if (!dio_get_uint8_raw(&codec_din, &codec)
+          || !dio_get_uint32_raw(&codec_din, &size)
+          || codec >= PACKET_CODEC_COUNT
+          || size <= 0 || size > MAX_LEN_BUFFER) {
+        log_verbose("Invalid compressed packet header. "
+                    "The connection will be closed now.");
+        connection_close(pc, _("decoding error"));
+        return NULL;
       }
 
-      if (error != Z_OK) {
-        if (error != Z_DATA_ERROR || decompress_factor > MAX_DECOMPRESSION ) {
-          log_verbose("Uncompressing of the packet stream failed. "
-                      "The connection will be closed now.");
-          connection_close(pc, _("decoding error"));
-          return NULL;
-        }
+      decompressed_size = size;
+      decompressed = fc_malloc(decompressed_size);
+      if (!packet_codec_decompress(codec, decompressed, decompressed_size,
+                                   ADD_TO_POINTER(buffer->data,
+                                                  header_size
+                                                  + CODEC_HEADER_SIZE),
+                                   compressed_size - CODEC_HEADER_SIZE)) {
+        log_verbose("Uncompressing of the packet stream (%s) failed. "
+                    "The connection will be closed now.",
+                    packet_codecs[codec].name);
+        free(decompressed);
+        connection_close(pc, _("decoding error"));
+        return NULL;
       }
+    } else {
+      int decompress_factor = 80;
+      int error = Z_DATA_ERROR;
+
+      decompressed_size = decompress_factor * compressed_size;
+      decompressed = fc_malloc(decompressed_size);
+
+      do {
+        error =
+          uncompress(decompressed, &decompressed_size,
+                     ADD_TO_POINTER(buffer->data, header_size),
+                     compressed_size);
+
+        if (error == Z_DATA_ERROR) {
+          decompress_factor += 50;
+          decompressed_size = decompress_factor * compressed_size;
+          decompressed = fc_realloc(decompressed, decompressed_size);
+        }
 
-    } while (error != Z_OK);
-
-    buffer->ndata -= whole_packet_len;
-    /* 
-     * Remove the packet with the compressed data and shift all the
-     * remaining data to the front. 
-     */
-    memmove(buffer->data, buffer->data + whole_packet_len, buffer->ndata);
+        if (error != Z_OK) {
+          if (error != Z_DATA_ERROR
+              || decompress_factor > MAX_DECOMPRESSION ) {
+            log_verbose("Uncompressing of the packet stream failed. "
+                        "The connection will be closed now.");
+            free(decompressed);
+            connection_close(pc, _("decoding error"));
+            return NULL;
+          }
+        }
 
-    if (buffer->ndata + decompressed_size > buffer->nsize) {
-      buffer->nsize += decompressed_size;
-      buffer->data = fc_realloc(buffer->data, buffer->nsize);
+      } while (error != Z_OK);
     }
 
     /*
-     * Make place for the uncompressed data by moving the remaining
-     * data.
-     */
-    memmove(buffer->data + decompressed_size, buffer->data, buffer->ndata);
-
-    /* 
-     * Copy the uncompressed data.
+     * Replace the packet with the compressed data by the uncompressed
+     * data, in front of the remaining data.
      */
-    memcpy(buffer->data, decompressed, decompressed_size);
+    socket_packet_buffer_consume(buffer, whole_packet_len);
+    socket_packet_buffer_prepend(buffer, decompressed, decompressed_size);
 
     free(decompressed);
 
-    buffer->ndata += decompressed_size;
-    
     log_compress("COMPRESS: decompressed %ld into %ld",
                  compressed_size, decompressed_size);
 
@@ -596,8 +1097,7 @@ void remove_packet_from_buffer(struct socket_packet_buffer *buffer)
 
   dio_input_init(&din, buffer->data, buffer->ndata);
   dio_get_uint16_raw(&din, &len);
-  memmove(buffer->data, buffer->data + len, buffer->ndata - len);
-  buffer->ndata -= len;
+  socket_packet_buffer_consume(buffer, len);
   log_debug("remove_packet_from_buffer: remove %d; remaining %d",
             len, buffer->ndata);
 }
@@ -880,5 +1380,13 @@ const struct packet_handlers *packet_handlers_get(const char *capability)
 **************************************************************************/
 void packets_deinit(void)
 {
+  int i;
+
   packet_handlers_free();
+
+  for (i = 0; i < PACKET_FANOUT_SLOTS; i++) {
+    free(fanout.slots[i].key);
+    free(fanout.slots[i].body);
+  }
+  memset(&fanout, 0, sizeof(fanout));
 }
@@ -19,6 +19,7 @@ extern "C" {
 
 struct connection;
 struct data_in;
+struct raw_data_out;
 
 /* utility */
 #include "shared.h"		/* MAX_LEN_ADDR */
@@ -161,6 +162,9 @@ void packets_deinit(void);
     return send_packet_data(pc, buffer, size, packet_type); \
   }
 
+/* The raw output of the packet being sent. */
+#define SEND_PACKET_RAW_OUT (&dout)
+
 #define RECEIVE_PACKET_START(packet_type, result) \
   struct data_in din; \
   struct packet_type packet_buf, *result = &packet_buf; \
@@ -194,6 +198,24 @@ void packets_deinit(void);
 int send_packet_data(struct connection *pc, unsigned char *data, int len,
                      enum packet_type packet_type);
 bool packet_check(struct data_in *din, struct connection *pc);
+bool conn_send_packet_stream(struct connection *pconn,
+                             const struct byte_vector *packets,
+                             struct byte_vector *frames);
+
+/* Whether two packets of the same variant are encoded the same way. */
+typedef bool (*packet_equal_fn_t)(const void *packet1, const void *packet2);
+
+bool packet_fanout_begin(const struct conn_list *dest);
+void packet_fanout_end(bool started);
+bool packet_fanout_lookup(struct connection *pc, struct raw_data_out *dout,
+                          enum packet_type type, int variant,
+                          const void *packet, size_t packet_size,
+                          packet_equal_fn_t equal,
+                          const void *fields, size_t fields_size);
+void packet_fanout_store(struct connection *pc, struct raw_data_out *dout,
+                         enum packet_type type, int variant,
+                         const void *packet, size_t packet_size,
+                         const void *fields, size_t fields_size);
 
 /* Utilities to exchange strings and string vectors. */
 #define PACKET_STRVEC_SEPARATOR '\3'
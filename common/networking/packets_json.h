@@ -67,6 +67,9 @@ void *get_packet_from_connection_json(struct connection *pc,
     return send_packet_data(pc, buffer, size, packet_type);             \
   }
 
+/* The raw output of the packet being sent. Not used by the json mode. */
+#define SEND_PACKET_RAW_OUT (&dout.raw)
+
 #define RECEIVE_PACKET_START(packet_type, result)       \
   struct packet_type packet_buf, *result = &packet_buf; \
   struct data_in din;                                   \
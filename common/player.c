@@ -588,6 +588,7 @@ static void player_defaults(struct player *pplayer)
   for (i = 0; i < B_LAST; i++) {
     pplayer->wonders[i] = WONDER_NOT_BUILT;
   }
+  req_cache_invalidate();
 
   pplayer->attribute_block.data = NULL;
   pplayer->attribute_block.length = 0;
@@ -740,7 +741,9 @@ void player_destroy(struct player *pplayer)
 
   dbv_free(&pplayer->tile_known);
 
-  if (!is_server()) {
+  if (is_server()) {
+    player_known_continents_invalidate(pplayer);
+  } else {
     vision_layer_iterate(v) {
       dbv_free(&pplayer->client.tile_vision[v]);
     } vision_layer_iterate_end;
@@ -810,6 +813,7 @@ bool player_set_nation(struct player *pplayer, struct nation_type *pnation)
       pnation->player = pplayer;
     }
     pplayer->nation = pnation;
+    req_cache_invalidate();
     return TRUE;
   }
   return FALSE;
@@ -1183,6 +1187,53 @@ bool player_in_city_map(const struct player *pplayer,
   return FALSE;
 }
 
+/*******************************************************************//**
+  Return the number of continents on which the player knows at least one
+  tile. Server only. The result is kept until the continent numbers
+  change or the player forgets some tile.
+***********************************************************************/
+int player_known_continents(struct player *pplayer)
+{
+  fc_assert_ret_val(is_server(), 0);
+
+  if (pplayer->server.known_continents == NULL) {
+    int size = wld.map.num_continents;
+
+    pplayer->server.known_continents
+      = fc_calloc(MAX(1, size), sizeof(*pplayer->server.known_continents));
+    pplayer->server.known_continents_size = size;
+    pplayer->server.known_continents_count = 0;
+
+    if (pplayer->tile_known.vec == NULL) {
+      return 0;
+    }
+
+    dbv_set_bits_iterate(&pplayer->tile_known, idx) {
+      Continent_id cont = tile_continent(index_to_tile(&(wld.map), idx));
+
+      if (cont > 0 && cont <= size
+          && !pplayer->server.known_continents[cont - 1]) {
+        pplayer->server.known_continents[cont - 1] = TRUE;
+        pplayer->server.known_continents_count++;
+      }
+    } dbv_set_bits_iterate_end;
+  }
+
+  return pplayer->server.known_continents_count;
+}
+
+/*******************************************************************//**
+  Make player_known_continents() rebuild its data on next call. Needed
+  when the continent numbers change, or when the player forgets tiles.
+***********************************************************************/
+void player_known_continents_invalidate(struct player *pplayer)
+{
+  if (pplayer->server.known_continents != NULL) {
+    free(pplayer->server.known_continents);
+    pplayer->server.known_continents = NULL;
+  }
+}
+
 /*******************************************************************//**
   Returns the number of techs the player has researched which has this
   flag. Needs to be optimized later (e.g. int tech_flags[TF_COUNT] in
@@ -312,7 +312,11 @@ struct player {
                             * city. Once set, never becomes unset.
                             * (Previously 'capital'.) */
 
-      struct player_tile *private_map;
+      struct player_map *private_map; /* see server/maphand.c */
+      /* Tiles the player sees with its own units, cities and borders on
+       * the main or invisible layer, i.e. those that shared vision gives
+       * to others. Kept by map_change_own_seen(). */
+      struct dbv own_seen_tiles;
 
       /* Player can see inside his borders. */
       bool border_vision;
@@ -339,6 +343,15 @@ struct player {
 
       int huts; /* How many huts this player has found */
 
+      /* Number of tiles set in tile_known. */
+      int known_tiles;
+      /* Continents with at least one known tile, indexed by continent
+       * number - 1, and their count. NULL when it has to be rebuilt from
+       * tile_known, see player_known_continents(). */
+      bool *known_continents;
+      int known_continents_size;
+      int known_continents_count;
+
       int bulbs_last_turn; /* Number of bulbs researched last turn only. */
     } server;
 
@@ -346,7 +359,7 @@ struct player {
       /* Only used at the client (the server is omniscient; ./client/). */
 
       /* Corresponds to the result of
-         (player:server:private_map[tile_index]:seen_count[vlayer] != 0). */
+         (map_get_seen(player, tile, vlayer) != 0) at the server. */
       struct dbv tile_vision[V_COUNT];
 
       enum mood_type mood;
@@ -436,6 +449,8 @@ struct unit *player_unit_by_number(const struct player *pplayer,
 
 bool player_in_city_map(const struct player *pplayer,
                         const struct tile *ptile);
+int player_known_continents(struct player *pplayer);
+void player_known_continents_invalidate(struct player *pplayer);
 bool player_knows_techs_with_flag(const struct player *pplayer,
 				  enum tech_flag_id flag);
 int num_known_tech_with_flag(const struct player *pplayer,
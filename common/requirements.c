@@ -46,6 +46,30 @@ typedef enum req_item_found (*universal_found)(const struct requirement *,
                                                const struct universal *);
 static universal_found universal_found_function[VUT_COUNT] = {NULL};
 
+/************************************************************************
+  Cache of the evaluation of the requirements which only depend on the
+  target player and on the state of the world, for the kinds whose
+  evaluation is not trivial. Every entry remembers the version of the
+  cache at the time it was computed, so it is enough to bump the version
+  when the state they depend on changes (see req_cache_invalidate()).
+************************************************************************/
+struct req_cache_entry {
+  unsigned int version;
+  enum fc_tristate eval;
+};
+
+struct req_cache_player {
+  /* Indexed by building, then [range is World][survives]. */
+  struct req_cache_entry buildings[B_LAST][2][2];
+  struct req_cache_entry nation_groups[MAX_NUM_NATION_GROUPS];
+};
+
+static struct {
+  unsigned int version;
+  bool readonly; /* see req_cache_set_readonly() */
+  struct req_cache_player *players[MAX_NUM_PLAYER_SLOTS];
+} req_cache = { .version = 1 };
+
 /**********************************************************************//**
   Parse requirement type (kind) and value strings into a universal
   structure.  Passing in a NULL type is considered VUT_NONE (not an error).
@@ -2862,6 +2886,96 @@ is_achievement_in_range(const struct player *target_player,
   return TRI_MAYBE;
 }
 
+/**********************************************************************//**
+  Return the cache entry of the requirement for the target player, or
+  NULL if this requirement is not cached.
+**************************************************************************/
+static struct req_cache_entry *
+req_cache_entry(const struct player *target_player,
+                const struct requirement *req)
+{
+  struct req_cache_player *pcache;
+
+  if (target_player == NULL) {
+    return NULL;
+  }
+
+  switch (req->source.kind) {
+  case VUT_IMPROVEMENT:
+    /* The obsolescence of the building is checked first, it must not
+     * depend on the target city. */
+    if ((req->range != REQ_RANGE_PLAYER && req->range != REQ_RANGE_WORLD)
+        || !req->source.value.building->player_obsolescence) {
+      return NULL;
+    }
+    break;
+  case VUT_NATIONGROUP:
+    if (req->range != REQ_RANGE_PLAYER) {
+      return NULL;
+    }
+    break;
+  default:
+    return NULL;
+  }
+
+  pcache = req_cache.players[player_index(target_player)];
+  if (pcache == NULL) {
+    if (req_cache.readonly) {
+      return NULL;
+    }
+    pcache = fc_calloc(1, sizeof(*pcache));
+    req_cache.players[player_index(target_player)] = pcache;
+  }
+
+  if (req->source.kind == VUT_IMPROVEMENT) {
+    return &pcache->buildings[improvement_index(req->source.value.building)]
+                             [req->range == REQ_RANGE_WORLD]
+                             [req->survives ? 1 : 0];
+  } else {
+    return &pcache->nation_groups[nation_group_index(
+                                      req->source.value.nationgroup)];
+  }
+}
+
+/**********************************************************************//**
+  Invalidate the whole requirement cache. This must be called when the
+  state the cached requirements depend on changes: the techs known by a
+  player, the wonders built, the nation or the team of a player...
+**************************************************************************/
+void req_cache_invalidate(void)
+{
+  req_cache.version++;
+  if (req_cache.version == 0) {
+    /* Wrapped: 0 is the version of the unused entries. */
+    req_cache_free();
+  }
+}
+
+/**********************************************************************//**
+  While the cache is read-only, the requirements are still looked up in
+  it but the new evaluations are not stored. This makes is_req_active()
+  safe to call from several threads at once, as long as nothing else
+  changes.
+**************************************************************************/
+void req_cache_set_readonly(bool readonly)
+{
+  req_cache.readonly = readonly;
+}
+
+/**********************************************************************//**
+  Free the requirement cache.
+**************************************************************************/
+void req_cache_free(void)
+{
+  int i;
+
+  for (i = 0; i < ARRAY_SIZE(req_cache.players); i++) {
+    free(req_cache.players[i]);
+    req_cache.players[i] = NULL;
+  }
+  req_cache.version = 1;
+}
+
 /**********************************************************************//**
   Checks the requirement to see if it is active on the given target.
 
@@ -2886,6 +3000,7 @@ bool is_req_active(const struct player *target_player,
                    const struct requirement *req,
                    const enum   req_problem_type prob_type)
 {
+  struct req_cache_entry *pentry = NULL;
   enum fc_tristate eval = TRI_NO;
 
   /* The supplied unit has a type. Use it if the unit type is missing. */
@@ -2930,6 +3045,11 @@ bool is_req_active(const struct player *target_player,
     }
     break;
   case VUT_IMPROVEMENT:
+    pentry = req_cache_entry(target_player, req);
+    if (pentry != NULL && pentry->version == req_cache.version) {
+      eval = pentry->eval;
+      break;
+    }
     eval = is_building_in_range(target_player, target_city,
                                 target_building,
                                 req->range, req->survives,
@@ -2966,6 +3086,11 @@ bool is_req_active(const struct player *target_player,
                               req->source.value.nation);
     break;
   case VUT_NATIONGROUP:
+    pentry = req_cache_entry(target_player, req);
+    if (pentry != NULL && pentry->version == req_cache.version) {
+      eval = pentry->eval;
+      break;
+    }
     eval = is_nation_group_in_range(target_player, req->range, req->survives,
                                     req->source.value.nationgroup);
     break;
@@ -3221,6 +3346,11 @@ bool is_req_active(const struct player *target_player,
     return FALSE;
   }
 
+  if (pentry != NULL && !req_cache.readonly) {
+    pentry->version = req_cache.version;
+    pentry->eval = eval;
+  }
+
   if (eval == TRI_MAYBE) {
     if (prob_type == RPT_POSSIBLE) {
       return TRUE;
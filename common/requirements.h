@@ -133,6 +133,10 @@ bool are_reqs_active(const struct player *target_player,
                      const struct requirement_vector *reqs,
                      const enum   req_problem_type prob_type);
 
+void req_cache_invalidate(void);
+void req_cache_set_readonly(bool readonly);
+void req_cache_free(void);
+
 bool is_req_unchanging(const struct requirement *req);
 
 bool is_req_in_vec(const struct requirement *req,
@@ -522,6 +522,9 @@ void research_update(struct research *presearch)
   enum tech_flag_id flag;
   int techs_researched;
 
+  /* Some techs may have been set as known directly. */
+  req_cache_invalidate();
+
   advance_index_iterate(A_FIRST, i) {
     enum tech_state state = presearch->inventions[i].state;
     bool root_reqs_known = TRUE;
@@ -656,6 +659,7 @@ enum tech_state research_invention_set(struct research *presearch,
     return old;
   }
   presearch->inventions[tech].state = value;
+  req_cache_invalidate();
 
   if (value == TECH_KNOWN) {
     if (!game.info.global_advances[tech]) {
@@ -483,6 +483,7 @@ void team_add_player(struct player *pplayer, struct team *pteam)
   /* Put the player on the new team. */
   pplayer->team = pteam;
   player_list_append(pteam->plrlist, pplayer);
+  req_cache_invalidate();
 }
 
 /************************************************************************//**
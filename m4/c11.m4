@@ -13,6 +13,19 @@ AC_DEFUN([FC_C11_STATIC_ASSERT],
   fi
 ])
 
+# Check for C11 _Thread_local
+#
+AC_DEFUN([FC_C11_THREAD_LOCAL],
+[
+  AC_CACHE_CHECK([for C11 thread local storage], [ac_cv_c11_thread_local],
+    [AC_LINK_IFELSE([AC_LANG_PROGRAM([[static _Thread_local int tl_var;
+]], [[ tl_var = 1; return tl_var - 1; ]])],
+[ac_cv_c11_thread_local=yes], [ac_cv_c11_thread_local=no])])
+  if test "x${ac_cv_c11_thread_local}" = "xyes" ; then
+    AC_DEFINE([HAVE_C11_THREAD_LOCAL], [1], [C11 _Thread_local supported])
+  fi
+])
+
 AC_DEFUN([FC_STATIC_STRLEN],
 [
   AC_REQUIRE([FC_C11_STATIC_ASSERT])
@@ -854,9 +854,7 @@ void adv_best_government(struct player *pplayer)
         /* Ideally we should change tax rates here, but since
          * this is a rather big CPU operation, we'd rather not. */
         check_player_max_rates(pplayer);
-        city_list_iterate(pplayer->cities, acity) {
-          auto_arrange_workers(acity);
-        } city_list_iterate_end;
+        auto_arrange_workers_for_player(pplayer);
         city_list_iterate(pplayer->cities, pcity) {
           val += adv_eval_calc_city(pcity, adv);
         } city_list_iterate_end;
@@ -992,9 +990,7 @@ void adv_best_government(struct player *pplayer)
     } governments_iterate_end;
     /* Now reset our gov to it's real state. */
     pplayer->government = current_gov;
-    city_list_iterate(pplayer->cities, acity) {
-      auto_arrange_workers(acity);
-    } city_list_iterate_end;
+    auto_arrange_workers_for_player(pplayer);
     if (player_is_cpuhog(pplayer)) {
       adv->govt_reeval = 1;
     } else {
@@ -2575,7 +2575,8 @@ bool update_dumb_city(struct player *pplayer, struct city *pcity)
 
   if (NULL == pdcity) {
     pdcity = vision_site_new_from_city(pcity);
-    change_playertile_site(map_get_player_tile(pcenter, pplayer), pdcity);
+    change_playertile_site(map_get_player_tile_writable(pcenter, pplayer),
+                           pdcity);
   } else if (pdcity->location != pcenter) {
     log_error("Trying to update bad city (wrong location) "
               "at %i,%i for player %s",
@@ -2626,7 +2627,8 @@ void reality_check_city(struct player *pplayer, struct tile *ptile)
     struct city *pcity = tile_city(ptile);
 
     if (!pcity || pcity->id != pdcity->identity) {
-      struct player_tile *playtile = map_get_player_tile(ptile, pplayer);
+      struct player_tile *playtile = map_get_player_tile_writable(ptile,
+                                                                  pplayer);
 
       dlsend_packet_city_remove(pplayer->connections, pdcity->identity);
       fc_assert_ret(playtile->site == pdcity);
@@ -2644,7 +2646,8 @@ void remove_dumb_city(struct player *pplayer, struct tile *ptile)
   struct vision_site *pdcity = map_get_player_city(ptile, pplayer);
 
   if (pdcity) {
-    struct player_tile *playtile = map_get_player_tile(ptile, pplayer);
+    struct player_tile *playtile = map_get_player_tile_writable(ptile,
+                                                                pplayer);
 
     dlsend_packet_city_remove(pplayer->connections, pdcity->identity);
     fc_assert_ret(playtile->site == pdcity);
@@ -3175,6 +3178,19 @@ void refresh_player_cities_vision(struct player *pplayer)
   } city_list_iterate_end;
 }
 
+/************************************************************************//**
+  Return the squared city radius the city should have, according to the
+  effects. See city_map_update_radius_sq().
+****************************************************************************/
+int city_map_radius_sq_wanted(const struct city *pcity)
+{
+  int radius_sq = game.info.init_city_radius_sq
+                  + get_city_bonus(pcity, EFT_CITY_RADIUS_SQ);
+
+  /* check minimum / maximum allowed city radii */
+  return CLIP(CITY_MAP_MIN_RADIUS_SQ, radius_sq, CITY_MAP_MAX_RADIUS_SQ);
+}
+
 /************************************************************************//**
   Updates the squared city radius. Returns if the radius is changed.
 ****************************************************************************/
@@ -3185,12 +3201,7 @@ bool city_map_update_radius_sq(struct city *pcity)
 
   int city_tiles_old, city_tiles_new;
   int city_radius_sq_old = city_map_radius_sq_get(pcity);
-  int city_radius_sq_new = game.info.init_city_radius_sq
-                           + get_city_bonus(pcity, EFT_CITY_RADIUS_SQ);
-
-  /* check minimum / maximum allowed city radii */
-  city_radius_sq_new = CLIP(CITY_MAP_MIN_RADIUS_SQ, city_radius_sq_new,
-                            CITY_MAP_MAX_RADIUS_SQ);
+  int city_radius_sq_new = city_map_radius_sq_wanted(pcity);
 
   if (city_radius_sq_new == city_radius_sq_old) {
     /* no change */
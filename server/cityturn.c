@@ -22,6 +22,7 @@
 
 /* utility */
 #include "fcintl.h"
+#include "fcthreadpool.h"
 #include "log.h"
 #include "mem.h"
 #include "rand.h"
@@ -45,6 +46,7 @@
 #include "government.h"
 #include "map.h"
 #include "player.h"
+#include "requirements.h"
 #include "research.h"
 #include "road.h"
 #include "server_settings.h"
@@ -201,16 +203,117 @@ void city_refresh_queue_add(struct city *pcity)
   pcity->server.needs_refresh = TRUE;
 }
 
+/**********************************************************************//**
+  Refresh one city of a group, from one of the threads of the pool.
+**************************************************************************/
+static void city_refresh_task(int index, void *data)
+{
+  struct city *pcity = ((struct city **) data)[index];
+
+  city_refresh_from_main_map(pcity, NULL);
+}
+
+/**********************************************************************//**
+  Refresh the queued cities with the threads of 'pool', the same way as
+  calling city_refresh() for each city in turn. Returns FALSE, having
+  done nothing, if a city radius changes: its workers would then have to
+  be arranged in between.
+
+  Only city_refresh_from_main_map() runs in parallel. It reads the trade
+  partners of the city, so a city goes in the group after all its
+  partners earlier in the queue. The result doesn't depend on the number
+  of threads.
+**************************************************************************/
+static bool city_refresh_queue_parallel(struct fc_threadpool *pool)
+{
+  struct city **order, **tasks;
+  int *group;
+  int ncities = 0, ngroups = 0;
+  int i, j, g;
+
+  city_list_iterate(city_refresh_queue, pcity) {
+    if (pcity->server.needs_refresh) {
+      if (city_map_tiles(city_map_radius_sq_wanted(pcity))
+          != city_map_tiles(city_map_radius_sq_get(pcity))) {
+        return FALSE;
+      }
+      ncities++;
+    }
+  } city_list_iterate_end;
+
+  if (ncities < 2) {
+    return FALSE;
+  }
+
+  order = fc_malloc(ncities * sizeof(*order));
+  group = fc_malloc(ncities * sizeof(*group));
+  i = 0;
+  city_list_iterate(city_refresh_queue, pcity) {
+    if (!pcity->server.needs_refresh) {
+      continue;
+    }
+
+    /* The upkeep is read by city_support(), not the other way round. */
+    pcity->server.needs_refresh = FALSE;
+    city_units_upkeep(pcity);
+
+    g = 0;
+    for (j = 0; j < i; j++) {
+      if (group[j] >= g && have_cities_trade_route(pcity, order[j])) {
+        g = group[j] + 1;
+      }
+    }
+    order[i] = pcity;
+    group[i] = g;
+    ngroups = MAX(ngroups, g + 1);
+    i++;
+  } city_list_iterate_end;
+
+  tasks = fc_malloc(ncities * sizeof(*tasks));
+  req_cache_set_readonly(TRUE);
+  for (g = 0; g < ngroups; g++) {
+    int ntasks = 0;
+
+    for (i = 0; i < ncities; i++) {
+      if (group[i] == g) {
+        tasks[ntasks++] = order[i];
+      }
+    }
+    fc_threadpool_run(pool, ntasks, city_refresh_task, tasks);
+  }
+  req_cache_set_readonly(FALSE);
+
+  for (i = 0; i < ncities; i++) {
+    city_style_refresh(order[i]);
+    send_city_info(city_owner(order[i]), order[i]);
+  }
+
+  free(tasks);
+  free(order);
+  free(group);
+
+  return TRUE;
+}
+
 /**********************************************************************//**
   Refresh the listed cities.
   Called after significant changes to borders, and arranging workers.
 **************************************************************************/
 void city_refresh_queue_processing(void)
 {
+  struct fc_threadpool *pool = srv_threadpool();
+
   if (NULL == city_refresh_queue) {
     return;
   }
 
+  if (fc_threadpool_size(pool) > 1
+      && city_refresh_queue_parallel(pool)) {
+    city_list_destroy(city_refresh_queue);
+    city_refresh_queue = NULL;
+    return;
+  }
+
   city_list_iterate(city_refresh_queue, pcity) {
     if (pcity->server.needs_refresh) {
       if (city_refresh(pcity)) {
@@ -350,21 +453,10 @@ static void set_default_city_manager(struct cm_parameter *cmp,
 }
 
 /**********************************************************************//**
-  Call sync_cities() to send the affected cities to the clients.
+  First step of auto_arrange_workers(): make sure the city is up to date.
 **************************************************************************/
-void auto_arrange_workers(struct city *pcity)
+static void arrange_workers_prepare(struct city *pcity)
 {
-  struct cm_parameter cmp;
-  struct cm_result *cmr;
-
-  /* See comment in freeze_workers(): we can't rearrange while
-   * workers are frozen (i.e. multiple updates need to be done). */
-  if (pcity->server.workers_frozen > 0) {
-    pcity->server.needs_arrange = TRUE;
-    return;
-  }
-  TIMING_LOG(AIT_CITIZEN_ARRANGE, TIMER_START);
-
   /* Freeze the workers and make sure all the tiles around the city
    * are up to date.  Then thaw, but hackishly make sure that thaw
    * doesn't call us recursively, which would waste time. */
@@ -380,7 +472,18 @@ void auto_arrange_workers(struct city *pcity)
   city_refresh(pcity);
 
   sanity_check_city(pcity);
-  cm_clear_cache(pcity);
+}
+
+/**********************************************************************//**
+  Second step of auto_arrange_workers(): find the arrangement. This only
+  changes the city itself, so it can be done for several independent
+  cities at once. 'released' is set if the parameter of the player had
+  to be dropped.
+**************************************************************************/
+static void arrange_workers_solve(struct city *pcity, struct cm_result *cmr,
+                                  bool *released)
+{
+  struct cm_parameter cmp;
 
   cm_init_parameter(&cmp);
 
@@ -390,9 +493,6 @@ void auto_arrange_workers(struct city *pcity)
     set_default_city_manager(&cmp, pcity);
   }
 
-  /* This must be after city_refresh() so that the result gets created for the right
-   * city radius */
-  cmr = cm_result_new(pcity);
   cm_query_result(pcity, &cmp, cmr, FALSE);
 
   if (!cmr->found_a_valid) {
@@ -400,12 +500,7 @@ void auto_arrange_workers(struct city *pcity)
       /* If player-defined parameters fail, cancel and notify player. */
       free(pcity->cm_parameter);
       pcity->cm_parameter = NULL;
-
-      notify_player(city_owner(pcity), city_tile(pcity),
-                    E_CITY_CMA_RELEASE, ftc_server,
-                    _("The citizen governor can't fulfill the requirements "
-                     "for %s. Passing back control."),
-                    city_link(pcity));
+      *released = TRUE;
     }
     /* Drop surpluses and try again. */
     cmp.minimal_surplus[O_FOOD] = 0;
@@ -430,6 +525,23 @@ void auto_arrange_workers(struct city *pcity)
     cm_init_emergency_parameter(&cmp);
     cm_query_result(pcity, &cmp, cmr, TRUE);
   }
+}
+
+/**********************************************************************//**
+  Last step of auto_arrange_workers(): put the workers in place.
+**************************************************************************/
+static void arrange_workers_apply(struct city *pcity,
+                                  const struct cm_result *cmr,
+                                  bool released)
+{
+  if (released) {
+    notify_player(city_owner(pcity), city_tile(pcity),
+                  E_CITY_CMA_RELEASE, ftc_server,
+                  _("The citizen governor can't fulfill the requirements "
+                    "for %s. Passing back control."),
+                  city_link(pcity));
+  }
+
   fc_assert_ret(cmr->found_a_valid);
 
   apply_cmresult_to_city(pcity, cmr);
@@ -447,11 +559,196 @@ void auto_arrange_workers(struct city *pcity)
      * by trying to arrange workers more. */
   }
   sanity_check_city(pcity);
+}
+
+/**********************************************************************//**
+  Call sync_cities() to send the affected cities to the clients.
+**************************************************************************/
+void auto_arrange_workers(struct city *pcity)
+{
+  struct cm_result *cmr;
+  bool released = FALSE;
+
+  /* See comment in freeze_workers(): we can't rearrange while
+   * workers are frozen (i.e. multiple updates need to be done). */
+  if (pcity->server.workers_frozen > 0) {
+    pcity->server.needs_arrange = TRUE;
+    return;
+  }
+  TIMING_LOG(AIT_CITIZEN_ARRANGE, TIMER_START);
+
+  arrange_workers_prepare(pcity);
+
+  /* This must be after city_refresh() so that the result gets created for the right
+   * city radius */
+  cmr = cm_result_new(pcity);
+  arrange_workers_solve(pcity, cmr, &released);
+  arrange_workers_apply(pcity, cmr, released);
 
   cm_result_destroy(cmr);
   TIMING_LOG(AIT_CITIZEN_ARRANGE, TIMER_STOP);
 }
 
+/* A city arranged together with others, see
+ * auto_arrange_workers_for_player(). */
+struct arrange_task {
+  struct city *pcity;
+  struct cm_result *cmr;
+  bool released;
+};
+
+/**********************************************************************//**
+  Solve one city of a group, from one of the threads of the pool.
+**************************************************************************/
+static void arrange_task_solve(int index, void *data)
+{
+  struct arrange_task *task = (struct arrange_task *) data + index;
+
+  arrange_workers_solve(task->pcity, task->cmr, &task->released);
+}
+
+/**********************************************************************//**
+  Return whether arranging the workers of these cities can change the map
+  other than by moving their own workers: this happens when a city radius
+  changes, or when a tile is worked by a city which can't work it any
+  more.
+**************************************************************************/
+static bool arrange_workers_changes_map(const struct city_list *cities)
+{
+  city_list_iterate(cities, pcity) {
+    int radius_sq = city_map_radius_sq_get(pcity);
+
+    if (city_map_tiles(city_map_radius_sq_wanted(pcity))
+        != city_map_tiles(radius_sq)) {
+      return TRUE;
+    }
+
+    city_tile_iterate_skip_free_worked(radius_sq, city_tile(pcity),
+                                       ptile, idx, x, y) {
+      struct city *pwork = tile_worked(ptile);
+
+      if (NULL != pwork
+          && !is_free_worked(pwork, ptile)
+          && !city_can_work_tile(pwork, ptile)) {
+        return TRUE;
+      }
+    } city_tile_iterate_skip_free_worked_end;
+  } city_list_iterate_end;
+
+  return FALSE;
+}
+
+/**********************************************************************//**
+  Arrange the workers of all the cities of the player, the same way as
+  calling auto_arrange_workers() for each city in turn.
+
+  The cities are split in groups: a city goes in the first group after
+  all the previous cities it depends on, that is the cities whose tiles
+  it may read or change and its trade partners. The cities of a group are
+  independent, so they are solved in parallel with the threads of
+  srv_threadpool(), then the results are applied in the order of the city
+  list. The result doesn't depend on the number of threads.
+**************************************************************************/
+void auto_arrange_workers_for_player(struct player *pplayer)
+{
+  const struct city_list *cities = pplayer->cities;
+  struct fc_threadpool *pool = srv_threadpool();
+  int ncities = city_list_size(cities);
+  struct city **order;
+  struct arrange_task *tasks;
+  int *group;
+  int *last_write, *last_read;
+  int i, g, ngroups = 0;
+
+  if (ncities < 2 || fc_threadpool_size(pool) <= 1
+      || arrange_workers_changes_map(cities)) {
+    city_list_iterate(cities, pcity) {
+      auto_arrange_workers(pcity);
+    } city_list_iterate_end;
+    return;
+  }
+
+  TIMING_LOG(AIT_CITIZEN_ARRANGE, TIMER_START);
+
+  /* Group the cities. last_write[] and last_read[] hold the last group
+   * (plus one) where a city may change or read each tile. */
+  last_write = fc_calloc(MAP_INDEX_SIZE, sizeof(*last_write));
+  last_read = fc_calloc(MAP_INDEX_SIZE, sizeof(*last_read));
+  order = fc_malloc(ncities * sizeof(*order));
+  group = fc_malloc(ncities * sizeof(*group));
+  i = 0;
+  city_list_iterate(cities, pcity) {
+    int radius_sq = city_map_radius_sq_get(pcity);
+
+    g = 0;
+    city_tile_iterate(radius_sq, city_tile(pcity), ptile) {
+      g = MAX(g, last_read[tile_index(ptile)]);
+      g = MAX(g, last_write[tile_index(ptile)]);
+      adjc_iterate(&(wld.map), ptile, adjc_tile) {
+        g = MAX(g, last_write[tile_index(adjc_tile)]);
+      } adjc_iterate_end;
+    } city_tile_iterate_end;
+    trade_partners_iterate(pcity, partner) {
+      g = MAX(g, last_write[tile_index(city_tile(partner))]);
+    } trade_partners_iterate_end;
+
+    city_tile_iterate(radius_sq, city_tile(pcity), ptile) {
+      last_write[tile_index(ptile)] = g + 1;
+      last_read[tile_index(ptile)] = MAX(last_read[tile_index(ptile)], g + 1);
+      adjc_iterate(&(wld.map), ptile, adjc_tile) {
+        last_read[tile_index(adjc_tile)]
+          = MAX(last_read[tile_index(adjc_tile)], g + 1);
+      } adjc_iterate_end;
+    } city_tile_iterate_end;
+
+    order[i] = pcity;
+    group[i] = g;
+    ngroups = MAX(ngroups, g + 1);
+    i++;
+  } city_list_iterate_end;
+  free(last_write);
+  free(last_read);
+
+  tasks = fc_malloc(ncities * sizeof(*tasks));
+  for (g = 0; g < ngroups; g++) {
+    int ntasks = 0;
+
+    for (i = 0; i < ncities; i++) {
+      struct city *pcity = order[i];
+
+      if (group[i] != g) {
+        continue;
+      }
+      if (pcity->server.workers_frozen > 0) {
+        pcity->server.needs_arrange = TRUE;
+        continue;
+      }
+
+      arrange_workers_prepare(pcity);
+      tasks[ntasks].pcity = pcity;
+      tasks[ntasks].cmr = cm_result_new(pcity);
+      tasks[ntasks].released = FALSE;
+      ntasks++;
+    }
+
+    /* Nothing but the cities being solved changes meanwhile, so the
+     * requirement cache can be shared. */
+    req_cache_set_readonly(TRUE);
+    fc_threadpool_run(pool, ntasks, arrange_task_solve, tasks);
+    req_cache_set_readonly(FALSE);
+
+    for (i = 0; i < ntasks; i++) {
+      arrange_workers_apply(tasks[i].pcity, tasks[i].cmr, tasks[i].released);
+      cm_result_destroy(tasks[i].cmr);
+    }
+  }
+  free(tasks);
+  free(order);
+  free(group);
+
+  TIMING_LOG(AIT_CITIZEN_ARRANGE, TIMER_STOP);
+}
+
 /**********************************************************************//**
   Notices about cities that should be sent to all players.
 **************************************************************************/
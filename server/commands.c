@@ -210,6 +210,7 @@ static struct command commands[] = {
       "debug units <x> <y>\n"
       "debug unit <id>\n"
       "debug timing\n"
+      "debug effects\n"
       "debug info"),
    N_("Turn on or off AI debugging of given entity."),
    N_("Print AI debug information about given entity and turn continuous "
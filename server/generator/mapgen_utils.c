@@ -23,6 +23,7 @@
 /* common */
 #include "map.h"
 #include "packets.h"
+#include "player.h"
 #include "terrain.h"
 #include "tile.h"
 
@@ -450,6 +451,11 @@ void assign_continent_numbers(void)
   wld.map.num_continents = 0;
   wld.map.num_oceans = 0;
 
+  /* The known continents of the players refer to the old numbers. */
+  players_iterate(pplayer) {
+    player_known_continents_invalidate(pplayer);
+  } players_iterate_end;
+
   whole_map_iterate(&(wld.map), ptile) {
     tile_set_continent(ptile, 0);
   } whole_map_iterate_end;
@@ -39,6 +39,9 @@
 #include "unitlist.h"
 #include "vision.h"
 
+/* common/aicore */
+#include "path_finding.h"
+
 /* server */
 #include "citytools.h"
 #include "cityturn.h"
@@ -60,8 +63,43 @@
 /* Suppress send_tile_info() during game_load() */
 static bool send_tile_suppressed = FALSE;
 
-static void player_tile_init(struct tile *ptile, struct player *pplayer);
-static void player_tile_free(struct tile *ptile, struct player *pplayer);
+/* What path-finding sees of a tile, as last sent by send_tile_info(). */
+struct tile_movement_state {
+  bv_extras extras;
+  int city_id;
+  short terrain;
+  short owner;
+  short extras_owner;
+  short city_owner;
+};
+
+static struct tile_movement_state *tile_movement_states = NULL;
+
+/* Number of player tiles allocated at once in a player map. */
+#define PLAYER_TILE_BLOCK_SIZE 1024
+
+/* The map of a player, as it knows it. */
+struct player_map {
+  /* The seen counts of the tiles, one array per vision layer, with and
+   * without the shared vision. They change all the time, so they are kept
+   * apart from the rest.
+   * If you build a city with an unknown square within city radius
+   * the square stays unknown. However, we still have to keep count
+   * of the seen points, so they are kept in here. When the tile
+   * then becomes known they are moved to seen. */
+  short *seen_count[V_COUNT];
+  short *own_seen[V_COUNT];
+
+  /* Index of the player tile of each tile, -1 for none. Tiles without
+   * their own player tile are like 'unknown', so the tiles the player
+   * never had anything to know about take no room. The player tiles are
+   * allocated in blocks, so that they never move. */
+  int *tile_index;
+  struct player_tile **blocks;
+  int num_tiles;
+  struct player_tile unknown;
+};
+
 static void give_tile_info_from_player_to_player(struct player *pfrom,
 						 struct player *pdest,
 						 struct tile *ptile);
@@ -76,12 +114,6 @@ static void map_change_seen(struct player *pplayer,
 static void map_change_own_seen(struct player *pplayer,
                                 struct tile *ptile,
                                 const v_radius_t change);
-static inline int map_get_seen(const struct player *pplayer,
-                               const struct tile *ptile,
-                               enum vision_layer vlayer);
-static inline int map_get_own_seen(const struct player *pplayer,
-                                   const struct tile *ptile,
-                                   enum vision_layer vlayer);
 
 static bool is_claimable_ocean(struct tile *ptile, struct tile *source,
                                struct player *pplayer);
@@ -460,6 +492,52 @@ bool send_tile_suppression(bool now)
   return formerly;
 }
 
+/**********************************************************************//**
+  Return whether the tile changed for path-finding since the last call,
+  that is its terrain, extras, owners or city.
+**************************************************************************/
+static bool tile_movement_state_changed(const struct tile *ptile)
+{
+  struct tile_movement_state state, *pstate;
+  const struct player *owner = tile_owner(ptile);
+  const struct player *eowner = extra_owner(ptile);
+  const struct city *pcity = tile_city(ptile);
+
+  if (NULL == tile_movement_states) {
+    tile_movement_states = fc_calloc(MAP_INDEX_SIZE,
+                                     sizeof(*tile_movement_states));
+    whole_map_iterate(&(wld.map), piter) {
+      tile_movement_states[tile_index(piter)].terrain = -1;
+    } whole_map_iterate_end;
+  }
+
+  memset(&state, 0, sizeof(state));
+  state.extras = *tile_extras(ptile);
+  state.city_id = (NULL != pcity ? pcity->id : IDENTITY_NUMBER_ZERO);
+  state.terrain = (NULL != tile_terrain(ptile)
+                   ? terrain_number(tile_terrain(ptile)) : -2);
+  state.owner = (NULL != owner ? player_number(owner) : -1);
+  state.extras_owner = (NULL != eowner ? player_number(eowner) : -1);
+  state.city_owner = (NULL != pcity ? player_number(city_owner(pcity)) : -1);
+
+  pstate = tile_movement_states + tile_index(ptile);
+  if (0 == memcmp(pstate, &state, sizeof(state))) {
+    return FALSE;
+  }
+  memcpy(pstate, &state, sizeof(state));
+
+  return TRUE;
+}
+
+/**********************************************************************//**
+  Forget the tile states kept by send_tile_info().
+**************************************************************************/
+void tile_movement_states_free(void)
+{
+  free(tile_movement_states);
+  tile_movement_states = NULL;
+}
+
 /**********************************************************************//**
   Send tile information to all the clients in dest which know and see
   the tile. If dest is NULL, sends to all clients (game.est_connections)
@@ -474,11 +552,18 @@ void send_tile_info(struct conn_list *dest, struct tile *ptile,
   struct packet_tile_info info;
   const struct player *owner;
   const struct player *eowner;
+  bool fanout;
 
   if (dest == NULL) {
     CALL_FUNC_EACH_AI(tile_info, ptile);
   }
 
+  /* The known and seen states are handled by map_change_seen(),
+   * map_set_known() and map_clear_known(), the units by unittools.c. */
+  if (tile_movement_state_changed(ptile)) {
+    pf_map_shared_clear_tile(ptile, NULL);
+  }
+
   if (send_tile_suppressed) {
     return;
   }
@@ -495,6 +580,8 @@ void send_tile_info(struct conn_list *dest, struct tile *ptile,
     info.spec_sprite[0] = '\0';
   }
 
+  /* Most connections see the tile the same way. */
+  fanout = packet_fanout_begin(dest);
   conn_list_iterate(dest, pconn) {
     struct player *pplayer = pconn->playing;
 
@@ -541,26 +628,26 @@ void send_tile_info(struct conn_list *dest, struct tile *ptile,
 
       send_packet_tile_info(pconn, &info);
     } else if (pplayer && map_is_known(ptile, pplayer)) {
-      struct player_tile *plrtile = map_get_player_tile(ptile, pplayer);
+      const struct player_tile *plrtile = map_get_player_tile(ptile, pplayer);
       struct vision_site *psite = map_get_player_site(ptile, pplayer);
 
       info.known = TILE_KNOWN_UNSEEN;
       info.continent = tile_continent(ptile);
       owner = (game.server.foggedborders
-               ? plrtile->owner
+               ? player_tile_owner(plrtile)
                : tile_owner(ptile));
-      eowner = plrtile->extras_owner;
+      eowner = player_tile_extras_owner(plrtile);
       info.owner = (owner ? player_number(owner) : MAP_TILE_OWNER_NULL);
       info.extras_owner = (eowner ? player_number(eowner) : MAP_TILE_OWNER_NULL);
       info.worked = (NULL != psite)
                     ? psite->identity
                     : IDENTITY_NUMBER_ZERO;
 
-      info.terrain = (NULL != plrtile->terrain)
-                      ? terrain_number(plrtile->terrain)
+      info.terrain = (0 <= plrtile->terrain)
+                      ? plrtile->terrain
                       : terrain_count();
-      info.resource = (NULL != plrtile->resource)
-                       ? extra_number(plrtile->resource)
+      info.resource = (0 <= plrtile->resource)
+                       ? plrtile->resource
                        : MAX_EXTRA_TYPES;
       info.placing = -1;
       info.place_turn = 0;
@@ -595,6 +682,7 @@ void send_tile_info(struct conn_list *dest, struct tile *ptile,
     }
   }
   conn_list_iterate_end;
+  packet_fanout_end(fanout);
 }
 
 /**********************************************************************//**
@@ -875,11 +963,10 @@ bool map_is_known_and_seen(const struct tile *ptile,
   happens when a city is founded with some unknown tiles in its radius); in
   this case the tile is unknown (but map_get_seen will still return TRUE).
 **************************************************************************/
-static inline int map_get_seen(const struct player *pplayer,
-                               const struct tile *ptile,
-                               enum vision_layer vlayer)
+int map_get_seen(const struct player *pplayer, const struct tile *ptile,
+                 enum vision_layer vlayer)
 {
-  return map_get_player_tile(ptile, pplayer)->seen_count[vlayer];
+  return pplayer->server.private_map->seen_count[vlayer][tile_index(ptile)];
 }
 
 /**********************************************************************//**
@@ -893,7 +980,8 @@ void map_change_seen(struct player *pplayer,
                      const v_radius_t change,
                      bool can_reveal_tiles)
 {
-  struct player_tile *plrtile = map_get_player_tile(ptile, pplayer);
+  struct player_map *pmap = pplayer->server.private_map;
+  const int idx = tile_index(ptile);
   bool revealing_tile = FALSE;
 
 #ifdef FREECIV_DEBUG
@@ -902,7 +990,7 @@ void map_change_seen(struct player *pplayer,
             TILE_XY(ptile));
   vision_layer_iterate(v) {
     log_debug("  vision layer %d is changing from %d to %d.",
-              v, plrtile->seen_count[v], plrtile->seen_count[v] + change[v]);
+              v, pmap->seen_count[v][idx], pmap->seen_count[v][idx] + change[v]);
   } vision_layer_iterate_end;
 #endif /* FREECIV_DEBUG */
 
@@ -910,14 +998,14 @@ void map_change_seen(struct player *pplayer,
    * we must remove all units before fog of war because clients expect
    * the tile is empty when it is fogged. */
   if (0 > change[V_INVIS]
-      && plrtile->seen_count[V_INVIS] == -change[V_INVIS]) {
+      && pmap->seen_count[V_INVIS][idx] == -change[V_INVIS]) {
     log_debug("(%d, %d): hiding invisible units to player %s (nb %d).",
               TILE_XY(ptile), player_name(pplayer), player_number(pplayer));
 
     unit_list_iterate(ptile->units, punit) {
       if (unit_is_visible_on_layer(punit, V_INVIS)
           && can_player_see_unit(pplayer, punit)
-          && (plrtile->seen_count[V_MAIN] + change[V_MAIN] <= 0
+          && (pmap->seen_count[V_MAIN][idx] + change[V_MAIN] <= 0
               || !pplayers_allied(pplayer, unit_owner(punit)))) {
         /* Allied units on seen tiles (V_MAIN) are always seen.
          * That's how can_player_see_unit_at() works. */
@@ -926,7 +1014,7 @@ void map_change_seen(struct player *pplayer,
     } unit_list_iterate_end;
   }
   if (0 > change[V_SUBSURFACE]
-      && plrtile->seen_count[V_SUBSURFACE] == -change[V_SUBSURFACE]) {
+      && pmap->seen_count[V_SUBSURFACE][idx] == -change[V_SUBSURFACE]) {
     log_debug("(%d, %d): hiding subsurface units to player %s (nb %d).",
               TILE_XY(ptile), player_name(pplayer), player_number(pplayer));
 
@@ -939,7 +1027,7 @@ void map_change_seen(struct player *pplayer,
   }
 
   if (0 > change[V_MAIN]
-      && plrtile->seen_count[V_MAIN] == -change[V_MAIN]) {
+      && pmap->seen_count[V_MAIN][idx] == -change[V_MAIN]) {
     log_debug("(%d, %d): hiding visible units to player %s (nb %d).",
               TILE_XY(ptile), player_name(pplayer), player_number(pplayer));
 
@@ -953,8 +1041,8 @@ void map_change_seen(struct player *pplayer,
 
   vision_layer_iterate(v) {
     /* Avoid underflow. */
-    fc_assert(0 <= change[v] || -change[v] <= plrtile->seen_count[v]);
-    plrtile->seen_count[v] += change[v];
+    fc_assert(0 <= change[v] || -change[v] <= pmap->seen_count[v][idx]);
+    pmap->seen_count[v][idx] += change[v];
   } vision_layer_iterate_end;
 
   /* V_MAIN vision ranges must always be more than invisible ranges
@@ -962,13 +1050,13 @@ void map_change_seen(struct player *pplayer,
    * seen count cannot be inferior to V_INVIS or V_SUBSURFACE seen count.
    * Moreover, when the fog of war is disabled, V_MAIN has an extra
    * seen count point. */
-  fc_assert(plrtile->seen_count[V_INVIS] + !game.info.fogofwar
-            <= plrtile->seen_count[V_MAIN]);
-  fc_assert(plrtile->seen_count[V_SUBSURFACE] + !game.info.fogofwar
-            <= plrtile->seen_count[V_MAIN]);
+  fc_assert(pmap->seen_count[V_INVIS][idx] + !game.info.fogofwar
+            <= pmap->seen_count[V_MAIN][idx]);
+  fc_assert(pmap->seen_count[V_SUBSURFACE][idx] + !game.info.fogofwar
+            <= pmap->seen_count[V_MAIN][idx]);
 
   if (!map_is_known(ptile, pplayer)) {
-    if (0 < plrtile->seen_count[V_MAIN] && can_reveal_tiles) {
+    if (0 < pmap->seen_count[V_MAIN][idx] && can_reveal_tiles) {
       log_debug("(%d, %d): revealing tile to player %s (nb %d).",
                 TILE_XY(ptile), player_name(pplayer),
                 player_number(pplayer));
@@ -981,29 +1069,37 @@ void map_change_seen(struct player *pplayer,
   }
 
   /* Fog the tile. */
-  if (0 > change[V_MAIN] && 0 == plrtile->seen_count[V_MAIN]) {
+  if (0 > change[V_MAIN] && 0 == pmap->seen_count[V_MAIN][idx]) {
+    struct player_tile *plrtile;
+
     log_debug("(%d, %d): fogging tile for player %s (nb %d).",
               TILE_XY(ptile), player_name(pplayer), player_number(pplayer));
 
+    /* Path-finding sees the unseen tiles differently. */
+    pf_map_shared_clear_tile(ptile, pplayer);
+
     update_player_tile_last_seen(pplayer, ptile);
+    plrtile = map_get_player_tile_writable(ptile, pplayer);
     if (game.server.foggedborders) {
-      plrtile->owner = tile_owner(ptile);
+      player_tile_set_owner(plrtile, tile_owner(ptile));
     }
-    plrtile->extras_owner = extra_owner(ptile);
+    player_tile_set_extras_owner(plrtile, extra_owner(ptile));
     send_tile_info(pplayer->connections, ptile, FALSE);
   }
 
-  if ((revealing_tile && 0 < plrtile->seen_count[V_MAIN])
+  if ((revealing_tile && 0 < pmap->seen_count[V_MAIN][idx])
       || (0 < change[V_MAIN]
-          /* plrtile->seen_count[V_MAIN] Always set to 1
+          /* pmap->seen_count[V_MAIN][idx] Always set to 1
             * when the fog of war is disabled. */
           && (change[V_MAIN] + !game.info.fogofwar
-              == (plrtile->seen_count[V_MAIN])))) {
+              == (pmap->seen_count[V_MAIN][idx])))) {
     struct city *pcity;
 
     log_debug("(%d, %d): unfogging tile for player %s (nb %d).",
               TILE_XY(ptile), player_name(pplayer), player_number(pplayer));
 
+    pf_map_shared_clear_tile(ptile, pplayer);
+
     /* Send info about the tile itself.
      * It has to be sent first because the client needs correct
      * continent number before it can handle following packets
@@ -1026,9 +1122,9 @@ void map_change_seen(struct player *pplayer,
     }
   }
 
-  if ((revealing_tile && 0 < plrtile->seen_count[V_INVIS])
+  if ((revealing_tile && 0 < pmap->seen_count[V_INVIS][idx])
       || (0 < change[V_INVIS]
-          && change[V_INVIS] == plrtile->seen_count[V_INVIS])) {
+          && change[V_INVIS] == pmap->seen_count[V_INVIS][idx])) {
     log_debug("(%d, %d): revealing invisible units to player %s (nb %d).",
               TILE_XY(ptile), player_name(pplayer),
               player_number(pplayer));
@@ -1039,9 +1135,9 @@ void map_change_seen(struct player *pplayer,
       }
     } unit_list_iterate_end;
   }
-  if ((revealing_tile && 0 < plrtile->seen_count[V_SUBSURFACE])
+  if ((revealing_tile && 0 < pmap->seen_count[V_SUBSURFACE][idx])
       || (0 < change[V_SUBSURFACE]
-          && change[V_SUBSURFACE] == plrtile->seen_count[V_SUBSURFACE])) {
+          && change[V_SUBSURFACE] == pmap->seen_count[V_SUBSURFACE][idx])) {
     log_debug("(%d, %d): revealing subsurface units to player %s (nb %d).",
               TILE_XY(ptile), player_name(pplayer),
               player_number(pplayer));
@@ -1060,11 +1156,10 @@ void map_change_seen(struct player *pplayer,
 
   See also map_get_seen().
 **************************************************************************/
-static inline int map_get_own_seen(const struct player *pplayer,
-                                   const struct tile *ptile,
-                                   enum vision_layer vlayer)
+int map_get_own_seen(const struct player *pplayer, const struct tile *ptile,
+                     enum vision_layer vlayer)
 {
-  return map_get_player_tile(ptile, pplayer)->own_seen[vlayer];
+  return pplayer->server.private_map->own_seen[vlayer][tile_index(ptile)];
 }
 
 /**********************************************************************//**
@@ -1074,11 +1169,18 @@ static void map_change_own_seen(struct player *pplayer,
                                 struct tile *ptile,
                                 const v_radius_t change)
 {
-  struct player_tile *plrtile = map_get_player_tile(ptile, pplayer);
+  struct player_map *pmap = pplayer->server.private_map;
+  const int idx = tile_index(ptile);
 
   vision_layer_iterate(v) {
-    plrtile->own_seen[v] += change[v];
+    pmap->own_seen[v][idx] += change[v];
   } vision_layer_iterate_end;
+
+  if (0 < pmap->own_seen[V_MAIN][idx] || 0 < pmap->own_seen[V_INVIS][idx]) {
+    dbv_set(&pplayer->server.own_seen_tiles, tile_index(ptile));
+  } else {
+    dbv_clr(&pplayer->server.own_seen_tiles, tile_index(ptile));
+  }
 }
 
 /**********************************************************************//**
@@ -1105,7 +1207,26 @@ void change_playertile_site(struct player_tile *ptile,
 **************************************************************************/
 void map_set_known(struct tile *ptile, struct player *pplayer)
 {
+  Continent_id cont;
+
+  if (dbv_isset(&pplayer->tile_known, tile_index(ptile))) {
+    return;
+  }
+
   dbv_set(&pplayer->tile_known, tile_index(ptile));
+  pplayer->server.known_tiles++;
+  pf_map_shared_clear_tile(ptile, pplayer);
+
+  /* Keep the known continents up to date, if they have been computed. */
+  cont = tile_continent(ptile);
+  if (pplayer->server.known_continents != NULL && cont > 0) {
+    if (cont > pplayer->server.known_continents_size) {
+      player_known_continents_invalidate(pplayer);
+    } else if (!pplayer->server.known_continents[cont - 1]) {
+      pplayer->server.known_continents[cont - 1] = TRUE;
+      pplayer->server.known_continents_count++;
+    }
+  }
 }
 
 /**********************************************************************//**
@@ -1113,7 +1234,25 @@ void map_set_known(struct tile *ptile, struct player *pplayer)
 **************************************************************************/
 void map_clear_known(struct tile *ptile, struct player *pplayer)
 {
+  if (!dbv_isset(&pplayer->tile_known, tile_index(ptile))) {
+    return;
+  }
+
   dbv_clr(&pplayer->tile_known, tile_index(ptile));
+  pplayer->server.known_tiles--;
+  player_known_continents_invalidate(pplayer);
+  pf_map_shared_clear_tile(ptile, pplayer);
+}
+
+/**********************************************************************//**
+  Clear known status of all the tiles.
+**************************************************************************/
+void map_clear_all_known(struct player *pplayer)
+{
+  dbv_clr_all(&pplayer->tile_known);
+  pplayer->server.known_tiles = 0;
+  player_known_continents_invalidate(pplayer);
+  pf_map_shared_clear();
 }
 
 /**********************************************************************//**
@@ -1145,18 +1284,52 @@ void show_map_to_all(void)
 /**********************************************************************//**
   Allocate space for map, and initialise the tiles.
   Uses current map.xsize and map.ysize.
+  We need to use fogofwar_old here, so the player's tiles get
+  in the same state as the other players' tiles.
 **************************************************************************/
 void player_map_init(struct player *pplayer)
 {
-  pplayer->server.private_map
-    = fc_realloc(pplayer->server.private_map,
-                 MAP_INDEX_SIZE * sizeof(*pplayer->server.private_map));
+  struct player_map *pmap;
+  int i;
 
-  whole_map_iterate(&(wld.map), ptile) {
-    player_tile_init(ptile, pplayer);
-  } whole_map_iterate_end;
+  player_map_free(pplayer);
+  pmap = fc_calloc(1, sizeof(*pmap));
+
+  vision_layer_iterate(v) {
+    pmap->seen_count[v] = fc_calloc(MAP_INDEX_SIZE,
+                                    sizeof(*pmap->seen_count[v]));
+    pmap->own_seen[v] = fc_calloc(MAP_INDEX_SIZE,
+                                  sizeof(*pmap->own_seen[v]));
+  } vision_layer_iterate_end;
+  dbv_init(&pplayer->server.own_seen_tiles, MAP_INDEX_SIZE);
+  if (!game.server.fogofwar_old) {
+    for (i = 0; i < MAP_INDEX_SIZE; i++) {
+      pmap->seen_count[V_MAIN][i] = 1;
+      pmap->own_seen[V_MAIN][i] = 1;
+    }
+    dbv_set_all(&pplayer->server.own_seen_tiles);
+  }
+
+  pmap->tile_index = fc_malloc(MAP_INDEX_SIZE * sizeof(*pmap->tile_index));
+  for (i = 0; i < MAP_INDEX_SIZE; i++) {
+    pmap->tile_index[i] = -1;
+  }
+  pmap->unknown.site = NULL;
+  BV_CLR_ALL(pmap->unknown.extras);
+  pmap->unknown.terrain = -1;
+  pmap->unknown.resource = -1;
+  pmap->unknown.owner = -1;
+  pmap->unknown.extras_owner = -1;
+  if (!game.server.last_updated_year) {
+    pmap->unknown.last_updated = game.info.turn;
+  } else {
+    pmap->unknown.last_updated = game.info.year;
+  }
+  pplayer->server.private_map = pmap;
 
   dbv_init(&pplayer->tile_known, MAP_INDEX_SIZE);
+  pplayer->server.known_tiles = 0;
+  player_known_continents_invalidate(pplayer);
 }
 
 /**********************************************************************//**
@@ -1164,18 +1337,92 @@ void player_map_init(struct player *pplayer)
 **************************************************************************/
 void player_map_free(struct player *pplayer)
 {
-  if (!pplayer->server.private_map) {
+  struct player_map *pmap = pplayer->server.private_map;
+  int i;
+
+  if (!pmap) {
     return;
   }
 
-  whole_map_iterate(&(wld.map), ptile) {
-    player_tile_free(ptile, pplayer);
-  } whole_map_iterate_end;
+  for (i = 0; i < pmap->num_tiles; i++) {
+    struct player_tile *plrtile
+      = &pmap->blocks[i / PLAYER_TILE_BLOCK_SIZE][i % PLAYER_TILE_BLOCK_SIZE];
 
-  free(pplayer->server.private_map);
+    if (plrtile->site != NULL) {
+      vision_site_destroy(plrtile->site);
+    }
+  }
+  for (i = 0; i * PLAYER_TILE_BLOCK_SIZE < pmap->num_tiles; i++) {
+    free(pmap->blocks[i]);
+  }
+  free(pmap->blocks);
+  free(pmap->tile_index);
+  vision_layer_iterate(v) {
+    free(pmap->seen_count[v]);
+    free(pmap->own_seen[v]);
+  } vision_layer_iterate_end;
+  free(pmap);
   pplayer->server.private_map = NULL;
+  dbv_free(&pplayer->server.own_seen_tiles);
 
   dbv_free(&pplayer->tile_known);
+  pplayer->server.known_tiles = 0;
+  player_known_continents_invalidate(pplayer);
+}
+
+/**********************************************************************//**
+  Drop the player tiles which hold nothing more than 'unknown'. Loading a
+  saved player map sets all the tiles, this makes the map small again.
+**************************************************************************/
+void player_map_compact(struct player *pplayer)
+{
+  struct player_map *pmap = pplayer->server.private_map;
+  struct player_tile **blocks = pmap->blocks;
+  int num_tiles = pmap->num_tiles;
+  int i;
+
+  /* The tiles never seen were all last updated when the map was made,
+   * which was before the game was loaded. Take that time from the first
+   * unknown tile. */
+  whole_map_iterate(&(wld.map), ptile) {
+    if (!map_is_known(ptile, pplayer)) {
+      pmap->unknown.last_updated
+        = map_get_player_tile(ptile, pplayer)->last_updated;
+      break;
+    }
+  } whole_map_iterate_end;
+
+  pmap->blocks = NULL;
+  pmap->num_tiles = 0;
+
+  /* Copy the player tiles to keep to new blocks, in tile order. */
+  whole_map_iterate(&(wld.map), ptile) {
+    int *pidx = pmap->tile_index + tile_index(ptile);
+    const struct player_tile *plrtile;
+
+    if (*pidx < 0) {
+      continue;
+    }
+    plrtile = &blocks[*pidx / PLAYER_TILE_BLOCK_SIZE]
+                     [*pidx % PLAYER_TILE_BLOCK_SIZE];
+    *pidx = -1;
+
+    if (plrtile->site == NULL
+        && BV_ARE_EQUAL(plrtile->extras, pmap->unknown.extras)
+        && plrtile->terrain == pmap->unknown.terrain
+        && plrtile->resource == pmap->unknown.resource
+        && plrtile->owner == pmap->unknown.owner
+        && plrtile->extras_owner == pmap->unknown.extras_owner
+        && plrtile->last_updated == pmap->unknown.last_updated) {
+      continue;
+    }
+    *map_get_player_tile_writable(ptile, pplayer) = *plrtile;
+  } whole_map_iterate_end;
+
+  for (i = 0; i * PLAYER_TILE_BLOCK_SIZE < num_tiles; i++) {
+    free(blocks[i]);
+  }
+  free(blocks);
 }
 
 /**********************************************************************//**
@@ -1193,7 +1440,7 @@ void remove_player_from_maps(struct player *pplayer)
     bool reality_changed = FALSE;
 
     players_iterate(aplayer) {
-      struct player_tile *aplrtile;
+      const struct player_tile *aplrtile;
       bool changed = FALSE;
 
       if (!aplayer->server.private_map) {
@@ -1202,19 +1449,23 @@ void remove_player_from_maps(struct player *pplayer)
       aplrtile = map_get_player_tile(ptile, aplayer);
 
       /* Free vision sites (cities) for removed and other players */
-      if (aplrtile && aplrtile->site
+      if (aplrtile->site
           && vision_site_owner(aplrtile->site) == pplayer) {
-        change_playertile_site(aplrtile, NULL);
+        change_playertile_site(map_get_player_tile_writable(ptile, aplayer),
+                               NULL);
         changed = TRUE;
       }
 
       /* Remove references to player from others' maps */
-      if (aplrtile->owner == pplayer) {
-        aplrtile->owner = NULL;
+      if (player_tile_owner(aplrtile) == pplayer) {
+        player_tile_set_owner(map_get_player_tile_writable(ptile, aplayer),
+                              NULL);
         changed = TRUE;
       }
-      if (aplrtile->extras_owner == pplayer) {
-        aplrtile->extras_owner = NULL;
+      if (player_tile_extras_owner(aplrtile) == pplayer) {
+        player_tile_set_extras_owner(map_get_player_tile_writable(ptile,
+                                                                  aplayer),
+                                     NULL);
         changed = TRUE;
       }
 
@@ -1250,76 +1501,148 @@ void remove_player_from_maps(struct player *pplayer)
 }
 
 /**********************************************************************//**
-  We need to use fogofwar_old here, so the player's tiles get
-  in the same state as the other players' tiles.
+  Returns city located at given tile from player map.
 **************************************************************************/
-static void player_tile_init(struct tile *ptile, struct player *pplayer)
+struct vision_site *map_get_player_city(const struct tile *ptile,
+					const struct player *pplayer)
 {
-  struct player_tile *plrtile = map_get_player_tile(ptile, pplayer);
+  struct vision_site *psite = map_get_player_site(ptile, pplayer);
 
-  plrtile->terrain = T_UNKNOWN;
-  plrtile->resource = NULL;
-  plrtile->owner = NULL;
-  plrtile->extras_owner = NULL;
-  plrtile->site = NULL;
-  BV_CLR_ALL(plrtile->extras);
-  if (!game.server.last_updated_year) {
-    plrtile->last_updated = game.info.turn;
-  } else {
-    plrtile->last_updated = game.info.year;
+  fc_assert_ret_val(psite == NULL || psite->location == ptile, NULL);
+ 
+  return psite;
+}
+
+/**********************************************************************//**
+  Returns site located at given tile from player map.
+**************************************************************************/
+struct vision_site *map_get_player_site(const struct tile *ptile,
+					const struct player *pplayer)
+{
+  return map_get_player_tile(ptile, pplayer)->site;
+}
+
+/**********************************************************************//**
+  Players' information of tiles is tracked so that fogged area can be kept
+  consistent even when the client disconnects.  This function returns the
+  player tile information for the given tile and player.
+**************************************************************************/
+const struct player_tile *map_get_player_tile(const struct tile *ptile,
+                                              const struct player *pplayer)
+{
+  const struct player_map *pmap = pplayer->server.private_map;
+  int idx;
+
+  fc_assert_ret_val(pmap, NULL);
+
+  idx = pmap->tile_index[tile_index(ptile)];
+  if (idx < 0) {
+    return &pmap->unknown;
   }
 
-  plrtile->seen_count[V_MAIN] = !game.server.fogofwar_old;
-  plrtile->seen_count[V_INVIS] = 0;
-  plrtile->seen_count[V_SUBSURFACE] = 0;
-  memcpy(plrtile->own_seen, plrtile->seen_count, sizeof(v_radius_t));
+  return &pmap->blocks[idx / PLAYER_TILE_BLOCK_SIZE]
+                      [idx % PLAYER_TILE_BLOCK_SIZE];
 }
 
 /**********************************************************************//**
-  Free the memory stored into the player tile.
+  Like map_get_player_tile(), but to change the player tile. Allocates it
+  if the tile had none yet.
 **************************************************************************/
-static void player_tile_free(struct tile *ptile, struct player *pplayer)
+struct player_tile *map_get_player_tile_writable(const struct tile *ptile,
+                                                 struct player *pplayer)
 {
-  struct player_tile *plrtile = map_get_player_tile(ptile, pplayer);
+  struct player_map *pmap = pplayer->server.private_map;
+  int *pidx;
+
+  fc_assert_ret_val(pmap, NULL);
+
+  pidx = pmap->tile_index + tile_index(ptile);
+  if (*pidx < 0) {
+    if (pmap->num_tiles % PLAYER_TILE_BLOCK_SIZE == 0) {
+      int num_blocks = pmap->num_tiles / PLAYER_TILE_BLOCK_SIZE;
 
-  if (plrtile->site != NULL) {
-    vision_site_destroy(plrtile->site);
+      pmap->blocks = fc_realloc(pmap->blocks,
+                                (num_blocks + 1) * sizeof(*pmap->blocks));
+      pmap->blocks[num_blocks]
+        = fc_malloc(PLAYER_TILE_BLOCK_SIZE * sizeof(*pmap->blocks[0]));
+    }
+    *pidx = pmap->num_tiles++;
+    pmap->blocks[*pidx / PLAYER_TILE_BLOCK_SIZE]
+                [*pidx % PLAYER_TILE_BLOCK_SIZE] = pmap->unknown;
   }
+
+  return &pmap->blocks[*pidx / PLAYER_TILE_BLOCK_SIZE]
+                      [*pidx % PLAYER_TILE_BLOCK_SIZE];
 }
 
 /**********************************************************************//**
-  Returns city located at given tile from player map.
+  Return the terrain of the player tile, T_UNKNOWN for unknown tiles.
 **************************************************************************/
-struct vision_site *map_get_player_city(const struct tile *ptile,
-					const struct player *pplayer)
+struct terrain *player_tile_terrain(const struct player_tile *plrtile)
 {
-  struct vision_site *psite = map_get_player_site(ptile, pplayer);
+  return 0 <= plrtile->terrain ? terrain_by_number(plrtile->terrain)
+                               : T_UNKNOWN;
+}
 
-  fc_assert_ret_val(psite == NULL || psite->location == ptile, NULL);
- 
-  return psite;
+/**********************************************************************//**
+  Set the terrain of the player tile.
+**************************************************************************/
+void player_tile_set_terrain(struct player_tile *plrtile,
+                             const struct terrain *pterrain)
+{
+  plrtile->terrain = T_UNKNOWN != pterrain ? terrain_number(pterrain) : -1;
 }
 
 /**********************************************************************//**
-  Returns site located at given tile from player map.
+  Return the resource of the player tile, or NULL.
 **************************************************************************/
-struct vision_site *map_get_player_site(const struct tile *ptile,
-					const struct player *pplayer)
+struct extra_type *player_tile_resource(const struct player_tile *plrtile)
 {
-  return map_get_player_tile(ptile, pplayer)->site;
+  return 0 <= plrtile->resource ? extra_by_number(plrtile->resource) : NULL;
 }
 
 /**********************************************************************//**
-  Players' information of tiles is tracked so that fogged area can be kept
-  consistent even when the client disconnects.  This function returns the
-  player tile information for the given tile and player.
+  Set the resource of the player tile.
 **************************************************************************/
-struct player_tile *map_get_player_tile(const struct tile *ptile,
-					const struct player *pplayer)
+void player_tile_set_resource(struct player_tile *plrtile,
+                              const struct extra_type *presource)
+{
+  plrtile->resource = NULL != presource ? extra_number(presource) : -1;
+}
+
+/**********************************************************************//**
+  Return the owner of the player tile, or NULL.
+**************************************************************************/
+struct player *player_tile_owner(const struct player_tile *plrtile)
+{
+  return 0 <= plrtile->owner ? player_by_number(plrtile->owner) : NULL;
+}
+
+/**********************************************************************//**
+  Set the owner of the player tile.
+**************************************************************************/
+void player_tile_set_owner(struct player_tile *plrtile,
+                           const struct player *powner)
 {
-  fc_assert_ret_val(pplayer->server.private_map, NULL);
+  plrtile->owner = NULL != powner ? player_number(powner) : -1;
+}
 
-  return pplayer->server.private_map + tile_index(ptile);
+/**********************************************************************//**
+  Return the owner of the extras of the player tile, or NULL.
+**************************************************************************/
+struct player *player_tile_extras_owner(const struct player_tile *plrtile)
+{
+  return (0 <= plrtile->extras_owner
+          ? player_by_number(plrtile->extras_owner) : NULL);
+}
+
+/**********************************************************************//**
+  Set the owner of the extras of the player tile.
+**************************************************************************/
+void player_tile_set_extras_owner(struct player_tile *plrtile,
+                                  const struct player *powner)
+{
+  plrtile->extras_owner = NULL != powner ? player_number(powner) : -1;
 }
 
 /**********************************************************************//**
@@ -1332,14 +1655,17 @@ struct player_tile *map_get_player_tile(const struct tile *ptile,
 **************************************************************************/
 bool update_player_tile_knowledge(struct player *pplayer, struct tile *ptile)
 {
-  struct player_tile *plrtile = map_get_player_tile(ptile, pplayer);
+  const struct player_tile *known = map_get_player_tile(ptile, pplayer);
 
-  if (plrtile->terrain != ptile->terrain
-      || !BV_ARE_EQUAL(plrtile->extras, ptile->extras)
-      || plrtile->resource != ptile->resource
-      || plrtile->owner != tile_owner(ptile)
-      || plrtile->extras_owner != extra_owner(ptile)) {
-    plrtile->terrain = ptile->terrain;
+  if (player_tile_terrain(known) != ptile->terrain
+      || !BV_ARE_EQUAL(known->extras, ptile->extras)
+      || player_tile_resource(known) != ptile->resource
+      || player_tile_owner(known) != tile_owner(ptile)
+      || player_tile_extras_owner(known) != extra_owner(ptile)) {
+    struct player_tile *plrtile = map_get_player_tile_writable(ptile,
+                                                               pplayer);
+
+    player_tile_set_terrain(plrtile, ptile->terrain);
     extra_type_iterate(pextra) {
       if (player_knows_extra_exist(pplayer, pextra, ptile)) {
 	BV_SET(plrtile->extras, extra_number(pextra));
@@ -1347,9 +1673,9 @@ bool update_player_tile_knowledge(struct player *pplayer, struct tile *ptile)
 	BV_CLR(plrtile->extras, extra_number(pextra));
       }
     } extra_type_iterate_end;
-    plrtile->resource = ptile->resource;
-    plrtile->owner = tile_owner(ptile);
-    plrtile->extras_owner = extra_owner(ptile);
+    player_tile_set_resource(plrtile, ptile->resource);
+    player_tile_set_owner(plrtile, tile_owner(ptile));
+    player_tile_set_extras_owner(plrtile, extra_owner(ptile));
 
     return TRUE;
   }
@@ -1398,9 +1724,11 @@ void update_player_tile_last_seen(struct player *pplayer,
                                   struct tile *ptile)
 {
   if (!game.server.last_updated_year) {
-    map_get_player_tile(ptile, pplayer)->last_updated = game.info.turn;
+    map_get_player_tile_writable(ptile, pplayer)->last_updated
+      = game.info.turn;
   } else {
-    map_get_player_tile(ptile, pplayer)->last_updated = game.info.year;
+    map_get_player_tile_writable(ptile, pplayer)->last_updated
+      = game.info.year;
   }
 }
 
@@ -1411,7 +1739,9 @@ static void really_give_tile_info_from_player_to_player(struct player *pfrom,
                                                         struct player *pdest,
                                                         struct tile *ptile)
 {
-  struct player_tile *from_tile, *dest_tile;
+  const struct player_tile *from_tile;
+  struct player_tile *dest_tile;
+
   if (!map_is_known_and_seen(ptile, pdest, V_MAIN)) {
     /* I can just hear people scream as they try to comprehend this if :).
      * Let me try in words:
@@ -1426,7 +1756,7 @@ static void really_give_tile_info_from_player_to_player(struct player *pfrom,
 		 > map_get_player_tile(ptile, pdest)->last_updated))
 	        || !map_is_known(ptile, pdest)))) {
       from_tile = map_get_player_tile(ptile, pfrom);
-      dest_tile = map_get_player_tile(ptile, pdest);
+      dest_tile = map_get_player_tile_writable(ptile, pdest);
       /* Update and send tile knowledge */
       map_set_known(ptile, pdest);
       dest_tile->terrain = from_tile->terrain;
@@ -1478,9 +1808,12 @@ static void really_give_tile_info_from_player_to_player(struct player *pfrom,
 static void really_give_map_from_player_to_player(struct player *pfrom,
                                                   struct player *pdest)
 {
-  whole_map_iterate(&(wld.map), ptile) {
-    really_give_tile_info_from_player_to_player(pfrom, pdest, ptile);
-  } whole_map_iterate_end;
+  /* Only the tiles pfrom knows can give something. */
+  dbv_set_bits_iterate(&pfrom->tile_known, idx) {
+    really_give_tile_info_from_player_to_player(pfrom, pdest,
+                                                index_to_tile(&(wld.map),
+                                                              idx));
+  } dbv_set_bits_iterate_end;
 
   city_thaw_workers_queue();
   sync_cities();
@@ -1510,33 +1843,24 @@ static void give_tile_info_from_player_to_player(struct player *pfrom,
 **************************************************************************/
 static void create_vision_dependencies(void)
 {
-  int added;
-
   players_iterate(pplayer) {
     pplayer->server.really_gives_vision = pplayer->gives_shared_vision;
+    BV_CLR(pplayer->server.really_gives_vision, player_index(pplayer));
   } players_iterate_end;
 
-  /* In words: This terminates when it has run a round without adding
-     a dependency. One loop only propagates dependencies one level deep,
-     which is why we keep doing it as long as changes occur. */
-  do {
-    added = 0;
+  /* In words: once pplayer2 has been handled as the middle of the
+   * chains, everyone giving vision to pplayer2 also gives everything
+   * pplayer2 gives, through any of the players handled before. So a
+   * single pass over the middle players gives the whole closure. */
+  players_iterate(pplayer2) {
     players_iterate(pplayer) {
-      players_iterate(pplayer2) {
-        if (really_gives_vision(pplayer, pplayer2)
-            && pplayer != pplayer2) {
-          players_iterate(pplayer3) {
-            if (really_gives_vision(pplayer2, pplayer3)
-                && !really_gives_vision(pplayer, pplayer3)
-                && pplayer != pplayer3) {
-              BV_SET(pplayer->server.really_gives_vision, player_index(pplayer3));
-              added++;
-            }
-          } players_iterate_end;
-        }
-      } players_iterate_end;
+      if (pplayer != pplayer2 && really_gives_vision(pplayer, pplayer2)) {
+        BV_SET_ALL_FROM(pplayer->server.really_gives_vision,
+                        pplayer2->server.really_gives_vision);
+        BV_CLR(pplayer->server.really_gives_vision, player_index(pplayer));
+      }
     } players_iterate_end;
-  } while (added > 0);
+  } players_iterate_end;
 }
 
 /**********************************************************************//**
@@ -1570,7 +1894,8 @@ void give_shared_vision(struct player *pfrom, struct player *pto)
                        player_index(pplayer2))) {
         log_debug("really giving shared vision from %s to %s",
                   player_name(pplayer), player_name(pplayer2));
-        whole_map_iterate(&(wld.map), ptile) {
+        dbv_set_bits_iterate(&pplayer->server.own_seen_tiles, idx) {
+          struct tile *ptile = index_to_tile(&(wld.map), idx);
           const v_radius_t change =
               V_RADIUS(map_get_own_seen(pplayer, ptile, V_MAIN),
                        map_get_own_seen(pplayer, ptile, V_INVIS),
@@ -1580,7 +1905,7 @@ void give_shared_vision(struct player *pfrom, struct player *pto)
             map_change_seen(pplayer2, ptile, change,
                             map_is_known(ptile, pplayer));
           }
-        } whole_map_iterate_end;
+        } dbv_set_bits_iterate_end;
 
 	/* squares that are not seen, but which pfrom may have more recent
 	   knowledge of */
@@ -1628,7 +1953,8 @@ void remove_shared_vision(struct player *pfrom, struct player *pto)
                       player_index(pplayer2))) {
         log_debug("really removing shared vision from %s to %s",
                   player_name(pplayer), player_name(pplayer2));
-        whole_map_iterate(&(wld.map), ptile) {
+        dbv_set_bits_iterate(&pplayer->server.own_seen_tiles, idx) {
+          struct tile *ptile = index_to_tile(&(wld.map), idx);
           const v_radius_t change =
               V_RADIUS(-map_get_own_seen(pplayer, ptile, V_MAIN),
                        -map_get_own_seen(pplayer, ptile, V_INVIS),
@@ -1637,7 +1963,7 @@ void remove_shared_vision(struct player *pfrom, struct player *pto)
           if (0 > change[V_MAIN] || 0 > change[V_INVIS]) {
             map_change_seen(pplayer2, ptile, change, FALSE);
           }
-        } whole_map_iterate_end;
+        } dbv_set_bits_iterate_end;
       }
     } players_iterate_end;
     unbuffer_shared_vision(pplayer);
@@ -26,20 +26,17 @@ struct section_file;
 struct conn_list;
 
 
+/* What a player last knew about a tile. The terrain, resource and owners
+ * are kept by index, -1 for none, so use the player_tile_*() functions
+ * to get and set them. The seen counts are kept apart, see
+ * map_get_seen(). */
 struct player_tile {
   struct vision_site *site;		/* NULL for no vision site */
-  struct extra_type *resource;          /* NULL for no resource */
-  struct terrain *terrain;		/* NULL for unknown tiles */
-  struct player *owner; 		/* NULL for unowned */
-  struct player *extras_owner;
   bv_extras extras;
-
-  /* If you build a city with an unknown square within city radius
-     the square stays unknown. However, we still have to keep count
-     of the seen points, so they are kept in here. When the tile
-     then becomes known they are moved to seen. */
-  v_radius_t own_seen;
-  v_radius_t seen_count;
+  short terrain;			/* -1 for unknown tiles */
+  short resource;			/* -1 for no resource */
+  short owner;				/* -1 for unowned */
+  short extras_owner;
   short last_updated;
 };
 
@@ -56,6 +53,7 @@ void give_citymap_from_player_to_player(struct city *pcity,
 void send_all_known_tiles(struct conn_list *dest);
 
 bool send_tile_suppression(bool now);
+void tile_movement_states_free(void);
 void send_tile_info(struct conn_list *dest, struct tile *ptile,
                     bool send_unknown);
 
@@ -79,19 +77,41 @@ bool map_is_known_and_seen(const struct tile *ptile,
 bool map_is_known(const struct tile *ptile, const struct player *pplayer);
 void map_set_known(struct tile *ptile, struct player *pplayer);
 void map_clear_known(struct tile *ptile, struct player *pplayer);
+void map_clear_all_known(struct player *pplayer);
 void map_know_and_see_all(struct player *pplayer);
 void show_map_to_all(void);
 
 void player_map_init(struct player *pplayer);
 void player_map_free(struct player *pplayer);
+void player_map_compact(struct player *pplayer);
 void remove_player_from_maps(struct player *pplayer);
 
 struct vision_site *map_get_player_city(const struct tile *ptile,
                                         const struct player *pplayer);
 struct vision_site *map_get_player_site(const struct tile *ptile,
                                         const struct player *pplayer);
-struct player_tile *map_get_player_tile(const struct tile *ptile,
-                                        const struct player *pplayer);
+const struct player_tile *map_get_player_tile(const struct tile *ptile,
+                                              const struct player *pplayer);
+struct player_tile *map_get_player_tile_writable(const struct tile *ptile,
+                                                 struct player *pplayer);
+int map_get_seen(const struct player *pplayer, const struct tile *ptile,
+                 enum vision_layer vlayer);
+int map_get_own_seen(const struct player *pplayer, const struct tile *ptile,
+                     enum vision_layer vlayer);
+
+struct terrain *player_tile_terrain(const struct player_tile *plrtile);
+void player_tile_set_terrain(struct player_tile *plrtile,
+                             const struct terrain *pterrain);
+struct extra_type *player_tile_resource(const struct player_tile *plrtile);
+void player_tile_set_resource(struct player_tile *plrtile,
+                              const struct extra_type *presource);
+struct player *player_tile_owner(const struct player_tile *plrtile);
+void player_tile_set_owner(struct player_tile *plrtile,
+                           const struct player *powner);
+struct player *player_tile_extras_owner(const struct player_tile *plrtile);
+void player_tile_set_extras_owner(struct player_tile *plrtile,
+                                  const struct player *powner);
+
 bool update_player_tile_knowledge(struct player *pplayer, struct tile *ptile);
 void update_tile_knowledge(struct tile *ptile);
 void update_player_tile_last_seen(struct player *pplayer, struct tile *ptile);
@@ -42,6 +42,9 @@
 #include "tech.h"
 #include "unitlist.h"
 
+/* common/aicore */
+#include "path_finding.h"
+
 /* common/scriptcore */
 #include "luascript_types.h"
 
@@ -1043,6 +1046,9 @@ static void send_player_info_c_real(struct player *src,
 **************************************************************************/
 void send_player_diplstate_c(struct player *src, struct conn_list *dest)
 {
+  /* Zones of control and enemy units depend on the diplomatic states. */
+  pf_map_shared_clear();
+
   if (src != NULL) {
     send_player_diplstate_c_real(src, dest);
     return;
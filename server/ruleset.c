@@ -24,6 +24,7 @@
 #include "bitvector.h"
 #include "deprecations.h"
 #include "fcintl.h"
+#include "fcthreadpool.h"
 #include "log.h"
 #include "mem.h"
 #include "registry.h"
@@ -124,6 +125,24 @@ static char *road_sections = NULL;
 
 static struct requirement_vector reqs_list;
 
+/* The packets of the rulesets as sent to the connections with a given
+ * capability string, see send_rulesets(). */
+struct ruleset_stream {
+  char capability[MAX_LEN_CAPSTR];
+  struct byte_vector packets;
+  struct byte_vector frames;
+  struct connection *recorder;  /* while the packets are recorded */
+};
+
+#define SPECLIST_TAG ruleset_stream
+#define SPECLIST_TYPE struct ruleset_stream
+#include "speclist.h"
+#define ruleset_stream_list_iterate(slist, pstream) \
+  TYPED_LIST_ITERATE(struct ruleset_stream, slist, pstream)
+#define ruleset_stream_list_iterate_end LIST_ITERATE_END
+
+static struct ruleset_stream_list *ruleset_streams = NULL;
+
 static bool load_rulesetdir(const char *rsdir, bool compat_mode,
                             rs_conversion_logger logger,
                             bool act, bool buffer_script, bool load_luadata);
@@ -190,6 +209,7 @@ static void send_ruleset_musics(struct conn_list *dest);
 static void send_ruleset_cities(struct conn_list *dest);
 static void send_ruleset_game(struct conn_list *dest);
 static void send_ruleset_team_names(struct conn_list *dest);
+static void ruleset_streams_free(void);
 
 static bool load_ruleset_veteran(struct section_file *file,
                                  const char *path,
@@ -281,6 +301,32 @@ char *get_parser_buffer(void)
   return parser_buffer;
 }
 
+/**********************************************************************//**
+  Return the directory where the parsed ruleset files are cached, or NULL
+  if they are not. The cache is shared by all the programs loading
+  rulesets, server and tools.
+**************************************************************************/
+static const char *ruleset_cache_dir(void)
+{
+  static char cache_dir[MAX_LEN_PATH] = "";
+  const char *sdir;
+
+  if (cache_dir[0] != '\0') {
+    return cache_dir;
+  }
+
+  sdir = freeciv_storage_dir();
+  if (sdir == NULL) {
+    return NULL;
+  }
+
+  fc_snprintf(cache_dir, sizeof(cache_dir),
+              "%s" DIR_SEPARATOR "cache" DIR_SEPARATOR "rulesets", sdir);
+  make_dir(cache_dir);
+
+  return cache_dir;
+}
+
 /**********************************************************************//**
   Do initial section_file_load on a ruleset file.
   "whichset" = "techs", "units", "buildings", "terrain", ...
@@ -300,7 +346,7 @@ static struct section_file *openload_ruleset_file(const char *whichset,
   /* Need to save a copy of the filename for following message, since
      section_file_load() may call datafilename() for includes. */
   sz_strlcpy(sfilename, dfilename);
-  secfile = secfile_load(sfilename, FALSE);
+  secfile = secfile_load_cached(sfilename, ruleset_cache_dir(), FALSE);
 
   if (secfile == NULL) {
     ruleset_error(LOG_ERROR, "Could not load ruleset '%s':\n%s",
@@ -310,6 +356,76 @@ static struct section_file *openload_ruleset_file(const char *whichset,
   return secfile;
 }
 
+/* A ruleset file parsed by openload_ruleset_files(). */
+struct ruleset_file_load {
+  char filename[512];           /* empty when not found */
+  const char *cache_dir;
+  struct section_file *secfile;
+  char error[1024];             /* secfile_error() when loading failed */
+};
+
+/**********************************************************************//**
+  Parse one of the ruleset files of openload_ruleset_files(). Run in
+  parallel for all of them.
+**************************************************************************/
+static void openload_ruleset_file_thread(int index, void *data)
+{
+  struct ruleset_file_load *pload = (struct ruleset_file_load *) data + index;
+
+  if (pload->filename[0] != '\0') {
+    pload->secfile = secfile_load_cached(pload->filename, pload->cache_dir,
+                                         FALSE);
+    if (pload->secfile == NULL) {
+      /* The error buffer is per thread, so this is our own error. */
+      sz_strlcpy(pload->error, secfile_error());
+    }
+  }
+}
+
+/**********************************************************************//**
+  Do initial section_file_load on several ruleset files, like
+  openload_ruleset_file(). The files are found and the errors reported
+  in order, but they are parsed in parallel when secfile_error() can be
+  kept per thread.
+**************************************************************************/
+static void openload_ruleset_files(const char *rsdir, int count,
+                                   const char *const whichsets[],
+                                   struct section_file *secfiles[])
+{
+  struct ruleset_file_load loads[count];
+  const char *cache_dir = ruleset_cache_dir();
+#ifdef HAVE_C11_THREAD_LOCAL
+  struct fc_threadpool *pool = srv_threadpool();
+#else
+  struct fc_threadpool *pool = NULL;
+#endif
+  int i;
+
+  for (i = 0; i < count; i++) {
+    const char *dfilename = valid_ruleset_filename(rsdir, whichsets[i],
+                                                   RULES_SUFFIX, FALSE);
+
+    if (dfilename != NULL) {
+      sz_strlcpy(loads[i].filename, dfilename);
+    } else {
+      loads[i].filename[0] = '\0';
+    }
+    loads[i].cache_dir = cache_dir;
+    loads[i].secfile = NULL;
+    loads[i].error[0] = '\0';
+  }
+
+  fc_threadpool_run(pool, count, openload_ruleset_file_thread, loads);
+
+  for (i = 0; i < count; i++) {
+    if (loads[i].filename[0] != '\0' && loads[i].secfile == NULL) {
+      ruleset_error(LOG_ERROR, "Could not load ruleset '%s':\n%s",
+                    loads[i].filename, loads[i].error);
+    }
+    secfiles[i] = loads[i].secfile;
+  }
+}
+
 /**********************************************************************//**
   Parse script file.
 **************************************************************************/
@@ -8209,9 +8325,6 @@ static void send_ruleset_nations(struct conn_list *dest)
 
     lsend_packet_ruleset_nation(dest, &packet);
   } nations_iterate_end;
-
-  /* Send initial values of is_pickable */
-  send_nation_availability(dest, FALSE);
 }
 
 /**********************************************************************//**
@@ -8520,6 +8633,7 @@ void rulesets_deinit(void)
 {
   script_server_free();
   requirement_vector_free(&reqs_list);
+  ruleset_streams_free();
 }
 
 /**********************************************************************//**
@@ -8542,6 +8656,7 @@ static bool load_rulesetdir(const char *rsdir, bool compat_mode,
   compat_info.log_cb = logger;
 
   game_ruleset_free();
+  ruleset_streams_free();
   /* Reset the list of available player colors. */
   playercolor_free();
   playercolor_init();
@@ -8558,16 +8673,27 @@ static bool load_rulesetdir(const char *rsdir, bool compat_mode,
 
   server.playable_nations = 0;
 
-  techfile = openload_ruleset_file("techs", rsdir);
-  buildfile = openload_ruleset_file("buildings", rsdir);
-  govfile = openload_ruleset_file("governments", rsdir);
-  unitfile = openload_ruleset_file("units", rsdir);
-  terrfile = openload_ruleset_file("terrain", rsdir);
-  stylefile = openload_ruleset_file("styles", rsdir);
-  cityfile = openload_ruleset_file("cities", rsdir);
-  nationfile = openload_ruleset_file("nations", rsdir);
-  effectfile = openload_ruleset_file("effects", rsdir);
-  gamefile = openload_ruleset_file("game", rsdir);
+  {
+    /* The nations first, their many includes take the longest to parse. */
+    const char *const whichsets[] = {
+      "nations", "techs", "buildings", "governments", "units", "terrain",
+      "styles", "cities", "effects", "game"
+    };
+    struct section_file *secfiles[ARRAY_SIZE(whichsets)];
+
+    openload_ruleset_files(rsdir, ARRAY_SIZE(whichsets), whichsets,
+                           secfiles);
+    nationfile = secfiles[0];
+    techfile = secfiles[1];
+    buildfile = secfiles[2];
+    govfile = secfiles[3];
+    unitfile = secfiles[4];
+    terrfile = secfiles[5];
+    stylefile = secfiles[6];
+    cityfile = secfiles[7];
+    effectfile = secfiles[8];
+    gamefile = secfiles[9];
+  }
   if (load_luadata) {
     game.server.luadata = openload_luadata_file(rsdir);
   } else {
@@ -8727,6 +8853,7 @@ static bool load_rulesetdir(const char *rsdir, bool compat_mode,
     /* Populate remaining caches. */
     techs_precalc_data();
     improvement_feature_cache_init();
+    ruleset_cache_index_build();
     unit_class_iterate(pclass) {
       set_unit_class_caches(pclass);
     } unit_class_iterate_end;
@@ -8771,12 +8898,49 @@ bool reload_rulesets_settings(void)
 }
 
 /**********************************************************************//**
-  Send all ruleset information to the specified connections.
+  Free the recorded ruleset packets. To be done whenever the rulesets
+  change.
 **************************************************************************/
-void send_rulesets(struct conn_list *dest)
+static void ruleset_streams_free(void)
 {
-  conn_list_compression_freeze(dest);
+  if (ruleset_streams == NULL) {
+    return;
+  }
+
+  ruleset_stream_list_iterate(ruleset_streams, pstream) {
+    fc_assert(pstream->recorder == NULL);
+    byte_vector_free(&pstream->packets);
+    byte_vector_free(&pstream->frames);
+    free(pstream);
+  } ruleset_stream_list_iterate_end;
+  ruleset_stream_list_destroy(ruleset_streams);
+  ruleset_streams = NULL;
+}
+
+/**********************************************************************//**
+  Return the recorded ruleset packets for the capabilities of the
+  connection, or NULL.
+**************************************************************************/
+static struct ruleset_stream *ruleset_stream_get(const struct connection
+                                                 *pconn)
+{
+  if (ruleset_streams != NULL) {
+    ruleset_stream_list_iterate(ruleset_streams, pstream) {
+      if (0 == strcmp(pstream->capability, pconn->capability)) {
+        return pstream;
+      }
+    } ruleset_stream_list_iterate_end;
+  }
 
+  return NULL;
+}
+
+/**********************************************************************//**
+  Send the ruleset information which does not change until the rulesets
+  are loaded again.
+**************************************************************************/
+static void send_rulesets_static(struct conn_list *dest)
+{
   /* ruleset_control also indicates to client that ruleset sending starts. */
   send_ruleset_control(dest);
 
@@ -8808,6 +8972,76 @@ void send_rulesets(struct conn_list *dest)
   send_ruleset_multipliers(dest);
   send_ruleset_musics(dest);
   send_ruleset_cache(dest);
+}
+
+/**********************************************************************//**
+  Send all ruleset information to the specified connections.
+
+  The ruleset packets only depend on the capabilities of the connection,
+  so they are recorded, with their compressed form, the first time they
+  are sent to a connection, and later connections with the same
+  capabilities just get a copy.
+**************************************************************************/
+void send_rulesets(struct conn_list *dest)
+{
+  struct conn_list *encode = conn_list_new();
+
+  conn_list_compression_freeze(dest);
+
+  if (ruleset_streams == NULL) {
+    ruleset_streams = ruleset_stream_list_new();
+  }
+
+  conn_list_iterate(dest, pconn) {
+    struct ruleset_stream *pstream;
+
+#ifdef FREECIV_JSON_CONNECTION
+    if (pconn->json_mode) {
+      conn_list_append(encode, pconn);
+      continue;
+    }
+#endif /* FREECIV_JSON_CONNECTION */
+
+    pstream = ruleset_stream_get(pconn);
+    if (pstream != NULL && pstream->recorder == NULL) {
+      conn_send_packet_stream(pconn, &pstream->packets, &pstream->frames);
+      continue;
+    }
+
+    if (pstream == NULL && pconn->packet_record == NULL) {
+      pstream = fc_calloc(1, sizeof(*pstream));
+      sz_strlcpy(pstream->capability, pconn->capability);
+      byte_vector_init(&pstream->packets);
+      byte_vector_init(&pstream->frames);
+      pstream->recorder = pconn;
+      pconn->packet_record = &pstream->packets;
+      ruleset_stream_list_append(ruleset_streams, pstream);
+    }
+    conn_list_append(encode, pconn);
+  } conn_list_iterate_end;
+
+  if (conn_list_size(encode) > 0) {
+    send_rulesets_static(encode);
+  }
+
+  ruleset_stream_list_iterate(ruleset_streams, pstream) {
+    struct connection *recorder = pstream->recorder;
+
+    if (recorder != NULL) {
+      recorder->packet_record = NULL;
+      pstream->recorder = NULL;
+      if (!recorder->used || recorder->server.is_closing) {
+        /* The packets may not all have been recorded. */
+        ruleset_stream_list_remove(ruleset_streams, pstream);
+        byte_vector_free(&pstream->packets);
+        free(pstream);
+      }
+    }
+  } ruleset_stream_list_iterate_end;
+  conn_list_destroy(encode);
+
+  /* Send initial values of is_pickable */
+  send_nation_availability(dest, FALSE);
 
   /* Indicate client that all rulesets have now been sent. */
   lsend_packet_rulesets_ready(dest);
@@ -118,23 +118,33 @@ static void check_fow(const char *file, const char *function, int line)
 
   whole_map_iterate(&(wld.map), ptile) {
     players_iterate(pplayer) {
-      struct player_tile *plr_tile = map_get_player_tile(ptile, pplayer);
-
       vision_layer_iterate(v) {
         /* underflow of unsigned int */
-        SANITY_TILE(ptile, plr_tile->seen_count[v] < 30000);
-        SANITY_TILE(ptile, plr_tile->own_seen[v] < 30000);
-        SANITY_TILE(ptile, plr_tile->own_seen[v] <= plr_tile->seen_count[v]);
+        SANITY_TILE(ptile, map_get_seen(pplayer, ptile, v) < 30000);
+        SANITY_TILE(ptile, map_get_own_seen(pplayer, ptile, v) < 30000);
+        SANITY_TILE(ptile, map_get_own_seen(pplayer, ptile, v)
+                           <= map_get_seen(pplayer, ptile, v));
       } vision_layer_iterate_end;
 
       /* Lots of server bits depend on this. */
-      SANITY_TILE(ptile, plr_tile->seen_count[V_INVIS]
-		   <= plr_tile->seen_count[V_MAIN]);
-      SANITY_TILE(ptile, plr_tile->own_seen[V_INVIS]
-		   <= plr_tile->own_seen[V_MAIN]);
+      SANITY_TILE(ptile, map_get_seen(pplayer, ptile, V_INVIS)
+		   <= map_get_seen(pplayer, ptile, V_MAIN));
+      SANITY_TILE(ptile, map_get_own_seen(pplayer, ptile, V_INVIS)
+		   <= map_get_own_seen(pplayer, ptile, V_MAIN));
+      /* Kept up to date by map_change_own_seen(). */
+      SANITY_TILE(ptile, dbv_isset(&pplayer->server.own_seen_tiles,
+                                   tile_index(ptile))
+                  == (0 < map_get_own_seen(pplayer, ptile, V_MAIN)
+                      || 0 < map_get_own_seen(pplayer, ptile, V_INVIS)));
     } players_iterate_end;
   } whole_map_iterate_end;
 
+  players_iterate(pplayer) {
+    /* Kept up to date by map_set_known() and map_clear_known(). */
+    SANITY_CHECK(pplayer->server.known_tiles
+                 == dbv_count(&pplayer->tile_known));
+  } players_iterate_end;
+
   SANITY_CHECK(game.government_during_revolution != NULL);
   SANITY_CHECK(game.government_during_revolution
 	       == government_by_number(game.info.government_during_revolution_id));
@@ -190,8 +190,9 @@ extern bool sg_success;
  *                  will be the y coordinate
  * Example:
  *   LOAD_MAP_CHAR(ch, ptile,
- *                 map_get_player_tile(ptile, plr)->terrain
- *                   = char2terrain(ch), file, "player%d.map_t%04d", plrno);
+ *                 map_get_player_tile_writable(ptile, plr)->last_updated
+ *                   = ascii_hex2bin(ch, 0), file, "player%d.map_u00_%04d",
+ *                 plrno);
  *
  * Note: some (but not all) of the code this is replacing used to skip over
  *       lines that did not exist. This allowed for backward-compatibility.
@@ -2314,7 +2315,7 @@ static void sg_load_map_known(struct loaddata *loading)
     }
 
     players_iterate(pplayer) {
-      dbv_clr_all(&pplayer->tile_known);
+      map_clear_all_known(pplayer);
     } players_iterate_end;
 
     /* HACK: we read the known data from hex into 32-bit integers, and
@@ -3239,6 +3240,7 @@ static void sg_load_player_main(struct loaddata *loading,
         }
       }
     }
+    req_cache_invalidate();
   }
 
   plr->history =
@@ -4545,14 +4547,14 @@ static void sg_load_player_vision(struct loaddata *loading,
 
   /* Load player map (terrain). */
   LOAD_MAP_CHAR(ch, ptile,
-                map_get_player_tile(ptile, plr)->terrain
-                  = char2terrain(ch), loading->file,
+                player_tile_set_terrain(map_get_player_tile_writable(ptile, plr),
+                                          char2terrain(ch)), loading->file,
                 "player%d.map_t%04d", plrno);
 
   /* Load player map (resources). */
   LOAD_MAP_CHAR(ch, ptile,
-                map_get_player_tile(ptile, plr)->resource
-                  = char2resource(ch), loading->file,
+                player_tile_set_resource(map_get_player_tile_writable(ptile, plr),
+                                           char2resource(ch)), loading->file,
                 "player%d.map_res%04d", plrno);
 
   if (loading->version >= 30) {
@@ -4561,7 +4563,7 @@ static void sg_load_player_vision(struct loaddata *loading,
     /* Load player map (extras). */
     halfbyte_iterate_extras(j, loading->extra.size) {
       LOAD_MAP_CHAR(ch, ptile,
-                    sg_extras_set(&map_get_player_tile(ptile, plr)->extras,
+                    sg_extras_set(&map_get_player_tile_writable(ptile, plr)->extras,
                                   ch, loading->extra.order + 4 * j),
                     loading->file, "player%d.map_e%02d_%04d", plrno, j);
     } halfbyte_iterate_extras_end;
@@ -4569,7 +4571,7 @@ static void sg_load_player_vision(struct loaddata *loading,
     /* Load player map (specials). */
     halfbyte_iterate_special(j, loading->special.size) {
       LOAD_MAP_CHAR(ch, ptile,
-                    sg_special_set(ptile, &map_get_player_tile(ptile, plr)->extras,
+                    sg_special_set(ptile, &map_get_player_tile_writable(ptile, plr)->extras,
                                    ch, loading->special.order + 4 * j, FALSE),
                     loading->file, "player%d.map_spe%02d_%04d", plrno, j);
     } halfbyte_iterate_special_end;
@@ -4577,7 +4579,7 @@ static void sg_load_player_vision(struct loaddata *loading,
     /* Load player map (bases). */
     halfbyte_iterate_bases(j, loading->base.size) {
       LOAD_MAP_CHAR(ch, ptile,
-                    sg_bases_set(&map_get_player_tile(ptile, plr)->extras,
+                    sg_bases_set(&map_get_player_tile_writable(ptile, plr)->extras,
                                  ch, loading->base.order + 4 * j),
                     loading->file, "player%d.map_b%02d_%04d", plrno, j);
     } halfbyte_iterate_bases_end;
@@ -4587,7 +4589,7 @@ static void sg_load_player_vision(struct loaddata *loading,
       /* 2.5.0 or newer */
       halfbyte_iterate_roads(j, loading->road.size) {
         LOAD_MAP_CHAR(ch, ptile,
-                      sg_roads_set(&map_get_player_tile(ptile, plr)->extras,
+                      sg_roads_set(&map_get_player_tile_writable(ptile, plr)->extras,
                                    ch, loading->road.order + 4 * j),
                       loading->file, "player%d.map_r%02d_%04d", plrno, j);
       } halfbyte_iterate_roads_end;
@@ -4620,12 +4622,14 @@ static void sg_load_player_vision(struct loaddata *loading,
         sg_failure_ret('\0' != token[0],
                        "Savegame corrupt - map size not correct.");
         if (strcmp(token, "-") == 0) {
-          map_get_player_tile(ptile, plr)->owner = NULL;
+          player_tile_set_owner(map_get_player_tile_writable(ptile, plr),
+                                NULL);
         } else  {
           sg_failure_ret(str_to_int(token, &number),
                          "Savegame corrupt - got tile owner=%s in (%d, %d).",
                          token, x, y);
-          map_get_player_tile(ptile, plr)->owner = player_by_number(number);
+          player_tile_set_owner(map_get_player_tile_writable(ptile, plr),
+                                player_by_number(number));
         }
 
         if (loading->version >= 30) {
@@ -4633,15 +4637,17 @@ static void sg_load_player_vision(struct loaddata *loading,
           sg_failure_ret('\0' != token2[0],
                          "Savegame corrupt - map size not correct.");
           if (strcmp(token2, "-") == 0) {
-            map_get_player_tile(ptile, plr)->extras_owner = NULL;
+            player_tile_set_extras_owner(map_get_player_tile_writable(ptile, plr),
+                                         NULL);
           } else  {
             sg_failure_ret(str_to_int(token2, &number),
                            "Savegame corrupt - got extras owner=%s in (%d, %d).",
                            token, x, y);
-            map_get_player_tile(ptile, plr)->extras_owner = player_by_number(number);
+            player_tile_set_extras_owner(map_get_player_tile_writable(ptile, plr),
+                                         player_by_number(number));
           }
         } else {
-          map_get_player_tile(ptile, plr)->extras_owner
+          map_get_player_tile_writable(ptile, plr)->extras_owner
             = map_get_player_tile(ptile, plr)->owner;
         }
       }
@@ -4653,12 +4659,12 @@ static void sg_load_player_vision(struct loaddata *loading,
     /* put 4-bit segments of 16-bit "updated" field */
     if (i == 0) {
       LOAD_MAP_CHAR(ch, ptile,
-                    map_get_player_tile(ptile, plr)->last_updated
+                    map_get_player_tile_writable(ptile, plr)->last_updated
                       = ascii_hex2bin(ch, i),
                     loading->file, "player%d.map_u%02d_%04d", plrno, i);
     } else {
       LOAD_MAP_CHAR(ch, ptile,
-                    map_get_player_tile(ptile, plr)->last_updated
+                    map_get_player_tile_writable(ptile, plr)->last_updated
                       |= ascii_hex2bin(ch, i),
                     loading->file, "player%d.map_u%02d_%04d", plrno, i);
     }
@@ -4672,7 +4678,8 @@ static void sg_load_player_vision(struct loaddata *loading,
 
     pdcity = vision_site_new(0, NULL, NULL);
     if (sg_load_player_vision_city(loading, plr, pdcity, buf)) {
-      change_playertile_site(map_get_player_tile(pdcity->location, plr),
+      change_playertile_site(map_get_player_tile_writable(pdcity->location,
+                                                          plr),
                              pdcity);
       identity_number_reserve(pdcity->identity);
     } else {
@@ -4697,11 +4704,12 @@ static void sg_load_player_vision(struct loaddata *loading,
       }
     } else if (!game.server.foggedborders && map_is_known(ptile, plr)) {
       /* Non fogged borders aren't loaded. See hrm Bug #879084 */
-      struct player_tile *plrtile = map_get_player_tile(ptile, plr);
-
-      plrtile->owner = tile_owner(ptile);
+      player_tile_set_owner(map_get_player_tile_writable(ptile, plr),
+                            tile_owner(ptile));
     }
   } whole_map_iterate_end;
+
+  player_map_compact(plr);
 }
 
 /************************************************************************//**
@@ -74,6 +74,7 @@
 /* utility */
 #include "bitvector.h"
 #include "fcintl.h"
+#include "fcthreadpool.h"
 #include "idex.h"
 #include "log.h"
 #include "mem.h"
@@ -200,8 +201,9 @@ extern bool sg_success;
  *                  will be the y coordinate
  * Example:
  *   LOAD_MAP_CHAR(ch, ptile,
- *                 map_get_player_tile(ptile, plr)->terrain
- *                   = char2terrain(ch), file, "player%d.map_t%04d", plrno);
+ *                 map_get_player_tile_writable(ptile, plr)->last_updated
+ *                   = ascii_hex2bin(ch, 0), file, "player%d.map_u00_%04d",
+ *                 plrno);
  *
  * Note: some (but not all) of the code this is replacing used to skip over
  *       lines that did not exist. This allowed for backward-compatibility.
@@ -265,10 +267,41 @@ struct savedata {
 
   /* Set in sg_save_game(); needed in sg_save_map_*(); ... */
   bool save_players;
+
+  /* Set in sg_save_parts(); moved to 'file' by sg_save_map() and
+   * sg_save_players(). */
+  struct sg_save_part *parts;
+  int num_parts;
+};
+
+/* A part of the savegame made in its own section file by a worker thread:
+ * either a map layer or the private map of a player. */
+struct sg_save_part {
+  struct savedata saving;
+  void (*map_save)(struct savedata *saving);
+  struct player *pplayer;
 };
 
 #define TOKEN_SIZE 10
 
+/************************************************************************//**
+  Append a token, and a comma if wanted, at the end of a map line being
+  built. Returns the new end of the line.
+****************************************************************************/
+static char *sg_line_append(char *end, const char *token, bool comma)
+{
+  size_t len = strlen(token);
+
+  memcpy(end, token, len);
+  end += len;
+  if (comma) {
+    *end++ = ',';
+  }
+  *end = '\0';
+
+  return end;
+}
+
 static const char savefile_options_default[] =
   " +version3";
 /* The following savefile option are added if needed:
@@ -336,6 +369,9 @@ static void sg_load_settings(struct loaddata *loading);
 static void sg_save_settings(struct savedata *saving);
 
 static void sg_load_map(struct loaddata *loading);
+static void sg_save_parts(struct savedata *saving);
+static void sg_save_parts_move(struct savedata *saving,
+                               const struct player *pplayer);
 static void sg_save_map(struct savedata *saving);
 static void sg_load_map_tiles(struct loaddata *loading);
 static void sg_save_map_tiles(struct savedata *saving);
@@ -532,6 +568,8 @@ static void savegame3_save_real(struct section_file *file,
   sg_save_settings(saving);
   /* [ruledata] */
   sg_save_ruledata(saving);
+  /* Map layers and private maps of [map] and [player<i>] */
+  sg_save_parts(saving);
   /* [map] */
   sg_save_map(saving);
   /* [player<i>] */
@@ -671,6 +709,12 @@ static struct savedata *savedata_new(struct section_file *file,
 ****************************************************************************/
 static void savedata_destroy(struct savedata *saving)
 {
+  int i;
+
+  for (i = 0; i < saving->num_parts; i++) {
+    secfile_destroy(saving->parts[i].saving.file);
+  }
+  free(saving->parts);
   free(saving);
 }
 
@@ -2603,6 +2647,94 @@ static void sg_load_map(struct loaddata *loading)
   sg_load_map_worked(loading);
 }
 
+/************************************************************************//**
+  Make one part of the savegame. Called by the worker threads.
+****************************************************************************/
+static void sg_save_part_run(int index, void *data)
+{
+  struct sg_save_part *part = (struct sg_save_part *) data + index;
+
+  if (part->pplayer != NULL) {
+    sg_save_player_vision(&part->saving, part->pplayer);
+  } else {
+    part->map_save(&part->saving);
+  }
+}
+
+/************************************************************************//**
+  Make the map layers and the private maps of the players in parallel,
+  each part in its own section file. The game does not change while they
+  are made, so they are as consistent as the rest of the savegame. They
+  are moved to the savegame in the order of a serial save by
+  sg_save_parts_move(), without copying the values.
+****************************************************************************/
+static void sg_save_parts(struct savedata *saving)
+{
+  void (*map_save[])(struct savedata *saving) = {
+    sg_save_map_tiles,
+    sg_save_map_startpos,
+    sg_save_map_tiles_extras,
+    sg_save_map_owner,
+    sg_save_map_worked,
+    sg_save_map_known
+  };
+  bool save_map, save_vision;
+  int i, n = 0;
+
+  /* Check status and return if not OK (sg_success != TRUE). */
+  sg_check_ret();
+
+  /* Same conditions as in sg_save_map() and sg_save_players(). */
+  save_map = !map_is_empty();
+  save_vision = !((saving->scenario && !saving->save_players)
+                  || !game_was_started());
+
+  saving->num_parts = (save_map ? ARRAY_SIZE(map_save) : 0)
+                      + (save_vision ? player_count() : 0);
+  if (0 == saving->num_parts) {
+    return;
+  }
+  saving->parts = fc_calloc(saving->num_parts, sizeof(*saving->parts));
+
+  for (i = 0; i < saving->num_parts; i++) {
+    saving->parts[i].saving = *saving;
+    saving->parts[i].saving.parts = NULL;
+    saving->parts[i].saving.num_parts = 0;
+    saving->parts[i].saving.file = secfile_new(TRUE);
+  }
+
+  if (save_map) {
+    for (i = 0; i < ARRAY_SIZE(map_save); i++) {
+      saving->parts[n++].map_save = map_save[i];
+    }
+  }
+  if (save_vision) {
+    players_iterate(pplayer) {
+      saving->parts[n++].pplayer = pplayer;
+    } players_iterate_end;
+  }
+  fc_assert(n == saving->num_parts);
+
+  fc_threadpool_run(srv_threadpool(), saving->num_parts, sg_save_part_run,
+                    saving->parts);
+}
+
+/************************************************************************//**
+  Move to the savegame the parts made by sg_save_parts() for the player,
+  or the map layers if pplayer is NULL.
+****************************************************************************/
+static void sg_save_parts_move(struct savedata *saving,
+                               const struct player *pplayer)
+{
+  int i;
+
+  for (i = 0; i < saving->num_parts; i++) {
+    if (saving->parts[i].pplayer == pplayer) {
+      secfile_move_entries(saving->file, saving->parts[i].saving.file);
+    }
+  }
+}
+
 /************************************************************************//**
   Save 'map'.
 ****************************************************************************/
@@ -2635,12 +2767,8 @@ static void sg_save_map(struct savedata *saving)
                        "map.random_seed");
   }
 
-  sg_save_map_tiles(saving);
-  sg_save_map_startpos(saving);
-  sg_save_map_tiles_extras(saving);
-  sg_save_map_owner(saving);
-  sg_save_map_worked(saving);
-  sg_save_map_known(saving);
+  /* The layers made by sg_save_parts(). */
+  sg_save_parts_move(saving, NULL);
 }
 
 /************************************************************************//**
@@ -3049,6 +3177,7 @@ static void sg_save_map_owner(struct savedata *saving)
   /* Store owner and ownership source as plain numbers. */
   for (y = 0; y < wld.map.ysize; y++) {
     char line[wld.map.xsize * TOKEN_SIZE];
+    char *end = line;
 
     line[0] = '\0';
     for (x = 0; x < wld.map.xsize; x++) {
@@ -3061,16 +3190,14 @@ static void sg_save_map_owner(struct savedata *saving)
         fc_snprintf(token, sizeof(token), "%d",
                     player_number(tile_owner(ptile)));
       }
-      strcat(line, token);
-      if (x + 1 < wld.map.xsize) {
-        strcat(line, ",");
-      }
+      end = sg_line_append(end, token, x + 1 < wld.map.xsize);
     }
     secfile_insert_str(saving->file, line, "map.owner%04d", y);
   }
 
   for (y = 0; y < wld.map.ysize; y++) {
     char line[wld.map.xsize * TOKEN_SIZE];
+    char *end = line;
 
     line[0] = '\0';
     for (x = 0; x < wld.map.xsize; x++) {
@@ -3082,16 +3209,14 @@ static void sg_save_map_owner(struct savedata *saving)
       } else {
         fc_snprintf(token, sizeof(token), "%d", tile_index(ptile->claimer));
       }
-      strcat(line, token);
-      if (x + 1 < wld.map.xsize) {
-        strcat(line, ",");
-      }
+      end = sg_line_append(end, token, x + 1 < wld.map.xsize);
     }
     secfile_insert_str(saving->file, line, "map.source%04d", y);
   }
 
   for (y = 0; y < wld.map.ysize; y++) {
     char line[wld.map.xsize * TOKEN_SIZE];
+    char *end = line;
 
     line[0] = '\0';
     for (x = 0; x < wld.map.xsize; x++) {
@@ -3104,16 +3229,14 @@ static void sg_save_map_owner(struct savedata *saving)
         fc_snprintf(token, sizeof(token), "%d",
                     player_number(extra_owner(ptile)));
       }
-      strcat(line, token);
-      if (x + 1 < wld.map.xsize) {
-        strcat(line, ",");
-      }
+      end = sg_line_append(end, token, x + 1 < wld.map.xsize);
     }
     secfile_insert_str(saving->file, line, "map.eowner%04d", y);
   }
 
   for (y = 0; y < wld.map.ysize; y++) {
     char line[wld.map.xsize * TOKEN_SIZE];
+    char *end = line;
 
     line[0] = '\0';
     for (x = 0; x < wld.map.xsize; x++) {
@@ -3126,16 +3249,14 @@ static void sg_save_map_owner(struct savedata *saving)
         fc_snprintf(token, sizeof(token), "%d",
                     extra_number(ptile->placing));
       }
-      strcat(line, token);
-      if (x + 1 < wld.map.xsize) {
-        strcat(line, ",");
-      }
+      end = sg_line_append(end, token, x + 1 < wld.map.xsize);
     }
     secfile_insert_str(saving->file, line, "map.placing%04d", y);
   }
 
   for (y = 0; y < wld.map.ysize; y++) {
     char line[wld.map.xsize * TOKEN_SIZE];
+    char *end = line;
 
     line[0] = '\0';
     for (x = 0; x < wld.map.xsize; x++) {
@@ -3148,10 +3269,7 @@ static void sg_save_map_owner(struct savedata *saving)
       } else {
         fc_snprintf(token, sizeof(token), "0"); 
       }
-      strcat(line, token);
-      if (x + 1 < wld.map.xsize) {
-        strcat(line, ",");
-      }
+      end = sg_line_append(end, token, x + 1 < wld.map.xsize);
     }
     secfile_insert_str(saving->file, line, "map.infra_turns%04d", y);
   }
@@ -3219,6 +3337,7 @@ static void sg_save_map_worked(struct savedata *saving)
   /* additionally save the tiles worked by the cities */
   for (y = 0; y < wld.map.ysize; y++) {
     char line[wld.map.xsize * TOKEN_SIZE];
+    char *end = line;
 
     line[0] = '\0';
     for (x = 0; x < wld.map.xsize; x++) {
@@ -3231,10 +3350,7 @@ static void sg_save_map_worked(struct savedata *saving)
       } else {
         fc_snprintf(token, sizeof(token), "%d", pcity->id);
       }
-      strcat(line, token);
-      if (x < wld.map.xsize) {
-        strcat(line, ",");
-      }
+      end = sg_line_append(end, token, x < wld.map.xsize);
     }
     secfile_insert_str(saving->file, line, "map.worked%04d", y);
   }
@@ -3276,7 +3392,7 @@ static void sg_load_map_known(struct loaddata *loading)
     }
 
     players_iterate(pplayer) {
-      dbv_clr_all(&pplayer->tile_known);
+      map_clear_all_known(pplayer);
     } players_iterate_end;
 
     /* HACK: we read the known data from hex into 32-bit integers, and
@@ -3823,7 +3939,8 @@ static void sg_save_players(struct savedata *saving)
     sg_save_player_cities(saving, pplayer);
     sg_save_player_units(saving, pplayer);
     sg_save_player_attributes(saving, pplayer);
-    sg_save_player_vision(saving, pplayer);
+    /* sg_save_player_vision(), done by sg_save_parts(). */
+    sg_save_parts_move(saving, pplayer);
   } players_iterate_end;
 }
 
@@ -4297,6 +4414,7 @@ static void sg_load_player_main(struct loaddata *loading,
         }
       }
     }
+    req_cache_invalidate();
   }
 
   plr->history =
@@ -6603,14 +6721,14 @@ static void sg_load_player_vision(struct loaddata *loading,
 
   /* Load player map (terrain). */
   LOAD_MAP_CHAR(ch, ptile,
-                map_get_player_tile(ptile, plr)->terrain
-                  = char2terrain(ch), loading->file,
+                player_tile_set_terrain(map_get_player_tile_writable(ptile, plr),
+                                          char2terrain(ch)), loading->file,
                 "player%d.map_t%04d", plrno);
 
   /* Load player map (extras). */
   halfbyte_iterate_extras(j, loading->extra.size) {
     LOAD_MAP_CHAR(ch, ptile,
-                  sg_extras_set(&map_get_player_tile(ptile, plr)->extras,
+                  sg_extras_set(&map_get_player_tile_writable(ptile, plr)->extras,
                                 ch, loading->extra.order + 4 * j),
                   loading->file, "player%d.map_e%02d_%04d", plrno, j);
   } halfbyte_iterate_extras_end;
@@ -6641,24 +6759,28 @@ static void sg_load_player_vision(struct loaddata *loading,
         sg_failure_ret('\0' != token[0],
                        "Savegame corrupt - map size not correct.");
         if (strcmp(token, "-") == 0) {
-          map_get_player_tile(ptile, plr)->owner = NULL;
+          player_tile_set_owner(map_get_player_tile_writable(ptile, plr),
+                                NULL);
         } else  {
           sg_failure_ret(str_to_int(token, &number),
                          "Savegame corrupt - got tile owner=%s in (%d, %d).",
                          token, x, y);
-          map_get_player_tile(ptile, plr)->owner = player_by_number(number);
+          player_tile_set_owner(map_get_player_tile_writable(ptile, plr),
+                                player_by_number(number));
         }
 
         scanin(&ptr2, ",", token2, sizeof(token2));
         sg_failure_ret('\0' != token2[0],
                        "Savegame corrupt - map size not correct.");
         if (strcmp(token2, "-") == 0) {
-          map_get_player_tile(ptile, plr)->extras_owner = NULL;
+          player_tile_set_extras_owner(map_get_player_tile_writable(ptile, plr),
+                                       NULL);
         } else  {
           sg_failure_ret(str_to_int(token2, &number),
                          "Savegame corrupt - got extras owner=%s in (%d, %d).",
                          token, x, y);
-          map_get_player_tile(ptile, plr)->extras_owner = player_by_number(number);
+          player_tile_set_extras_owner(map_get_player_tile_writable(ptile, plr),
+                                       player_by_number(number));
         }
       }
     }
@@ -6669,12 +6791,12 @@ static void sg_load_player_vision(struct loaddata *loading,
     /* put 4-bit segments of 16-bit "updated" field */
     if (i == 0) {
       LOAD_MAP_CHAR(ch, ptile,
-                    map_get_player_tile(ptile, plr)->last_updated
+                    map_get_player_tile_writable(ptile, plr)->last_updated
                       = ascii_hex2bin(ch, i),
                     loading->file, "player%d.map_u%02d_%04d", plrno, i);
     } else {
       LOAD_MAP_CHAR(ch, ptile,
-                    map_get_player_tile(ptile, plr)->last_updated
+                    map_get_player_tile_writable(ptile, plr)->last_updated
                       |= ascii_hex2bin(ch, i),
                     loading->file, "player%d.map_u%02d_%04d", plrno, i);
     }
@@ -6688,7 +6810,8 @@ static void sg_load_player_vision(struct loaddata *loading,
 
     pdcity = vision_site_new(0, NULL, NULL);
     if (sg_load_player_vision_city(loading, plr, pdcity, buf)) {
-      change_playertile_site(map_get_player_tile(pdcity->location, plr),
+      change_playertile_site(map_get_player_tile_writable(pdcity->location,
+                                                          plr),
                              pdcity);
       identity_number_reserve(pdcity->identity);
     } else {
@@ -6713,11 +6836,12 @@ static void sg_load_player_vision(struct loaddata *loading,
       }
     } else if (!game.server.foggedborders && map_is_known(ptile, plr)) {
       /* Non fogged borders aren't loaded. See hrm Bug #879084 */
-      struct player_tile *plrtile = map_get_player_tile(ptile, plr);
-
-      plrtile->owner = tile_owner(ptile);
+      player_tile_set_owner(map_get_player_tile_writable(ptile, plr),
+                            tile_owner(ptile));
     }
   } whole_map_iterate_end;
+
+  player_map_compact(plr);
 }
 
 /************************************************************************//**
@@ -6845,7 +6969,8 @@ static void sg_save_player_vision(struct savedata *saving,
 
   /* Save the map (terrain). */
   SAVE_MAP_CHAR(ptile,
-                terrain2char(map_get_player_tile(ptile, plr)->terrain),
+                terrain2char(player_tile_terrain(
+                  map_get_player_tile(ptile, plr))),
                 saving->file, "player%d.map_t%04d", plrno);
 
   if (game.server.foggedborders) {
@@ -6854,23 +6979,20 @@ static void sg_save_player_vision(struct savedata *saving,
 
     for (y = 0; y < wld.map.ysize; y++) {
       char line[wld.map.xsize * TOKEN_SIZE];
+      char *end = line;
 
       line[0] = '\0';
       for (x = 0; x < wld.map.xsize; x++) {
         char token[TOKEN_SIZE];
         struct tile *ptile = native_pos_to_tile(&(wld.map), x, y);
-        struct player_tile *plrtile = map_get_player_tile(ptile, plr);
+        const struct player_tile *plrtile = map_get_player_tile(ptile, plr);
 
-        if (plrtile == NULL || plrtile->owner == NULL) {
+        if (plrtile == NULL || plrtile->owner < 0) {
           strcpy(token, "-");
         } else {
-          fc_snprintf(token, sizeof(token), "%d",
-                      player_number(plrtile->owner));
-        }
-        strcat(line, token);
-        if (x < wld.map.xsize) {
-          strcat(line, ",");
+          fc_snprintf(token, sizeof(token), "%d", plrtile->owner);
         }
+        end = sg_line_append(end, token, x < wld.map.xsize);
       }
       secfile_insert_str(saving->file, line, "player%d.map_owner%04d",
                          plrno, y);
@@ -6878,23 +7000,20 @@ static void sg_save_player_vision(struct savedata *saving,
 
     for (y = 0; y < wld.map.ysize; y++) {
       char line[wld.map.xsize * TOKEN_SIZE];
+      char *end = line;
 
       line[0] = '\0';
       for (x = 0; x < wld.map.xsize; x++) {
         char token[TOKEN_SIZE];
         struct tile *ptile = native_pos_to_tile(&(wld.map), x, y);
-        struct player_tile *plrtile = map_get_player_tile(ptile, plr);
+        const struct player_tile *plrtile = map_get_player_tile(ptile, plr);
 
-        if (plrtile == NULL || plrtile->extras_owner == NULL) {
+        if (plrtile == NULL || plrtile->extras_owner < 0) {
           strcpy(token, "-");
         } else {
-          fc_snprintf(token, sizeof(token), "%d",
-                      player_number(plrtile->extras_owner));
-        }
-        strcat(line, token);
-        if (x < wld.map.xsize) {
-          strcat(line, ",");
+          fc_snprintf(token, sizeof(token), "%d", plrtile->extras_owner);
         }
+        end = sg_line_append(end, token, x < wld.map.xsize);
       }
       secfile_insert_str(saving->file, line, "player%d.extras_owner%04d",
                          plrno, y);
@@ -6916,7 +7035,8 @@ static void sg_save_player_vision(struct savedata *saving,
 
     SAVE_MAP_CHAR(ptile,
                   sg_extras_get(map_get_player_tile(ptile, plr)->extras,
-                                map_get_player_tile(ptile, plr)->resource,
+                                player_tile_resource(
+                                  map_get_player_tile(ptile, plr)),
                                 mod),
                   saving->file, "player%d.map_e%02d_%04d", plrno, j);
   } halfbyte_iterate_extras_end;
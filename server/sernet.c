@@ -45,6 +45,9 @@
 #include <readline/history.h>
 #include <readline/readline.h>
 #endif
+#ifdef HAVE_SYS_EPOLL_H
+#include <sys/epoll.h>
+#endif
 #ifdef HAVE_SYS_SELECT_H
 #include <sys/select.h>
 #endif
@@ -122,6 +125,42 @@ static int socklan;
 
 #define PROCESSING_TIME_STATISTICS 0
 
+#if defined(HAVE_SYS_EPOLL_H) && !defined(FREECIV_SOCKET_ZERO_NOT_STDIN)
+/* Wait for the sockets with epoll where possible. select() is used when
+ * it is not available, or when the epoll instances cannot be made. */
+#define SERNET_EPOLL
+#define SERNET_EPOLL_EVENTS 64
+#endif
+
+/* The readiness of the connection sockets. With select() it is found
+ * again by every wait. With epoll the connection sockets are edge
+ * triggered, so a flag stays set until a read or a write would block. */
+static struct {
+  bool read;
+  bool write;
+  bool except;
+  bool queued;
+} conn_ready[MAX_NUM_CONNECTIONS];
+
+/* The connections to read from or with an exception, in the order they
+ * got ready. */
+static int ready_queue[MAX_NUM_CONNECTIONS];
+static int ready_count = 0;
+
+/* Server operator input and listening sockets found ready by the last
+ * wait of server_sniff_all_input(). */
+static bool input_ready = FALSE;
+static bool *listen_ready = NULL;
+static bool listen_except = FALSE;
+
+#ifdef SERNET_EPOLL
+static int conn_epoll = -1;  /* The connection sockets, edge triggered. */
+static int sniff_epoll = -1; /* The listening sockets, the server operator
+                              * input and conn_epoll. */
+static bool input_watched = FALSE;
+static bool input_always_ready = FALSE; /* E.g. stdin is a regular file. */
+#endif /* SERNET_EPOLL */
+
 static int server_accept_connection(int sockfd);
 static void start_processing_request(struct connection *pconn,
                                      int request_id);
@@ -134,6 +173,454 @@ static void send_lanserver_response(void);
 
 static bool no_input = FALSE;
 
+/*************************************************************************//**
+  Put the connection in the ready queue, if not already there.
+*****************************************************************************/
+static void conn_ready_queue(int i)
+{
+  if (!conn_ready[i].queued) {
+    conn_ready[i].queued = TRUE;
+    ready_queue[ready_count++] = i;
+  }
+}
+
+/*************************************************************************//**
+  Remove from the ready queue the connections with nothing left to read
+  and no exception.
+*****************************************************************************/
+static void conn_ready_compact(void)
+{
+  int i, j = 0;
+
+  for (i = 0; i < ready_count; i++) {
+    int k = ready_queue[i];
+
+    if (connections[k].used && !connections[k].server.is_closing
+        && (conn_ready[k].read || conn_ready[k].except)) {
+      ready_queue[j++] = k;
+    } else {
+      conn_ready[k].queued = FALSE;
+    }
+  }
+  ready_count = j;
+}
+
+/*************************************************************************//**
+  Forget the readiness of all the connections.
+*****************************************************************************/
+static void conn_ready_clear_all(void)
+{
+  int i;
+
+  for (i = 0; i < MAX_NUM_CONNECTIONS; i++) {
+    conn_ready[i].read = FALSE;
+    conn_ready[i].write = FALSE;
+    conn_ready[i].except = FALSE;
+    conn_ready[i].queued = FALSE;
+  }
+  ready_count = 0;
+}
+
+/*************************************************************************//**
+  Start watching the socket of a new connection. Returns FALSE if it
+  cannot be done.
+*****************************************************************************/
+static bool conn_watch(int i, int sock)
+{
+  conn_ready[i].read = FALSE;
+  conn_ready[i].write = FALSE;
+  conn_ready[i].except = FALSE;
+
+#ifdef SERNET_EPOLL
+  if (conn_epoll >= 0) {
+    struct epoll_event ev;
+
+    ev.events = EPOLLIN | EPOLLOUT | EPOLLPRI | EPOLLRDHUP | EPOLLET;
+    ev.data.u64 = 0;
+    ev.data.u32 = i;
+    if (epoll_ctl(conn_epoll, EPOLL_CTL_ADD, sock, &ev) == -1) {
+      log_error("epoll_ctl() failed for a new connection: %s",
+                fc_strerror(fc_get_errno()));
+      return FALSE;
+    }
+  }
+#endif /* SERNET_EPOLL */
+
+  return TRUE;
+}
+
+/*************************************************************************//**
+  Stop watching the socket of a connection, before it is closed.
+*****************************************************************************/
+static void conn_unwatch(struct connection *pconn)
+{
+  int i = pconn - connections;
+
+#ifdef SERNET_EPOLL
+  if (conn_epoll >= 0) {
+    struct epoll_event ev;
+
+    /* The event is ignored, but old kernels want one. */
+    (void) epoll_ctl(conn_epoll, EPOLL_CTL_DEL, pconn->sock, &ev);
+  }
+#endif /* SERNET_EPOLL */
+
+  conn_ready[i].read = FALSE;
+  conn_ready[i].write = FALSE;
+  conn_ready[i].except = FALSE;
+}
+
+#ifdef SERNET_EPOLL
+/*************************************************************************//**
+  Return whether a connection has data to send and a socket ready for it.
+*****************************************************************************/
+static bool conn_write_ready(void)
+{
+  conn_list_iterate(game.all_connections, pconn) {
+    if (!pconn->server.is_closing
+        && 0 < pconn->send_buffer->ndata
+        && conn_ready[pconn - connections].write) {
+      return TRUE;
+    }
+  } conn_list_iterate_end;
+
+  return FALSE;
+}
+
+/*************************************************************************//**
+  Make the epoll instances and watch the listening sockets. On failure,
+  the select() backend is used.
+*****************************************************************************/
+static void sernet_epoll_init(void)
+{
+  struct epoll_event ev;
+  int i;
+
+  conn_epoll = epoll_create1(EPOLL_CLOEXEC);
+  sniff_epoll = epoll_create1(EPOLL_CLOEXEC);
+  if (conn_epoll < 0 || sniff_epoll < 0) {
+    goto failed;
+  }
+
+  ev.events = EPOLLIN;
+  ev.data.u64 = 0;
+  ev.data.fd = conn_epoll;
+  if (epoll_ctl(sniff_epoll, EPOLL_CTL_ADD, conn_epoll, &ev) == -1) {
+    goto failed;
+  }
+
+  for (i = 0; i < listen_count; i++) {
+    ev.events = EPOLLIN | EPOLLPRI;
+    ev.data.u64 = 0;
+    ev.data.fd = listen_socks[i];
+    if (epoll_ctl(sniff_epoll, EPOLL_CTL_ADD, listen_socks[i], &ev) == -1) {
+      goto failed;
+    }
+  }
+
+  input_watched = FALSE;
+  input_always_ready = FALSE;
+  log_verbose("Using epoll for the server sockets.");
+  return;
+
+failed:
+  log_verbose("Cannot use epoll (%s), using select().",
+              fc_strerror(fc_get_errno()));
+  if (conn_epoll >= 0) {
+    close(conn_epoll);
+    conn_epoll = -1;
+  }
+  if (sniff_epoll >= 0) {
+    close(sniff_epoll);
+    sniff_epoll = -1;
+  }
+}
+
+/*************************************************************************//**
+  Close the epoll instances.
+*****************************************************************************/
+static void sernet_epoll_close(void)
+{
+  if (conn_epoll >= 0) {
+    close(conn_epoll);
+    conn_epoll = -1;
+  }
+  if (sniff_epoll >= 0) {
+    close(sniff_epoll);
+    sniff_epoll = -1;
+  }
+}
+
+/*************************************************************************//**
+  Watch the server operator input as long as there is some.
+*****************************************************************************/
+static void sernet_epoll_watch_input(void)
+{
+  struct epoll_event ev;
+
+  if (!no_input && !input_watched && !input_always_ready) {
+    ev.events = EPOLLIN;
+    ev.data.u64 = 0;
+    ev.data.fd = 0;
+    if (epoll_ctl(sniff_epoll, EPOLL_CTL_ADD, 0, &ev) == 0) {
+      input_watched = TRUE;
+    } else {
+      /* Regular files cannot be watched, but are always readable. */
+      input_always_ready = TRUE;
+    }
+  } else if (no_input && input_watched) {
+    (void) epoll_ctl(sniff_epoll, EPOLL_CTL_DEL, 0, &ev);
+    input_watched = FALSE;
+  }
+}
+
+/*************************************************************************//**
+  Collect the events of the connection sockets, waiting for up to
+  'timeout' milliseconds. Returns the number of events.
+*****************************************************************************/
+static int sernet_epoll_conns(int timeout)
+{
+  struct epoll_event events[SERNET_EPOLL_EVENTS];
+  int n, i, total = 0;
+
+  do {
+    n = epoll_wait(conn_epoll, events, ARRAY_SIZE(events), timeout);
+
+    for (i = 0; i < n; i++) {
+      int k = events[i].data.u32;
+
+      if (!connections[k].used) {
+        continue;
+      }
+      if (events[i].events & (EPOLLIN | EPOLLERR | EPOLLHUP | EPOLLRDHUP)) {
+        /* Errors and hangups are found by reading. */
+        conn_ready[k].read = TRUE;
+        conn_ready_queue(k);
+      }
+      if (events[i].events & EPOLLOUT) {
+        conn_ready[k].write = TRUE;
+      }
+      if (events[i].events & EPOLLPRI) {
+        conn_ready[k].except = TRUE;
+        conn_ready_queue(k);
+      }
+    }
+    total += MAX(n, 0);
+    timeout = 0;
+  } while (n == ARRAY_SIZE(events));
+
+  return total;
+}
+
+/*************************************************************************//**
+  Wait for up to 'seconds' for something to do in
+  server_sniff_all_input(), with epoll. Returns 0 on timeout.
+*****************************************************************************/
+static int sniff_wait_epoll(int seconds)
+{
+  struct epoll_event events[SERNET_EPOLL_EVENTS];
+  int timeout = seconds * 1000;
+  bool write_ready = conn_write_ready();
+  int n, i, j;
+
+  sernet_epoll_watch_input();
+
+  input_ready = FALSE;
+  listen_except = FALSE;
+  for (i = 0; i < listen_count; i++) {
+    listen_ready[i] = FALSE;
+  }
+
+  if (0 < ready_count || write_ready
+      || (input_always_ready && !no_input)) {
+    /* Something is left from the previous round. */
+    timeout = 0;
+  }
+
+  n = epoll_wait(sniff_epoll, events, ARRAY_SIZE(events), timeout);
+  for (i = 0; i < n; i++) {
+    int fd = events[i].data.fd;
+
+    if (fd == conn_epoll) {
+      (void) sernet_epoll_conns(0);
+      write_ready = write_ready || conn_write_ready();
+    } else if (fd == 0) {
+      input_ready = TRUE;
+    } else {
+      for (j = 0; j < listen_count; j++) {
+        if (listen_socks[j] == fd) {
+          if (events[i].events & EPOLLPRI) {
+            listen_except = TRUE;
+          }
+          if (events[i].events & EPOLLIN) {
+            listen_ready[j] = TRUE;
+          }
+        }
+      }
+    }
+  }
+
+  if (input_always_ready && !no_input) {
+    input_ready = TRUE;
+  }
+
+  return MAX(n, 0) + ready_count + (input_ready ? 1 : 0)
+         + (write_ready ? 1 : 0);
+}
+#endif /* SERNET_EPOLL */
+
+/*************************************************************************//**
+  Wait for up to 'seconds' for something to do in
+  server_sniff_all_input(), with select(). Returns 0 on timeout.
+*****************************************************************************/
+static int sniff_wait_select(int seconds)
+{
+  int i, n;
+  int max_desc;
+  fd_set readfs, writefs, exceptfs;
+  fc_timeval tv;
+
+  tv.tv_sec = seconds;
+  tv.tv_usec = 0;
+
+  FC_FD_ZERO(&readfs);
+  FC_FD_ZERO(&writefs);
+  FC_FD_ZERO(&exceptfs);
+
+  if (!no_input) {
+#ifdef FREECIV_SOCKET_ZERO_NOT_STDIN
+    fc_init_console();
+#else /* FREECIV_SOCKET_ZERO_NOT_STDIN */
+#   if !defined(__VMS)
+    FD_SET(0, &readfs);
+#   endif /* VMS */
+#endif /* FREECIV_SOCKET_ZERO_NOT_STDIN */
+  }
+
+  max_desc = 0;
+  for (i = 0; i < listen_count; i++) {
+    FD_SET(listen_socks[i], &readfs);
+    FD_SET(listen_socks[i], &exceptfs);
+    max_desc = MAX(max_desc, listen_socks[i]);
+  }
+
+  for (i = 0; i < MAX_NUM_CONNECTIONS; i++) {
+    struct connection *pconn = connections + i;
+
+    if (pconn->used && !pconn->server.is_closing) {
+      FD_SET(pconn->sock, &readfs);
+      if (0 < pconn->send_buffer->ndata) {
+        FD_SET(pconn->sock, &writefs);
+      }
+      FD_SET(pconn->sock, &exceptfs);
+      max_desc = MAX(pconn->sock, max_desc);
+    }
+  }
+
+  n = fc_select(max_desc + 1, &readfs, &writefs, &exceptfs, &tv);
+
+  conn_ready_clear_all();
+  input_ready = FALSE;
+  listen_except = FALSE;
+  for (i = 0; i < listen_count; i++) {
+    listen_ready[i] = FALSE;
+  }
+
+  if (n <= 0) {
+    return n;
+  }
+
+#if !defined(FREECIV_SOCKET_ZERO_NOT_STDIN) && !defined(__VMS)
+  input_ready = (!no_input && FD_ISSET(0, &readfs));
+#endif
+
+  for (i = 0; i < listen_count; i++) {
+    listen_except = listen_except || FD_ISSET(listen_socks[i], &exceptfs);
+    listen_ready[i] = FD_ISSET(listen_socks[i], &readfs);
+  }
+
+  for (i = 0; i < MAX_NUM_CONNECTIONS; i++) {
+    struct connection *pconn = connections + i;
+
+    if (pconn->used && !pconn->server.is_closing) {
+      conn_ready[i].read = FD_ISSET(pconn->sock, &readfs);
+      conn_ready[i].write = FD_ISSET(pconn->sock, &writefs);
+      conn_ready[i].except = FD_ISSET(pconn->sock, &exceptfs);
+      if (conn_ready[i].read || conn_ready[i].except) {
+        conn_ready_queue(i);
+      }
+    }
+  }
+
+  return n;
+}
+
+/*************************************************************************//**
+  Wait for up to 'seconds' for something to do in
+  server_sniff_all_input(). Returns 0 on timeout.
+*****************************************************************************/
+static int sniff_wait(int seconds)
+{
+#ifdef SERNET_EPOLL
+  if (sniff_epoll >= 0) {
+    return sniff_wait_epoll(seconds);
+  }
+#endif /* SERNET_EPOLL */
+
+  return sniff_wait_select(seconds);
+}
+
+/*************************************************************************//**
+  Wait for up to 'seconds' until a connection with data to send can
+  write, or has an exception. Returns 0 on timeout.
+*****************************************************************************/
+static int flush_wait(int seconds)
+{
+  int max_desc;
+  fd_set writefs, exceptfs;
+  fc_timeval tv;
+  int n;
+
+#ifdef SERNET_EPOLL
+  if (conn_epoll >= 0) {
+    if (conn_write_ready()) {
+      return 1;
+    }
+    return sernet_epoll_conns(seconds * 1000);
+  }
+#endif /* SERNET_EPOLL */
+
+  tv.tv_sec = seconds;
+  tv.tv_usec = 0;
+
+  FC_FD_ZERO(&writefs);
+  FC_FD_ZERO(&exceptfs);
+  max_desc = -1;
+
+  conn_list_iterate(game.all_connections, pconn) {
+    if (!pconn->server.is_closing && 0 < pconn->send_buffer->ndata) {
+      FD_SET(pconn->sock, &writefs);
+      FD_SET(pconn->sock, &exceptfs);
+      max_desc = MAX(pconn->sock, max_desc);
+    }
+  } conn_list_iterate_end;
+
+  if (max_desc == -1) {
+    return 0;
+  }
+
+  n = fc_select(max_desc + 1, NULL, &writefs, &exceptfs, &tv);
+
+  conn_list_iterate(game.all_connections, pconn) {
+    int i = pconn - connections;
+
+    conn_ready[i].write = (0 < n && FD_ISSET(pconn->sock, &writefs));
+    conn_ready[i].except = (0 < n && FD_ISSET(pconn->sock, &exceptfs));
+  } conn_list_iterate_end;
+
+  return n;
+}
+
 /* Avoid compiler warning about defined, but unused function
  * by defining it only when needed */
 #if defined(FREECIV_HAVE_LIBREADLINE) || \
@@ -220,6 +707,7 @@ static void close_connection(struct connection *pconn)
   pconn->playing = NULL;
   pconn->client_gui = GUI_STUB;
   pconn->access_level = ALLOW_NONE;
+  conn_unwatch(pconn);
   connection_common_close(pconn);
 
   send_updated_vote_totals(NULL);
@@ -251,6 +739,11 @@ void close_connections_and_socket(void)
     fc_closesocket(listen_socks[i]);
   }
   FC_FREE(listen_socks);
+  FC_FREE(listen_ready);
+
+#ifdef SERNET_EPOLL
+  sernet_epoll_close();
+#endif
 
   if (srvarg.announce != ANNOUNCE_NONE) {
     fc_closesocket(socklan);
@@ -351,65 +844,52 @@ static void cut_lagging_connection(struct connection *pconn)
 *****************************************************************************/
 void flush_packets(void)
 {
-  int i;
-  int max_desc;
-  fd_set writefs, exceptfs;
-  fc_timeval tv;
   time_t start;
 
   (void) time(&start);
 
   for (;;) {
-    tv.tv_sec = (game.server.netwait - (time(NULL) - start));
-    tv.tv_usec = 0;
+    int seconds = (game.server.netwait - (time(NULL) - start));
+    bool pending = FALSE;
 
-    if (tv.tv_sec < 0) {
+    if (seconds < 0) {
       return;
     }
 
-    FC_FD_ZERO(&writefs);
-    FC_FD_ZERO(&exceptfs);
-    max_desc = -1;
-
-    for (i = 0; i < MAX_NUM_CONNECTIONS; i++) {
-      struct connection *pconn = &connections[i];
-
-      if (pconn->used
-          && !pconn->server.is_closing
-          && 0 < pconn->send_buffer->ndata) {
-        FD_SET(pconn->sock, &writefs);
-        FD_SET(pconn->sock, &exceptfs);
-        max_desc = MAX(pconn->sock, max_desc);
+    conn_list_iterate(game.all_connections, pconn) {
+      if (!pconn->server.is_closing && 0 < pconn->send_buffer->ndata) {
+        pending = TRUE;
+        break;
       }
-    }
-
-    if (max_desc == -1) {
-      return;
-    }
+    } conn_list_iterate_end;
 
-    if (fc_select(max_desc + 1, NULL, &writefs, &exceptfs, &tv) <= 0) {
+    if (!pending || flush_wait(seconds) <= 0) {
       return;
     }
 
-    for (i = 0; i < MAX_NUM_CONNECTIONS; i++) {   /* check for freaky players */
-      struct connection *pconn = &connections[i];
+    conn_list_iterate(game.all_connections, pconn) {
+      int i = pconn - connections;
 
-      if (pconn->used && !pconn->server.is_closing) {
-        if (FD_ISSET(pconn->sock, &exceptfs)) {
-          log_verbose("connection (%s) cut due to exception data",
-                      conn_description(pconn));
-          connection_close_server(pconn, _("network exception"));
-        } else {
-          if (pconn->send_buffer && pconn->send_buffer->ndata > 0) {
-            if (FD_ISSET(pconn->sock, &writefs)) {
-              flush_connection_send_buffer_all(pconn);
-            } else {
-              cut_lagging_connection(pconn);
-            }
+      /* check for freaky players */
+      if (pconn->server.is_closing) {
+        continue;
+      }
+      if (conn_ready[i].except) {
+        log_verbose("connection (%s) cut due to exception data",
+                    conn_description(pconn));
+        connection_close_server(pconn, _("network exception"));
+      } else if (pconn->send_buffer && pconn->send_buffer->ndata > 0) {
+        if (conn_ready[i].write) {
+          flush_connection_send_buffer_all(pconn);
+          if (0 < pconn->send_buffer->ndata) {
+            /* Would block. */
+            conn_ready[i].write = FALSE;
           }
+        } else {
+          cut_lagging_connection(pconn);
         }
       }
-    }
+    } conn_list_iterate_end;
   }
 }
 
@@ -494,10 +974,6 @@ static void incoming_client_packets(struct connection *pconn)
 enum server_events server_sniff_all_input(void)
 {
   int i, s;
-  int max_desc;
-  bool excepting;
-  fd_set readfs, writefs, exceptfs;
-  fc_timeval tv;
 #ifdef FREECIV_SOCKET_ZERO_NOT_STDIN
   char *bufptr;
 #endif
@@ -656,45 +1132,9 @@ enum server_events server_sniff_all_input(void)
       return S_E_END_OF_TURN_TIMEOUT;
     }
 
-    tv.tv_sec = 1;
-    tv.tv_usec = 0;
-
-    FC_FD_ZERO(&readfs);
-    FC_FD_ZERO(&writefs);
-    FC_FD_ZERO(&exceptfs);
-
-    if (!no_input) {
-#ifdef FREECIV_SOCKET_ZERO_NOT_STDIN
-      fc_init_console();
-#else /* FREECIV_SOCKET_ZERO_NOT_STDIN */
-#   if !defined(__VMS)
-      FD_SET(0, &readfs);
-#   endif /* VMS */
-#endif /* FREECIV_SOCKET_ZERO_NOT_STDIN */
-    }
-
-    max_desc = 0;
-    for (i = 0; i < listen_count; i++) {
-      FD_SET(listen_socks[i], &readfs);
-      FD_SET(listen_socks[i], &exceptfs);
-      max_desc = MAX(max_desc, listen_socks[i]);
-    }
-
-    for (i = 0; i < MAX_NUM_CONNECTIONS; i++) {
-      struct connection *pconn = connections + i;
-
-      if (pconn->used && !pconn->server.is_closing) {
-        FD_SET(pconn->sock, &readfs);
-        if (0 < pconn->send_buffer->ndata) {
-          FD_SET(pconn->sock, &writefs);
-        }
-        FD_SET(pconn->sock, &exceptfs);
-        max_desc = MAX(pconn->sock, max_desc);
-      }
-    }
     con_prompt_off();		/* output doesn't generate a new prompt */
 
-    if (fc_select(max_desc + 1, &readfs, &writefs, &exceptfs, &tv) == 0) {
+    if (sniff_wait(1) == 0) {
       /* timeout */
       call_ai_refresh();
       script_server_signal_emit("pulse");
@@ -736,7 +1176,7 @@ enum server_events server_sniff_all_input(void)
 	    lib$stop(status);
 	  }
 	  if (ttchar.numchars) {
-	    FD_SET(0, &readfs);
+	    input_ready = TRUE;
 	  } else {
 	    continue;
 	  }
@@ -750,19 +1190,12 @@ enum server_events server_sniff_all_input(void)
       }
     }
 
-    excepting = FALSE;
-    for (i = 0; i < listen_count; i++) {
-      if (FD_ISSET(listen_socks[i], &exceptfs)) {
-        excepting = TRUE;
-        break;
-      }
-    }
-    if (excepting) {                  /* handle Ctrl-Z suspend/resume */
+    if (listen_except) {              /* handle Ctrl-Z suspend/resume */
       continue;
     }
     for (i = 0; i < listen_count; i++) {
       s = listen_socks[i];
-      if (FD_ISSET(s, &readfs)) {     /* new players connects */
+      if (listen_ready[i]) {          /* new players connects */
         log_verbose("got new connection");
         if (-1 == server_accept_connection(s)) {
           /* There will be a log_error() message from
@@ -773,13 +1206,13 @@ enum server_events server_sniff_all_input(void)
         }
       }
     }
-    for (i = 0; i < MAX_NUM_CONNECTIONS; i++) {
+    for (i = 0; i < ready_count; i++) {
       /* check for freaky players */
-      struct connection *pconn = &connections[i];
+      struct connection *pconn = &connections[ready_queue[i]];
 
       if (pconn->used
           && !pconn->server.is_closing
-          && FD_ISSET(pconn->sock, &exceptfs)) {
+          && conn_ready[ready_queue[i]].except) {
         log_verbose("connection (%s) cut due to exception data",
                     conn_description(pconn));
         connection_close_server(pconn, _("network exception"));
@@ -794,7 +1227,7 @@ enum server_events server_sniff_all_input(void)
       free(bufptr_internal);
     }
 #else  /* !FREECIV_SOCKET_ZERO_NOT_STDIN */
-    if (!no_input && FD_ISSET(0, &readfs)) {    /* input from server operator */
+    if (!no_input && input_ready) {    /* input from server operator */
 #ifdef FREECIV_HAVE_LIBREADLINE
       rl_callback_read_char();
       if (readline_handled_input) {
@@ -844,17 +1277,22 @@ enum server_events server_sniff_all_input(void)
 #endif /* !FREECIV_SOCKET_ZERO_NOT_STDIN */
 
     {                             /* input from a player */
-      for (i = 0; i < MAX_NUM_CONNECTIONS; i++) {
-        struct connection *pconn = connections + i;
+      for (i = 0; i < ready_count; i++) {
+        int k = ready_queue[i];
+        struct connection *pconn = connections + k;
         int nb;
 
         if (!pconn->used
             || pconn->server.is_closing
-            || !FD_ISSET(pconn->sock, &readfs)) {
+            || !conn_ready[k].read) {
           continue;
         }
 
         nb = read_socket_data(pconn->sock, pconn->buffer);
+        if (0 == nb) {
+          /* Would block. */
+          conn_ready[k].read = FALSE;
+        }
         if (0 <= nb) {
           /* We read packets; now handle them. */
           incoming_client_packets(pconn);
@@ -866,20 +1304,23 @@ enum server_events server_sniff_all_input(void)
         }
       }
 
-      for (i = 0; i < MAX_NUM_CONNECTIONS; i++) {
-        struct connection *pconn = &connections[i];
+      conn_ready_compact();
 
-        if (pconn->used
-            && !pconn->server.is_closing
+      conn_list_iterate(game.all_connections, pconn) {
+        if (!pconn->server.is_closing
             && pconn->send_buffer
             && pconn->send_buffer->ndata > 0) {
-          if (FD_ISSET(pconn->sock, &writefs)) {
+          if (conn_ready[pconn - connections].write) {
             flush_connection_send_buffer_all(pconn);
+            if (0 < pconn->send_buffer->ndata) {
+              /* Would block. */
+              conn_ready[pconn - connections].write = FALSE;
+            }
           } else {
             cut_lagging_connection(pconn);
           }
         }
-      }
+      } conn_list_iterate_end;
       really_close_connections();
       break;
     }
@@ -1042,6 +1483,9 @@ int server_make_connection(int new_sock, const char *client_addr,
     struct connection *pconn = &connections[i];
 
     if (!pconn->used) {
+      if (!conn_watch(i, new_sock)) {
+        break;
+      }
       connection_common_init(pconn);
       pconn->sock = new_sock;
       pconn->observer = FALSE;
@@ -1081,7 +1525,9 @@ int server_make_connection(int new_sock, const char *client_addr,
     }
   }
 
-  log_error("maximum number of connections reached");
+  if (i == MAX_NUM_CONNECTIONS) {
+    log_error("maximum number of connections reached");
+  }
   fc_closesocket(new_sock);
   return -1;
 }
@@ -1132,6 +1578,7 @@ int server_open_socket(void)
 
   /* Loop to create sockets, bind, listen. */
   listen_socks = fc_calloc(name_count, sizeof(listen_socks[0]));
+  listen_ready = fc_calloc(name_count, sizeof(listen_ready[0]));
   listen_count = 0;
 
   fc_sockaddr_list_iterate(list, paddr) {
@@ -1226,6 +1673,10 @@ int server_open_socket(void)
 
   connections_set_close_callback(server_conn_close_callback);
 
+#ifdef SERNET_EPOLL
+  sernet_epoll_init();
+#endif
+
   if (srvarg.announce == ANNOUNCE_NONE) {
     return 0;
   }
@@ -2878,6 +2878,26 @@ static struct setting settings[] = {
               "have clicked on \"Turn Done\"."),
            NULL, NULL, FALSE)
 
+  GEN_BOOL("pfhierarchy", game.server.pf_hierarchy,
+           SSET_META, SSET_INTERNAL, SSET_RARE,
+           ALLOW_NONE, ALLOW_BASIC,
+           N_("Hierarchical path-finding for AI gotos"),
+           N_("If this is turned on, the AI looks for long distance "
+              "paths through a graph of map sectors first, then searches "
+              "only the sectors on the way. This is faster on big maps, "
+              "but the paths may be slightly longer."),
+           NULL, NULL, GAME_DEFAULT_PF_HIERARCHY)
+
+  GEN_INT("threads", game.server.threads,
+          SSET_META, SSET_INTERNAL, SSET_RARE,
+          ALLOW_NONE, ALLOW_BASIC,
+          N_("Number of threads for city computations"),
+          N_("How many threads the server uses to arrange the workers of "
+             "many cities at once, for instance when the AI evaluates "
+             "governments. The results are the same whatever the value, "
+             "only the time taken changes."), NULL, NULL, NULL,
+          GAME_MIN_THREADS, GAME_MAX_THREADS, GAME_DEFAULT_THREADS)
+
   GEN_STRING("demography", game.server.demography,
              SSET_META, SSET_INTERNAL, SSET_SITUATIONAL,
              ALLOW_NONE, ALLOW_BASIC,
@@ -27,6 +27,7 @@
 /* common */
 #include "ai.h"
 #include "city.h"
+#include "effects.h"
 #include "game.h"
 #include "map.h"
 #include "unit.h"
@@ -237,3 +238,94 @@ void timing_log_free(void)
     timer_destroy(aitimer[i][1]);
   }
 }
+
+/**********************************************************************//**
+  Compute the bonus of every effect type for every player, city and unit
+  of the game, using either the effect index or a scan of the effect
+  lists. The results are added to 'results', which must be large enough.
+  Returns the number of queries.
+**************************************************************************/
+static int effect_index_benchmark_run(bool use_index, int *results,
+                                      struct timer *ptimer)
+{
+  bool old = ruleset_cache_index_use(use_index);
+  enum effect_type type;
+  int n = 0;
+
+  timer_start(ptimer);
+  for (type = 0; type < EFT_COUNT; type++) {
+    results[n++] = get_world_bonus(type);
+    players_iterate_alive(pplayer) {
+      results[n++] = get_player_bonus(pplayer, type);
+      city_list_iterate(pplayer->cities, pcity) {
+        results[n++] = get_city_bonus(pcity, type);
+        output_type_iterate(o) {
+          results[n++] = get_city_output_bonus(pcity, get_output_type(o),
+                                               type);
+        } output_type_iterate_end;
+        city_built_iterate(pcity, pimprove) {
+          results[n++] = get_building_bonus(pcity, pimprove, type);
+        } city_built_iterate_end;
+      } city_list_iterate_end;
+      unit_list_iterate(pplayer->units, punit) {
+        results[n++] = get_unit_bonus(punit, type);
+      } unit_list_iterate_end;
+    } players_iterate_alive_end;
+  }
+  timer_stop(ptimer);
+
+  (void) ruleset_cache_index_use(old);
+
+  return n;
+}
+
+/**********************************************************************//**
+  Compare the effect bonuses computed with the effect index with the ones
+  computed by scanning the effect lists. Report the time spent by both
+  methods and the number of results which do not match.
+**************************************************************************/
+void effect_index_benchmark(void)
+{
+  struct timer *scan_timer, *index_timer;
+  int *scan_results, *index_results;
+  int size = 1, queries, mismatches = 0, i;
+  char buf[200];
+
+  players_iterate_alive(pplayer) {
+    size += 1 + unit_list_size(pplayer->units);
+    city_list_iterate(pplayer->cities, pcity) {
+      size += 1 + O_LAST;
+      city_built_iterate(pcity, pimprove) {
+        size++;
+      } city_built_iterate_end;
+    } city_list_iterate_end;
+  } players_iterate_alive_end;
+  size *= EFT_COUNT;
+
+  scan_results = fc_malloc(size * sizeof(*scan_results));
+  index_results = fc_malloc(size * sizeof(*index_results));
+  scan_timer = timer_new(TIMER_CPU, TIMER_ACTIVE);
+  index_timer = timer_new(TIMER_CPU, TIMER_ACTIVE);
+
+  queries = effect_index_benchmark_run(FALSE, scan_results, scan_timer);
+  (void) effect_index_benchmark_run(TRUE, index_results, index_timer);
+
+  for (i = 0; i < queries; i++) {
+    if (scan_results[i] != index_results[i]) {
+      mismatches++;
+    }
+  }
+
+  fc_snprintf(buf, sizeof(buf),
+              "Effects benchmark: %d queries, %d mismatches; "
+              "scan %g sec, index %g sec",
+              queries, mismatches, timer_read_seconds(scan_timer),
+              timer_read_seconds(index_timer));
+  log_normal("%s", buf);
+  notify_conn(NULL, NULL, E_AI_DEBUG, ftc_log, "%s", buf);
+
+  timer_destroy(scan_timer);
+  timer_destroy(index_timer);
+  free(scan_results);
+  free(index_results);
+}
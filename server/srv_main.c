@@ -50,6 +50,7 @@
 #include "fc_cmdline.h"
 #include "fciconv.h"
 #include "fcintl.h"
+#include "fcthreadpool.h"
 #include "log.h"
 #include "mem.h"
 #include "netintf.h"
@@ -60,6 +61,7 @@
 
 /* common/aicore */
 #include "citymap.h"
+#include "path_finding.h"
 
 /* common */
 #include "achievements.h"
@@ -192,6 +194,10 @@ static struct timer *eot_timer = NULL;
 
 static struct timer *between_turns = NULL;
 
+/* threads for the computations, see srv_threadpool() */
+static struct fc_threadpool *threadpool = NULL;
+static int threadpool_threads = 0;
+
 /**********************************************************************//**
   Initialize the game seed.  This may safely be called multiple times.
 **************************************************************************/
@@ -312,6 +318,25 @@ void handle_client_info(struct connection *pc, enum gui_type gui,
   }
 }
 
+/**********************************************************************//**
+  Return the pool of threads to run server computations in parallel. Its
+  size follows the 'threads' server setting.
+**************************************************************************/
+struct fc_threadpool *srv_threadpool(void)
+{
+  if (threadpool != NULL && threadpool_threads != game.server.threads) {
+    fc_threadpool_destroy(threadpool);
+    threadpool = NULL;
+  }
+
+  if (threadpool == NULL) {
+    threadpool = fc_threadpool_new(game.server.threads);
+    threadpool_threads = game.server.threads;
+  }
+
+  return threadpool;
+}
+
 /**********************************************************************//**
   Return current server state.
 **************************************************************************/
@@ -1077,6 +1102,10 @@ static void begin_turn(bool is_new_turn)
 
   event_cache_remove_old();
 
+  /* Path-finding searches are shared within a turn only. */
+  pf_map_shared_log_stats();
+  pf_map_shared_clear();
+
   /* Reset this each turn. */
   if (is_new_turn) {
     if (game.info.phase_mode != game.server.phase_mode_stored) {
@@ -1452,6 +1481,84 @@ static void end_phase(void)
   } phase_players_iterate_end;
 }
 
+/* Fixed point one for the probabilities of spontaneous_extra_skip(). */
+#define SKIP_ONE (1u << 30)
+
+/* The probabilities used to draw the tiles picked by a spontaneous extra
+ * change, see spontaneous_extra_skip(). */
+struct spontaneous_skip {
+  int chance;           /* Per tile, in 1 / 10000. */
+  int top;              /* Blocks of 2^top tiles are skipped at once. */
+  RANDOM_TYPE miss[31]; /* The probability, with SKIP_ONE as 1, that none
+                         * of 2^i tiles is picked. */
+};
+
+/**********************************************************************//**
+  Prepare the probabilities of a spontaneous extra change which happens
+  with a probability of chance / 10000 per tile. The largest block is the
+  first one not picked at least half of the time, or the whole map.
+**************************************************************************/
+static void spontaneous_skip_init(struct spontaneous_skip *skip,
+                                  int chance)
+{
+  skip->chance = chance;
+  skip->top = 0;
+  if (chance <= 0 || chance >= 10000) {
+    return;
+  }
+
+  skip->miss[0] = (RANDOM_TYPE) (((uint64_t) SKIP_ONE * (10000 - chance))
+                                 / 10000);
+  while (skip->top < (int) ARRAY_SIZE(skip->miss) - 1
+         && skip->miss[skip->top] > SKIP_ONE / 2
+         && (1 << skip->top) < MAP_INDEX_SIZE) {
+    uint64_t miss = skip->miss[skip->top];
+
+    skip->top++;
+    skip->miss[skip->top] = (RANDOM_TYPE) ((miss * miss) / SKIP_ONE);
+  }
+}
+
+/**********************************************************************//**
+  Return how many tiles to skip before the next one picked by a
+  spontaneous extra change. Drawing the gaps between the picked tiles
+  gives each tile the same probability as a roll per tile, but only
+  costs a few random numbers per picked tile.
+
+  Whole blocks of tiles are skipped while none of their tiles is picked.
+  The block with the picked tile is then halved until one tile is left:
+  when a block has a picked tile, its first half has none with the
+  probability miss / (1 + miss), where miss is the probability that the
+  half has none. Only integers are used, so the same seed picks the same
+  tiles everywhere.
+**************************************************************************/
+static int spontaneous_extra_skip(const struct spontaneous_skip *skip)
+{
+  int tiles = 0, i;
+
+  if (skip->chance >= 10000) {
+    return 0;
+  }
+  if (skip->chance <= 0) {
+    return MAP_INDEX_SIZE;
+  }
+
+  while (fc_rand(SKIP_ONE) < skip->miss[skip->top]) {
+    tiles += 1 << skip->top;
+    if (tiles >= MAP_INDEX_SIZE) {
+      return MAP_INDEX_SIZE;
+    }
+  }
+
+  for (i = skip->top - 1; i >= 0; i--) {
+    if (fc_rand(SKIP_ONE + skip->miss[i]) < skip->miss[i]) {
+      tiles += 1 << i;
+    }
+  }
+
+  return MIN(tiles, MAP_INDEX_SIZE);
+}
+
 /**********************************************************************//**
   Handle the end of each turn.
 **************************************************************************/
@@ -1578,9 +1685,16 @@ static void end_turn(void)
    * Extra never appears only to disappear at the same turn,
    * but it can disappear and reappear. */
   extra_type_by_rmcause_iterate(ERM_DISAPPEARANCE, pextra) {
-    whole_map_iterate(&(wld.map), ptile) {
+    struct spontaneous_skip skip;
+    int idx;
+
+    spontaneous_skip_init(&skip, pextra->disappearance_chance);
+    for (idx = spontaneous_extra_skip(&skip);
+         idx < MAP_INDEX_SIZE;
+         idx += 1 + spontaneous_extra_skip(&skip)) {
+      struct tile *ptile = index_to_tile(&(wld.map), idx);
+
       if (tile_has_extra(ptile, pextra)
-          && fc_rand(10000) < pextra->disappearance_chance
           && can_extra_disappear(pextra, ptile)) {
         tile_extra_rm_apply(ptile, pextra);
 
@@ -1604,13 +1718,20 @@ static void end_turn(void)
           unit_activities_cancel_all_illegal(n_tile);
         } adjc_iterate_end;
       }
-    } whole_map_iterate_end;
+    }
   } extra_type_by_rmcause_iterate_end;
 
   extra_type_by_cause_iterate(EC_APPEARANCE, pextra) {
-    whole_map_iterate(&(wld.map), ptile) {
+    struct spontaneous_skip skip;
+    int idx;
+
+    spontaneous_skip_init(&skip, pextra->appearance_chance);
+    for (idx = spontaneous_extra_skip(&skip);
+         idx < MAP_INDEX_SIZE;
+         idx += 1 + spontaneous_extra_skip(&skip)) {
+      struct tile *ptile = index_to_tile(&(wld.map), idx);
+
       if (!tile_has_extra(ptile, pextra)
-          && fc_rand(10000) < pextra->appearance_chance
           && can_extra_appear(pextra, ptile)) {
 
         tile_extra_apply(ptile, pextra);
@@ -1635,7 +1756,7 @@ static void end_turn(void)
           unit_activities_cancel_all_illegal(n_tile);
         } adjc_iterate_end;
       }
-    } whole_map_iterate_end;
+    }
   } extra_type_by_cause_iterate_end;
 
   update_diplomatics();
@@ -1798,6 +1919,11 @@ void server_quit(void)
   }
 #endif /* HAVE_FCDB */
 
+  if (threadpool != NULL) {
+    fc_threadpool_destroy(threadpool);
+    threadpool = NULL;
+  }
+
   settings_free();
   stdinhand_free();
   edithand_free();
@@ -3373,6 +3499,7 @@ void server_game_free(void)
   log_civ_score_free();
   playercolor_free();
   citymap_free();
+  tile_movement_states_free();
   game_free();
 }
 
@@ -3601,8 +3728,7 @@ static struct terrain
                               const struct player *pplayer, bool knowledge)
 {
   if (knowledge && pplayer) {
-    struct player_tile *plrtile = map_get_player_tile(ptile, pplayer);
-    return plrtile->terrain;
+    return player_tile_terrain(map_get_player_tile(ptile, pplayer));
   }
 
   return tile_terrain(ptile);
@@ -3617,8 +3743,7 @@ static struct player *mapimg_server_tile_owner(const struct tile *ptile,
 {
   if (knowledge && pplayer
       && tile_get_known(ptile, pplayer) != TILE_KNOWN_SEEN) {
-    struct player_tile *plrtile = map_get_player_tile(ptile, pplayer);
-    return plrtile->owner;
+    return player_tile_owner(map_get_player_tile(ptile, pplayer));
   }
 
   return tile_owner(ptile);
@@ -92,6 +92,8 @@ void srv_main(void);
 void server_quit(void);
 void save_game_auto(const char *save_reason, enum autosave_type type);
 
+struct fc_threadpool *srv_threadpool(void);
+
 enum server_states server_state(void);
 void set_server_state(enum server_states newstate);
 
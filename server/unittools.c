@@ -1690,6 +1690,8 @@ struct unit *create_unit_full(struct player *pplayer, struct tile *ptile,
   CALL_FUNC_EACH_AI(unit_created, punit);
   CALL_PLR_AI_FUNC(unit_got, pplayer, punit);
 
+  pf_map_shared_clear_tile(ptile, NULL);
+
   return punit;
 }
 
@@ -1741,6 +1743,8 @@ static void server_remove_unit_full(struct unit *punit, bool transported,
   CALL_PLR_AI_FUNC(unit_lost, pplayer, punit);
   CALL_FUNC_EACH_AI(unit_destroyed, punit);
 
+  pf_map_shared_clear_tile(ptile, NULL);
+
   /* Save transporter for updating below. */
   ptrans = unit_transport_get(punit);
   /* Unload unit. */
@@ -2861,17 +2865,18 @@ bool do_paradrop(struct unit *punit, struct tile *ptile,
     const struct player_tile *plrtile = map_get_player_tile(ptile, pplayer);
 
     if (NULL == plrtile->site
-        && !is_native_to_class(unit_class_get(punit), plrtile->terrain,
+        && !is_native_to_class(unit_class_get(punit),
+                               player_tile_terrain(plrtile),
                                &(plrtile->extras))) {
       notify_player(pplayer, ptile, E_BAD_COMMAND, ftc_server,
                     _("This unit cannot paradrop into %s."),
-                    terrain_name_translation(plrtile->terrain));
+                    terrain_name_translation(player_tile_terrain(plrtile)));
       return FALSE;
     }
 
     if (NULL != plrtile->site
-        && plrtile->owner != NULL
-        && pplayers_non_attack(pplayer, plrtile->owner)) {
+        && player_tile_owner(plrtile) != NULL
+        && pplayers_non_attack(pplayer, player_tile_owner(plrtile))) {
       notify_player(pplayer, ptile, E_BAD_COMMAND, ftc_server,
                     _("Cannot attack unless you declare war first."));
       return FALSE;
@@ -3045,6 +3050,9 @@ void unit_transport_load_send(struct unit *punit, struct unit *ptrans)
 
   unit_transport_load(punit, ptrans, FALSE);
 
+  /* Shared path-finding searches may depend on the transport state. */
+  pf_map_shared_clear_tile(unit_tile(punit), NULL);
+
   players_iterate(pplayer) {
     if (BV_ISSET(can_see_unit, player_index(pplayer))
         && !can_player_see_unit(pplayer, punit)) {
@@ -3072,6 +3080,9 @@ static void unit_transport_load_tp_status(struct unit *punit,
 
   unit_transport_load(punit, ptrans, force);
 
+  /* Shared path-finding searches may depend on the transport state. */
+  pf_map_shared_clear_tile(unit_tile(punit), NULL);
+
   if (!had_cargo) {
     /* Transport's loaded status changed */
     send_unit_info(NULL, ptrans);
@@ -3093,6 +3104,9 @@ void unit_transport_unload_send(struct unit *punit)
 
   unit_transport_unload(punit);
 
+  /* Shared path-finding searches may depend on the transport state. */
+  pf_map_shared_clear_tile(unit_tile(punit), NULL);
+
   send_unit_info(NULL, punit);
   send_unit_info(NULL, ptrans);
 }
@@ -3652,6 +3666,10 @@ bool unit_move(struct unit *punit, struct tile *pdesttile, int move_cost,
   psrctile = unit_tile(punit);
   adj = base_get_direction_for_step(&(wld.map), psrctile, pdesttile, &facing);
 
+  /* Shared path-finding searches may go through either tile. */
+  pf_map_shared_clear_tile(psrctile, NULL);
+  pf_map_shared_clear_tile(pdesttile, NULL);
+
   conn_list_do_buffer(game.est_connections);
 
   /* Unload the unit if on a transport. */
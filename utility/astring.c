@@ -77,48 +77,6 @@
 #define n_alloc _private_n_alloc_
 
 static const struct astring zero_astr = ASTRING_INIT;
-static char *astr_buffer = NULL;
-static size_t astr_buffer_alloc = 0;
-
-static inline char *astr_buffer_get(size_t *alloc);
-static inline char *astr_buffer_grow(size_t *alloc);
-static void astr_buffer_free(void);
-
-
-/************************************************************************//**
-  Returns the astring buffer. Create it if necessary.
-****************************************************************************/
-static inline char *astr_buffer_get(size_t *alloc)
-{
-  if (!astr_buffer) {
-    astr_buffer_alloc = 65536;
-    astr_buffer = fc_malloc(astr_buffer_alloc);
-    atexit(astr_buffer_free);
-  }
-
-  *alloc = astr_buffer_alloc;
-  return astr_buffer;
-}
-
-/************************************************************************//**
-  Grow the astring buffer.
-****************************************************************************/
-static inline char *astr_buffer_grow(size_t *alloc)
-{
-  astr_buffer_alloc *= 2;
-  astr_buffer = fc_realloc(astr_buffer, astr_buffer_alloc);
-
-  *alloc = astr_buffer_alloc;
-  return astr_buffer;
-}
-
-/************************************************************************//**
-  Free the astring buffer.
-****************************************************************************/
-static void astr_buffer_free(void)
-{
-  free(astr_buffer);
-}
 
 /************************************************************************//**
   Initialize the struct.
@@ -200,23 +158,38 @@ void astr_clear(struct astring *astr)
 static inline void astr_vadd_at(struct astring *astr, size_t at,
                                 const char *format, va_list ap)
 {
-  char *buffer;
-  size_t buffer_size;
+  /* Not a static buffer, so that astrings can be used by several threads
+   * at once. */
+  char local_buffer[4096];
+  char *buffer = local_buffer;
+  size_t buffer_size = sizeof(local_buffer);
   size_t new_len;
 
-  buffer = astr_buffer_get(&buffer_size);
   for (;;) {
-    new_len = fc_vsnprintf(buffer, buffer_size, format, ap);
+    va_list args;
+
+    va_copy(args, ap);
+    new_len = fc_vsnprintf(buffer, buffer_size, format, args);
+    va_end(args);
     if (new_len < buffer_size && (size_t) -1 != new_len) {
       break;
     }
-    buffer = astr_buffer_grow(&buffer_size);
+    buffer_size *= 2;
+    if (buffer == local_buffer) {
+      buffer = fc_malloc(buffer_size);
+    } else {
+      buffer = fc_realloc(buffer, buffer_size);
+    }
   }
 
   new_len += at + 1;
 
   astr_reserve(astr, new_len);
   fc_strlcpy(astr->str + at, buffer, astr->n_alloc - at);
+
+  if (buffer != local_buffer) {
+    free(buffer);
+  }
 }
 
 /************************************************************************//**
@@ -41,6 +41,57 @@
                given as 'struct dbv' and the information can be accessed
                using the functions dbv_*(). They uses the BV_* macros. */
 
+/* Words of the dynamic bitvectors. */
+#define _DBV_WORD_BITS         64
+#define _DBV_WORDS(bits)       ((((bits) - 1) / _DBV_WORD_BITS) + 1)
+#define _DBV_WORD_INDEX(bit)   ((bit) / _DBV_WORD_BITS)
+#define _DBV_BITMASK(bit)      ((uint64_t) 1 << ((bit) % _DBV_WORD_BITS))
+
+/***********************************************************************//**
+  Returns the number of bits set in a word.
+***************************************************************************/
+static inline int word_count(uint64_t word)
+{
+#ifdef __GNUC__
+  return __builtin_popcountll(word);
+#else
+  word = word - ((word >> 1) & 0x5555555555555555ULL);
+  word = (word & 0x3333333333333333ULL) + ((word >> 2) & 0x3333333333333333ULL);
+  word = (word + (word >> 4)) & 0x0f0f0f0f0f0f0f0fULL;
+
+  return (word * 0x0101010101010101ULL) >> 56;
+#endif /* __GNUC__ */
+}
+
+/***********************************************************************//**
+  Returns the index of the lowest bit set in a word, which must not be 0.
+***************************************************************************/
+static inline int word_first_set(uint64_t word)
+{
+#ifdef __GNUC__
+  return __builtin_ctzll(word);
+#else
+  int bit = 0;
+
+  while (!(word & 1)) {
+    word >>= 1;
+    bit++;
+  }
+
+  return bit;
+#endif /* __GNUC__ */
+}
+
+/***********************************************************************//**
+  Returns the mask of the bits in use in the last word of the bitvector.
+***************************************************************************/
+static inline uint64_t dbv_last_word_mask(const struct dbv *pdbv)
+{
+  int used = pdbv->bits % _DBV_WORD_BITS;
+
+  return (0 == used ? ~(uint64_t) 0 : _DBV_BITMASK(used) - 1);
+}
+
 /***********************************************************************//**
   Initialize a dynamic bitvector of size 'bits'. 'bits' must be greater
   than 0 and lower than the maximal size given by MAX_DBV_LENGTH. The
@@ -59,7 +110,7 @@ void dbv_init(struct dbv *pdbv, int bits)
   fc_assert_ret(bits > 0 && bits < MAX_DBV_LENGTH);
 
   pdbv->bits = bits;
-  pdbv->vec = fc_calloc(1, _BV_BYTES(pdbv->bits) * sizeof(*pdbv->vec));
+  pdbv->vec = fc_calloc(1, _DBV_WORDS(pdbv->bits) * sizeof(*pdbv->vec));
 
   dbv_clr_all(pdbv);
 }
@@ -81,7 +132,7 @@ void dbv_resize(struct dbv *pdbv, int bits)
     if (bits != pdbv->bits) {
       pdbv->bits = bits;
       pdbv->vec = fc_realloc(pdbv->vec,
-                             _BV_BYTES(pdbv->bits) * sizeof(*pdbv->vec));
+                             _DBV_WORDS(pdbv->bits) * sizeof(*pdbv->vec));
     }
 
     dbv_clr_all(pdbv);
@@ -122,7 +173,7 @@ bool dbv_isset(const struct dbv *pdbv, int bit)
   fc_assert_ret_val(pdbv->vec != NULL, FALSE);
   fc_assert_ret_val(bit < pdbv->bits, FALSE);
 
-  return ((pdbv->vec[_BV_BYTE_INDEX(bit)] & _BV_BITMASK(bit)) != 0);
+  return ((pdbv->vec[_DBV_WORD_INDEX(bit)] & _DBV_BITMASK(bit)) != 0);
 }
 
 /***********************************************************************//**
@@ -130,11 +181,18 @@ bool dbv_isset(const struct dbv *pdbv, int bit)
 ***************************************************************************/
 bool dbv_isset_any(const struct dbv *pdbv)
 {
+  int i;
+
   fc_assert_ret_val(pdbv != NULL, FALSE);
   fc_assert_ret_val(pdbv->vec != NULL, FALSE);
 
-  return bv_check_mask(pdbv->vec, pdbv->vec, _BV_BYTES(pdbv->bits),
-                       _BV_BYTES(pdbv->bits));
+  for (i = 0; i < _DBV_WORDS(pdbv->bits); i++) {
+    if (pdbv->vec[i] != 0) {
+      return TRUE;
+    }
+  }
+
+  return FALSE;
 }
 
 /***********************************************************************//**
@@ -146,7 +204,7 @@ void dbv_set(struct dbv *pdbv, int bit)
   fc_assert_ret(pdbv->vec != NULL);
   fc_assert_ret(bit < pdbv->bits);
 
-  pdbv->vec[_BV_BYTE_INDEX(bit)] |= _BV_BITMASK(bit);
+  pdbv->vec[_DBV_WORD_INDEX(bit)] |= _DBV_BITMASK(bit);
 }
 
 /***********************************************************************//**
@@ -157,7 +215,8 @@ void dbv_set_all(struct dbv *pdbv)
   fc_assert_ret(pdbv != NULL);
   fc_assert_ret(pdbv->vec != NULL);
 
-  memset(pdbv->vec, 0xff, _BV_BYTES(pdbv->bits));
+  memset(pdbv->vec, 0xff, _DBV_WORDS(pdbv->bits) * sizeof(*pdbv->vec));
+  pdbv->vec[_DBV_WORDS(pdbv->bits) - 1] &= dbv_last_word_mask(pdbv);
 }
 
 /***********************************************************************//**
@@ -169,7 +228,7 @@ void dbv_clr(struct dbv *pdbv, int bit)
   fc_assert_ret(pdbv->vec != NULL);
   fc_assert_ret(bit < pdbv->bits);
 
-  pdbv->vec[_BV_BYTE_INDEX(bit)] &= ~_BV_BITMASK(bit);
+  pdbv->vec[_DBV_WORD_INDEX(bit)] &= ~_DBV_BITMASK(bit);
 }
 
 /***********************************************************************//**
@@ -180,7 +239,7 @@ void dbv_clr_all(struct dbv *pdbv)
   fc_assert_ret(pdbv != NULL);
   fc_assert_ret(pdbv->vec != NULL);
 
-  memset(pdbv->vec, 0, _BV_BYTES(pdbv->bits));
+  memset(pdbv->vec, 0, _DBV_WORDS(pdbv->bits) * sizeof(*pdbv->vec));
 }
 
 /***********************************************************************//**
@@ -192,9 +251,107 @@ bool dbv_are_equal(const struct dbv *pdbv1, const struct dbv *pdbv2)
   fc_assert_ret_val(pdbv1->vec != NULL, FALSE);
   fc_assert_ret_val(pdbv2 != NULL, FALSE);
   fc_assert_ret_val(pdbv2->vec != NULL, FALSE);
+  fc_assert_ret_val(pdbv1->bits == pdbv2->bits, FALSE);
+
+  return 0 == memcmp(pdbv1->vec, pdbv2->vec,
+                     _DBV_WORDS(pdbv1->bits) * sizeof(*pdbv1->vec));
+}
+
+/***********************************************************************//**
+  Returns the number of bits set.
+***************************************************************************/
+int dbv_count(const struct dbv *pdbv)
+{
+  int i, count = 0;
+
+  fc_assert_ret_val(pdbv != NULL, 0);
+  fc_assert_ret_val(pdbv->vec != NULL, 0);
+
+  for (i = 0; i < _DBV_WORDS(pdbv->bits); i++) {
+    count += word_count(pdbv->vec[i]);
+  }
+
+  return count;
+}
+
+/***********************************************************************//**
+  Returns the first bit set from 'bit' included, or -1 if there is none.
+***************************************************************************/
+int dbv_next_set(const struct dbv *pdbv, int bit)
+{
+  int i, words;
+  uint64_t word;
 
-  return bv_are_equal(pdbv1->vec, pdbv2->vec, _BV_BYTES(pdbv1->bits),
-                      _BV_BYTES(pdbv2->bits));
+  fc_assert_ret_val(pdbv != NULL, -1);
+  fc_assert_ret_val(pdbv->vec != NULL, -1);
+  fc_assert_ret_val(bit >= 0, -1);
+
+  if (bit >= pdbv->bits) {
+    return -1;
+  }
+
+  i = _DBV_WORD_INDEX(bit);
+  word = pdbv->vec[i] & ~(_DBV_BITMASK(bit) - 1);
+  words = _DBV_WORDS(pdbv->bits);
+
+  while (word == 0) {
+    if (++i >= words) {
+      return -1;
+    }
+    word = pdbv->vec[i];
+  }
+
+  return i * _DBV_WORD_BITS + word_first_set(word);
+}
+
+/***********************************************************************//**
+  Keep only the bits which are also set in pdbv_from. (Bitwise AND
+  assignment)
+***************************************************************************/
+void dbv_and(struct dbv *pdbv_to, const struct dbv *pdbv_from)
+{
+  int i;
+
+  fc_assert_ret(pdbv_to != NULL && pdbv_to->vec != NULL);
+  fc_assert_ret(pdbv_from != NULL && pdbv_from->vec != NULL);
+  fc_assert_ret(pdbv_to->bits == pdbv_from->bits);
+
+  for (i = 0; i < _DBV_WORDS(pdbv_to->bits); i++) {
+    pdbv_to->vec[i] &= pdbv_from->vec[i];
+  }
+}
+
+/***********************************************************************//**
+  Set all the bits which are set in pdbv_from. (Bitwise inclusive OR
+  assignment)
+***************************************************************************/
+void dbv_or(struct dbv *pdbv_to, const struct dbv *pdbv_from)
+{
+  int i;
+
+  fc_assert_ret(pdbv_to != NULL && pdbv_to->vec != NULL);
+  fc_assert_ret(pdbv_from != NULL && pdbv_from->vec != NULL);
+  fc_assert_ret(pdbv_to->bits == pdbv_from->bits);
+
+  for (i = 0; i < _DBV_WORDS(pdbv_to->bits); i++) {
+    pdbv_to->vec[i] |= pdbv_from->vec[i];
+  }
+}
+
+/***********************************************************************//**
+  Clear all the bits which are set in pdbv_from.
+***************************************************************************/
+void dbv_andnot(struct dbv *pdbv_to, const struct dbv *pdbv_from)
+{
+  int i;
+
+  fc_assert_ret(pdbv_to != NULL && pdbv_to->vec != NULL);
+  fc_assert_ret(pdbv_from != NULL && pdbv_from->vec != NULL);
+  fc_assert_ret(pdbv_to->bits == pdbv_from->bits);
+
+  for (i = 0; i < _DBV_WORDS(pdbv_to->bits); i++) {
+    pdbv_to->vec[i] &= ~pdbv_from->vec[i];
+  }
 }
 
 /***********************************************************************//**
@@ -231,15 +388,24 @@ void dbv_debug(struct dbv *pdbv)
 bool bv_check_mask(const unsigned char *vec1, const unsigned char *vec2,
                    size_t size1, size_t size2)
 {
-  size_t i;
+  size_t i = 0;
   fc_assert_ret_val(size1 == size2, FALSE);
 
-  for (i = 0; i < size1; i++) {
-    if ((vec1[0] & vec2[0]) != 0) {
+  /* Whole words first. */
+  for (; i + sizeof(uint64_t) <= size1; i += sizeof(uint64_t)) {
+    uint64_t word1, word2;
+
+    memcpy(&word1, vec1 + i, sizeof(word1));
+    memcpy(&word2, vec2 + i, sizeof(word2));
+    if ((word1 & word2) != 0) {
+      return TRUE;
+    }
+  }
+
+  for (; i < size1; i++) {
+    if ((vec1[i] & vec2[i]) != 0) {
       return TRUE;
     }
-    vec1++;
-    vec2++;
   }
   return FALSE;
 }
@@ -251,17 +417,9 @@ bool bv_check_mask(const unsigned char *vec1, const unsigned char *vec2,
 bool bv_are_equal(const unsigned char *vec1, const unsigned char *vec2,
                   size_t size1, size_t size2)
 {
-  size_t i;
   fc_assert_ret_val(size1 == size2, FALSE);
 
-  for (i = 0; i < size1; i++) {
-    if (vec1[0] != vec2[0]) {
-      return FALSE;
-    }
-    vec1++;
-    vec2++;
-  }
-  return TRUE;
+  return 0 == memcmp(vec1, vec2, size1);
 }
 
 /***********************************************************************//**
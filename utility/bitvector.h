@@ -28,10 +28,12 @@ extern "C" {
 #define TEST_BIT(val, bit_no)                                               \
   (((val) & (1u << (bit_no))) == (1u << (bit_no)))
 
-/* Dynamic bitvectors */
+/* Dynamic bitvectors. They are stored in 64 bits words, so the bulk
+ * operations work on whole words. The bits after 'bits' in the last word
+ * are always clear. */
 struct dbv {
   int bits;
-  unsigned char *vec;
+  uint64_t *vec;
 };
 
 void dbv_init(struct dbv *pdbv, int bits);
@@ -51,6 +53,24 @@ void dbv_clr_all(struct dbv *pdbv);
 
 bool dbv_are_equal(const struct dbv *pdbv1, const struct dbv *pdbv2);
 
+int dbv_count(const struct dbv *pdbv);
+int dbv_next_set(const struct dbv *pdbv, int bit);
+
+void dbv_and(struct dbv *pdbv_to, const struct dbv *pdbv_from);
+void dbv_or(struct dbv *pdbv_to, const struct dbv *pdbv_from);
+void dbv_andnot(struct dbv *pdbv_to, const struct dbv *pdbv_from);
+
+/* Iterate over the set bits of a dynamic bitvector, in increasing order. */
+#define dbv_set_bits_iterate(pdbv, _bit)                                    \
+{                                                                           \
+  int _bit;                                                                 \
+                                                                            \
+  for (_bit = dbv_next_set(pdbv, 0); _bit >= 0;                             \
+       _bit = dbv_next_set(pdbv, _bit + 1)) {
+#define dbv_set_bits_iterate_end                                            \
+  }                                                                         \
+}
+
 void dbv_debug(struct dbv *pdbv);
 
 /* Maximal size of a dynamic bitvector.
@@ -0,0 +1,191 @@
+/***********************************************************************
+ Freeciv - Copyright (C) 1996 - A Kjeldberg, L Gregersen, P Unold
+   This program is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation; either version 2, or (at your option)
+   any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+***********************************************************************/
+
+#ifdef HAVE_CONFIG_H
+#include <fc_config.h>
+#endif
+
+/* utility */
+#include "fcthread.h"
+#include "log.h"
+#include "mem.h"
+#include "shared.h"
+
+#include "fcthreadpool.h"
+
+struct fc_threadpool {
+  int size;           /* threads taking part, the calling one included */
+  fc_thread *workers; /* the other (size - 1) threads */
+
+  fc_mutex mutex;
+  fc_thread_cond work_cond;
+  fc_thread_cond done_cond;
+
+  /* The loop being run. Protected by the mutex. */
+  fc_threadpool_func func;
+  void *data;
+  int count;
+  int next;
+  int done;
+  unsigned int generation; /* incremented for every loop */
+  bool quit;
+};
+
+/*******************************************************************//**
+  Run iterations of the current loop until there are none left. Must be
+  called with the mutex held, which is released during the iterations.
+***********************************************************************/
+static void threadpool_work(struct fc_threadpool *pool)
+{
+  fc_threadpool_func func = pool->func;
+  void *data = pool->data;
+
+  while (pool->next < pool->count) {
+    int index = pool->next++;
+
+    fc_release_mutex(&pool->mutex);
+    func(index, data);
+    fc_allocate_mutex(&pool->mutex);
+
+    if (++pool->done == pool->count) {
+      fc_thread_cond_signal(&pool->done_cond);
+    }
+  }
+}
+
+/*******************************************************************//**
+  Main function of the worker threads.
+***********************************************************************/
+static void threadpool_worker(void *arg)
+{
+  struct fc_threadpool *pool = (struct fc_threadpool *) arg;
+  unsigned int seen = 0;
+
+  fc_allocate_mutex(&pool->mutex);
+  while (!pool->quit) {
+    if (pool->generation == seen) {
+      fc_thread_cond_wait(&pool->work_cond, &pool->mutex);
+      continue;
+    }
+    seen = pool->generation;
+    threadpool_work(pool);
+  }
+  fc_release_mutex(&pool->mutex);
+}
+
+/*******************************************************************//**
+  Create a pool where loops are run by 'threads' threads, the calling
+  thread included. A pool of size 1 runs the loops in the calling thread
+  only. This is also the case when the platform has no thread
+  conditions.
+***********************************************************************/
+struct fc_threadpool *fc_threadpool_new(int threads)
+{
+  struct fc_threadpool *pool = fc_calloc(1, sizeof(*pool));
+  int i;
+
+  pool->size = MAX(1, threads);
+  if (pool->size > 1 && !has_thread_cond_impl()) {
+    log_verbose("No thread conditions, running loops in one thread.");
+    pool->size = 1;
+  }
+
+  if (pool->size > 1) {
+    fc_init_mutex(&pool->mutex);
+    fc_thread_cond_init(&pool->work_cond);
+    fc_thread_cond_init(&pool->done_cond);
+
+    pool->workers = fc_calloc(pool->size - 1, sizeof(*pool->workers));
+    for (i = 0; i < pool->size - 1; i++) {
+      if (fc_thread_start(&pool->workers[i], threadpool_worker, pool) != 0) {
+        log_error("Could not start a worker thread, using %d threads.",
+                  i + 1);
+        pool->size = i + 1;
+        break;
+      }
+    }
+  }
+
+  return pool;
+}
+
+/*******************************************************************//**
+  Stop the threads of the pool and free it.
+***********************************************************************/
+void fc_threadpool_destroy(struct fc_threadpool *pool)
+{
+  int i;
+
+  if (pool->workers != NULL) {
+    fc_allocate_mutex(&pool->mutex);
+    pool->quit = TRUE;
+    for (i = 0; i < pool->size - 1; i++) {
+      fc_thread_cond_signal(&pool->work_cond);
+    }
+    fc_release_mutex(&pool->mutex);
+
+    for (i = 0; i < pool->size - 1; i++) {
+      fc_thread_wait(&pool->workers[i]);
+    }
+    free(pool->workers);
+
+    fc_thread_cond_destroy(&pool->work_cond);
+    fc_thread_cond_destroy(&pool->done_cond);
+    fc_destroy_mutex(&pool->mutex);
+  }
+
+  free(pool);
+}
+
+/*******************************************************************//**
+  Return the number of threads running the loops of the pool.
+***********************************************************************/
+int fc_threadpool_size(const struct fc_threadpool *pool)
+{
+  return pool != NULL ? pool->size : 1;
+}
+
+/*******************************************************************//**
+  Call func(index, data) for every index from 0 to count - 1, spread over
+  the threads of the pool, and return when all calls are done. A NULL
+  pool runs the loop in the calling thread.
+***********************************************************************/
+void fc_threadpool_run(struct fc_threadpool *pool, int count,
+                       fc_threadpool_func func, void *data)
+{
+  int i;
+
+  if (pool == NULL || pool->size <= 1 || count <= 1) {
+    for (i = 0; i < count; i++) {
+      func(i, data);
+    }
+    return;
+  }
+
+  fc_allocate_mutex(&pool->mutex);
+  pool->func = func;
+  pool->data = data;
+  pool->count = count;
+  pool->next = 0;
+  pool->done = 0;
+  pool->generation++;
+  for (i = 0; i < pool->size - 1 && i < count - 1; i++) {
+    fc_thread_cond_signal(&pool->work_cond);
+  }
+
+  threadpool_work(pool);
+  while (pool->done < pool->count) {
+    fc_thread_cond_wait(&pool->done_cond, &pool->mutex);
+  }
+  fc_release_mutex(&pool->mutex);
+}
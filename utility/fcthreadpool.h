@@ -0,0 +1,49 @@
+/***********************************************************************
+ Freeciv - Copyright (C) 1996 - A Kjeldberg, L Gregersen, P Unold
+   This program is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation; either version 2, or (at your option)
+   any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+***********************************************************************/
+#ifndef FC__FCTHREADPOOL_H
+#define FC__FCTHREADPOOL_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif /* __cplusplus */
+
+/* utility */
+#include "support.h" /* bool */
+
+/*
+ * A fixed set of worker threads, used to run the iterations of a loop in
+ * parallel. The thread calling fc_threadpool_run() takes part in the work
+ * and returns only when all the iterations are done, so the pool can be
+ * used like a plain loop by the caller.
+ *
+ * The order in which the iterations are run is not defined. Callers which
+ * need reproducible results must make the iterations independent, and
+ * apply what they computed in a fixed order afterwards.
+ */
+
+struct fc_threadpool;
+
+typedef void (*fc_threadpool_func)(int index, void *data);
+
+struct fc_threadpool *fc_threadpool_new(int threads);
+void fc_threadpool_destroy(struct fc_threadpool *pool);
+
+int fc_threadpool_size(const struct fc_threadpool *pool);
+void fc_threadpool_run(struct fc_threadpool *pool, int count,
+                       fc_threadpool_func func, void *data);
+
+#ifdef __cplusplus
+}
+#endif /* __cplusplus */
+
+#endif /* FC__FCTHREADPOOL_H */
@@ -78,6 +78,7 @@
 #include "log.h"
 #include "mem.h"
 #include "shared.h"		/* TRUE, FALSE */
+#include "string_vector.h"
 #include "support.h"
 
 #include "inputfile.h"
@@ -110,6 +111,8 @@ struct inputfile {
   struct inputfile *included_from; /* NULL for toplevel file, otherwise
 				      points back to files which this one
 				      has been included from */
+  struct strvec *deps;          /* if not NULL, the files read besides
+                                   the toplevel one, see inf_set_deps() */
 };
 
 /* A function to get a specific token type: */
@@ -168,6 +171,7 @@ static void init_zeros(struct inputfile *inf)
   inf->fp = NULL;
   inf->datafn = NULL;
   inf->included_from = NULL;
+  inf->deps = NULL;
   inf->line_num = inf->cur_line_pos = 0;
   inf->at_eof = inf->in_string = FALSE;
   inf->string_start_line = 0;
@@ -255,6 +259,31 @@ struct inputfile *inf_from_stream(fz_FILE *stream, datafilename_fn_t datafn)
 }
 
 
+/*******************************************************************//**
+  Record in 'deps' the files read because of the content of the
+  inputfile: included files and stringfiles. Two strings are appended
+  for each, the name as written in the inputfile and the name of the
+  file it was found as.
+***********************************************************************/
+void inf_set_deps(struct inputfile *inf, struct strvec *deps)
+{
+  fc_assert_ret(inf_sanity_check(inf));
+
+  inf->deps = deps;
+}
+
+/*******************************************************************//**
+  Add a file read by the inputfile to its dependencies.
+***********************************************************************/
+static void inf_add_dep(struct inputfile *inf, const char *name,
+                        const char *full_name)
+{
+  if (inf->deps != NULL) {
+    strvec_append(inf->deps, name);
+    strvec_append(inf->deps, full_name);
+  }
+}
+
 /*******************************************************************//**
   Close the file and free associated memory, but don't recurse
   included_from files, and don't free the actual memory where
@@ -351,15 +380,13 @@ bool inf_at_eof(struct inputfile *inf)
 static bool check_include(struct inputfile *inf)
 {
   const char *include_prefix = "*include";
-  static size_t len = 0;
+  size_t len = strlen(include_prefix);
   size_t bare_name_len;
   char *bare_name;
   const char *c, *bare_name_start, *full_name;
+  struct astring full_name_buf = ASTRING_INIT;
   struct inputfile *new_inf, temp;
 
-  if (len == 0) {
-    len = strlen(include_prefix);
-  }
   fc_assert_ret_val(inf_sanity_check(inf), FALSE);
   if (inf->in_string || astr_len(&inf->cur_line) <= len
       || inf->cur_line_pos > 0) {
@@ -410,12 +437,14 @@ static bool check_include(struct inputfile *inf)
   }
   inf->cur_line_pos = astr_len(&inf->cur_line) - 1;
 
-  full_name = inf->datafn(bare_name);
+  full_name = inf->datafn(bare_name, &full_name_buf);
   if (!full_name) {
     log_error("Could not find included file \"%s\"", bare_name);
     free(bare_name);
+    astr_free(&full_name_buf);
     return FALSE;
   }
+  inf_add_dep(inf, bare_name, full_name);
   free(bare_name);
 
   /* avoid recursion: (first filename may not have the same path,
@@ -425,12 +454,14 @@ static bool check_include(struct inputfile *inf)
     do {
       if (inc->filename && strcmp(full_name, inc->filename) == 0) {
         log_error("Recursion trap on '*include' for \"%s\"", full_name);
+        astr_free(&full_name_buf);
         return FALSE;
       }
     } while ((inc = inc->included_from));
   }
 
   new_inf = inf_from_file(full_name, inf->datafn);
+  astr_free(&full_name_buf);
 
   /* Swap things around so that memory pointed to by inf (user pointer,
      and pointer in calling functions) contains the new inputfile,
@@ -441,6 +472,7 @@ static bool check_include(struct inputfile *inf)
   *new_inf = *inf;
   *inf = temp;
   inf->included_from = new_inf;
+  inf->deps = new_inf->deps;
   return TRUE;
 }
 
@@ -547,7 +579,12 @@ static bool read_a_line(struct inputfile *inf)
 char *inf_log_str(struct inputfile *inf, const char *message, ...)
 {
   va_list args;
+  /* One per thread where possible, like the secfile error buffer. */
+#ifdef HAVE_C11_THREAD_LOCAL
+  static _Thread_local char str[512];
+#else
   static char str[512];
+#endif
 
   fc_assert_ret_val(inf_sanity_check(inf), NULL);
 
@@ -839,6 +876,7 @@ static const char *get_token_value(struct inputfile *inf)
   border_character = *c;
 
   if (border_character == '*') {
+    struct astring rfname_buf = ASTRING_INIT;
     const char *rfname;
     fz_FILE *fp;
     bool eof;
@@ -863,20 +901,24 @@ static const char *get_token_value(struct inputfile *inf)
     trailing = *(c - 1);
     *((char *) (c - 1)) = '\0';     /* Tricky. */
 
-    rfname = fileinfoname(get_data_dirs(), start);
+    rfname = fileinfoname_astr(get_data_dirs(), start, &rfname_buf);
     if (rfname == NULL) {
       inf_log(inf, LOG_ERROR, 
               _("Cannot find stringfile \"%s\"."), start);
       *((char *) c) = trailing; /* Revert. */
+      astr_free(&rfname_buf);
       return NULL;
     }
+    inf_add_dep(inf, start, rfname);
     *((char *) c) = trailing; /* Revert. */
     fp = fz_from_file(rfname, "r", -1, 0);
     if (!fp) {
       inf_log(inf, LOG_ERROR,
               _("Cannot open stringfile \"%s\"."), rfname);
+      astr_free(&rfname_buf);
       return NULL;
     }
+    astr_free(&rfname_buf);
     log_debug("Stringfile \"%s\" opened ok", start);
     *((char *) (c - 1)) = trailing; /* Revert. */
     astr_set(&inf->token, "*"); /* Mark as a string read from a file */
@@ -28,15 +28,20 @@ extern "C" {
 #include "log.h"                /* enum log_level */
 #include "support.h"            /* bool type and fc__attribute */
 
+struct astring;
 struct inputfile;		/* opaque */
+struct strvec;
 
-typedef const char *(*datafilename_fn_t)(const char *filename);
+/* Returns the full name of the file, stored in 'realfile'. */
+typedef const char *(*datafilename_fn_t)(const char *filename,
+                                         struct astring *realfile);
 
 struct inputfile *inf_from_file(const char *filename,
                                 datafilename_fn_t datafn);
 struct inputfile *inf_from_stream(fz_FILE * stream,
                                   datafilename_fn_t datafn);
 void inf_close(struct inputfile *inf);
+void inf_set_deps(struct inputfile *inf, struct strvec *deps);
 bool inf_at_eof(struct inputfile *inf);
 
 enum inf_token_type {
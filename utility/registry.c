@@ -49,6 +49,18 @@ void registry_module_close(void)
 *************************************************************************/
 struct section_file *secfile_load(const char *filename,
                                   bool allow_duplicates)
+{
+  return secfile_load_cached(filename, NULL, allow_duplicates);
+}
+
+/*********************************************************************//**
+  Create a section file from a file, keeping the parsed result in
+  'cache_dir' to speed up the next loads of the same file. No cache is
+  used when 'cache_dir' is NULL. Returns NULL on error.
+*************************************************************************/
+struct section_file *secfile_load_cached(const char *filename,
+                                         const char *cache_dir,
+                                         bool allow_duplicates)
 {
 #ifdef FREECIV_HAVE_XML_REGISTRY
   struct stat buf;
@@ -63,5 +75,9 @@ struct section_file *secfile_load(const char *filename,
   }
 #endif /* FREECIV_HAVE_XML_REGISTRY */
 
-  return secfile_load_section(filename, NULL, allow_duplicates);
+  if (cache_dir == NULL) {
+    return secfile_load_section(filename, NULL, allow_duplicates);
+  }
+
+  return secfile_load_with_cache(filename, cache_dir, allow_duplicates);
 }
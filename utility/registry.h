@@ -28,6 +28,9 @@ struct section_file *secfile_new(bool allow_duplicates);
 void secfile_destroy(struct section_file *secfile);
 struct section_file *secfile_load(const char *filename,
                                   bool allow_duplicates);
+struct section_file *secfile_load_cached(const char *filename,
+                                         const char *cache_dir,
+                                         bool allow_duplicates);
 
 void secfile_allow_digital_boolean(struct section_file *secfile,
                                    bool allow_digital_boolean);
@@ -148,13 +148,27 @@
   - Now uses hash.c
 **************************************************************************/
 
+/**************************************************************************
+  Binary cache: (see secfile_load_cached())
+  - The parsed sections and entries of a file are written in a flat
+    binary form, with the name and the md5sum of the file and of every
+    file it included or took a stringfile from.
+  - The cache is only used when all these files are found at the same
+    place with the same content, and when it was written by the same
+    version of freeciv.
+**************************************************************************/
+
 #ifdef HAVE_CONFIG_H
 #include <fc_config.h>
 #endif
 
 #include <stdarg.h>
+#include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#ifdef HAVE_UNISTD_H
+#include <unistd.h>             /* getpid */
+#endif
 
 /* utility */
 #include "astring.h"
@@ -164,10 +178,12 @@
 #include "inputfile.h"
 #include "ioz.h"
 #include "log.h"
+#include "md5.h"
 #include "mem.h"
 #include "registry.h"
 #include "section_file.h"
 #include "shared.h"
+#include "string_vector.h"
 #include "support.h"
 
 #include "registry_ini.h"
@@ -220,15 +236,17 @@ struct entry {
   };
 };
 
+static struct entry *entry_new(struct section *psection, const char *name);
 static struct entry *section_entry_filereference_new(struct section *psection,
                                                      const char *name, const char *value);
 
 /**********************************************************************//**
-  Simplification of fileinfoname().
+  Simplification of fileinfoname_astr().
 **************************************************************************/
-static const char *datafilename(const char *filename)
+static const char *datafilename(const char *filename,
+                                struct astring *realfile)
 {
-  return fileinfoname(get_data_dirs(), filename);
+  return fileinfoname_astr(get_data_dirs(), filename, realfile);
 }
 
 /**********************************************************************//**
@@ -294,6 +312,27 @@ static bool secfile_hash_delete(struct section_file *secfile,
   return entry_hash_remove(secfile->hash.entries, buf);
 }
 
+/**********************************************************************//**
+  Build the entry hash table of a loaded section file. Returns TRUE on
+  success.
+**************************************************************************/
+static bool secfile_hash_build(struct section_file *secfile,
+                               bool allow_duplicates)
+{
+  secfile->allow_duplicates = allow_duplicates;
+  secfile->hash.entries = entry_hash_new_nentries(secfile->num_entries);
+
+  section_list_iterate(secfile->sections, hashing_section) {
+    entry_list_iterate(section_entries(hashing_section), pentry) {
+      if (!secfile_hash_insert(secfile, pentry)) {
+        return FALSE;
+      }
+    } entry_list_iterate_end;
+  } section_list_iterate_end;
+
+  return TRUE;
+}
+
 /**********************************************************************//**
   Base function to load a section file.  Note it closes the inputfile.
 **************************************************************************/
@@ -550,21 +589,7 @@ END:
   }
 
   if (!error) {
-    /* Build the entry hash table. */
-    secfile->allow_duplicates = allow_duplicates;
-    secfile->hash.entries = entry_hash_new_nentries(secfile->num_entries);
-
-    section_list_iterate(secfile->sections, hashing_section) {
-      entry_list_iterate(section_entries(hashing_section), pentry) {
-        if (!secfile_hash_insert(secfile, pentry)) {
-          error = TRUE;
-          break;
-        }
-      } entry_list_iterate_end;
-      if (error) {
-        break;
-      }
-    } section_list_iterate_end;
+    error = !secfile_hash_build(secfile, allow_duplicates);
   }
   if (error) {
     secfile_destroy(secfile);
@@ -599,6 +624,497 @@ struct section_file *secfile_from_stream(fz_FILE *stream,
                                  NULL, NULL, allow_duplicates);
 }
 
+/* Version of the format of the cache files. */
+#define SECFILE_CACHE_MAGIC "FCSECF"
+#define SECFILE_CACHE_FORMAT 1
+
+/**********************************************************************//**
+  Read the whole file. Returns NULL if it cannot be read, else the
+  malloced data, whose size is stored in 'size'.
+**************************************************************************/
+static unsigned char *file_read_all(const char *filename, size_t *size)
+{
+  FILE *fp = fc_fopen(filename, "rb");
+  unsigned char *data;
+  size_t alloc = 65536, len = 0, got;
+
+  if (fp == NULL) {
+    return NULL;
+  }
+
+  data = fc_malloc(alloc);
+  while ((got = fread(data + len, 1, alloc - len, fp)) > 0) {
+    len += got;
+    if (len == alloc) {
+      alloc *= 2;
+      data = fc_realloc(data, alloc);
+    }
+  }
+  if (ferror(fp)) {
+    fclose(fp);
+    free(data);
+    return NULL;
+  }
+  fclose(fp);
+
+  *size = len;
+  return data;
+}
+
+/**********************************************************************//**
+  Compute the md5sum of the content of the file. Returns FALSE if it
+  cannot be read.
+**************************************************************************/
+static bool file_md5sum(const char *filename, char md5[MD5_HEX_BYTES + 1])
+{
+  size_t size;
+  unsigned char *data = file_read_all(filename, &size);
+
+  if (data == NULL) {
+    return FALSE;
+  }
+  create_md5sum(data, size, md5);
+  free(data);
+
+  return TRUE;
+}
+
+/**********************************************************************//**
+  Write an unsigned integer to the cache file.
+**************************************************************************/
+static void cache_put_uint32(FILE *fp, unsigned int value)
+{
+  unsigned char buf[4];
+
+  buf[0] = value & 0xff;
+  buf[1] = (value >> 8) & 0xff;
+  buf[2] = (value >> 16) & 0xff;
+  buf[3] = (value >> 24) & 0xff;
+  fwrite(buf, 1, sizeof(buf), fp);
+}
+
+/**********************************************************************//**
+  Write a string to the cache file. NULL is allowed.
+**************************************************************************/
+static void cache_put_str(FILE *fp, const char *str)
+{
+  if (str == NULL) {
+    cache_put_uint32(fp, 0xffffffff);
+  } else {
+    size_t len = strlen(str);
+
+    cache_put_uint32(fp, len);
+    fwrite(str, 1, len + 1, fp);
+  }
+}
+
+/* Reading position in a cache file. */
+struct cache_reader {
+  const unsigned char *pos;
+  size_t left;
+  bool error;
+};
+
+/**********************************************************************//**
+  Read an unsigned integer from the cache file.
+**************************************************************************/
+static unsigned int cache_get_uint32(struct cache_reader *reader)
+{
+  unsigned int value;
+
+  if (reader->left < 4) {
+    reader->error = TRUE;
+    return 0;
+  }
+  value = (reader->pos[0] | (reader->pos[1] << 8) | (reader->pos[2] << 16)
+           | ((unsigned int) reader->pos[3] << 24));
+  reader->pos += 4;
+  reader->left -= 4;
+
+  return value;
+}
+
+/**********************************************************************//**
+  Read a string from the cache file. The string is not copied, it lives
+  as long as the data of the reader.
+**************************************************************************/
+static const char *cache_get_str(struct cache_reader *reader)
+{
+  unsigned int len = cache_get_uint32(reader);
+  const char *str;
+
+  if (reader->error || len == 0xffffffff) {
+    return NULL;
+  }
+  if (reader->left <= len || reader->pos[len] != '\0') {
+    reader->error = TRUE;
+    return NULL;
+  }
+  str = (const char *) reader->pos;
+  reader->pos += len + 1;
+  reader->left -= len + 1;
+
+  return str;
+}
+
+/**********************************************************************//**
+  Return the name of the cache file for the file, in 'cache_dir'.
+**************************************************************************/
+static void secfile_cache_name(const char *real_filename,
+                               const char *cache_dir,
+                               char *buf, size_t buf_len)
+{
+  char md5[MD5_HEX_BYTES + 1];
+
+  create_md5sum((const unsigned char *) real_filename,
+                strlen(real_filename), md5);
+  fc_snprintf(buf, buf_len, "%s" DIR_SEPARATOR "%s.secfile",
+              cache_dir, md5);
+}
+
+/**********************************************************************//**
+  Create a temporary file next to 'cache_name', with a name no other
+  writer uses, and store that name in 'buf'. Several servers sharing the
+  cache directory, or several threads of the same one, may write the same
+  cache at once.
+**************************************************************************/
+static FILE *secfile_cache_tmp_open(const char *cache_name,
+                                    const struct section_file *secfile,
+                                    char *buf, size_t buf_len)
+{
+#if defined(HAVE_MKSTEMP) && defined(HAVE_FDOPEN)
+  FILE *fp;
+  int fd;
+
+  fc_snprintf(buf, buf_len, "%s.XXXXXX", cache_name);
+  fd = mkstemp(buf);
+  if (fd < 0) {
+    return NULL;
+  }
+  fp = fdopen(fd, "wb");
+  if (fp == NULL) {
+    close(fd);
+    fc_remove(buf);
+  }
+
+  return fp;
+#else  /* HAVE_MKSTEMP && HAVE_FDOPEN */
+  unsigned long pid = 0;
+
+#ifdef HAVE_UNISTD_H
+  pid = (unsigned long) getpid();
+#endif
+
+  /* The section file address tells the threads apart. */
+  fc_snprintf(buf, buf_len, "%s.%lx.%lx", cache_name, pid,
+              (unsigned long) (uintptr_t) secfile);
+
+  return fc_fopen(buf, "wb");
+#endif /* HAVE_MKSTEMP && HAVE_FDOPEN */
+}
+
+/**********************************************************************//**
+  Write the cache of the section file loaded from 'real_filename'. 'deps'
+  are the other files it was read from, as recorded by inf_set_deps().
+**************************************************************************/
+static void secfile_cache_save(const struct section_file *secfile,
+                               const char *real_filename,
+                               const struct strvec *deps,
+                               const char *cache_name)
+{
+  char tmp_name[strlen(cache_name) + 40];
+  char md5[MD5_HEX_BYTES + 1];
+  size_t i;
+  FILE *fp;
+
+  fp = secfile_cache_tmp_open(cache_name, secfile,
+                              tmp_name, sizeof(tmp_name));
+  if (fp == NULL) {
+    log_verbose("Cannot write the cache file \"%s\".", cache_name);
+    return;
+  }
+
+  fwrite(SECFILE_CACHE_MAGIC, 1, strlen(SECFILE_CACHE_MAGIC), fp);
+  cache_put_uint32(fp, SECFILE_CACHE_FORMAT);
+  cache_put_str(fp, VERSION_STRING);
+
+  /* The files read. */
+  cache_put_uint32(fp, 1 + strvec_size(deps) / 2);
+  if (!file_md5sum(real_filename, md5)) {
+    fclose(fp);
+    fc_remove(tmp_name);
+    return;
+  }
+  cache_put_str(fp, NULL);
+  cache_put_str(fp, real_filename);
+  cache_put_str(fp, md5);
+  for (i = 0; i + 1 < strvec_size(deps); i += 2) {
+    if (!file_md5sum(strvec_get(deps, i + 1), md5)) {
+      fclose(fp);
+      fc_remove(tmp_name);
+      return;
+    }
+    cache_put_str(fp, strvec_get(deps, i));
+    cache_put_str(fp, strvec_get(deps, i + 1));
+    cache_put_str(fp, md5);
+  }
+
+  /* The sections. */
+  cache_put_uint32(fp, section_list_size(secfile->sections));
+  section_list_iterate(secfile->sections, psection) {
+    cache_put_str(fp, psection->name);
+    cache_put_uint32(fp, psection->special);
+    cache_put_uint32(fp, entry_list_size(psection->entries));
+    entry_list_iterate(psection->entries, pentry) {
+      cache_put_str(fp, pentry->name);
+      cache_put_str(fp, pentry->comment);
+      cache_put_uint32(fp, pentry->type);
+      switch (pentry->type) {
+      case ENTRY_BOOL:
+        cache_put_uint32(fp, pentry->boolean.value);
+        break;
+      case ENTRY_INT:
+        cache_put_uint32(fp, pentry->integer.value);
+        break;
+      case ENTRY_FLOAT:
+        {
+          unsigned int bits;
+
+          FC_STATIC_ASSERT(sizeof(bits) == sizeof(pentry->floating.value),
+                           float_not_32_bits);
+          memcpy(&bits, &pentry->floating.value, sizeof(bits));
+          cache_put_uint32(fp, bits);
+        }
+        break;
+      case ENTRY_STR:
+        cache_put_str(fp, pentry->string.value);
+        cache_put_uint32(fp, (pentry->string.escaped
+                              | pentry->string.raw << 1
+                              | pentry->string.gt_marking << 2));
+        break;
+      case ENTRY_FILEREFERENCE:
+        cache_put_str(fp, pentry->string.value);
+        break;
+      case ENTRY_ILLEGAL:
+        fc_assert(pentry->type != ENTRY_ILLEGAL);
+        break;
+      }
+    } entry_list_iterate_end;
+  } section_list_iterate_end;
+
+  if (ferror(fp) || fclose(fp) != 0) {
+    log_verbose("Cannot write the cache file \"%s\".", tmp_name);
+    fc_remove(tmp_name);
+    return;
+  }
+
+  /* Readers never see a partial cache file. */
+  if (rename(tmp_name, cache_name) != 0) {
+    fc_remove(tmp_name);
+  }
+}
+
+/**********************************************************************//**
+  Load the section file from its cache, if the cache is up to date.
+  Returns NULL if it cannot be used.
+**************************************************************************/
+static struct section_file *secfile_cache_load(const char *real_filename,
+                                               const char *filename,
+                                               const char *cache_name)
+{
+  struct section_file *secfile;
+  struct cache_reader reader;
+  unsigned char *data;
+  size_t size;
+  unsigned int num, i, j;
+  size_t magic_len = strlen(SECFILE_CACHE_MAGIC);
+  const char *str;
+
+  data = file_read_all(cache_name, &size);
+  if (data == NULL) {
+    return NULL;
+  }
+
+  reader.pos = data;
+  reader.left = size;
+  reader.error = FALSE;
+
+  if (size < magic_len
+      || memcmp(data, SECFILE_CACHE_MAGIC, magic_len) != 0) {
+    free(data);
+    return NULL;
+  }
+  reader.pos += magic_len;
+  reader.left -= magic_len;
+
+  if (cache_get_uint32(&reader) != SECFILE_CACHE_FORMAT
+      || (str = cache_get_str(&reader)) == NULL
+      || strcmp(str, VERSION_STRING) != 0) {
+    free(data);
+    return NULL;
+  }
+
+  /* Check that the files read are still the same. */
+  num = cache_get_uint32(&reader);
+  for (i = 0; i < num && !reader.error; i++) {
+    const char *name = cache_get_str(&reader);
+    const char *full_name = cache_get_str(&reader);
+    const char *md5 = cache_get_str(&reader);
+    char current_md5[MD5_HEX_BYTES + 1];
+
+    if (reader.error || full_name == NULL || md5 == NULL) {
+      reader.error = TRUE;
+    } else if (name == NULL) {
+      /* The file itself. */
+      if (strcmp(full_name, real_filename) != 0) {
+        reader.error = TRUE;
+      }
+    } else {
+      struct astring found = ASTRING_INIT;
+
+      if (datafilename(name, &found) == NULL
+          || strcmp(astr_str(&found), full_name) != 0) {
+        log_debug("\"%s\" changed place, not using the cache of \"%s\".",
+                  name, filename);
+        reader.error = TRUE;
+      }
+      astr_free(&found);
+    }
+    if (!reader.error
+        && (!file_md5sum(full_name, current_md5)
+            || strcmp(current_md5, md5) != 0)) {
+      log_debug("\"%s\" changed, not using the cache of \"%s\".",
+                full_name, filename);
+      reader.error = TRUE;
+    }
+  }
+  if (reader.error) {
+    free(data);
+    return NULL;
+  }
+
+  secfile = secfile_new(TRUE);
+  secfile->name = fc_strdup(filename);
+
+  num = cache_get_uint32(&reader);
+  for (i = 0; i < num && !reader.error; i++) {
+    const char *name = cache_get_str(&reader);
+    struct section *psection;
+    unsigned int num_entries;
+
+    psection = (name != NULL ? secfile_section_new(secfile, name) : NULL);
+    if (psection == NULL) {
+      reader.error = TRUE;
+      break;
+    }
+    psection->special = cache_get_uint32(&reader);
+    num_entries = cache_get_uint32(&reader);
+
+    for (j = 0; j < num_entries && !reader.error; j++) {
+      const char *entry_name = cache_get_str(&reader);
+      const char *comment = cache_get_str(&reader);
+      enum entry_type type = cache_get_uint32(&reader);
+      struct entry *pentry;
+
+      pentry = (entry_name != NULL ? entry_new(psection, entry_name)
+                : NULL);
+      if (pentry == NULL) {
+        reader.error = TRUE;
+        break;
+      }
+      pentry->comment = (comment != NULL ? fc_strdup(comment) : NULL);
+      pentry->type = type;
+
+      switch (type) {
+      case ENTRY_BOOL:
+        pentry->boolean.value = (cache_get_uint32(&reader) != 0);
+        break;
+      case ENTRY_INT:
+        pentry->integer.value = (int) cache_get_uint32(&reader);
+        break;
+      case ENTRY_FLOAT:
+        {
+          unsigned int bits = cache_get_uint32(&reader);
+
+          memcpy(&pentry->floating.value, &bits, sizeof(bits));
+        }
+        break;
+      case ENTRY_STR:
+      case ENTRY_FILEREFERENCE:
+        str = cache_get_str(&reader);
+        pentry->string.value = fc_strdup(str != NULL ? str : "");
+        if (type == ENTRY_STR) {
+          unsigned int flags = cache_get_uint32(&reader);
+
+          pentry->string.escaped = (flags & 1) != 0;
+          pentry->string.raw = (flags & 2) != 0;
+          pentry->string.gt_marking = (flags & 4) != 0;
+        }
+        break;
+      default:
+        /* Keep it destroyable. */
+        pentry->type = ENTRY_INT;
+        reader.error = TRUE;
+        break;
+      }
+    }
+  }
+  free(data);
+
+  if (reader.error || reader.left != 0) {
+    log_verbose("Corrupted cache for \"%s\".", filename);
+    secfile_destroy(secfile);
+    return NULL;
+  }
+
+  return secfile;
+}
+
+/**********************************************************************//**
+  Create a section file from a file, like secfile_load_section() with no
+  particular section, using a binary cache of the parsed file kept in
+  'cache_dir'. The cache is written when it is missing or out of date.
+  Returns NULL on error.
+**************************************************************************/
+struct section_file *secfile_load_with_cache(const char *filename,
+                                             const char *cache_dir,
+                                             bool allow_duplicates)
+{
+  char real_filename[1024];
+  char cache_name[2048];
+  struct section_file *secfile;
+  struct inputfile *inf;
+  struct strvec *deps;
+
+  interpret_tilde(real_filename, sizeof(real_filename), filename);
+  secfile_cache_name(real_filename, cache_dir, cache_name,
+                     sizeof(cache_name));
+
+  secfile = secfile_cache_load(real_filename, filename, cache_name);
+  if (secfile != NULL) {
+    log_verbose("Reading registry from \"%s\" (cached)", filename);
+    if (!secfile_hash_build(secfile, allow_duplicates)) {
+      secfile_destroy(secfile);
+      return NULL;
+    }
+    return secfile;
+  }
+
+  inf = inf_from_file(real_filename, datafilename);
+  if (inf == NULL) {
+    return NULL;
+  }
+  deps = strvec_new();
+  inf_set_deps(inf, deps);
+  secfile = secfile_from_input_file(inf, filename, NULL, allow_duplicates);
+  if (secfile != NULL) {
+    secfile_cache_save(secfile, real_filename, deps, cache_name);
+  }
+  strvec_destroy(deps);
+
+  return secfile;
+}
+
 /**********************************************************************//**
   Returns TRUE iff the character is legal in a table entry name.
 **************************************************************************/
@@ -2860,6 +3376,64 @@ struct section *secfile_section_new(struct section_file *secfile,
   return psection;
 }
 
+/**********************************************************************//**
+  Move all the entries of 'src' to the end of the sections of the same
+  name in 'dest', creating the sections which 'dest' does not have yet.
+  The values are not copied. The sections of 'src' are left empty.
+**************************************************************************/
+void secfile_move_entries(struct section_file *dest,
+                          struct section_file *src)
+{
+  SECFILE_RETURN_IF_FAIL(dest, NULL, NULL != dest);
+  SECFILE_RETURN_IF_FAIL(src, NULL, NULL != src);
+
+  section_list_iterate(src->sections, psrc) {
+    struct section *pdest = secfile_section_by_name(dest, psrc->name);
+
+    if (NULL == pdest) {
+      pdest = secfile_section_new(dest, psrc->name);
+      if (NULL == pdest) {
+        continue;
+      }
+      pdest->special = psrc->special;
+    }
+
+    entry_list_iterate(psrc->entries, psrc_entry) {
+      struct entry *pentry = entry_new(pdest, psrc_entry->name);
+
+      if (NULL == pentry) {
+        continue;
+      }
+
+      pentry->type = psrc_entry->type;
+      pentry->comment = psrc_entry->comment;
+      psrc_entry->comment = NULL;
+
+      switch (psrc_entry->type) {
+      case ENTRY_BOOL:
+        pentry->boolean = psrc_entry->boolean;
+        break;
+      case ENTRY_INT:
+        pentry->integer = psrc_entry->integer;
+        break;
+      case ENTRY_FLOAT:
+        pentry->floating = psrc_entry->floating;
+        break;
+      case ENTRY_STR:
+      case ENTRY_FILEREFERENCE:
+        pentry->string = psrc_entry->string;
+        psrc_entry->string.value = NULL;
+        break;
+      case ENTRY_ILLEGAL:
+        fc_assert(psrc_entry->type != ENTRY_ILLEGAL);
+        break;
+      }
+    } entry_list_iterate_end;
+
+    section_clear_all(psrc);
+  } section_list_iterate_end;
+}
+
 /**********************************************************************//**
   Remove this section from the secfile.
 **************************************************************************/
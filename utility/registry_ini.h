@@ -62,6 +62,9 @@ struct section_file *secfile_load_section(const char *filename,
                                           bool allow_duplicates);
 struct section_file *secfile_from_stream(fz_FILE *stream,
                                          bool allow_duplicates);
+struct section_file *secfile_load_with_cache(const char *filename,
+                                             const char *cache_dir,
+                                             bool allow_duplicates);
 
 bool secfile_save(const struct section_file *secfile, const char *filename,
                   int compression_level, enum fz_method compression_method);
@@ -584,6 +587,8 @@ secfile_sections_by_name_prefix(const struct section_file *secfile,
                                 const char *prefix);
 struct section *secfile_section_new(struct section_file *secfile,
                                     const char *section_name);
+void secfile_move_entries(struct section_file *dest,
+                          struct section_file *src);
 
 
 /* Independant section functions. */
@@ -25,7 +25,14 @@
 
 #define MAX_LEN_ERRORBUF 1024
 
+/* One per thread where possible, as ruleset files get parsed in
+ * parallel. */
+#ifdef HAVE_C11_THREAD_LOCAL
+static _Thread_local char error_buffer[MAX_LEN_ERRORBUF] = "\0";
+#else
 static char error_buffer[MAX_LEN_ERRORBUF] = "\0";
+#endif
+
 
 /* Debug function for every new entry. */
 #define DEBUG_ENTRIES(...) /* log_debug(__VA_ARGS__); */
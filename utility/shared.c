@@ -1043,11 +1043,20 @@ struct strvec *fileinfolist(const struct strvec *dirs, const char *suffix)
   data directories.  (A file is considered "found" if it can be
   read-opened.)  The returned pointer points to static memory, so this
   function can only supply one filename at a time.  Don't free that
-  pointer.
-
-  TODO: Make this re-entrant
+  pointer. See fileinfoname_astr() for a re-entrant version.
 ****************************************************************************/
 const char *fileinfoname(const struct strvec *dirs, const char *filename)
+{
+  return fileinfoname_astr(dirs, filename, &realfile);
+}
+
+/************************************************************************//**
+  Like fileinfoname(), but the filename is stored in 'realfile', and the
+  returned pointer is valid as long as 'realfile' is not changed. This
+  one can be used by several threads at once.
+****************************************************************************/
+const char *fileinfoname_astr(const struct strvec *dirs, const char *filename,
+                              struct astring *realfile)
 {
 #ifndef DIR_SEPARATOR_IS_DEFAULT
   char fnbuf[filename != NULL ? strlen(filename) + 1 : 1];
@@ -1063,17 +1072,17 @@ const char *fileinfoname(const struct strvec *dirs, const char *filename)
   if (!filename) {
     bool first = TRUE;
 
-    astr_clear(&realfile);
+    astr_clear(realfile);
     strvec_iterate(dirs, dirname) {
       if (first) {
-        astr_add(&realfile, "%s%s", PATH_SEPARATOR, dirname);
+        astr_add(realfile, "%s%s", PATH_SEPARATOR, dirname);
         first = FALSE;
       } else {
-        astr_add(&realfile, "%s", dirname);
+        astr_add(realfile, "%s", dirname);
       }
     } strvec_iterate_end;
 
-    return astr_str(&realfile);
+    return astr_str(realfile);
   }
 
 #ifndef DIR_SEPARATOR_IS_DEFAULT
@@ -1090,9 +1099,9 @@ const char *fileinfoname(const struct strvec *dirs, const char *filename)
   strvec_iterate(dirs, dirname) {
     struct stat buf;    /* see if we can open the file or directory */
 
-    astr_set(&realfile, "%s" DIR_SEPARATOR "%s", dirname, fnbuf);
-    if (fc_stat(astr_str(&realfile), &buf) == 0) {
-      return astr_str(&realfile);
+    astr_set(realfile, "%s" DIR_SEPARATOR "%s", dirname, fnbuf);
+    if (fc_stat(astr_str(realfile), &buf) == 0) {
+      return astr_str(realfile);
     }
   } strvec_iterate_end;
 
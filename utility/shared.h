@@ -27,6 +27,8 @@ extern "C" {
 #include "log.h"
 #include "support.h" /* bool, fc__attribute */
 
+struct astring;
+
 /* Changing these will break network compatability! */
 #define MAX_LEN_ADDR     256	/* see also MAXHOSTNAMELEN and RFC 1123 2.1 */
 #define MAX_LEN_PATH    4095
@@ -196,6 +198,8 @@ struct strvec *fileinfolist(const struct strvec *dirs, const char *suffix);
 struct fileinfo_list *fileinfolist_infix(const struct strvec *dirs,
                                          const char *infix, bool nodups);
 const char *fileinfoname(const struct strvec *dirs, const char *filename);
+const char *fileinfoname_astr(const struct strvec *dirs, const char *filename,
+                              struct astring *realfile);
 void free_fileinfo_data(void);
 
 void init_nls(void);